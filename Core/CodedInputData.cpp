@@ -39,215 +39,367 @@ CodedInputData::CodedInputData(const void *oData, size_t length)
     MMKV_ASSERT(m_ptr);
 }
 
-void CodedInputData::seek(size_t addedSize) {
-    if (m_position + addedSize > m_size) {
-        throw out_of_range("OutOfSpace");
+// exception-free decoding
+
+bool CodedInputData::trySeek(size_t addedSize) {
+    if (mmkv_unlikely(addedSize > m_size - m_position)) {
+        return false;
     }
     m_position += addedSize;
+    return true;
 }
 
-double CodedInputData::readDouble() {
-    return Int64ToFloat64(this->readRawLittleEndian64());
+bool CodedInputData::tryReadRawByte(int8_t &value) {
+    if (mmkv_unlikely(m_position == m_size)) {
+        return false;
+    }
+    auto *bytes = (int8_t *) m_ptr;
+    value = bytes[m_position++];
+    return true;
 }
 
-float CodedInputData::readFloat() {
-    return Int32ToFloat32(this->readRawLittleEndian32());
+bool CodedInputData::tryReadRawVarint32(int32_t &value) {
+    int8_t tmp = 0;
+    if (!tryReadRawByte(tmp)) {
+        return false;
+    }
+    if (tmp >= 0) {
+        value = tmp;
+        return true;
+    }
+    int32_t result = tmp & 0x7f;
+    for (int32_t shift = 7; shift < 28; shift += 7) {
+        if (!tryReadRawByte(tmp)) {
+            return false;
+        }
+        if (tmp >= 0) {
+            value = result | (tmp << shift);
+            return true;
+        }
+        result |= (tmp & 0x7f) << shift;
+    }
+    if (!tryReadRawByte(tmp)) {
+        return false;
+    }
+    result |= tmp << 28;
+    if (tmp < 0) {
+        // discard upper 32 bits
+        for (int i = 0; i < 5; i++) {
+            if (!tryReadRawByte(tmp)) {
+                return false;
+            }
+            if (tmp >= 0) {
+                value = result;
+                return true;
+            }
+        }
+        // malformed varint32
+        return false;
+    }
+    value = result;
+    return true;
 }
 
-int64_t CodedInputData::readInt64() {
+bool CodedInputData::tryReadRawLittleEndian32(int32_t &value) {
+    if (mmkv_unlikely(m_size - m_position < 4)) {
+        return false;
+    }
+    auto bytes = m_ptr + m_position;
+    value = static_cast<int32_t>(((uint32_t) bytes[0]) | ((uint32_t) bytes[1] << 8) | ((uint32_t) bytes[2] << 16) |
+                                 ((uint32_t) bytes[3] << 24));
+    m_position += 4;
+    return true;
+}
+
+bool CodedInputData::tryReadRawLittleEndian64(int64_t &value) {
+    if (mmkv_unlikely(m_size - m_position < 8)) {
+        return false;
+    }
+    auto bytes = m_ptr + m_position;
+    value = static_cast<int64_t>(((uint64_t) bytes[0]) | ((uint64_t) bytes[1] << 8) | ((uint64_t) bytes[2] << 16) |
+                                 ((uint64_t) bytes[3] << 24) | ((uint64_t) bytes[4] << 32) |
+                                 ((uint64_t) bytes[5] << 40) | ((uint64_t) bytes[6] << 48) |
+                                 ((uint64_t) bytes[7] << 56));
+    m_position += 8;
+    return true;
+}
+
+// a non-negative length prefix that fits in the remaining data
+bool CodedInputData::tryReadSize(size_t &size) {
+    int32_t length = 0;
+    if (!tryReadRawVarint32(length) || length < 0) {
+        return false;
+    }
+    size = static_cast<size_t>(length);
+    return size <= m_size - m_position;
+}
+
+bool CodedInputData::tryReadDouble(double &value) {
+    int64_t raw = 0;
+    if (!tryReadRawLittleEndian64(raw)) {
+        return false;
+    }
+    value = Int64ToFloat64(raw);
+    return true;
+}
+
+bool CodedInputData::tryReadFloat(float &value) {
+    int32_t raw = 0;
+    if (!tryReadRawLittleEndian32(raw)) {
+        return false;
+    }
+    value = Int32ToFloat32(raw);
+    return true;
+}
+
+bool CodedInputData::tryReadInt64(int64_t &value) {
     int32_t shift = 0;
     int64_t result = 0;
     while (shift < 64) {
-        int8_t b = this->readRawByte();
-        result |= (int64_t)(b & 0x7f) << shift;
+        int8_t b = 0;
+        if (!tryReadRawByte(b)) {
+            return false;
+        }
+        result |= (int64_t) (b & 0x7f) << shift;
         if ((b & 0x80) == 0) {
-            return result;
+            value = result;
+            return true;
         }
         shift += 7;
     }
-    throw invalid_argument("InvalidProtocolBuffer malformedInt64");
+    // malformed int64
+    return false;
 }
 
-uint64_t CodedInputData::readUInt64() {
-    return static_cast<uint64_t>(readInt64());
+bool CodedInputData::tryReadUInt64(uint64_t &value) {
+    int64_t raw = 0;
+    if (!tryReadInt64(raw)) {
+        return false;
+    }
+    value = static_cast<uint64_t>(raw);
+    return true;
 }
 
-int32_t CodedInputData::readInt32() {
-    return this->readRawVarint32();
+bool CodedInputData::tryReadInt32(int32_t &value) {
+    return tryReadRawVarint32(value);
 }
 
-uint32_t CodedInputData::readUInt32() {
-    return static_cast<uint32_t>(readRawVarint32());
+bool CodedInputData::tryReadUInt32(uint32_t &value) {
+    int32_t raw = 0;
+    if (!tryReadRawVarint32(raw)) {
+        return false;
+    }
+    value = static_cast<uint32_t>(raw);
+    return true;
 }
 
-bool CodedInputData::readBool() {
-    return this->readRawVarint32() != 0;
+bool CodedInputData::tryReadBool(bool &value) {
+    int32_t raw = 0;
+    if (!tryReadRawVarint32(raw)) {
+        return false;
+    }
+    value = (raw != 0);
+    return true;
 }
 
-string CodedInputData::readString() {
-    int32_t size = readRawVarint32();
-    if (size < 0) {
-        throw length_error("InvalidProtocolBuffer negativeSize");
+bool CodedInputData::tryReadString(string &s) {
+    size_t s_size = 0;
+    if (!tryReadSize(s_size)) {
+        return false;
     }
+    s.resize(s_size);
+    memcpy((void *) s.data(), (char *) (m_ptr + m_position), s_size);
+    m_position += s_size;
+    return true;
+}
 
-    auto s_size = static_cast<size_t>(size);
-    if (s_size <= m_size - m_position) {
-        string result((char *) (m_ptr + m_position), s_size);
-        m_position += s_size;
-        return result;
-    } else {
-        throw out_of_range("InvalidProtocolBuffer truncatedMessage");
+bool CodedInputData::tryReadString(KeyValueHolder &kvHolder, string &key) {
+    kvHolder.offset = static_cast<uint32_t>(m_position);
+
+    size_t s_size = 0;
+    if (!tryReadSize(s_size) || s_size > mmkv::KeySizeLimit) {
+        return false;
     }
+    kvHolder.keySize = static_cast<uint16_t>(s_size);
+
+    key.assign((char *) (m_ptr + m_position), s_size);
+    m_position += s_size;
+    return true;
 }
 
-void CodedInputData::readString(string &s) {
-    int32_t size = readRawVarint32();
-    if (size < 0) {
-        throw length_error("InvalidProtocolBuffer negativeSize");
+bool CodedInputData::tryReadData(MMBuffer &value, bool copy, bool exactly) {
+    size_t s_size = 0;
+    if (!tryReadSize(s_size)) {
+        return false;
     }
+    if (exactly && s_size != m_size - m_position) {
+        return false;
+    }
+    size_t pos = m_position;
+    m_position += s_size;
+    auto copyFlag = copy ? MMBufferCopy : MMBufferNoCopy;
+    value = MMBuffer(((int8_t *) m_ptr) + pos, s_size, copyFlag);
+    return true;
+}
 
-    auto s_size = static_cast<size_t>(size);
-    if (s_size <= m_size - m_position) {
-        s.resize(s_size);
-        memcpy((void *) s.data(), (char *) (m_ptr + m_position), s_size);
-        m_position += s_size;
-    } else {
-        throw out_of_range("InvalidProtocolBuffer truncatedMessage");
+bool CodedInputData::tryReadData(KeyValueHolder &kvHolder) {
+    size_t s_size = 0;
+    if (!tryReadSize(s_size)) {
+        return false;
+    }
+    auto kvSize = m_position - kvHolder.offset;
+    if (kvSize > UINT16_MAX) {
+        return false;
     }
+    kvHolder.computedKVSize = static_cast<uint16_t>(kvSize);
+    kvHolder.valueSize = static_cast<uint32_t>(s_size);
+
+    m_position += s_size;
+    return true;
 }
 
-string CodedInputData::readString(KeyValueHolder &kvHolder) {
-    kvHolder.offset = static_cast<uint32_t>(m_position);
+template <typename T, typename U>
+static bool readPackedVarints(const uint8_t *ptr, size_t size, vector<T> &result,
+                              bool (*decode)(const uint8_t *ptr, size_t size, U *output)) {
+    static_assert(sizeof(T) == sizeof(U), "size not match");
+    size_t count = 0;
+    if (!pbCountVarints(ptr, size, count)) {
+        return false;
+    }
+    auto oldSize = result.size();
+    result.resize(oldSize + count);
+    if (!decode(ptr, size, reinterpret_cast<U *>(result.data() + oldSize))) {
+        result.resize(oldSize);
+        return false;
+    }
+    return true;
+}
 
-    int32_t size = this->readRawVarint32();
-    if (size < 0) {
-        throw length_error("InvalidProtocolBuffer negativeSize");
+bool CodedInputData::tryReadPackedVarints(vector<int32_t> &result) {
+    if (!readPackedVarints(m_ptr + m_position, m_size - m_position, result, pbDecodeVarints32)) {
+        return false;
     }
+    m_position = m_size;
+    return true;
+}
 
-    auto s_size = static_cast<size_t>(size);
-    if (s_size <= m_size - m_position) {
-        if (s_size > mmkv::KeySizeLimit) {
-            throw length_error("MMKV key too large for uint16 holder");
-        }
-        kvHolder.keySize = static_cast<uint16_t>(s_size);
+bool CodedInputData::tryReadPackedVarints(vector<uint32_t> &result) {
+    if (!readPackedVarints(m_ptr + m_position, m_size - m_position, result, pbDecodeVarints32)) {
+        return false;
+    }
+    m_position = m_size;
+    return true;
+}
 
-        auto ptr = m_ptr + m_position;
-        string result((char *) ptr, s_size);
-        m_position += s_size;
-        return result;
-    } else {
-        throw out_of_range("InvalidProtocolBuffer truncatedMessage");
+bool CodedInputData::tryReadPackedVarints(vector<int64_t> &result) {
+    if (!readPackedVarints(m_ptr + m_position, m_size - m_position, result, pbDecodeVarints64)) {
+        return false;
     }
+    m_position = m_size;
+    return true;
 }
 
-MMBuffer CodedInputData::readRealData(mmkv::MMBuffer & data) {
-    CodedInputData input(data.getPtr(), data.length());
-    return input.readData(false, true);
+bool CodedInputData::tryReadPackedVarints(vector<uint64_t> &result) {
+    if (!readPackedVarints(m_ptr + m_position, m_size - m_position, result, pbDecodeVarints64)) {
+        return false;
+    }
+    m_position = m_size;
+    return true;
 }
 
-MMBuffer CodedInputData::readData(bool copy, bool exactly) {
-    int32_t size = this->readRawVarint32();
-    if (size < 0) {
-        throw length_error("InvalidProtocolBuffer negativeSize");
-    }
-
-    auto s_size = static_cast<size_t>(size);
-    bool isSizeValid = exactly ? (s_size == m_size - m_position) : (s_size <= m_size - m_position);
-    if (isSizeValid) {
-        size_t pos = m_position;
-        m_position += s_size;
-        auto copyFlag = copy ? MMBufferCopy : MMBufferNoCopy;
-        return MMBuffer(((int8_t *) m_ptr) + pos, s_size, copyFlag);
-    } else {
+// throwing decoding, built on top of the exception-free one
+
+void CodedInputData::seek(size_t addedSize) {
+    if (!trySeek(addedSize)) {
+        throw out_of_range("OutOfSpace");
+    }
+}
+
+double CodedInputData::readDouble() {
+    double value = 0;
+    if (!tryReadDouble(value)) {
         throw out_of_range("InvalidProtocolBuffer truncatedMessage");
     }
+    return value;
 }
 
-void CodedInputData::readData(KeyValueHolder &kvHolder) {
-    int32_t size = this->readRawVarint32();
-    if (size < 0) {
-        throw length_error("InvalidProtocolBuffer negativeSize");
+float CodedInputData::readFloat() {
+    float value = 0;
+    if (!tryReadFloat(value)) {
+        throw out_of_range("InvalidProtocolBuffer truncatedMessage");
     }
+    return value;
+}
 
-    auto s_size = static_cast<size_t>(size);
-    if (s_size <= m_size - m_position) {
-        auto kvSize = m_position - kvHolder.offset;
-        if (kvSize > UINT16_MAX) {
-            throw length_error("MMKV computed KV size too large for uint16 holder");
-        }
-        kvHolder.computedKVSize = static_cast<uint16_t>(kvSize);
-        kvHolder.valueSize = static_cast<uint32_t>(s_size);
+int64_t CodedInputData::readInt64() {
+    int64_t value = 0;
+    if (!tryReadInt64(value)) {
+        throw invalid_argument("InvalidProtocolBuffer malformedInt64");
+    }
+    return value;
+}
+
+uint64_t CodedInputData::readUInt64() {
+    return static_cast<uint64_t>(readInt64());
+}
+
+int32_t CodedInputData::readInt32() {
+    return this->readRawVarint32();
+}
+
+uint32_t CodedInputData::readUInt32() {
+    return static_cast<uint32_t>(readRawVarint32());
+}
 
-        m_position += s_size;
-    } else {
+bool CodedInputData::readBool() {
+    return this->readRawVarint32() != 0;
+}
+
+string CodedInputData::readString() {
+    string result;
+    readString(result);
+    return result;
+}
+
+void CodedInputData::readString(string &s) {
+    if (!tryReadString(s)) {
         throw out_of_range("InvalidProtocolBuffer truncatedMessage");
     }
 }
 
-int32_t CodedInputData::readRawVarint32() {
-    int8_t tmp = this->readRawByte();
-    if (tmp >= 0) {
-        return tmp;
-    }
-    int32_t result = tmp & 0x7f;
-    if ((tmp = this->readRawByte()) >= 0) {
-        result |= tmp << 7;
-    } else {
-        result |= (tmp & 0x7f) << 7;
-        if ((tmp = this->readRawByte()) >= 0) {
-            result |= tmp << 14;
-        } else {
-            result |= (tmp & 0x7f) << 14;
-            if ((tmp = this->readRawByte()) >= 0) {
-                result |= tmp << 21;
-            } else {
-                result |= (tmp & 0x7f) << 21;
-                result |= (tmp = this->readRawByte()) << 28;
-                if (tmp < 0) {
-                    // discard upper 32 bits
-                    for (int i = 0; i < 5; i++) {
-                        if (this->readRawByte() >= 0) {
-                            return result;
-                        }
-                    }
-                    throw invalid_argument("InvalidProtocolBuffer malformed varint32");
-                }
-            }
-        }
+string CodedInputData::readString(KeyValueHolder &kvHolder) {
+    string result;
+    if (!tryReadString(kvHolder, result)) {
+        throw out_of_range("InvalidProtocolBuffer truncatedMessage");
     }
     return result;
 }
 
-int32_t CodedInputData::readRawLittleEndian32() {
-    int8_t b1 = this->readRawByte();
-    int8_t b2 = this->readRawByte();
-    int8_t b3 = this->readRawByte();
-    int8_t b4 = this->readRawByte();
-    return (((int32_t) b1 & 0xff)) | (((int32_t) b2 & 0xff) << 8) | (((int32_t) b3 & 0xff) << 16) |
-           (((int32_t) b4 & 0xff) << 24);
+MMBuffer CodedInputData::readRealData(mmkv::MMBuffer & data) {
+    CodedInputData input(data.getPtr(), data.length());
+    return input.readData(false, true);
+}
+
+MMBuffer CodedInputData::readData(bool copy, bool exactly) {
+    MMBuffer result;
+    if (!tryReadData(result, copy, exactly)) {
+        throw out_of_range("InvalidProtocolBuffer truncatedMessage");
+    }
+    return result;
 }
 
-int64_t CodedInputData::readRawLittleEndian64() {
-    int8_t b1 = this->readRawByte();
-    int8_t b2 = this->readRawByte();
-    int8_t b3 = this->readRawByte();
-    int8_t b4 = this->readRawByte();
-    int8_t b5 = this->readRawByte();
-    int8_t b6 = this->readRawByte();
-    int8_t b7 = this->readRawByte();
-    int8_t b8 = this->readRawByte();
-    return (((int64_t) b1 & 0xff)) | (((int64_t) b2 & 0xff) << 8) | (((int64_t) b3 & 0xff) << 16) |
-           (((int64_t) b4 & 0xff) << 24) | (((int64_t) b5 & 0xff) << 32) | (((int64_t) b6 & 0xff) << 40) |
-           (((int64_t) b7 & 0xff) << 48) | (((int64_t) b8 & 0xff) << 56);
+void CodedInputData::readData(KeyValueHolder &kvHolder) {
+    if (!tryReadData(kvHolder)) {
+        throw out_of_range("InvalidProtocolBuffer truncatedMessage");
+    }
 }
 
-int8_t CodedInputData::readRawByte() {
-    if (m_position == m_size) {
-        auto msg = "reach end, m_position: " + to_string(m_position) + ", m_size: " + to_string(m_size);
-        throw out_of_range(msg);
+int32_t CodedInputData::readRawVarint32() {
+    int32_t value = 0;
+    if (!tryReadRawVarint32(value)) {
+        throw invalid_argument("InvalidProtocolBuffer malformed varint32");
     }
-    auto *bytes = (int8_t *) m_ptr;
-    return bytes[m_position++];
+    return value;
 }
 
 #ifdef MMKV_APPLE
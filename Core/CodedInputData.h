@@ -27,6 +27,7 @@
 #include "KeyValueHolder.h"
 #include "MMBuffer.h"
 #include <cstdint>
+#include <vector>
 
 namespace mmkv {
 
@@ -35,13 +36,17 @@ class CodedInputData {
     size_t m_size;
     size_t m_position;
 
-    int8_t readRawByte();
+    bool tryReadRawByte(int8_t &value);
 
-    int32_t readRawVarint32();
+    bool tryReadRawVarint32(int32_t &value);
+
+    bool tryReadRawLittleEndian32(int32_t &value);
 
-    int32_t readRawLittleEndian32();
+    bool tryReadRawLittleEndian64(int64_t &value);
 
-    int64_t readRawLittleEndian64();
+    bool tryReadSize(size_t &size);
+
+    int32_t readRawVarint32();
 
 public:
     CodedInputData(const void *oData, size_t length);
@@ -50,6 +55,38 @@ public:
 
     void seek(size_t addedSize);
 
+    // exception-free decoding, return false on truncated or malformed data
+    // the read position is unspecified after a failure
+    bool trySeek(size_t addedSize);
+
+    bool tryReadBool(bool &value);
+
+    bool tryReadDouble(double &value);
+
+    bool tryReadFloat(float &value);
+
+    bool tryReadInt64(int64_t &value);
+
+    bool tryReadUInt64(uint64_t &value);
+
+    bool tryReadInt32(int32_t &value);
+
+    bool tryReadUInt32(uint32_t &value);
+
+    bool tryReadData(MMBuffer &value, bool copy = true, bool exactly = false);
+    bool tryReadData(KeyValueHolder &kvHolder);
+
+    bool tryReadString(std::string &s);
+    bool tryReadString(KeyValueHolder &kvHolder, std::string &key);
+
+    // bulk decode all the remaining data as packed varints, appended to result
+    bool tryReadPackedVarints(std::vector<int32_t> &result);
+    bool tryReadPackedVarints(std::vector<uint32_t> &result);
+    bool tryReadPackedVarints(std::vector<int64_t> &result);
+    bool tryReadPackedVarints(std::vector<uint64_t> &result);
+
+    // the throwing version of the above
+
     bool readBool();
 
     double readDouble();
@@ -58,23 +58,36 @@ CodedInputDataCrypt::~CodedInputDataCrypt() {
     }
 }
 
-void CodedInputDataCrypt::seek(size_t addedSize) {
+bool CodedInputDataCrypt::trySeek(size_t addedSize) {
+    if (mmkv_unlikely(addedSize > m_size - m_position)) {
+        return false;
+    }
     m_position += addedSize;
     m_decryptPosition += addedSize;
 
-    if (m_position > m_size) {
+    assert(m_position % AES_IV_LEN == m_decrypter.m_number);
+    return true;
+}
+
+void CodedInputDataCrypt::seek(size_t addedSize) {
+    if (!trySeek(addedSize)) {
         throw out_of_range("OutOfSpace");
     }
-    assert(m_position % AES_IV_LEN == m_decrypter.m_number);
 }
 
 void CodedInputDataCrypt::consumeBytes(size_t length, bool discardPreData) {
+    if (!tryConsumeBytes(length, discardPreData)) {
+        throw runtime_error(strerror(errno));
+    }
+}
+
+bool CodedInputDataCrypt::tryConsumeBytes(size_t length, bool discardPreData) {
     if (discardPreData) {
         m_decryptBufferDiscardPosition = m_decryptBufferPosition;
     }
     auto decryptedBytesLeft = m_decryptBufferDecryptLength - m_decryptBufferPosition;
     if (decryptedBytesLeft >= length) {
-        return;
+        return true;
     }
     length -= decryptedBytesLeft;
 
@@ -114,7 +127,7 @@ void CodedInputDataCrypt::consumeBytes(size_t length, bool discardPreData) {
         auto newSize = m_decryptBufferSize + length;
         auto newBuffer = realloc(m_decryptBuffer, newSize);
         if (!newBuffer) {
-            throw runtime_error(strerror(errno));
+            return false;
         }
         m_decryptBuffer = (uint8_t *) newBuffer;
         m_decryptBufferSize = newSize;
@@ -123,6 +136,7 @@ void CodedInputDataCrypt::consumeBytes(size_t length, bool discardPreData) {
     m_decryptPosition += length;
     m_decryptBufferDecryptLength += length;
     assert(m_decryptPosition == m_size || m_decrypter.m_number == 0);
+    return true;
 }
 
 void CodedInputDataCrypt::skipBytes(size_t length) {
@@ -165,112 +179,175 @@ inline void CodedInputDataCrypt::statusBeforeDecrypt(size_t rollbackSize, AESCry
                                     rollbackSize, status);
 }
 
-int8_t CodedInputDataCrypt::readRawByte() {
+bool CodedInputDataCrypt::tryReadRawByte(int8_t &value) {
     assert(m_position <= m_decryptPosition);
-    if (m_position == m_size) {
-        auto msg = "reach end, m_position: " + to_string(m_position) + ", m_size: " + to_string(m_size);
-        throw out_of_range(msg);
+    if (mmkv_unlikely(m_position == m_size)) {
+        return false;
     }
     m_position++;
 
     assert(m_decryptBufferPosition < m_decryptBufferSize);
     auto *bytes = (int8_t *) m_decryptBuffer;
-    return bytes[m_decryptBufferPosition++];
+    value = bytes[m_decryptBufferPosition++];
+    return true;
 }
 
-int32_t CodedInputDataCrypt::readRawVarint32(bool discardPreData) {
-    consumeBytes(10, discardPreData);
+bool CodedInputDataCrypt::tryReadRawVarint32(int32_t &value, bool discardPreData) {
+    if (!tryConsumeBytes(10, discardPreData)) {
+        return false;
+    }
 
-    int8_t tmp = this->readRawByte();
+    int8_t tmp = 0;
+    if (!tryReadRawByte(tmp)) {
+        return false;
+    }
     if (tmp >= 0) {
-        return tmp;
+        value = tmp;
+        return true;
     }
     int32_t result = tmp & 0x7f;
-    if ((tmp = this->readRawByte()) >= 0) {
-        result |= tmp << 7;
-    } else {
-        result |= (tmp & 0x7f) << 7;
-        if ((tmp = this->readRawByte()) >= 0) {
-            result |= tmp << 14;
-        } else {
-            result |= (tmp & 0x7f) << 14;
-            if ((tmp = this->readRawByte()) >= 0) {
-                result |= tmp << 21;
-            } else {
-                result |= (tmp & 0x7f) << 21;
-                result |= (tmp = this->readRawByte()) << 28;
-                if (tmp < 0) {
-                    // discard upper 32 bits
-                    for (int i = 0; i < 5; i++) {
-                        if (this->readRawByte() >= 0) {
-                            return result;
-                        }
-                    }
-                    throw invalid_argument("InvalidProtocolBuffer malformed varint32");
-                }
+    for (int32_t shift = 7; shift < 28; shift += 7) {
+        if (!tryReadRawByte(tmp)) {
+            return false;
+        }
+        if (tmp >= 0) {
+            value = result | (tmp << shift);
+            return true;
+        }
+        result |= (tmp & 0x7f) << shift;
+    }
+    if (!tryReadRawByte(tmp)) {
+        return false;
+    }
+    result |= tmp << 28;
+    if (tmp < 0) {
+        // discard upper 32 bits
+        for (int i = 0; i < 5; i++) {
+            if (!tryReadRawByte(tmp)) {
+                return false;
+            }
+            if (tmp >= 0) {
+                value = result;
+                return true;
             }
         }
+        // malformed varint32
+        return false;
     }
-    return result;
+    value = result;
+    return true;
 }
 
-int32_t CodedInputDataCrypt::readInt32() {
-    return this->readRawVarint32();
+bool CodedInputDataCrypt::tryReadInt32(int32_t &value) {
+    return tryReadRawVarint32(value);
 }
 
-string CodedInputDataCrypt::readString(KeyValueHolderCrypt &kvHolder) {
+bool CodedInputDataCrypt::tryReadString(KeyValueHolderCrypt &kvHolder, string &key) {
     kvHolder.offset = static_cast<uint32_t>(m_position);
 
-    int32_t size = this->readRawVarint32(true);
-    if (size < 0) {
-        throw length_error("InvalidProtocolBuffer negativeSize");
+    int32_t size = 0;
+    if (!tryReadRawVarint32(size, true) || size < 0) {
+        return false;
+    }
+    auto s_size = static_cast<size_t>(size);
+    if (s_size > m_size - m_position || s_size > mmkv::KeySizeLimit) {
+        return false;
+    }
+    if (!tryConsumeBytes(s_size)) {
+        return false;
     }
+    kvHolder.keySize = static_cast<uint16_t>(s_size);
 
+    key.assign((char *) (m_decryptBuffer + m_decryptBufferPosition), s_size);
+    m_position += s_size;
+    m_decryptBufferPosition += s_size;
+    return true;
+}
+
+bool CodedInputDataCrypt::tryReadData(KeyValueHolderCrypt &kvHolder) {
+    int32_t size = 0;
+    if (!tryReadRawVarint32(size) || size < 0) {
+        return false;
+    }
     auto s_size = static_cast<size_t>(size);
-    if (s_size <= m_size - m_position) {
-        consumeBytes(s_size);
+    if (s_size > m_size - m_position) {
+        return false;
+    }
+    auto storedAsOffset = KeyValueHolderCrypt::isValueStoredAsOffset(s_size);
+    if (!storedAsOffset && s_size > KeyValueHolderCrypt::SmallBufferSize()) {
+        if (s_size > m_memoryBudget) {
+            storedAsOffset = true;
+        } else {
+            m_memoryBudget -= s_size;
+        }
+    }
+    if (storedAsOffset) {
+        kvHolder.type = KeyValueHolderType_Offset;
+        kvHolder.valueSize = static_cast<uint32_t>(s_size);
+        kvHolder.pbKeyValueSize =
+            static_cast<uint8_t>(pbRawVarint32Size(kvHolder.valueSize) + pbRawVarint32Size(kvHolder.keySize));
 
-        if (s_size > mmkv::KeySizeLimit) {
-            throw length_error("MMKV key too large for uint16 holder");
+        size_t rollbackSize = kvHolder.pbKeyValueSize + kvHolder.keySize;
+        statusBeforeDecrypt(rollbackSize, kvHolder.cryptStatus);
+
+        skipBytes(s_size);
+    } else {
+        if (!tryConsumeBytes(s_size)) {
+            return false;
         }
-        kvHolder.keySize = static_cast<uint16_t>(s_size);
 
-        string result((char *) (m_decryptBuffer + m_decryptBufferPosition), s_size);
-        m_position += s_size;
+        kvHolder.type = KeyValueHolderType_Direct;
+#ifdef MMKV_HAS_ARENA
+        if (m_arena) {
+            kvHolder = KeyValueHolderCrypt(m_decryptBuffer + m_decryptBufferPosition, s_size, m_arena);
+        } else
+#endif
+        {
+            kvHolder = KeyValueHolderCrypt(m_decryptBuffer + m_decryptBufferPosition, s_size);
+        }
         m_decryptBufferPosition += s_size;
-        return result;
-    } else {
-        throw out_of_range("InvalidProtocolBuffer truncatedMessage");
+        m_position += s_size;
     }
+    return true;
 }
 
-void CodedInputDataCrypt::readData(KeyValueHolderCrypt &kvHolder) {
-    int32_t size = this->readRawVarint32();
-    if (size < 0) {
-        throw length_error("InvalidProtocolBuffer negativeSize");
+bool CodedInputDataCrypt::trySkipData() {
+    int32_t size = 0;
+    if (!tryReadRawVarint32(size) || size < 0) {
+        return false;
     }
-
     auto s_size = static_cast<size_t>(size);
-    if (s_size <= m_size - m_position) {
-        if (KeyValueHolderCrypt::isValueStoredAsOffset(s_size)) {
-            kvHolder.type = KeyValueHolderType_Offset;
-            kvHolder.valueSize = static_cast<uint32_t>(s_size);
-            kvHolder.pbKeyValueSize =
-                static_cast<uint8_t>(pbRawVarint32Size(kvHolder.valueSize) + pbRawVarint32Size(kvHolder.keySize));
+    if (s_size > m_size - m_position) {
+        return false;
+    }
+    skipBytes(s_size);
+    return true;
+}
 
-            size_t rollbackSize = kvHolder.pbKeyValueSize + kvHolder.keySize;
-            statusBeforeDecrypt(rollbackSize, kvHolder.cryptStatus);
+// throwing decoding, built on top of the exception-free one
 
-            skipBytes(s_size);
-        } else {
-            consumeBytes(s_size);
+int32_t CodedInputDataCrypt::readRawVarint32(bool discardPreData) {
+    int32_t value = 0;
+    if (!tryReadRawVarint32(value, discardPreData)) {
+        throw invalid_argument("InvalidProtocolBuffer malformed varint32");
+    }
+    return value;
+}
 
-            kvHolder.type = KeyValueHolderType_Direct;
-            kvHolder = KeyValueHolderCrypt(m_decryptBuffer + m_decryptBufferPosition, s_size);
-            m_decryptBufferPosition += s_size;
-            m_position += s_size;
-        }
-    } else {
+int32_t CodedInputDataCrypt::readInt32() {
+    return this->readRawVarint32();
+}
+
+string CodedInputDataCrypt::readString(KeyValueHolderCrypt &kvHolder) {
+    string result;
+    if (!tryReadString(kvHolder, result)) {
+        throw out_of_range("InvalidProtocolBuffer truncatedMessage");
+    }
+    return result;
+}
+
+void CodedInputDataCrypt::readData(KeyValueHolderCrypt &kvHolder) {
+    if (!tryReadData(kvHolder)) {
         throw out_of_range("InvalidProtocolBuffer truncatedMessage");
     }
 }
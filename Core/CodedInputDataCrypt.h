@@ -51,12 +51,19 @@ class CodedInputDataCrypt {
     size_t m_decryptBufferPosition; // reader position in the buffer, synced with m_position
     size_t m_decryptBufferDecryptLength; // length of the buffer that has been used
     size_t m_decryptBufferDiscardPosition; // recycle position, any data before that can be discarded
+#ifdef MMKV_HAS_ARENA
+    MMKVArena *m_arena = nullptr;
+#endif
+    size_t m_memoryBudget = SIZE_MAX;
 
+    bool tryConsumeBytes(size_t length, bool discardPreData = false);
     void consumeBytes(size_t length, bool discardPreData = false);
     void skipBytes(size_t length);
     void statusBeforeDecrypt(size_t rollbackSize, AESCryptStatus &status);
 
-    int8_t readRawByte();
+    bool tryReadRawByte(int8_t &value);
+
+    bool tryReadRawVarint32(int32_t &value, bool discardPreData = false);
 
     int32_t readRawVarint32(bool discardPreData = false);
 
@@ -67,8 +74,29 @@ public:
 
     bool isAtEnd() { return m_position == m_size; };
 
+#ifdef MMKV_HAS_ARENA
+    // tryReadData() copies a medium value into the arena instead of the heap
+    void setArena(MMKVArena *arena) { m_arena = arena; }
+#endif
+
+    // tryReadData() keeps a medium value in memory only while the budget lasts, otherwise by offset like a large one
+    void setMemoryBudget(size_t budget) { m_memoryBudget = budget; }
+
     void seek(size_t addedSize);
 
+    // exception-free decoding, return false on truncated or malformed data
+    bool trySeek(size_t addedSize);
+
+    bool tryReadInt32(int32_t &value);
+
+    bool tryReadData(KeyValueHolderCrypt &kvHolder);
+
+    // go past a value without keeping it, it's still decrypted for the decrypter to go on
+    bool trySkipData();
+
+    bool tryReadString(KeyValueHolderCrypt &kvHolder, std::string &key);
+
+    // the throwing version of the above
     int32_t readInt32();
 
     void readData(KeyValueHolderCrypt &kvHolder);
@@ -24,6 +24,18 @@
 #ifndef MMKV_WIN32
 #    include <sys/file.h>
 #endif
+#ifdef MMKV_LINUX
+#    include <algorithm>
+#    include <climits>
+#    include <cstdio>
+#    include <cstring>
+#    include <linux/futex.h>
+#    include <pthread.h>
+#    include <sched.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#    include <vector>
+#endif
 
 namespace mmkv {
 
@@ -44,6 +56,10 @@ FileLock::~FileLock() {
             platformUnLock(false);
         }
     }
+#ifdef MMKV_LINUX
+    // after unlocking, no one takes our locks for those of a dead process meanwhile
+    dropParticipant();
+#endif
 }
 
 bool FileLock::lock(LockType lockType) {
@@ -102,6 +118,11 @@ static int32_t LockType2FlockType(LockType lockType) {
 }
 
 bool FileLock::platformLock(LockType lockType, bool wait, bool unLockFirstIfNeeded, bool *tryAgain) {
+#    ifdef MMKV_LINUX
+    if (m_sharedState) {
+        return sharedMemoryLock(lockType, wait, tryAgain);
+    }
+#    endif
 #    ifdef MMKV_ANDROID
     if (m_useFcntlLock) {
         return fcntlLock(lockType, wait, unLockFirstIfNeeded, tryAgain);
@@ -145,6 +166,11 @@ bool FileLock::platformLock(LockType lockType, bool wait, bool unLockFirstIfNeed
 }
 
 bool FileLock::platformUnLock(bool unlockToSharedLock) {
+#    ifdef MMKV_LINUX
+    if (m_sharedState) {
+        return sharedMemoryUnLock(unlockToSharedLock);
+    }
+#    endif
 #    ifdef MMKV_ANDROID
     if (m_useFcntlLock) {
         return fcntlUnLock(unlockToSharedLock);
@@ -158,6 +184,326 @@ bool FileLock::platformUnLock(bool unlockToSharedLock) {
     return true;
 }
 
+#    ifdef MMKV_LINUX
+
+static int32_t g_currentPid = 0;
+
+static void refreshCurrentPid() {
+    g_currentPid = getpid();
+}
+
+// getpid() is a real syscall nowadays, cache it and keep it right in forked children
+int32_t currentPid() {
+    static bool registered = [] {
+        refreshCurrentPid();
+        return pthread_atfork(nullptr, nullptr, refreshCurrentPid) == 0;
+    }();
+    (void) registered;
+    return g_currentPid;
+}
+
+static int32_t ownerPid(uint64_t owner) {
+    return static_cast<int32_t>(owner & 0xffffffffu);
+}
+
+static uint32_t ownerParticipant(uint64_t owner) {
+    return static_cast<uint32_t>(owner >> 32);
+}
+
+// one byte each, past the end of the meta file, nobody else locks it by fcntl()
+constexpr off_t ParticipantLockOffset = 1 << 20;
+
+static struct flock participantLockInfo(uint32_t participant) {
+    struct flock info = {};
+    info.l_type = F_WRLCK;
+    info.l_whence = SEEK_SET;
+    info.l_start = ParticipantLockOffset + participant - 1;
+    info.l_len = 1;
+    return info;
+}
+
+// the participants of this process, a forked child mustn't keep them alive after its parent is gone
+static pthread_mutex_t g_participantsLock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<FileLock *> *g_participants = nullptr;
+
+static void lockParticipants() {
+    pthread_mutex_lock(&g_participantsLock);
+}
+
+static void unlockParticipants() {
+    pthread_mutex_unlock(&g_participantsLock);
+}
+
+void FileLock::dropParticipantsInChild() {
+    if (g_participants) {
+        for (auto fileLock : *g_participants) {
+            close(fileLock->m_participantFd);
+            fileLock->m_participantFd = -1;
+            fileLock->m_participant = 0;
+        }
+        g_participants->clear();
+    }
+    unlockParticipants();
+}
+
+void FileLock::claimParticipant() {
+    auto pid = currentPid();
+    if (m_participantPid == pid) {
+        return;
+    }
+    m_participantPid = pid;
+
+    // a dup() of m_fd would share its OFD locks, so would a forked child, open a description of our own
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", m_fd);
+    auto fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        MMKVError("fail to open %s, a dead holder of the shared-memory lock can't be told, error:%s", path, strerror(errno));
+        return;
+    }
+    auto start = static_cast<uint32_t>(pid) % SharedMemoryLockParticipants;
+    for (uint32_t index = 0; index < SharedMemoryLockParticipants; index++) {
+        auto participant = (start + index) % SharedMemoryLockParticipants + 1;
+        auto info = participantLockInfo(participant);
+        if (fcntl(fd, F_OFD_SETLK, &info) != 0) {
+            continue;
+        }
+        static bool registered = [] {
+            g_participants = new std::vector<FileLock *>();
+            return pthread_atfork(lockParticipants, unlockParticipants, dropParticipantsInChild) == 0;
+        }();
+        (void) registered;
+        lockParticipants();
+        g_participants->push_back(this);
+        unlockParticipants();
+        m_participantFd = fd;
+        m_participant = participant;
+
+        // whoever had it before is dead, and so are the locks it has left behind
+        auto state = m_sharedState;
+        bool hasStale = false;
+        auto writer = state->writer.load();
+        if (ownerParticipant(writer) == participant && state->writer.compare_exchange_strong(writer, 0)) {
+            hasStale = true;
+        }
+        for (auto &reader : state->readers) {
+            auto holder = reader.load();
+            if (ownerParticipant(holder) == participant && reader.compare_exchange_strong(holder, 0)) {
+                hasStale = true;
+            }
+        }
+        if (hasStale) {
+            MMKVWarning("take back locks left by the dead participant %u, fd=%d", participant, m_fd);
+            sharedMemoryRelease();
+        }
+        return;
+    }
+    close(fd);
+    MMKVError("all %u participants of the shared-memory lock are taken, fd=%d", SharedMemoryLockParticipants, m_fd);
+}
+
+void FileLock::dropParticipant() {
+    if (m_participantFd < 0) {
+        return;
+    }
+    lockParticipants();
+    auto &participants = *g_participants;
+    participants.erase(std::remove(participants.begin(), participants.end(), this), participants.end());
+    unlockParticipants();
+    close(m_participantFd);
+    m_participantFd = -1;
+    m_participant = 0;
+}
+
+uint64_t FileLock::sharedMemoryOwner() {
+    claimParticipant();
+    return sharedMemoryLockOwner(currentPid(), m_participant);
+}
+
+// only called on contention, the OFD lock of a participant is gone with its process, zombie or not,
+// whichever pid namespace it lives in, no pid can be reused to pass for it
+bool FileLock::isHolderAlive(uint64_t holder) const {
+    auto participant = ownerParticipant(holder);
+    if (participant == 0 || participant == m_participant) {
+        return true;
+    }
+    auto info = participantLockInfo(participant);
+    if (fcntl(m_fd, F_OFD_GETLK, &info) != 0) {
+        MMKVError("fail to check participant %u fd=%d, error:%s", participant, m_fd, strerror(errno));
+        return true;
+    }
+    return info.l_type != F_UNLCK;
+}
+
+bool FileLock::sharedMemoryLock(LockType lockType, bool wait, bool *tryAgain) {
+    auto ret = (lockType == SharedLockType) ? sharedMemoryLockReader(wait) : sharedMemoryLockWriter(wait);
+    if (!ret && tryAgain) {
+        *tryAgain = !wait;
+    }
+    return ret;
+}
+
+int32_t FileLock::claimReaderSlot(uint64_t owner) {
+    auto start = static_cast<uint32_t>(ownerPid(owner)) % SharedMemoryLockReaderSlots;
+    for (uint32_t index = 0; index < SharedMemoryLockReaderSlots; index++) {
+        auto slot = (start + index) % SharedMemoryLockReaderSlots;
+        uint64_t expected = 0;
+        if (m_sharedState->readers[slot].compare_exchange_strong(expected, owner)) {
+            return static_cast<int32_t>(slot);
+        }
+    }
+    // all taken, take back those of dead processes
+    for (uint32_t slot = 0; slot < SharedMemoryLockReaderSlots; slot++) {
+        auto holder = m_sharedState->readers[slot].load();
+        if (holder != 0 && !isHolderAlive(holder) && m_sharedState->readers[slot].compare_exchange_strong(holder, owner)) {
+            MMKVWarning("take back reader lock from dead process %d, fd=%d", ownerPid(holder), m_fd);
+            return static_cast<int32_t>(slot);
+        }
+    }
+    return -1;
+}
+
+bool FileLock::sharedMemoryLockReader(bool wait) {
+    auto state = m_sharedState;
+    auto owner = sharedMemoryOwner();
+    while (true) {
+        auto sequence = state->sequence.load();
+        auto writer = state->writer.load();
+        if (writer == 0) {
+            auto slot = claimReaderSlot(owner);
+            if (slot >= 0) {
+                // the writer checks readers after taking the lock, one of us will see the other
+                if (state->writer.load() == 0) {
+                    m_readerSlot = slot;
+                    m_owner = owner;
+                    return true;
+                }
+                state->readers[slot].store(0);
+                sharedMemoryRelease();
+            }
+        } else if (!isHolderAlive(writer)) {
+            if (state->writer.compare_exchange_strong(writer, 0)) {
+                MMKVWarning("take back writer lock from dead process %d, fd=%d", ownerPid(writer), m_fd);
+                sharedMemoryRelease();
+            }
+            continue;
+        }
+        if (!wait) {
+            return false;
+        }
+        sharedMemoryWait(sequence);
+    }
+}
+
+bool FileLock::sharedMemoryLockWriter(bool wait) {
+    auto state = m_sharedState;
+    auto owner = sharedMemoryOwner();
+    while (true) {
+        auto sequence = state->sequence.load();
+        uint64_t writer = 0;
+        if (state->writer.compare_exchange_strong(writer, owner)) {
+            break;
+        }
+        if (!isHolderAlive(writer)) {
+            if (state->writer.compare_exchange_strong(writer, 0)) {
+                MMKVWarning("take back writer lock from dead process %d, fd=%d", ownerPid(writer), m_fd);
+            }
+            continue;
+        }
+        if (!wait) {
+            return false;
+        }
+        // let's be gentleman: give up my reader lock to prevent deadlock with another upgrading process
+        if (m_readerSlot >= 0) {
+            state->readers[m_readerSlot].store(0);
+            m_readerSlot = -1;
+            sharedMemoryRelease();
+        }
+        sharedMemoryWait(sequence);
+    }
+
+    // wait for the readers to leave, newcomers will see the writer and back off
+    while (true) {
+        auto sequence = state->sequence.load();
+        bool hasReader = false;
+        for (uint32_t slot = 0; slot < SharedMemoryLockReaderSlots; slot++) {
+            auto holder = state->readers[slot].load();
+            if (holder == 0 || static_cast<int32_t>(slot) == m_readerSlot) {
+                continue;
+            }
+            if (isHolderAlive(holder)) {
+                hasReader = true;
+                break;
+            }
+            if (state->readers[slot].compare_exchange_strong(holder, 0)) {
+                MMKVWarning("take back reader lock from dead process %d, fd=%d", ownerPid(holder), m_fd);
+            }
+        }
+        if (!hasReader) {
+            break;
+        }
+        if (!wait) {
+            state->writer.store(0);
+            sharedMemoryRelease();
+            return false;
+        }
+        sharedMemoryWait(sequence);
+    }
+    if (m_readerSlot >= 0) {
+        state->readers[m_readerSlot].store(0);
+        m_readerSlot = -1;
+    }
+    m_isWriter = true;
+    m_owner = owner;
+    return true;
+}
+
+bool FileLock::sharedMemoryUnLock(bool unlockToSharedLock) {
+    auto state = m_sharedState;
+    // a forked child has nothing to unlock, the lock is its parent's
+    bool isOwner = (ownerPid(m_owner) == currentPid());
+    if (unlockToSharedLock && m_isWriter) {
+        // no writer can get in while we are still holding it, only transient readers
+        int32_t slot;
+        while ((slot = claimReaderSlot(m_owner)) < 0) {
+            sched_yield();
+        }
+        m_readerSlot = slot;
+    } else if (m_readerSlot >= 0) {
+        auto owner = m_owner;
+        if (isOwner) {
+            state->readers[m_readerSlot].compare_exchange_strong(owner, 0);
+        }
+        m_readerSlot = -1;
+    }
+    if (m_isWriter) {
+        // it might have been reset by someone overriding the whole file, nothing to worry about
+        auto owner = m_owner;
+        if (isOwner) {
+            state->writer.compare_exchange_strong(owner, 0);
+        }
+        m_isWriter = false;
+    }
+    sharedMemoryRelease();
+    return true;
+}
+
+void FileLock::sharedMemoryRelease() {
+    m_sharedState->sequence.fetch_add(1);
+    if (m_sharedState->hasWaiter.exchange(0) != 0) {
+        syscall(SYS_futex, &m_sharedState->sequence, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
+
+// a dead holder never wakes us, check it out from time to time
+void FileLock::sharedMemoryWait(uint32_t sequence) {
+    m_sharedState->hasWaiter.store(1);
+    timespec timeout = {0, 20 * 1000 * 1000};
+    syscall(SYS_futex, &m_sharedState->sequence, FUTEX_WAIT, sequence, &timeout, nullptr, 0);
+}
+
+#    endif // MMKV_LINUX
+
 #endif // MMKV_WIN32
 
 bool FileLock::unlock(LockType lockType) {
@@ -25,6 +25,9 @@
 #    include "MMKVPredef.h"
 
 #    include <fcntl.h>
+#    ifdef MMKV_LINUX
+#        include <atomic>
+#    endif
 
 namespace mmkv {
 
@@ -33,6 +36,33 @@ enum LockType {
     ExclusiveLockType,
 };
 
+#    ifdef MMKV_LINUX
+constexpr uint32_t SharedMemoryLockReaderSlots = 64;
+constexpr uint32_t SharedMemoryLockParticipants = 1024;
+
+// a reader-writer lock living in a file shared by processes, all zero means unlocked
+// holders are recorded by the participant they lock through, a byte of the file each process holds an OFD lock on,
+// the kernel drops it when the process dies, so that a dead holder is detected in any pid namespace & its lock
+// taken back; see sharedMemoryLockOwner()
+struct SharedMemoryLockState {
+    std::atomic<uint64_t> writer;
+    std::atomic<uint32_t> sequence; // futex word, increased on every release
+    std::atomic<uint32_t> hasWaiter;
+    uint64_t reserved;
+    std::atomic<uint64_t> readers[SharedMemoryLockReaderSlots];
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "SharedMemoryLockState requires lock-free atomics");
+
+// the participant is 1-based, 0 if the holder has failed to get one, it's never taken for dead then
+// the pid only tells a forked child from its parent
+constexpr uint64_t sharedMemoryLockOwner(int32_t pid, uint32_t participant) {
+    return (static_cast<uint64_t>(participant) << 32) | static_cast<uint32_t>(pid);
+}
+
+// getpid() without the syscall, kept right in forked children
+int32_t currentPid();
+#    endif
+
 // a recursive POSIX file-lock wrapper
 // handles lock upgrade & downgrade correctly
 class FileLock {
@@ -46,6 +76,27 @@ class FileLock {
 
 #    ifndef MMKV_WIN32
     bool isFileLockValid() const { return m_fd >= 0; }
+#        ifdef MMKV_LINUX
+    SharedMemoryLockState *m_sharedState = nullptr;
+    int32_t m_readerSlot = -1;
+    bool m_isWriter = false;
+    uint64_t m_owner = 0; // recorded on locking, a forked child must not unlock it
+    uint64_t sharedMemoryOwner();
+    int m_participantFd = -1;      // an open file description of our own, holding the OFD lock of m_participant
+    uint32_t m_participant = 0;    // 1-based
+    int32_t m_participantPid = 0;  // the process that has claimed it, a forked child claims one of its own
+    void claimParticipant();
+    void dropParticipant();
+    static void dropParticipantsInChild();
+    bool isHolderAlive(uint64_t holder) const;
+    bool sharedMemoryLock(LockType lockType, bool wait, bool *tryAgain);
+    bool sharedMemoryUnLock(bool unlockToSharedLock);
+    bool sharedMemoryLockReader(bool wait);
+    bool sharedMemoryLockWriter(bool wait);
+    int32_t claimReaderSlot(uint64_t owner);
+    void sharedMemoryRelease();
+    void sharedMemoryWait(uint32_t sequence);
+#        endif
 #        ifdef MMKV_ANDROID
     const bool m_useFcntlLock; // fcntl(F_OFD_SETLK)
     const bool m_isAshmem; // fcntl(F_SETLK)
@@ -82,6 +133,14 @@ public:
     // unlock all and destroy file lock
     void destroyAndUnLock();
 
+#    ifdef MMKV_LINUX
+    // lock & unlock through a SharedMemoryLockState instead of flock(), uncontended ones cost no syscall
+    // every process locking the same file must use the same state, call it before any locking
+    void enableSharedMemoryLock(void *state) { m_sharedState = (SharedMemoryLockState *) state; }
+
+    bool isSharedMemoryLock() const { return m_sharedState != nullptr; }
+#    endif
+
     // just forbid it for possibly misuse
     explicit FileLock(const FileLock &other) = delete;
     FileLock &operator=(const FileLock &other) = delete;
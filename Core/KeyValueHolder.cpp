@@ -49,7 +49,7 @@ KeyValueHolderCrypt::KeyValueHolderCrypt(const void *src, size_t length) {
     } else {
         type = KeyValueHolderType_Memory;
         memSize = static_cast<uint32_t>(length);
-        memPtr = malloc(length);
+        memPtr = allocateMemory(length);
         if (!memPtr) {
             throw std::runtime_error(strerror(errno));
         }
@@ -57,6 +57,21 @@ KeyValueHolderCrypt::KeyValueHolderCrypt(const void *src, size_t length) {
     }
 }
 
+#ifdef MMKV_HAS_ARENA
+KeyValueHolderCrypt::KeyValueHolderCrypt(const void *src, size_t length, MMKVArena *arena) {
+    if (length <= SmallBufferSize()) {
+        type = KeyValueHolderType_Direct;
+        paddedSize = static_cast<uint8_t>(length);
+        memcpy(paddedValue, src, length);
+    } else {
+        type = KeyValueHolderType_Arena;
+        memSize = static_cast<uint32_t>(length);
+        memPtr = arena->allocate(length, 1);
+        memcpy(memPtr, src, memSize);
+    }
+}
+#endif
+
 KeyValueHolderCrypt::KeyValueHolderCrypt(MMBuffer &&data) {
     if (data.type == MMBuffer::MMBufferType_Small) {
         static_assert(SmallBufferSize() >= MMBuffer::SmallBufferSize(), "KeyValueHolderCrypt can't hold MMBuffer");
@@ -69,7 +84,7 @@ KeyValueHolderCrypt::KeyValueHolderCrypt(MMBuffer &&data) {
         memSize = static_cast<uint32_t>(data.length());
 #    ifdef MMKV_APPLE
         if (data.m_data != nil) {
-            memPtr = malloc(memSize);
+            memPtr = allocateMemory(memSize);
             if (!memPtr) {
                 throw std::runtime_error(strerror(errno));
             }
@@ -94,14 +109,15 @@ KeyValueHolderCrypt::KeyValueHolderCrypt(KeyValueHolderCrypt &&other) noexcept {
 
 KeyValueHolderCrypt &KeyValueHolderCrypt::operator=(KeyValueHolderCrypt &&other) noexcept {
     if (type == KeyValueHolderType_Memory && memPtr) {
-        free(memPtr);
+        freeMemory(memPtr);
     }
     this->move(std::move(other));
     return *this;
 }
 
 void KeyValueHolderCrypt::move(KeyValueHolderCrypt &&other) noexcept {
-    if (other.type == KeyValueHolderType_Direct || other.type == KeyValueHolderType_Offset) {
+    if (other.type == KeyValueHolderType_Direct || other.type == KeyValueHolderType_Offset ||
+        other.type == KeyValueHolderType_Arena) {
         memcpy(reinterpret_cast<void*>(this), &other, sizeof(other));
     } else if (other.type == KeyValueHolderType_Memory) {
         type = KeyValueHolderType_Memory;
@@ -113,7 +129,7 @@ void KeyValueHolderCrypt::move(KeyValueHolderCrypt &&other) noexcept {
 
 KeyValueHolderCrypt::~KeyValueHolderCrypt() {
     if (type == KeyValueHolderType_Memory && memPtr) {
-        free(memPtr);
+        freeMemory(memPtr);
     }
 }
 
@@ -124,6 +140,7 @@ uint32_t KeyValueHolderCrypt::realValueSize() const {
         case KeyValueHolderType_Offset:
             return valueSize;
         case KeyValueHolderType_Memory:
+        case KeyValueHolderType_Arena:
             return memSize;
     }
     return 0;
@@ -155,7 +172,7 @@ static MMBuffer decryptBuffer(AESCrypt &crypter, const MMBuffer &inputBuffer, si
 MMBuffer KeyValueHolderCrypt::toMMBuffer(const void *basePtr, const AESCrypt *crypter) const {
     if (type == KeyValueHolderType_Direct) {
         return MMBuffer((void *) paddedValue, paddedSize, MMBufferNoCopy);
-    } else if (type == KeyValueHolderType_Memory) {
+    } else if (type == KeyValueHolderType_Memory || type == KeyValueHolderType_Arena) {
         return MMBuffer(memPtr, memSize, MMBufferNoCopy);
     } else {
         auto realPtr = (uint8_t *) basePtr + offset;
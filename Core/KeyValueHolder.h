@@ -58,6 +58,7 @@ enum KeyValueHolderType : uint8_t {
     KeyValueHolderType_Direct, // store value directly
     KeyValueHolderType_Memory, // store value in the heap memory
     KeyValueHolderType_Offset, // store value by offset
+    KeyValueHolderType_Arena,  // store value in the arena of the dictionary, it's freed along with the arena
 };
 
 // kv holder for encrypted mmkv
@@ -97,6 +98,9 @@ struct KeyValueHolderCrypt {
 
     KeyValueHolderCrypt() = default;
     KeyValueHolderCrypt(const void *valuePtr, size_t valueLength);
+#ifdef MMKV_HAS_ARENA
+    KeyValueHolderCrypt(const void *valuePtr, size_t valueLength, MMKVArena *arena);
+#endif
     explicit KeyValueHolderCrypt(MMBuffer &&data);
     KeyValueHolderCrypt(uint32_t keyLength, uint32_t valueLength, uint32_t offset);
 
@@ -108,6 +112,11 @@ struct KeyValueHolderCrypt {
 
     uint32_t realValueSize() const;
 
+    // heap memory taken by the value, apart from the holder itself
+    size_t memoryUsage() const {
+        return (type == KeyValueHolderType_Memory || type == KeyValueHolderType_Arena) ? memSize : 0;
+    }
+
     MMBuffer toMMBuffer(const void *basePtr, const AESCrypt *crypter) const;
 
     std::tuple<uint32_t, uint32_t, AESCryptStatus *> toTuple() {
@@ -21,6 +21,7 @@
 #define NOMINMAX // undefine max/min
 
 #include "MMBuffer.h"
+#include "MMKVHandler.h"
 #include <cerrno>
 #include <cstdlib>
 #include <cstring>
@@ -38,12 +39,57 @@ using namespace std;
 
 namespace mmkv {
 
+MMKVAllocator *g_allocator = nullptr;
+
+void *allocateMemory(size_t size) {
+    return g_allocator ? g_allocator->allocate(size) : malloc(size);
+}
+
+void freeMemory(void *ptr) {
+    if (g_allocator) {
+        g_allocator->deallocate(ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+#ifdef MMKV_HAS_ARENA
+// the pool asks for its chunks aligned up to the block size, so an over-aligned block is carved out of a
+// bigger one, with the pointer from the allocator kept right before it
+void *AllocatorResource::do_allocate(size_t bytes, size_t alignment) {
+    auto overAligned = alignment > alignof(std::max_align_t);
+    auto size = overAligned ? bytes + alignment : bytes;
+    auto ptr = m_allocator ? m_allocator->allocate(size) : allocateMemory(size);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    if (!overAligned) {
+        return ptr;
+    }
+    auto aligned = reinterpret_cast<void **>((reinterpret_cast<uintptr_t>(ptr) + alignment) & ~(alignment - 1));
+    aligned[-1] = ptr;
+    return aligned;
+}
+
+void AllocatorResource::do_deallocate(void *ptr, size_t bytes, size_t alignment) {
+    (void) bytes;
+    if (alignment > alignof(std::max_align_t)) {
+        ptr = static_cast<void **>(ptr)[-1];
+    }
+    if (m_allocator) {
+        m_allocator->deallocate(ptr);
+    } else {
+        freeMemory(ptr);
+    }
+}
+#endif
+
 MMBuffer::MMBuffer(size_t length) {
     if (length > SmallBufferSize()) {
         type = MMBufferType_Normal;
         isNoCopy = MMBufferCopy;
         size = length;
-        ptr = malloc(size);
+        ptr = allocateMemory(size);
         if (!ptr) {
             throw std::runtime_error(strerror(errno));
         }
@@ -61,7 +107,7 @@ MMBuffer::MMBuffer(void *source, size_t length, MMBufferCopyFlag flag) : isNoCop
         if (length > SmallBufferSize()) {
             type = MMBufferType_Normal;
             size = length;
-            ptr = malloc(size);
+            ptr = allocateMemory(size);
             if (!ptr) {
                 throw std::runtime_error(strerror(errno));
             }
@@ -148,11 +194,11 @@ MMBuffer &MMBuffer::operator=(MMBuffer &&other) noexcept {
                 if (m_data) {
                     [m_data release];
                 } else if (ptr) {
-                    free(ptr);
+                    freeMemory(ptr);
                 }
 #else
                 if (ptr) {
-                    free(ptr);
+                    freeMemory(ptr);
                 }
 #endif
             }
@@ -193,7 +239,7 @@ MMBuffer::~MMBuffer() {
 #endif
 
     if (isNoCopy == MMBufferCopy && ptr) {
-        free(ptr);
+        freeMemory(ptr);
     }
 }
 
@@ -204,6 +250,27 @@ void MMBuffer::detach() {
     *memsetPtr = 0;
 }
 
+void *MMBuffer::detachToMalloc() {
+    auto size = length();
+    if (size == 0) {
+        return nullptr;
+    }
+    bool fromMalloc = !isStoredOnStack() && isNoCopy == MMBufferCopy && !g_allocator;
+#ifdef MMKV_APPLE
+    fromMalloc = fromMalloc && !m_data;
+#endif
+    if (fromMalloc) {
+        auto result = ptr;
+        detach();
+        return result;
+    }
+    auto result = malloc(size);
+    if (result) {
+        memcpy(result, getPtr(), size);
+    }
+    return result;
+}
+
 #ifdef MMKV_APPLE
 NSData *MMBuffer::toNSData(bool transferOwnerShip) {
     if (!transferOwnerShip) {
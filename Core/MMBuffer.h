@@ -27,9 +27,39 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cstddef>
+#include <new>
 
 namespace mmkv {
 
+// heap memory of MMKV: from the allocator registered by MMKV::initializeMMKV(), malloc() if there's none
+extern MMKVAllocator *g_allocator;
+void *allocateMemory(size_t size);
+void freeMemory(void *ptr);
+
+// for std containers of MMKV
+template <typename T>
+struct HeapAllocator {
+    using value_type = T;
+
+    HeapAllocator() = default;
+    template <typename U>
+    HeapAllocator(const HeapAllocator<U> &) {}
+
+    T *allocate(size_t count) {
+        auto ptr = allocateMemory(count * sizeof(T));
+        if (!ptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(ptr);
+    }
+    void deallocate(T *ptr, size_t) { freeMemory(ptr); }
+
+    template <typename U>
+    bool operator==(const HeapAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const HeapAllocator<U> &) const { return false; }
+};
+
 enum MMBufferCopyFlag : bool {
     MMBufferCopy = false,
     MMBufferNoCopy = true,
@@ -101,6 +131,11 @@ public:
     // transfer ownership to others
     void detach();
 
+    // transfer the bytes to a caller that releases them by free(): the heap memory is detached if it's from malloc(),
+    // it's copied into malloc()-ed memory otherwise (stored on the stack, or from the allocator of initializeMMKV())
+    // nullptr if it's empty or out of memory
+    void *detachToMalloc();
+
     // compare two MMBuffer
     bool operator==(const MMBuffer& other) const;
 
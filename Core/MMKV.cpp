@@ -37,6 +37,7 @@
 #include "aes/openssl/openssl_md5.h"
 #include "crc32/Checksum.h"
 #include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <cstring>
 #include <filesystem>
@@ -49,6 +50,16 @@
 #    include <sys/auxv.h>
 #endif
 
+#ifdef MMKV_LINUX
+#    include <climits>
+#    include <linux/futex.h>
+#    include <sys/eventfd.h>
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <thread>
+#    include <unistd.h>
+#endif
+
 #ifdef MMKV_APPLE
 #    if __has_feature(objc_arc)
 #        error This file must be compiled with MRC. Use -fno-objc-arc flag.
@@ -67,6 +78,12 @@ MMKVPath_t g_realRootDir;
 static ThreadLock *g_namespaceLock;
 static unordered_map<MMKVPath_t, MMKVPath_t> g_realRootMap;
 size_t mmkv::DEFAULT_MMAP_SIZE;
+#ifndef MMKV_APPLE
+static std::atomic<size_t> g_memoryBudget(0);
+static std::atomic<size_t> g_residentSize(0); // the sum of MMKV::m_residentSize
+static std::atomic<uint64_t> g_accessTick(0);
+constexpr uint64_t ResidencyCheckInterval = 1024;
+#endif
 
 MMKV_NAMESPACE_BEGIN
 
@@ -74,9 +91,19 @@ static MMKVPath_t encodeFilePath(const string &mmapID, const MMKVPath_t &rootDir
 MMKVPath_t filename(const MMKVPath_t &path);
 
 #ifndef MMKV_ANDROID
+// an instance that only loads a slice of keys can't write them back
+static MMKVMode modeWithConfig(const MMKVConfig &config) {
+#ifndef MMKV_APPLE
+    if (!config.keyPrefixes.empty()) {
+        return config.mode | MMKV_READ_ONLY;
+    }
+#endif
+    return config.mode;
+}
+
 MMKV::MMKV(const string &mmapID, const MMKVConfig &config)
     : m_mmapID(mmapID)
-    , m_mode(config.mode)
+    , m_mode(modeWithConfig(config))
     , m_path(mappedKVPathWithID(m_mmapID, config.rootPath, true))
     , m_crcPath(crcPathWithPath(m_path))
     , m_dic(nullptr)
@@ -93,17 +120,19 @@ MMKV::MMKV(const string &mmapID, const MMKVConfig &config)
 {
     m_actualSize = 0;
     m_output = nullptr;
+    m_allocator = config.allocator;
 
 #    ifndef MMKV_DISABLE_CRYPT
     auto cryptKey = config.cryptKey;
     if (cryptKey && !cryptKey->empty()) {
-        m_dicCrypt = new MMKVMapCrypt();
+        m_dicCrypt = newDictionary<MMKVMapCrypt>(m_allocator);
         m_crypter = new AESCrypt(cryptKey->data(), cryptKey->length(), nullptr, 0, config.aes256);
+        m_cryptMemoryLimit = config.cryptMemoryLimit;
     } else {
-        m_dic = new MMKVMap();
+        m_dic = newDictionary<MMKVMap>(m_allocator);
     }
 #    else
-    m_dic = new MMKVMap();
+    m_dic = newDictionary<MMKVMap>(m_allocator);
 #    endif
 
     m_needLoadFromFile = true;
@@ -117,6 +146,8 @@ MMKV::MMKV(const string &mmapID, const MMKVConfig &config)
 
     m_recoverStrategic = config.recover;
     m_itemSizeLimit = config.itemSizeLimit;
+    m_blobThreshold = config.blobThreshold;
+    m_expectedSegmentSize = roundUp<size_t>(config.segmentSize, DEFAULT_MMAP_SIZE);
 
     if (config.enableKeyExpire.has_value()) {
         configAutoExipreIfNeeded(config);
@@ -125,15 +156,69 @@ MMKV::MMKV(const string &mmapID, const MMKVConfig &config)
     if (config.enableCompareBeforeSet) {
         enableCompareBeforeSet();
     }
+
+    if (config.sharedMemoryLock && isMultiProcess()) {
+        m_sharedMemoryLock = true;
+        attachSharedMemoryLock();
+    }
+
+#ifndef MMKV_APPLE
+    m_keyPrefixes = config.keyPrefixes;
+    if (!m_keyPrefixes.empty()) {
+        MMKVInfo("[%s] only loads keys of %zu prefixes, read-only", m_mmapID.c_str(), m_keyPrefixes.size());
+    }
+    if (config.sharedIndex) {
+        if (!isMultiProcess() || m_crypter || m_enableKeyExpire || m_blobThreshold > 0 || m_expectedSegmentSize > 0 ||
+            !m_keyPrefixes.empty()) {
+            MMKVWarning("[%s] shared index only works for multi-process instances without encryption, key expiration, "
+                        "value separation, segments or key prefixes, ignored",
+                        m_mmapID.c_str());
+        } else {
+            m_enableSharedIndex = true;
+        }
+    }
+    m_optimisticRead = config.optimisticRead && isMultiProcess();
+#endif
 }
 #endif
 
+void MMKV::attachSharedMemoryLock() {
+#ifdef MMKV_LINUX
+    static_assert(SharedMemoryLockOffset + sizeof(SharedMemoryLockState) <= 4 * 1024, "shared-memory lock out of page");
+    if (isReadOnly()) {
+        MMKVWarning("[%s] is read-only, can't use shared-memory lock, fallback to file lock", m_mmapID.c_str());
+        return;
+    }
+    if (!m_metaFile->isFileValid() || m_metaFile->getFileSize() < SharedMemoryLockOffset + sizeof(SharedMemoryLockState)) {
+        MMKVError("[%s] meta file not valid, can't use shared-memory lock", m_mmapID.c_str());
+        return;
+    }
+    m_fileLock->enableSharedMemoryLock((uint8_t *) m_metaFile->getMemory() + SharedMemoryLockOffset);
+#else
+    MMKVWarning("[%s] shared-memory lock not supported on this platform, fallback to file lock", m_mmapID.c_str());
+#endif
+}
+
 MMKV::~MMKV() {
+#ifdef MMKV_LINUX
+    disableChangeNotification();
+#endif
     clearMemoryCache();
+    closeBlobFile();
+#ifndef MMKV_APPLE
+    closeSharedIndex();
+    g_residentSize.fetch_sub(m_residentSize.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+    if (m_stores) {
+        for (auto &itr : *m_stores) {
+            delete itr.second;
+        }
+        delete m_stores;
+    }
+#endif
 
-    delete m_dic;
+    deleteDictionary(m_dic);
 #ifndef MMKV_DISABLE_CRYPT
-    delete m_dicCrypt;
+    deleteDictionary(m_dicCrypt);
     delete m_crypter;
 #endif
     delete m_metaInfo;
@@ -216,9 +301,18 @@ static void ensureMinimalInitialize() {
     ThreadLock::ThreadOnce(&once_control, initialize);
 }
 
-void MMKV::initializeMMKV(const MMKVPath_t &rootDir, MMKVLogLevel logLevel, mmkv::MMKVHandler *handler) {
+void MMKV::initializeMMKV(const MMKVPath_t &rootDir, MMKVLogLevel logLevel, mmkv::MMKVHandler *handler,
+                          mmkv::MMKVAllocator *allocator) {
     g_currentLogLevel = logLevel;
     g_handler = handler;
+    if (allocator && allocator != g_allocator) {
+        // memory from one can't be given back to another
+        if (g_instanceLock) {
+            MMKVWarning("allocator can only be set on the first call of initializeMMKV(), ignored");
+        } else {
+            g_allocator = allocator;
+        }
+    }
 
     ensureMinimalInitialize();
 
@@ -322,10 +416,34 @@ const string &MMKV::mmapID() const {
     return m_mmapID;
 }
 
+#ifdef MMKV_LINUX
+namespace mmkv {
+
+struct ChangeDispatcher {
+    int eventFd = -1;
+    // a mapping of our own, it stays put even if the instance remaps its meta file
+    void *metaMemory = MAP_FAILED;
+    std::atomic<bool> stopped = false;
+    std::thread *thread = nullptr;
+    int32_t pid = 0;
+};
+
+} // namespace mmkv
+#endif
+
 void MMKV::notifyContentChanged() {
     if (g_handler) {
         g_handler->onContentChangedByOuterProcess(m_mmapID);
     }
+#ifdef MMKV_LINUX
+    // a forked child shares the eventfd with its parent, keep its own changes out of it
+    if (m_changeDispatcher && m_changeDispatcher->pid == currentPid()) {
+        uint64_t count = 1;
+        if (write(m_changeDispatcher->eventFd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+            MMKVError("[%s] fail to signal eventfd, %d(%s)", m_mmapID.c_str(), errno, strerror(errno));
+        }
+    }
+#endif
 }
 
 void MMKV::notifyContentLoaded() {
@@ -339,6 +457,96 @@ void MMKV::checkContentChanged() {
     checkLoadData();
 }
 
+#ifdef MMKV_LINUX
+int MMKV::enableChangeNotification() {
+    SCOPED_LOCK(m_lock);
+    if (m_changeDispatcher) {
+        return m_changeDispatcher->eventFd;
+    }
+    if (!isMultiProcess() || isReadOnly()) {
+        MMKVWarning("[%s] change notification requires a writable multi-process instance", m_mmapID.c_str());
+        return -1;
+    }
+    if (!m_metaFile->isFileValid() || m_metaFile->getFileSize() < DEFAULT_MMAP_SIZE) {
+        MMKVError("[%s] meta file not valid, can't notify changes", m_mmapID.c_str());
+        return -1;
+    }
+    auto dispatcher = new ChangeDispatcher();
+    dispatcher->eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (dispatcher->eventFd < 0) {
+        MMKVError("[%s] fail to create eventfd, %d(%s)", m_mmapID.c_str(), errno, strerror(errno));
+        delete dispatcher;
+        return -1;
+    }
+    dispatcher->metaMemory = mmap(nullptr, DEFAULT_MMAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, m_metaFile->getFd(), 0);
+    if (dispatcher->metaMemory == MAP_FAILED) {
+        MMKVError("[%s] fail to mmap meta file, %d(%s)", m_mmapID.c_str(), errno, strerror(errno));
+        ::close(dispatcher->eventFd);
+        delete dispatcher;
+        return -1;
+    }
+    dispatcher->pid = currentPid();
+
+    auto notifier = changeNotifier(dispatcher->metaMemory);
+    auto generation = metaGeneration(dispatcher->metaMemory);
+    auto seen = m_metaGeneration;
+    dispatcher->thread = new std::thread([this, dispatcher, notifier, generation, seen]() mutable {
+        while (!dispatcher->stopped.load()) {
+            // mark before taking a look, so that a writer changing it afterwards won't miss waking us up
+            int32_t waiter = 0;
+            if (!notifier->waiter.compare_exchange_strong(waiter, dispatcher->pid) && waiter != dispatcher->pid) {
+                notifier->waiter.store(-1);
+            }
+            auto sequence = notifier->sequence.load();
+            auto current = generation->load();
+            if (current != seen) {
+                seen = current;
+                // notifies through onContentChangedByOuterProcess() & the eventfd, unless the change is our own
+                checkContentChanged();
+                continue;
+            }
+            syscall(SYS_futex, &notifier->sequence, FUTEX_WAIT, sequence, nullptr, nullptr, 0);
+        }
+    });
+    m_changeDispatcher = dispatcher;
+    MMKVInfo("[%s] enable change notification, eventfd %d", m_mmapID.c_str(), dispatcher->eventFd);
+    return dispatcher->eventFd;
+}
+
+void MMKV::disableChangeNotification() {
+    ChangeDispatcher *dispatcher = nullptr;
+    {
+        // the dispatcher thread takes m_lock too, don't wait for it while holding the lock
+        SCOPED_LOCK(m_lock);
+        std::swap(dispatcher, m_changeDispatcher);
+    }
+    if (!dispatcher) {
+        return;
+    }
+    if (dispatcher->pid == currentPid()) {
+        dispatcher->stopped = true;
+        wakeChangeListeners(dispatcher->metaMemory);
+        dispatcher->thread->join();
+        delete dispatcher->thread;
+        auto pid = dispatcher->pid;
+        changeNotifier(dispatcher->metaMemory)->waiter.compare_exchange_strong(pid, 0);
+    }
+    // else: a forked child has nothing but a copy of the thread handle, just leave it
+    munmap(dispatcher->metaMemory, DEFAULT_MMAP_SIZE);
+    ::close(dispatcher->eventFd);
+    delete dispatcher;
+    MMKVInfo("[%s] disable change notification", m_mmapID.c_str());
+}
+
+#endif // MMKV_LINUX
+
+// unique across instances, so a handle resolved by another instance is never taken for one of ours
+static std::atomic<uint64_t> g_keyHandleEpoch(0);
+
+void MMKV::invalidateKeyHandles() {
+    m_dicEpoch = ++g_keyHandleEpoch;
+}
+
 void MMKV::clearMemoryCache(bool keepSpace) {
     SCOPED_LOCK(m_lock);
     if (m_needLoadFromFile) {
@@ -349,8 +557,10 @@ void MMKV::clearMemoryCache(bool keepSpace) {
     m_hasFullWriteback = false;
 
     clearDictionary(m_dic);
+    invalidateKeyHandles();
 #ifndef MMKV_DISABLE_CRYPT
     clearDictionary(m_dicCrypt);
+    m_cryptMemoryUsage = 0;
     if (m_crypter) {
         // if read-only, cannot garrentee we have random iv
         if (m_metaInfo->m_version >= MMKVVersionRandomIV) {
@@ -363,18 +573,182 @@ void MMKV::clearMemoryCache(bool keepSpace) {
 
     delete m_output;
     m_output = nullptr;
+    closeBlobFile();
+    m_segmentSize = 0;
+#ifndef MMKV_APPLE
+    closeSharedIndex();
+    delete m_orderedKeys;
+    m_orderedKeys = nullptr;
+#endif
 
-    if (!keepSpace) {
+    // a zero-copy view might still be pointing into the file
+    if (!keepSpace && m_pinnedViews.load() == 0) {
         m_file->clearMemoryCache();
     }
     // inter-process lock rely on MetaFile's fd, never close it
     // m_metaFile->clearMemoryCache();
     m_actualSize = 0;
     m_metaInfo->m_crcDigest = 0;
+#ifndef MMKV_APPLE
+    updateResidentSize(false);
+#endif
+}
+
+#ifndef MMKV_APPLE
+
+// the caller holds m_lock
+void MMKV::touchResidency() {
+    auto budget = g_memoryBudget.load(std::memory_order_relaxed);
+    if (budget == 0) {
+        return;
+    }
+    auto tick = g_accessTick.fetch_add(1, std::memory_order_relaxed);
+    m_lastAccess.store(tick, std::memory_order_relaxed);
+    // values set since the last load count too
+    if (tick % ResidencyCheckInterval == 0 && !m_needLoadFromFile) {
+        updateResidentSize(false);
+        if (g_residentSize.load(std::memory_order_relaxed) > budget) {
+            enforceMemoryBudget(this);
+        }
+    }
+}
+
+// the bucket array, a node for each entry (hash code cached) & keys too long to be stored inline
+template <typename T>
+static size_t dictionaryMemoryUsage(const T &dic, bool exact, size_t &keyHeapSize) {
+    using Node = pair<typename T::key_type, typename T::mapped_type>;
+    size_t size = dic.bucket_count() * sizeof(void *);
+    size += dic.size() * (sizeof(void *) + sizeof(Node) + sizeof(size_t));
+    if (!exact) {
+        return size + dic.size() * keyHeapSize;
+    }
+    const auto inlineCapacity = typename T::key_type().capacity();
+    size_t keySize = 0;
+    for (auto &itr : dic) {
+        if (itr.first.capacity() > inlineCapacity) {
+            keySize += itr.first.capacity() + 1;
+        }
+    }
+    if (!dic.empty()) {
+        keyHeapSize = keySize / dic.size();
+    }
+    return size + keySize;
+}
+
+MMKVMemoryUsage MMKV::computeMemoryUsage(bool exact) {
+    MMKVMemoryUsage usage;
+#    ifndef MMKV_DISABLE_CRYPT
+    if (m_crypter) {
+        usage.dictionarySize = dictionaryMemoryUsage(*m_dicCrypt, exact, m_keyHeapSize);
+        usage.heapValueSize = m_cryptMemoryUsage;
+    } else
+#    endif
+    {
+        usage.dictionarySize = dictionaryMemoryUsage(*m_dic, exact, m_keyHeapSize);
+    }
+    if (m_file->isFileValid()) {
+        usage.mappedSize += m_file->getFileSize();
+    }
+    if (m_metaFile->isFileValid()) {
+        usage.mappedSize += m_metaFile->getFileSize();
+    }
+    return usage;
+}
+
+MMKVMemoryUsage MMKV::updateResidentSize(bool exact) {
+    auto usage = computeMemoryUsage(exact);
+    auto newSize = usage.totalSize();
+    auto oldSize = m_residentSize.exchange(newSize, std::memory_order_relaxed);
+    // unsigned wrap-around takes care of shrinking
+    g_residentSize.fetch_add(newSize - oldSize, std::memory_order_relaxed);
+    return usage;
+}
+
+MMKVMemoryUsage MMKV::memoryUsage() {
+    SCOPED_LOCK(m_lock);
+    return updateResidentSize(true);
+}
+
+void MMKV::setMemoryBudget(size_t budget) {
+    g_memoryBudget.store(budget, std::memory_order_relaxed);
+    if (budget == 0 || !g_instanceLock) {
+        return;
+    }
+    // count what's been set since each of them loaded
+    {
+        SCOPED_LOCK(g_instanceLock);
+        for (auto &pair : *g_instanceDic) {
+            auto kv = pair.second;
+            SCOPED_LOCK(kv->m_lock);
+            kv->updateResidentSize(true);
+        }
+    }
+    enforceMemoryBudget(nullptr);
+}
+
+size_t MMKV::memoryBudget() {
+    return g_memoryBudget.load(std::memory_order_relaxed);
+}
+
+void MMKV::enforceMemoryBudget(MMKV *current) {
+    auto budget = g_memoryBudget.load(std::memory_order_relaxed);
+    // never wait for it, the caller might hold the lock of an instance, which close() takes inside it
+    if (budget == 0 || !g_instanceLock || !g_instanceLock->try_lock()) {
+        return;
+    }
+    size_t totalSize = 0;
+    vector<MMKV *> candidates;
+    for (auto &pair : *g_instanceDic) {
+        auto kv = pair.second;
+        totalSize += kv->m_residentSize.load(std::memory_order_relaxed);
+        if (kv != current) {
+            candidates.push_back(kv);
+        }
+    }
+    if (totalSize > budget) {
+        sort(candidates.begin(), candidates.end(), [](MMKV *left, MMKV *right) {
+            return left->m_lastAccess.load(std::memory_order_relaxed) < right->m_lastAccess.load(std::memory_order_relaxed);
+        });
+        size_t unloadCount = 0;
+        for (auto kv : candidates) {
+            if (totalSize <= budget) {
+                break;
+            }
+#    ifdef MMKV_ANDROID
+            if (kv->isAshmem()) {
+                continue;
+            }
+#    endif
+            // busy in another thread, or held by the caller up the stack, e.g. inside forEach() or a value writer
+            if (!kv->m_lock->try_lock()) {
+                continue;
+            }
+            if (kv->m_lock->isOwnedOnce() && !kv->m_needLoadFromFile) {
+                auto oldSize = kv->m_residentSize.load(std::memory_order_relaxed);
+                kv->clearMemoryCache();
+                auto newSize = kv->m_residentSize.load(std::memory_order_relaxed);
+                if (oldSize > newSize) {
+                    totalSize -= std::min(totalSize, oldSize - newSize);
+                }
+                unloadCount++;
+            }
+            kv->m_lock->unlock();
+        }
+        if (unloadCount > 0) {
+            MMKVInfo("unloaded %zu instances for the memory budget %zu, %zu resident", unloadCount, budget, totalSize);
+        }
+    }
+    g_instanceLock->unlock();
 }
 
+#endif // !MMKV_APPLE
+
 void MMKV::close() {
     MMKVInfo("close [%s]", m_mmapID.c_str());
+#ifdef MMKV_LINUX
+    // before holding m_lock, which the dispatcher thread might be waiting for
+    disableChangeNotification();
+#endif
     SCOPED_LOCK(g_instanceLock);
     m_lock->lock();
 
@@ -416,13 +790,13 @@ void MMKV::checkReSetCryptKey(const string *cryptKey, bool aes256) {
     if (hasNewKey) {
         MMKVInfo("setting new aes key");
         if (!m_dicCrypt) {
-            m_dicCrypt = new MMKVMapCrypt();
+            m_dicCrypt = newDictionary<MMKVMapCrypt>(m_allocator);
         }
         newCrypter = new AESCrypt(cryptKey->data(), cryptKey->length(), nullptr, 0, aes256);
     } else {
         MMKVInfo("reset aes key");
         if (!m_dic) {
-            m_dic = new MMKVMap();
+            m_dic = newDictionary<MMKVMap>(m_allocator);
         }
     }
 
@@ -432,6 +806,25 @@ void MMKV::checkReSetCryptKey(const string *cryptKey, bool aes256) {
     checkLoadData();
 }
 
+void MMKV::setCryptMemoryLimit(size_t limit) {
+    SCOPED_LOCK(m_lock);
+
+    m_cryptMemoryLimit = limit;
+    if (limit > 0 && m_cryptMemoryUsage > limit) {
+        MMKVInfo("[%s] crypt memory usage %zu over the new limit %zu, drop the memory cache", m_mmapID.c_str(),
+                 m_cryptMemoryUsage, limit);
+        clearMemoryCache(true);
+    }
+}
+
+size_t MMKV::cryptMemoryUsage() {
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    checkLoadData();
+
+    return m_cryptMemoryUsage;
+}
+
 #endif // MMKV_DISABLE_CRYPT
 
 bool MMKV::isFileValid() {
@@ -483,6 +876,35 @@ void MMKV::updateCRCDigest(const uint8_t *ptr, size_t length) {
 
 // set & get
 
+// writers for setDirectlyForKey(), encode the value straight into the file
+static void writeBoolValue(CodedOutputData &output, const void *value) {
+    output.writeBool(*(const bool *) value);
+}
+
+static void writeInt32Value(CodedOutputData &output, const void *value) {
+    output.writeInt32(*(const int32_t *) value);
+}
+
+static void writeUInt32Value(CodedOutputData &output, const void *value) {
+    output.writeUInt32(*(const uint32_t *) value);
+}
+
+static void writeInt64Value(CodedOutputData &output, const void *value) {
+    output.writeInt64(*(const int64_t *) value);
+}
+
+static void writeUInt64Value(CodedOutputData &output, const void *value) {
+    output.writeUInt64(*(const uint64_t *) value);
+}
+
+static void writeFloatValue(CodedOutputData &output, const void *value) {
+    output.writeFloat(*(const float *) value);
+}
+
+static void writeDoubleValue(CodedOutputData &output, const void *value) {
+    output.writeDouble(*(const double *) value);
+}
+
 bool MMKV::set(bool value, MMKVKey_t key) {
     return set(value, key, m_expiredInSeconds);
 }
@@ -491,6 +913,10 @@ bool MMKV::set(bool value, MMKVKey_t key, uint32_t expireDuration) {
     if (isKeyEmpty(key)) {
         return false;
     }
+    if (mmkv_likely(canSetDirectly())) {
+        assert(expireDuration == ExpireNever && "setting expire duration without calling enableAutoKeyExpire() first");
+        return setDirectlyForKey(&value, pbBoolSize(), writeBoolValue, key);
+    }
     size_t size = mmkv_unlikely(m_enableKeyExpire) ? Fixed32Size + pbBoolSize() : pbBoolSize();
     MMBuffer data(size);
     CodedOutputData output(data.getPtr(), size);
@@ -513,6 +939,10 @@ bool MMKV::set(int32_t value, MMKVKey_t key, uint32_t expireDuration) {
     if (isKeyEmpty(key)) {
         return false;
     }
+    if (mmkv_likely(canSetDirectly())) {
+        assert(expireDuration == ExpireNever && "setting expire duration without calling enableAutoKeyExpire() first");
+        return setDirectlyForKey(&value, pbInt32Size(value), writeInt32Value, key);
+    }
     size_t size = mmkv_unlikely(m_enableKeyExpire) ? Fixed32Size + pbInt32Size(value) : pbInt32Size(value);
     MMBuffer data(size);
     CodedOutputData output(data.getPtr(), size);
@@ -535,6 +965,10 @@ bool MMKV::set(uint32_t value, MMKVKey_t key, uint32_t expireDuration) {
     if (isKeyEmpty(key)) {
         return false;
     }
+    if (mmkv_likely(canSetDirectly())) {
+        assert(expireDuration == ExpireNever && "setting expire duration without calling enableAutoKeyExpire() first");
+        return setDirectlyForKey(&value, pbUInt32Size(value), writeUInt32Value, key);
+    }
     size_t size = mmkv_unlikely(m_enableKeyExpire) ? Fixed32Size + pbUInt32Size(value) : pbUInt32Size(value);
     MMBuffer data(size);
     CodedOutputData output(data.getPtr(), size);
@@ -557,6 +991,10 @@ bool MMKV::set(int64_t value, MMKVKey_t key, uint32_t expireDuration) {
     if (isKeyEmpty(key)) {
         return false;
     }
+    if (mmkv_likely(canSetDirectly())) {
+        assert(expireDuration == ExpireNever && "setting expire duration without calling enableAutoKeyExpire() first");
+        return setDirectlyForKey(&value, pbInt64Size(value), writeInt64Value, key);
+    }
     size_t size = mmkv_unlikely(m_enableKeyExpire) ? Fixed32Size + pbInt64Size(value) : pbInt64Size(value);
     MMBuffer data(size);
     CodedOutputData output(data.getPtr(), size);
@@ -579,6 +1017,10 @@ bool MMKV::set(uint64_t value, MMKVKey_t key, uint32_t expireDuration) {
     if (isKeyEmpty(key)) {
         return false;
     }
+    if (mmkv_likely(canSetDirectly())) {
+        assert(expireDuration == ExpireNever && "setting expire duration without calling enableAutoKeyExpire() first");
+        return setDirectlyForKey(&value, pbUInt64Size(value), writeUInt64Value, key);
+    }
     size_t size = mmkv_unlikely(m_enableKeyExpire) ? Fixed32Size + pbUInt64Size(value) : pbUInt64Size(value);
     MMBuffer data(size);
     CodedOutputData output(data.getPtr(), size);
@@ -601,6 +1043,10 @@ bool MMKV::set(float value, MMKVKey_t key, uint32_t expireDuration) {
     if (isKeyEmpty(key)) {
         return false;
     }
+    if (mmkv_likely(canSetDirectly())) {
+        assert(expireDuration == ExpireNever && "setting expire duration without calling enableAutoKeyExpire() first");
+        return setDirectlyForKey(&value, pbFloatSize(), writeFloatValue, key);
+    }
     size_t size = mmkv_unlikely(m_enableKeyExpire) ? Fixed32Size + pbFloatSize() : pbFloatSize();
     MMBuffer data(size);
     CodedOutputData output(data.getPtr(), size);
@@ -623,6 +1069,10 @@ bool MMKV::set(double value, MMKVKey_t key, uint32_t expireDuration) {
     if (isKeyEmpty(key)) {
         return false;
     }
+    if (mmkv_likely(canSetDirectly())) {
+        assert(expireDuration == ExpireNever && "setting expire duration without calling enableAutoKeyExpire() first");
+        return setDirectlyForKey(&value, pbDoubleSize(), writeDoubleValue, key);
+    }
     size_t size = mmkv_unlikely(m_enableKeyExpire) ? Fixed32Size + pbDoubleSize() : pbDoubleSize();
     MMBuffer data(size);
     CodedOutputData output(data.getPtr(), size);
@@ -640,6 +1090,10 @@ bool MMKV::set(double value, MMKVKey_t key, uint32_t expireDuration) {
 bool MMKV::setDataForKey(mmkv::MMBuffer &&data, MMKV::MMKVKey_t key, uint32_t expireDuration) {
     if (mmkv_likely(!m_enableKeyExpire)) {
         assert(expireDuration == ExpireNever && "setting expire duration without calling enableAutoKeyExpire() first");
+        if (mmkv_likely(canSetDirectly() && data.length() <= numeric_limits<uint32_t>::max())) {
+            auto valueSize = pbRawVarint32Size(static_cast<uint32_t>(data.length())) + data.length();
+            return setDirectlyForKey(&data, valueSize, writeDataHolderValue, key);
+        }
         return setDataForKey(std::move(data), key, true);
     } else {
         if (data.length() > numeric_limits<uint32_t>::max()) {
@@ -661,6 +1115,94 @@ bool MMKV::setDataForKey(mmkv::MMBuffer &&data, MMKV::MMKVKey_t key, uint32_t ex
     }
 }
 
+#ifdef MMKV_HAS_CPP20
+
+// aligned bytes: [tag][type code][head padding][tail padding][head padding bytes][elements][tail padding bytes]
+// the head padding aligns the elements in the file, the total padding is fixed so that the size is known beforehand
+// the type code is one byte for vectors and a fingerprint of size, alignment & user tag for PODs
+struct AlignedBytes {
+    const void *ptr;
+    size_t size;
+    uint8_t tag;
+    const void *typeCode;
+    size_t typeCodeSize;
+    size_t alignment;
+
+    size_t headerSize() const { return 1 + typeCodeSize + 2; }
+};
+
+static void writeAlignedBytesValue(CodedOutputData &output, const void *value) {
+    auto bytes = (const AlignedBytes *) value;
+    auto address = reinterpret_cast<uintptr_t>(output.curWritePointer()) + bytes->headerSize();
+    auto headPadding = static_cast<uint8_t>((bytes->alignment - address % bytes->alignment) % bytes->alignment);
+    auto tailPadding = static_cast<uint8_t>(bytes->alignment - 1 - headPadding);
+    output.writeRawByte(bytes->tag);
+    output.writeRawData(MMBuffer((void *) bytes->typeCode, bytes->typeCodeSize, MMBufferNoCopy));
+    output.writeRawByte(headPadding);
+    output.writeRawByte(tailPadding);
+    for (uint8_t i = 0; i < headPadding; i++) {
+        output.writeRawByte(0);
+    }
+    output.writeRawData(MMBuffer((void *) bytes->ptr, bytes->size, MMBufferNoCopy));
+    for (uint8_t i = 0; i < tailPadding; i++) {
+        output.writeRawByte(0);
+    }
+}
+
+bool MMKV::setAlignedBytes(const void *ptr, size_t size, uint8_t tag, const void *typeCode, size_t typeCodeSize,
+                           size_t alignment, MMKVKey_t key, uint32_t expireDuration) {
+    if (isKeyEmpty(key)) {
+        return false;
+    }
+    if (size > numeric_limits<uint32_t>::max() || alignment == 0 || alignment > UINT8_MAX) {
+        MMKVError("[%s] reject aligned value of size %zu, alignment %zu", m_mmapID.c_str(), size, alignment);
+        return false;
+    }
+    AlignedBytes bytes = {ptr, size, tag, typeCode, typeCodeSize, alignment};
+    size_t valueSize = bytes.headerSize() + alignment - 1 + size;
+    if (mmkv_likely(canSetDirectly())) {
+        assert(expireDuration == ExpireNever && "setting expire duration without calling enableAutoKeyExpire() first");
+        return setDirectlyForKey(&bytes, valueSize, writeAlignedBytesValue, key);
+    }
+    // the elements are aligned to the temporary buffer rather than the file, getAlignedView() will copy them
+    size_t totalSize = mmkv_unlikely(m_enableKeyExpire) ? Fixed32Size + valueSize : valueSize;
+    MMBuffer data(totalSize);
+    CodedOutputData output(data.getPtr(), totalSize);
+    writeAlignedBytesValue(output, &bytes);
+    if (mmkv_unlikely(m_enableKeyExpire)) {
+        auto time = (expireDuration != ExpireNever) ? safeExpirationPlusCurrentTime(expireDuration) : ExpireNever;
+        output.writeRawLittleEndian32(UInt32ToInt32(time));
+    } else {
+        assert(expireDuration == ExpireNever && "setting expire duration without calling enableAutoKeyExpire() first");
+    }
+
+    return setDataForKey(std::move(data), key);
+}
+
+bool MMKV::parseAlignedBytes(const MMBuffer &data, uint8_t tag, const void *typeCode, size_t typeCodeSize,
+                             size_t elementSize, size_t &offset, size_t &size) const {
+    if (data.length() == 0) {
+        return false;
+    }
+    auto ptr = (const uint8_t *) data.getPtr();
+    size_t headerSize = 1 + typeCodeSize + 2;
+    if (data.length() < headerSize || ptr[0] != tag || memcmp(ptr + 1, typeCode, typeCodeSize) != 0) {
+        MMKVError("[%s] not an aligned value of tag 0x%x or its type code mismatch", m_mmapID.c_str(), tag);
+        return false;
+    }
+    auto paddingPtr = ptr + 1 + typeCodeSize;
+    size_t padding = paddingPtr[0] + paddingPtr[1];
+    if (data.length() < headerSize + padding || (data.length() - headerSize - padding) % elementSize != 0) {
+        MMKVError("[%s] corrupted aligned value of size %zu", m_mmapID.c_str(), data.length());
+        return false;
+    }
+    offset = headerSize + paddingPtr[0];
+    size = data.length() - headerSize - padding;
+    return true;
+}
+
+#endif // MMKV_HAS_CPP20
+
 bool MMKV::set(const char *value, MMKVKey_t key) {
     return set(value, key, m_expiredInSeconds);
 }
@@ -735,22 +1277,22 @@ bool MMKV::getString(MMKVKey_t key, string &result, bool inplaceModification) {
         return false;
     }
     SCOPED_LOCK(m_lock);
-    SCOPED_LOCK(m_sharedProcessLock);
-    auto data = getDataForKey(key);
+    unique_lock<InterProcessLock> processLock(*m_sharedProcessLock, defer_lock);
+    auto data = readDataForKey(key, processLock);
     if (data.length() > 0) {
-        try {
-            CodedInputData input(data.getPtr(), data.length());
-            if (inplaceModification) {
-                input.readString(result);
-            } else {
-                result = input.readString();
+        CodedInputData input(data.getPtr(), data.length());
+        if (inplaceModification) {
+            if (input.tryReadString(result)) {
+                return true;
+            }
+        } else {
+            string value;
+            if (input.tryReadString(value)) {
+                result = std::move(value);
+                return true;
             }
-            return true;
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("decode fail");
         }
+        MMKVError("[%s] decode fail", m_mmapID.c_str());
     }
     return false;
 }
@@ -760,18 +1302,14 @@ bool MMKV::getBytes(MMKVKey_t key, mmkv::MMBuffer &result) {
         return false;
     }
     SCOPED_LOCK(m_lock);
-    SCOPED_LOCK(m_sharedProcessLock);
-    auto data = getDataForKey(key);
+    unique_lock<InterProcessLock> processLock(*m_sharedProcessLock, defer_lock);
+    auto data = readDataForKey(key, processLock);
     if (data.length() > 0) {
-        try {
-            CodedInputData input(data.getPtr(), data.length());
-            result = input.readData();
+        CodedInputData input(data.getPtr(), data.length());
+        if (input.tryReadData(result)) {
             return true;
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("decode fail");
         }
+        MMKVError("[%s] decode fail", m_mmapID.c_str());
     }
     return false;
 }
@@ -781,17 +1319,15 @@ MMBuffer MMKV::getBytes(MMKVKey_t key) {
         return MMBuffer();
     }
     SCOPED_LOCK(m_lock);
-    SCOPED_LOCK(m_sharedProcessLock);
-    auto data = getDataForKey(key);
+    unique_lock<InterProcessLock> processLock(*m_sharedProcessLock, defer_lock);
+    auto data = readDataForKey(key, processLock);
     if (data.length() > 0) {
-        try {
-            CodedInputData input(data.getPtr(), data.length());
-            return input.readData();
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("decode fail");
+        CodedInputData input(data.getPtr(), data.length());
+        MMBuffer result;
+        if (input.tryReadData(result)) {
+            return result;
         }
+        MMKVError("[%s] decode fail", m_mmapID.c_str());
     }
     return MMBuffer();
 }
@@ -801,17 +1337,15 @@ bool MMKV::getVector(MMKVKey_t key, vector<string> &result) {
         return false;
     }
     SCOPED_LOCK(m_lock);
-    SCOPED_LOCK(m_sharedProcessLock);
-    auto data = getDataForKey(key);
+    unique_lock<InterProcessLock> processLock(*m_sharedProcessLock, defer_lock);
+    auto data = readDataForKey(key, processLock);
     if (data.length() > 0) {
-        try {
-            result = MiniPBCoder::decodeVector(data);
+        vector<string> value;
+        if (MiniPBCoder::decodeVector(data, value)) {
+            result = std::move(value);
             return true;
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("decode fail");
         }
+        MMKVError("[%s] decode fail", m_mmapID.c_str());
     }
     return false;
 }
@@ -834,20 +1368,18 @@ bool MMKV::getBool(MMKVKey_t key, bool defaultValue, bool *hasValue) {
         return defaultValue;
     }
     SCOPED_LOCK(m_lock);
-    SCOPED_LOCK(m_sharedProcessLock);
-    auto data = getDataForKey(key);
+    unique_lock<InterProcessLock> processLock(*m_sharedProcessLock, defer_lock);
+    auto data = readDataForKey(key, processLock);
     if (data.length() > 0) {
-        try {
-            CodedInputData input(data.getPtr(), data.length());
+        CodedInputData input(data.getPtr(), data.length());
+        decltype(defaultValue) value;
+        if (input.tryReadBool(value)) {
             if (hasValue != nullptr) {
                 *hasValue = true;
             }
-            return input.readBool();
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("decode fail");
+            return value;
         }
+        MMKVError("[%s] decode fail", m_mmapID.c_str());
     }
     if (hasValue != nullptr) {
         *hasValue = false;
@@ -863,20 +1395,18 @@ int32_t MMKV::getInt32(MMKVKey_t key, int32_t defaultValue, bool *hasValue) {
         return defaultValue;
     }
     SCOPED_LOCK(m_lock);
-    SCOPED_LOCK(m_sharedProcessLock);
-    auto data = getDataForKey(key);
+    unique_lock<InterProcessLock> processLock(*m_sharedProcessLock, defer_lock);
+    auto data = readDataForKey(key, processLock);
     if (data.length() > 0) {
-        try {
-            CodedInputData input(data.getPtr(), data.length());
+        CodedInputData input(data.getPtr(), data.length());
+        decltype(defaultValue) value;
+        if (input.tryReadInt32(value)) {
             if (hasValue != nullptr) {
                 *hasValue = true;
             }
-            return input.readInt32();
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("decode fail");
+            return value;
         }
+        MMKVError("[%s] decode fail", m_mmapID.c_str());
     }
     if (hasValue != nullptr) {
         *hasValue = false;
@@ -892,20 +1422,18 @@ uint32_t MMKV::getUInt32(MMKVKey_t key, uint32_t defaultValue, bool *hasValue) {
         return defaultValue;
     }
     SCOPED_LOCK(m_lock);
-    SCOPED_LOCK(m_sharedProcessLock);
-    auto data = getDataForKey(key);
+    unique_lock<InterProcessLock> processLock(*m_sharedProcessLock, defer_lock);
+    auto data = readDataForKey(key, processLock);
     if (data.length() > 0) {
-        try {
-            CodedInputData input(data.getPtr(), data.length());
+        CodedInputData input(data.getPtr(), data.length());
+        decltype(defaultValue) value;
+        if (input.tryReadUInt32(value)) {
             if (hasValue != nullptr) {
                 *hasValue = true;
             }
-            return input.readUInt32();
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("decode fail");
+            return value;
         }
+        MMKVError("[%s] decode fail", m_mmapID.c_str());
     }
     if (hasValue != nullptr) {
         *hasValue = false;
@@ -921,20 +1449,18 @@ int64_t MMKV::getInt64(MMKVKey_t key, int64_t defaultValue, bool *hasValue) {
         return defaultValue;
     }
     SCOPED_LOCK(m_lock);
-    SCOPED_LOCK(m_sharedProcessLock);
-    auto data = getDataForKey(key);
+    unique_lock<InterProcessLock> processLock(*m_sharedProcessLock, defer_lock);
+    auto data = readDataForKey(key, processLock);
     if (data.length() > 0) {
-        try {
-            CodedInputData input(data.getPtr(), data.length());
+        CodedInputData input(data.getPtr(), data.length());
+        decltype(defaultValue) value;
+        if (input.tryReadInt64(value)) {
             if (hasValue != nullptr) {
                 *hasValue = true;
             }
-            return input.readInt64();
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("decode fail");
+            return value;
         }
+        MMKVError("[%s] decode fail", m_mmapID.c_str());
     }
     if (hasValue != nullptr) {
         *hasValue = false;
@@ -950,20 +1476,18 @@ uint64_t MMKV::getUInt64(MMKVKey_t key, uint64_t defaultValue, bool *hasValue) {
         return defaultValue;
     }
     SCOPED_LOCK(m_lock);
-    SCOPED_LOCK(m_sharedProcessLock);
-    auto data = getDataForKey(key);
+    unique_lock<InterProcessLock> processLock(*m_sharedProcessLock, defer_lock);
+    auto data = readDataForKey(key, processLock);
     if (data.length() > 0) {
-        try {
-            CodedInputData input(data.getPtr(), data.length());
+        CodedInputData input(data.getPtr(), data.length());
+        decltype(defaultValue) value;
+        if (input.tryReadUInt64(value)) {
             if (hasValue != nullptr) {
                 *hasValue = true;
             }
-            return input.readUInt64();
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("decode fail");
+            return value;
         }
+        MMKVError("[%s] decode fail", m_mmapID.c_str());
     }
     if (hasValue != nullptr) {
         *hasValue = false;
@@ -979,20 +1503,18 @@ float MMKV::getFloat(MMKVKey_t key, float defaultValue, bool *hasValue) {
         return defaultValue;
     }
     SCOPED_LOCK(m_lock);
-    SCOPED_LOCK(m_sharedProcessLock);
-    auto data = getDataForKey(key);
+    unique_lock<InterProcessLock> processLock(*m_sharedProcessLock, defer_lock);
+    auto data = readDataForKey(key, processLock);
     if (data.length() > 0) {
-        try {
-            CodedInputData input(data.getPtr(), data.length());
+        CodedInputData input(data.getPtr(), data.length());
+        decltype(defaultValue) value;
+        if (input.tryReadFloat(value)) {
             if (hasValue != nullptr) {
                 *hasValue = true;
             }
-            return input.readFloat();
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("decode fail");
+            return value;
         }
+        MMKVError("[%s] decode fail", m_mmapID.c_str());
     }
     if (hasValue != nullptr) {
         *hasValue = false;
@@ -1008,20 +1530,18 @@ double MMKV::getDouble(MMKVKey_t key, double defaultValue, bool *hasValue) {
         return defaultValue;
     }
     SCOPED_LOCK(m_lock);
-    SCOPED_LOCK(m_sharedProcessLock);
-    auto data = getDataForKey(key);
+    unique_lock<InterProcessLock> processLock(*m_sharedProcessLock, defer_lock);
+    auto data = readDataForKey(key, processLock);
     if (data.length() > 0) {
-        try {
-            CodedInputData input(data.getPtr(), data.length());
+        CodedInputData input(data.getPtr(), data.length());
+        decltype(defaultValue) value;
+        if (input.tryReadDouble(value)) {
             if (hasValue != nullptr) {
                 *hasValue = true;
             }
-            return input.readDouble();
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("decode fail");
+            return value;
         }
+        MMKVError("[%s] decode fail", m_mmapID.c_str());
     }
     if (hasValue != nullptr) {
         *hasValue = false;
@@ -1034,22 +1554,16 @@ size_t MMKV::getValueSize(MMKVKey_t key, bool actualSize) {
         return 0;
     }
     SCOPED_LOCK(m_lock);
-    SCOPED_LOCK(m_sharedProcessLock);
-    auto data = getDataForKey(key);
+    unique_lock<InterProcessLock> processLock(*m_sharedProcessLock, defer_lock);
+    auto data = readDataForKey(key, processLock);
     if (actualSize) {
-        try {
-            CodedInputData input(data.getPtr(), data.length());
-            auto length = input.readInt32();
-            if (length >= 0) {
-                auto s_length = static_cast<size_t>(length);
-                if (pbRawVarint32Size(length) + s_length == data.length()) {
-                    return s_length;
-                }
+        CodedInputData input(data.getPtr(), data.length());
+        int32_t length = 0;
+        if (input.tryReadInt32(length) && length >= 0) {
+            auto s_length = static_cast<size_t>(length);
+            if (pbRawVarint32Size(length) + s_length == data.length()) {
+                return s_length;
             }
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("decode fail");
         }
     }
     return data.length();
@@ -1062,30 +1576,24 @@ int32_t MMKV::writeValueToBuffer(MMKVKey_t key, void *ptr, int32_t size) {
     auto s_size = static_cast<size_t>(size);
 
     SCOPED_LOCK(m_lock);
-    SCOPED_LOCK(m_sharedProcessLock);
-    auto data = getDataForKey(key);
-    try {
-        CodedInputData input(data.getPtr(), data.length());
-        auto length = input.readInt32();
+    unique_lock<InterProcessLock> processLock(*m_sharedProcessLock, defer_lock);
+    auto data = readDataForKey(key, processLock);
+    CodedInputData input(data.getPtr(), data.length());
+    int32_t length = 0;
+    if (input.tryReadInt32(length) && length >= 0) {
         auto offset = pbRawVarint32Size(length);
-        if (length >= 0) {
-            auto s_length = static_cast<size_t>(length);
-            if (offset + s_length == data.length()) {
-                if (s_length <= s_size) {
-                    memcpy(ptr, (uint8_t *) data.getPtr() + offset, s_length);
-                    return length;
-                }
-            } else {
-                if (data.length() <= s_size) {
-                    memcpy(ptr, data.getPtr(), data.length());
-                    return static_cast<int32_t>(data.length());
-                }
+        auto s_length = static_cast<size_t>(length);
+        if (offset + s_length == data.length()) {
+            if (s_length <= s_size) {
+                memcpy(ptr, (uint8_t *) data.getPtr() + offset, s_length);
+                return length;
+            }
+        } else {
+            if (data.length() <= s_size) {
+                memcpy(ptr, data.getPtr(), data.length());
+                return static_cast<int32_t>(data.length());
             }
         }
-    } catch (std::exception &exception) {
-        MMKVError("%s", exception.what());
-    } catch (...) {
-        MMKVError("encode fail");
     }
     return -1;
 }
@@ -1094,6 +1602,17 @@ int32_t MMKV::writeValueToBuffer(MMKVKey_t key, void *ptr, int32_t size) {
 
 bool MMKV::containsKey(MMKVKey_t key) {
     SCOPED_LOCK(m_lock);
+#ifndef MMKV_APPLE
+    if (mmkv_unlikely(m_enableSharedIndex)) {
+        // writers of other processes update the index in place
+        SCOPED_LOCK(m_sharedProcessLock);
+        checkLoadData();
+        if (m_sharedIndex) {
+            KeyValueHolder kvHolder;
+            return findInSharedIndex(key, kvHolder);
+        }
+    }
+#endif
     checkLoadData();
 
     if (mmkv_likely(!m_enableKeyExpire)) {
@@ -1109,9 +1628,18 @@ bool MMKV::containsKey(MMKVKey_t key) {
 
 size_t MMKV::count(bool filterExpire) {
     SCOPED_LOCK(m_lock);
-    checkLoadData();
-
-    if (mmkv_unlikely(filterExpire && m_enableKeyExpire)) {
+#ifndef MMKV_APPLE
+    if (mmkv_unlikely(m_enableSharedIndex)) {
+        SCOPED_LOCK(m_sharedProcessLock);
+        checkLoadData();
+        if (m_sharedIndex) {
+            return sharedIndexCount();
+        }
+    }
+#endif
+    checkLoadData();
+
+    if (mmkv_unlikely(filterExpire && m_enableKeyExpire)) {
         SCOPED_LOCK(m_exclusiveProcessLock);
         fullWriteback(nullptr, true);
     }
@@ -1154,6 +1682,13 @@ bool MMKV::removeValueForKey(MMKVKey_t key) {
 
 vector<string> MMKV::allKeys(bool filterExpire) {
     SCOPED_LOCK(m_lock);
+    if (mmkv_unlikely(m_enableSharedIndex)) {
+        SCOPED_LOCK(m_sharedProcessLock);
+        checkLoadData();
+        if (m_sharedIndex) {
+            return sharedIndexKeys();
+        }
+    }
     checkLoadData();
 
     if (mmkv_unlikely(filterExpire && m_enableKeyExpire)) {
@@ -1164,11 +1699,11 @@ vector<string> MMKV::allKeys(bool filterExpire) {
     vector<string> keys;
     if (m_crypter) {
         for (const auto &itr : *m_dicCrypt) {
-            keys.push_back(itr.first);
+            keys.emplace_back(itr.first);
         }
     } else {
         for (const auto &itr : *m_dic) {
-            keys.push_back(itr.first);
+            keys.emplace_back(itr.first);
         }
     }
     return keys;
@@ -1189,12 +1724,17 @@ bool MMKV::removeValuesForKeys(const vector<string> &arrKeys) {
     SCOPED_LOCK(m_lock);
     SCOPED_LOCK(m_exclusiveProcessLock);
     checkLoadData();
+    // erase them from the dictionary lent by the shared index, it's handed back after the full write-back
+    loadDictionaryFromSharedIndex();
 
     size_t deleteCount = 0;
     if (m_crypter) {
         for (const auto &key : arrKeys) {
             auto itr = m_dicCrypt->find(key);
             if (itr != m_dicCrypt->end()) {
+#ifndef MMKV_DISABLE_CRYPT
+                m_cryptMemoryUsage -= itr->second.memoryUsage();
+#endif
                 m_dicCrypt->erase(itr);
                 deleteCount++;
             }
@@ -1208,17 +1748,570 @@ bool MMKV::removeValuesForKeys(const vector<string> &arrKeys) {
             }
         }
     }
+    bool ret = true;
     if (deleteCount > 0) {
+        invalidateKeyHandles();
         m_hasFullWriteback = false;
-        auto ret = fullWriteback();
+        ret = fullWriteback();
         if (!ret) {
             clearMemoryCache();
         }
-        return ret;
     }
+    saveDictionaryToSharedIndex();
+    return ret;
+}
+
+vector<optional<MMBuffer>> MMKV::getBytesForKeys(const vector<string_view> &keys) {
+    vector<optional<MMBuffer>> values(keys.size());
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    for (size_t index = 0; index < keys.size(); index++) {
+        if (isKeyEmpty(keys[index])) {
+            continue;
+        }
+        auto data = getDataForKey(keys[index]);
+        if (data.length() > 0) {
+            CodedInputData input(data.getPtr(), data.length());
+            MMBuffer result;
+            if (input.tryReadData(result)) {
+                values[index] = std::move(result);
+            } else {
+                MMKVError("[%s] decode fail", m_mmapID.c_str());
+            }
+        }
+    }
+    return values;
+}
+
+size_t MMKV::forEach(ForEachFunc_t func, void *context) {
+    if (!func) {
+        return 0;
+    }
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    checkLoadData();
+    if (mmkv_unlikely(m_sharedIndex)) {
+        return forEachInSharedIndex(func, context);
+    }
+
+    size_t count = 0;
+    auto now = mmkv_unlikely(m_enableKeyExpire) ? getCurrentTimeInSecond() : 0;
+    auto basePtr = (uint8_t *) (m_file->getMemory()) + Fixed32Size;
+#ifndef MMKV_DISABLE_CRYPT
+    if (m_crypter) {
+        for (const auto &itr : *m_dicCrypt) {
+            if (visitKeyValue(itr.first, itr.second.toMMBuffer(basePtr, m_crypter), now, func, context, count)) {
+                break;
+            }
+        }
+    } else
+#endif
+    {
+        for (const auto &itr : *m_dic) {
+            if (visitKeyValue(itr.first, itr.second.toMMBuffer(basePtr), now, func, context, count)) {
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+// the same as getDataForKey() does, except that expired keys are left alone
+bool MMKV::visitKeyValue(string_view key, MMBuffer &&raw, uint32_t now, ForEachFunc_t func, void *context, size_t &count) {
+    if (mmkv_unlikely(m_enableKeyExpire)) {
+        if (raw.length() < Fixed32Size) {
+            return false;
+        }
+        uint32_t time = 0;
+        memcpy(&time, (const uint8_t *) raw.getPtr() + raw.length() - Fixed32Size, sizeof(time));
+        if (time != ExpireNever && time <= now) {
+            return false;
+        }
+        auto length = raw.length() - Fixed32Size;
+        raw = MMBuffer(std::move(raw), length);
+    }
+    count++;
+    if (mmkv_unlikely(raw.length() == BlobPointerSize) && !m_crypter) {
+        return func(key, resolveBlobValue(std::move(raw)), context);
+    }
+    return func(key, raw, context);
+}
+
+bool MMKV::bytesView(const MMBuffer &value, MMBuffer &result) {
+    if (value.length() == 0) {
+        return false;
+    }
+    CodedInputData input(value.getPtr(), value.length());
+    return input.tryReadData(result, false, true);
+}
+
+static bool collectOrderedKey(string_view key, const MMBuffer &, void *context) {
+    static_cast<vector<string> *>(context)->emplace_back(key);
+    return false;
+}
+
+static bool countOrderedKey(string_view, const MMBuffer &, void *) {
+    return false;
+}
+
+vector<string> MMKV::keysWithPrefix(string_view prefix, bool filterExpire) {
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    checkLoadData();
+
+    vector<string> keys;
+    walkOrderedKeys(prefix, {}, prefix, filterExpire && m_enableKeyExpire, collectOrderedKey, &keys);
+    return keys;
+}
+
+size_t MMKV::countPrefix(string_view prefix, bool filterExpire) {
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    checkLoadData();
+
+    return walkOrderedKeys(prefix, {}, prefix, filterExpire && m_enableKeyExpire, countOrderedKey, nullptr);
+}
+
+size_t MMKV::removePrefix(string_view prefix) {
+    if (prefix.empty()) {
+        return 0;
+    }
+    if (isReadOnly()) {
+        MMKVWarning("[%s] file readonly", m_mmapID.c_str());
+        return 0;
+    }
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_exclusiveProcessLock);
+    checkLoadData();
+
+    vector<string> keys;
+    walkOrderedKeys(prefix, {}, prefix, false, collectOrderedKey, &keys);
+    size_t removed = 0;
+    for (const auto &key : keys) {
+        if (removeDataForKey(key)) {
+            removed++;
+        }
+    }
+    if (removed > 0) {
+        MMKVInfo("[%s] removed %zu keys with prefix of %zu bytes", m_mmapID.c_str(), removed, prefix.size());
+    }
+    return removed;
+}
+
+size_t MMKV::forEachInRange(string_view begin, string_view end, ForEachFunc_t func, void *context) {
+    if (!func) {
+        return 0;
+    }
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    checkLoadData();
+
+    return walkOrderedKeys(begin, end, {}, true, func, context);
+}
+
+size_t MMKV::walkOrderedKeys(string_view begin, string_view end, string_view prefix, bool withValue,
+                             ForEachFunc_t func, void *context) {
+    prepareOrderedKeys();
+
+    size_t count = 0;
+    auto now = (withValue && mmkv_unlikely(m_enableKeyExpire)) ? getCurrentTimeInSecond() : 0;
+    MMBuffer nan;
+    for (auto itr = m_orderedKeys->lower_bound(begin); itr != m_orderedKeys->end(); itr++) {
+        string_view key = *itr;
+        if ((!end.empty() && key >= end) || key.compare(0, prefix.size(), prefix) != 0) {
+            break;
+        }
+        if (!withValue) {
+            count++;
+            if (func(key, nan, context)) {
+                break;
+            }
+            continue;
+        }
+        auto raw = getRawDataForKey(key);
+        if (raw.length() > 0 && visitKeyValue(key, std::move(raw), now, func, context, count)) {
+            break;
+        }
+    }
+    return count;
+}
+
+void MMKV::prepareOrderedKeys() {
+    if (m_orderedKeys && m_orderedKeysGeneration == m_metaGeneration) {
+        return;
+    }
+    if (!m_orderedKeys) {
+        m_orderedKeys = new MMKVOrderedKeys();
+    } else {
+        m_orderedKeys->clear();
+    }
+    if (m_sharedIndex) {
+        for (auto &key : sharedIndexKeys()) {
+            m_orderedKeys->insert(std::move(key));
+        }
+    } else if (m_crypter) {
+        for (const auto &itr : *m_dicCrypt) {
+            m_orderedKeys->emplace(itr.first);
+        }
+    } else {
+        for (const auto &itr : *m_dic) {
+            m_orderedKeys->emplace(itr.first);
+        }
+    }
+    m_orderedKeysGeneration = m_metaGeneration;
+    MMKVDebug("[%s] ordered index of %zu keys", m_mmapID.c_str(), m_orderedKeys->size());
+}
+
+bool MMKV::hasKeyInMemory(string_view key) {
+    if (m_sharedIndex) {
+        KeyValueHolder kvHolder;
+        return findInSharedIndex(key, kvHolder);
+    }
+    if (m_crypter) {
+        return m_dicCrypt->find(key) != m_dicCrypt->end();
+    }
+    return m_dic->find(key) != m_dic->end();
+}
+
+size_t MMKV::keyCountInMemory() {
+    if (m_sharedIndex) {
+        return sharedIndexCount();
+    }
+    return m_crypter ? m_dicCrypt->size() : m_dic->size();
+}
+
+MMKV::OrderedKeysUpdate::OrderedKeysUpdate(MMKV *kv, string_view key) : m_kv(kv), m_key(key) {
+    if (mmkv_likely(!kv->m_orderedKeys) || kv->m_orderedKeysGeneration != kv->m_metaGeneration) {
+        return;
+    }
+    m_active = true;
+    m_generation = kv->m_metaGeneration;
+    m_count = kv->keyCountInMemory();
+    m_hadKey = kv->hasKeyInMemory(key);
+}
+
+MMKV::OrderedKeysUpdate::~OrderedKeysUpdate() {
+    if (!m_active || !m_kv->m_orderedKeys || m_kv->m_orderedKeysGeneration != m_generation ||
+        m_kv->m_metaGeneration == m_generation) {
+        return;
+    }
+    bool hasKey = m_kv->hasKeyInMemory(m_key);
+    // other keys have come and gone as well, e.g. expired ones dropped by a full write-back
+    if (m_kv->keyCountInMemory() + m_hadKey != m_count + hasKey) {
+        return;
+    }
+    if (hasKey && !m_hadKey) {
+        m_kv->m_orderedKeys->emplace(m_key);
+    } else if (!hasKey && m_hadKey) {
+        auto itr = m_kv->m_orderedKeys->find(m_key);
+        if (itr != m_kv->m_orderedKeys->end()) {
+            m_kv->m_orderedKeys->erase(itr);
+        }
+    }
+    m_kv->m_orderedKeysGeneration = m_kv->m_metaGeneration;
+}
+
+
+// key handle
+
+MMKV::KeyHandle MMKV::resolveKey(string_view key) {
+    KeyHandle handle(key);
+    if (isKeyEmpty(key)) {
+        return handle;
+    }
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    checkLoadData();
+    if (!m_sharedIndex) {
+        resolveHandle(handle);
+    }
+    return handle;
+}
+
+bool MMKV::set(bool value, KeyHandle &handle) {
+    if (mmkv_likely(canSetDirectly())) {
+        return setDirectlyForHandle(&value, pbBoolSize(), writeBoolValue, handle);
+    }
+    return set(value, handle.m_key);
+}
+
+bool MMKV::set(int32_t value, KeyHandle &handle) {
+    if (mmkv_likely(canSetDirectly())) {
+        return setDirectlyForHandle(&value, pbInt32Size(value), writeInt32Value, handle);
+    }
+    return set(value, handle.m_key);
+}
+
+bool MMKV::set(uint32_t value, KeyHandle &handle) {
+    if (mmkv_likely(canSetDirectly())) {
+        return setDirectlyForHandle(&value, pbUInt32Size(value), writeUInt32Value, handle);
+    }
+    return set(value, handle.m_key);
+}
+
+bool MMKV::set(int64_t value, KeyHandle &handle) {
+    if (mmkv_likely(canSetDirectly())) {
+        return setDirectlyForHandle(&value, pbInt64Size(value), writeInt64Value, handle);
+    }
+    return set(value, handle.m_key);
+}
+
+bool MMKV::set(uint64_t value, KeyHandle &handle) {
+    if (mmkv_likely(canSetDirectly())) {
+        return setDirectlyForHandle(&value, pbUInt64Size(value), writeUInt64Value, handle);
+    }
+    return set(value, handle.m_key);
+}
+
+bool MMKV::set(float value, KeyHandle &handle) {
+    if (mmkv_likely(canSetDirectly())) {
+        return setDirectlyForHandle(&value, pbFloatSize(), writeFloatValue, handle);
+    }
+    return set(value, handle.m_key);
+}
+
+bool MMKV::set(double value, KeyHandle &handle) {
+    if (mmkv_likely(canSetDirectly())) {
+        return setDirectlyForHandle(&value, pbDoubleSize(), writeDoubleValue, handle);
+    }
+    return set(value, handle.m_key);
+}
+
+template <typename T>
+static T decodeValue(const MMBuffer &data, T defaultValue, bool *hasValue, bool (CodedInputData::*read)(T &), const string &mmapID) {
+    if (data.length() > 0) {
+        CodedInputData input(data.getPtr(), data.length());
+        T value;
+        if ((input.*read)(value)) {
+            if (hasValue != nullptr) {
+                *hasValue = true;
+            }
+            return value;
+        }
+        MMKVError("[%s] decode fail", mmapID.c_str());
+    }
+    if (hasValue != nullptr) {
+        *hasValue = false;
+    }
+    return defaultValue;
+}
+
+bool MMKV::getBool(KeyHandle &handle, bool defaultValue, bool *hasValue) {
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    return decodeValue(getDataForHandle(handle), defaultValue, hasValue, &CodedInputData::tryReadBool, m_mmapID);
+}
+
+int32_t MMKV::getInt32(KeyHandle &handle, int32_t defaultValue, bool *hasValue) {
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    return decodeValue(getDataForHandle(handle), defaultValue, hasValue, &CodedInputData::tryReadInt32, m_mmapID);
+}
+
+uint32_t MMKV::getUInt32(KeyHandle &handle, uint32_t defaultValue, bool *hasValue) {
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    return decodeValue(getDataForHandle(handle), defaultValue, hasValue, &CodedInputData::tryReadUInt32, m_mmapID);
+}
+
+int64_t MMKV::getInt64(KeyHandle &handle, int64_t defaultValue, bool *hasValue) {
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    return decodeValue(getDataForHandle(handle), defaultValue, hasValue, &CodedInputData::tryReadInt64, m_mmapID);
+}
+
+uint64_t MMKV::getUInt64(KeyHandle &handle, uint64_t defaultValue, bool *hasValue) {
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    return decodeValue(getDataForHandle(handle), defaultValue, hasValue, &CodedInputData::tryReadUInt64, m_mmapID);
+}
+
+float MMKV::getFloat(KeyHandle &handle, float defaultValue, bool *hasValue) {
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    return decodeValue(getDataForHandle(handle), defaultValue, hasValue, &CodedInputData::tryReadFloat, m_mmapID);
+}
+
+double MMKV::getDouble(KeyHandle &handle, double defaultValue, bool *hasValue) {
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    return decodeValue(getDataForHandle(handle), defaultValue, hasValue, &CodedInputData::tryReadDouble, m_mmapID);
+}
+
+bool MMKV::getString(KeyHandle &handle, string &result) {
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    auto data = getDataForHandle(handle);
+    if (data.length() > 0) {
+        CodedInputData input(data.getPtr(), data.length());
+        string value;
+        if (input.tryReadString(value)) {
+            result = std::move(value);
+            return true;
+        }
+        MMKVError("[%s] decode fail", m_mmapID.c_str());
+    }
+    return false;
+}
+
+bool MMKV::getBytes(KeyHandle &handle, MMBuffer &result) {
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    auto data = getDataForHandle(handle);
+    if (data.length() > 0) {
+        CodedInputData input(data.getPtr(), data.length());
+        if (input.tryReadData(result)) {
+            return true;
+        }
+        MMKVError("[%s] decode fail", m_mmapID.c_str());
+    }
+    return false;
+}
+
+// container mode
+
+MMKVStore *MMKV::storeWithID(const string &storeID) {
+    if (storeID.empty() || storeID.find('\0') != string::npos) {
+        MMKVError("[%s] invalid store id [%s]", m_mmapID.c_str(), storeID.c_str());
+        return nullptr;
+    }
+    SCOPED_LOCK(m_lock);
+
+    if (!m_stores) {
+        m_stores = new unordered_map<string, MMKVStore *>();
+    }
+    auto &store = (*m_stores)[storeID];
+    if (!store) {
+        store = new MMKVStore(this, storeID);
+    }
+    return store;
+}
+
+vector<string> MMKV::allStoreIDs() {
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_sharedProcessLock);
+    checkLoadData();
+    prepareOrderedKeys();
+
+    // a key of a store is '\0' + store id + '\0' + key, jump over the rest of a store once it's found
+    vector<string> storeIDs;
+    string begin(1, '\0');
+    auto itr = m_orderedKeys->lower_bound(begin);
+    while (itr != m_orderedKeys->end() && itr->front() == '\0') {
+        auto end = itr->find('\0', 1);
+        if (end == string::npos) {
+            // not a key of any store
+            begin = *itr + '\0';
+        } else {
+            storeIDs.emplace_back(*itr, 1, end - 1);
+            begin.assign(*itr, 0, end);
+            begin.push_back('\1');
+        }
+        itr = m_orderedKeys->lower_bound(begin);
+    }
+    return storeIDs;
+}
+
+MMKVStore::MMKVStore(MMKV *container, const string &storeID)
+    : m_container(container), m_storeID(storeID), m_keyPrefix(keyPrefix(storeID)) {}
+
+string MMKVStore::keyPrefix(string_view storeID) {
+    string prefix;
+    prefix.reserve(storeID.size() + 2);
+    prefix.push_back('\0');
+    prefix.append(storeID);
+    prefix.push_back('\0');
+    return prefix;
+}
+
+string MMKVStore::storeKey(string_view key) const {
+    string result;
+    result.reserve(m_keyPrefix.size() + key.size());
+    result.append(m_keyPrefix);
+    result.append(key);
+    return result;
+}
+
+bool MMKVStore::getBool(string_view key, bool defaultValue, bool *hasValue) {
+    return m_container->getBool(storeKey(key), defaultValue, hasValue);
+}
+
+int32_t MMKVStore::getInt32(string_view key, int32_t defaultValue, bool *hasValue) {
+    return m_container->getInt32(storeKey(key), defaultValue, hasValue);
+}
+
+uint32_t MMKVStore::getUInt32(string_view key, uint32_t defaultValue, bool *hasValue) {
+    return m_container->getUInt32(storeKey(key), defaultValue, hasValue);
+}
+
+int64_t MMKVStore::getInt64(string_view key, int64_t defaultValue, bool *hasValue) {
+    return m_container->getInt64(storeKey(key), defaultValue, hasValue);
+}
+
+uint64_t MMKVStore::getUInt64(string_view key, uint64_t defaultValue, bool *hasValue) {
+    return m_container->getUInt64(storeKey(key), defaultValue, hasValue);
+}
+
+float MMKVStore::getFloat(string_view key, float defaultValue, bool *hasValue) {
+    return m_container->getFloat(storeKey(key), defaultValue, hasValue);
+}
+
+double MMKVStore::getDouble(string_view key, double defaultValue, bool *hasValue) {
+    return m_container->getDouble(storeKey(key), defaultValue, hasValue);
+}
+
+bool MMKVStore::getString(string_view key, string &result, bool inplaceModification) {
+    return m_container->getString(storeKey(key), result, inplaceModification);
+}
+
+MMBuffer MMKVStore::getBytes(string_view key) {
+    return m_container->getBytes(storeKey(key));
+}
+
+bool MMKVStore::getBytes(string_view key, MMBuffer &result) {
+    return m_container->getBytes(storeKey(key), result);
+}
+
+bool MMKVStore::containsKey(string_view key) {
+    return !key.empty() && m_container->containsKey(storeKey(key));
+}
+
+bool MMKVStore::removeValueForKey(string_view key) {
+    return !key.empty() && m_container->removeValueForKey(storeKey(key));
+}
+
+size_t MMKVStore::count(bool filterExpire) {
+    return m_container->countPrefix(m_keyPrefix, filterExpire);
+}
+
+vector<string> MMKVStore::allKeys(bool filterExpire) {
+    auto keys = m_container->keysWithPrefix(m_keyPrefix, filterExpire);
+    for (auto &key : keys) {
+        key.erase(0, m_keyPrefix.size());
+    }
+    return keys;
+}
+
+size_t MMKVStore::clearAll() {
+    return m_container->removePrefix(m_keyPrefix);
+}
+
+bool MMKVStore::enableAutoKeyExpire(uint32_t expiredInSeconds) {
+    if (!m_container->isExpirationEnabled()) {
+        // turning it on rewrites every store of the container, leave that to the container itself
+        MMKVWarning("[%s] store [%s] can't expire keys, the container is opened without key expiration",
+                    m_container->mmapID().c_str(), m_storeID.c_str());
+        return false;
+    }
+    m_expiredInSeconds.store(expiredInSeconds, std::memory_order_relaxed);
+    m_enableKeyExpire.store(true, std::memory_order_relaxed);
     return true;
 }
 
+void MMKVStore::disableAutoKeyExpire() {
+    m_enableKeyExpire.store(false, std::memory_order_relaxed);
+}
+
 #endif // MMKV_APPLE
 
 // file
@@ -1270,6 +2363,55 @@ static bool sameDirectory(const MMKVPath_t &left, const MMKVPath_t &right) {
     return fs::equivalent(fs::path(left), fs::path(right), error) && !error;
 }
 
+// the blob file is optional, separated values live there
+static bool copyBlobFileIfExists(const MMKVPath_t &srcPath, const MMKVPath_t &dstPath) {
+    auto srcBlobPath = srcPath + BLOB_SUFFIX;
+    if (!isFileExist(srcBlobPath)) {
+        return true;
+    }
+    auto dstBlobPath = dstPath + BLOB_SUFFIX;
+    if (isFileExist(dstBlobPath)) {
+        // other processes might have already mmap it
+        return copyFileContent(srcBlobPath, dstBlobPath);
+    }
+    return copyFile(srcBlobPath, dstBlobPath);
+}
+
+#ifdef MMKV_LINUX
+// processes using the shared-memory lock don't see flock(), take the lock state in the meta file as well
+class SharedMemoryFileLock {
+    FileLock m_fileLock;
+    InterProcessLock m_lock;
+
+public:
+    SharedMemoryFileLock(MemoryFile &metaFile, LockType lockType)
+        : m_fileLock(metaFile.getFd()), m_lock(&m_fileLock, lockType) {
+        m_lock.m_enable = metaFile.isFileValid() &&
+                          metaFile.getFileSize() >= SharedMemoryLockOffset + sizeof(SharedMemoryLockState);
+        if (m_lock.m_enable) {
+            m_fileLock.enableSharedMemoryLock((uint8_t *) metaFile.getMemory() + SharedMemoryLockOffset);
+            m_lock.lock();
+        }
+    }
+
+    ~SharedMemoryFileLock() { m_lock.unlock(); }
+};
+
+// a copied meta file carries the lock state & the change waiters of the source, neither exists for the copy
+static void resetSharedMemoryLock(const MMKVPath_t &crcPath) {
+    File file(crcPath, OpenFlag::ReadWrite);
+    if (file.isFileValid() && file.getActualFileSize() >= SharedMemoryLockOffset + sizeof(SharedMemoryLockState)) {
+        uint8_t zeros[sizeof(SharedMemoryLockState)] = {};
+        if (pwrite(file.getFd(), zeros, sizeof(zeros), SharedMemoryLockOffset) != sizeof(zeros)) {
+            MMKVError("fail to reset shared-memory lock of %s, %d(%s)", crcPath.c_str(), errno, strerror(errno));
+        }
+        if (pwrite(file.getFd(), zeros, sizeof(MMKVChangeNotifier), ChangeNotifierOffset) != sizeof(MMKVChangeNotifier)) {
+            MMKVError("fail to reset change notifier of %s, %d(%s)", crcPath.c_str(), errno, strerror(errno));
+        }
+    }
+}
+#endif
+
 static bool backupOneToDirectoryByFilePath(const string &mmapKey, const MMKVPath_t &srcPath, const MMKVPath_t &dstPath) {
     auto srcCRCPath = srcPath + CRC_SUFFIX;
     File crcFile(srcCRCPath, OpenFlag::ReadOnly);
@@ -1283,6 +2425,11 @@ static bool backupOneToDirectoryByFilePath(const string &mmapKey, const MMKVPath
         const auto &dstUTF8Path = MMKVPath_t2String(dstPath);
         MMKVInfo("backup one mmkv[%s] from [%s] to [%s]", mmapKey.c_str(), srcUTF8Path.c_str(),
                  dstUTF8Path.c_str());
+#ifdef MMKV_LINUX
+        // mapping takes flock() of its own, do it before locking
+        MemoryFile srcMetaFile(srcCRCPath, 0, false, false);
+        SharedMemoryFileLock sharedMemoryLock(srcMetaFile, SharedLockType);
+#endif
         FileLock fileLock(crcFile.getFd());
         InterProcessLock lock(&fileLock, SharedLockType);
         SCOPED_LOCK(&lock);
@@ -1291,6 +2438,12 @@ static bool backupOneToDirectoryByFilePath(const string &mmapKey, const MMKVPath
         if (ret) {
             auto dstCRCPath = dstPath + CRC_SUFFIX;
             ret = copyFile(srcCRCPath, dstCRCPath);
+#ifdef MMKV_LINUX
+            resetSharedMemoryLock(dstCRCPath);
+#endif
+        }
+        if (ret) {
+            ret = copyBlobFileIfExists(srcPath, dstPath);
         }
         MMKVInfo("finish backup one mmkv[%s]", mmapKey.c_str());
     }
@@ -1332,6 +2485,12 @@ bool MMKV::backupOneToDirectory(const string &mmapKey, const MMKVPath_t &dstPath
         if (ret) {
             auto dstCRCPath = dstPath + CRC_SUFFIX;
             ret = copyFile(kv->m_crcPath, dstCRCPath);
+#ifdef MMKV_LINUX
+            resetSharedMemoryLock(dstCRCPath);
+#endif
+        }
+        if (ret) {
+            ret = copyBlobFileIfExists(kv->m_path, dstPath);
         }
         MMKVInfo("finish backup one mmkv[%s], ret: %d", mmapKey.c_str(), ret);
         return ret;
@@ -1433,9 +2592,14 @@ static bool isValidRestoreSource(const MMKVPath_t &srcPath) {
 }
 
 static bool restoreOneFromDirectoryByFilePath(const string &mmapKey, const MMKVPath_t &srcPath, const MMKVPath_t &dstPath) {
+    // map it before locking, mapping takes flock() of its own
     auto dstCRCPath = dstPath + CRC_SUFFIX;
-    File dstCRCFile(std::move(dstCRCPath), OpenFlag::ReadWrite | OpenFlag::Create);
-    if (!dstCRCFile.isFileValid()) {
+#ifndef MMKV_ANDROID
+    MemoryFile dstCRCFile(std::move(dstCRCPath), 0, false, false);
+#else
+    MemoryFile dstCRCFile(std::move(dstCRCPath), MMFILE_TYPE_FILE, 0, false, false);
+#endif
+    if (!dstCRCFile.isFileValid() || dstCRCFile.getFileSize() < DEFAULT_MMAP_SIZE) {
         return false;
     }
 
@@ -1444,14 +2608,32 @@ static bool restoreOneFromDirectoryByFilePath(const string &mmapKey, const MMKVP
         const auto &srcUTF8Path = MMKVPath_t2String(srcPath);
         const auto &dstUTF8Path = MMKVPath_t2String(dstPath);
         MMKVInfo("restore one mmkv[%s] from [%s] to [%s]", mmapKey.c_str(), srcUTF8Path.c_str(), dstUTF8Path.c_str());
+#ifdef MMKV_LINUX
+        SharedMemoryFileLock sharedMemoryLock(dstCRCFile, ExclusiveLockType);
+#endif
         FileLock fileLock(dstCRCFile.getFd());
         InterProcessLock lock(&fileLock, ExclusiveLockType);
         SCOPED_LOCK(&lock);
 
+        // tell those reading without the lock before overwriting, see MMKVConfig::optimisticRead
+        metaGeneration(dstCRCFile.getMemory())->fetch_add(1);
         ret = copyFileContent(srcPath, dstPath);
         if (ret) {
+            // override the meta info only, the lock & generation after it are in use by other processes
             auto srcCRCPath = srcPath + CRC_SUFFIX;
-            ret = copyFileContent(srcCRCPath, dstCRCFile.getFd());
+#ifndef MMKV_ANDROID
+            MemoryFile srcCRCFile(srcCRCPath, 0, true);
+#else
+            MemoryFile srcCRCFile(srcCRCPath, MMFILE_TYPE_FILE, 0, true);
+#endif
+            ret = srcCRCFile.isFileValid() && srcCRCFile.getFileSize() >= sizeof(MMKVMetaInfo);
+            if (ret) {
+                memcpy(dstCRCFile.getMemory(), srcCRCFile.getMemory(), sizeof(MMKVMetaInfo));
+                metaGeneration(dstCRCFile.getMemory())->fetch_add(1, std::memory_order_release);
+            }
+        }
+        if (ret) {
+            ret = copyBlobFileIfExists(srcPath, dstPath);
         }
         MMKVInfo("finish restore one mmkv[%s]", mmapKey.c_str());
     }
@@ -1501,12 +2683,20 @@ bool MMKV::restoreOneFromDirectory(const string &mmapKey, const MMKVPath_t &srcP
 
         SCOPED_LOCK(kv->m_lock);
         SCOPED_LOCK(kv->m_exclusiveProcessLock);
+        if (kv->refuseForPinnedViews("restore")) {
+            return false;
+        }
 
         kv->sync();
+        kv->willRewriteInPlace();
         auto ret = copyFileContent(srcPath, kv->m_file->getFd());
         kv->m_file->cleanMayflyFD();
+        if (ret) {
+            ret = copyBlobFileIfExists(srcPath, kv->m_path);
+        }
         if (ret) {
             memcpy(kv->m_metaFile->getMemory(), srcCRCFile.getMemory(), sizeof(MMKVMetaInfo));
+            kv->increaseMetaGeneration();
         }
 
         // reload data after restore
@@ -1830,4 +3020,120 @@ bool NameSpace::checkExist(const std::string &mmapID) {
     return MMKV::checkExist(mmapID, &m_rootDir);
 }
 
+#ifndef MMKV_APPLE
+
+MMKVPartitioned MMKVPartitioned::mmkvWithID(const string &mmapID, uint32_t partitionCount, const MMKVConfig &config) {
+    if (mmapID.empty() || partitionCount == 0) {
+        MMKVError("invalid partitioned mmapID [%s] with %u partitions", mmapID.c_str(), partitionCount);
+        return MMKVPartitioned();
+    }
+    vector<MMKV *> partitions;
+    partitions.reserve(partitionCount);
+    for (uint32_t index = 0; index < partitionCount; index++) {
+        auto partitionID = mmapID + "." + to_string(index) + "of" + to_string(partitionCount);
+        auto kv = MMKV::mmkvWithID(partitionID, config);
+        if (!kv) {
+            return MMKVPartitioned();
+        }
+        partitions.push_back(kv);
+    }
+    return MMKVPartitioned(std::move(partitions));
+}
+
+bool MMKVPartitioned::removeStorage(const string &mmapID, uint32_t partitionCount, const MMKVPath_t *rootPath) {
+    bool ret = true;
+    for (uint32_t index = 0; index < partitionCount; index++) {
+        auto partitionID = mmapID + "." + to_string(index) + "of" + to_string(partitionCount);
+        ret = MMKV::removeStorage(partitionID, rootPath) && ret;
+    }
+    return ret;
+}
+
+MMKV *MMKVPartitioned::partitionForKey(MMKVKey_t key) const {
+    // a stable hash, std::hash might differ between builds
+    auto hash = static_cast<uint32_t>(CRC32(0, (const uint8_t *) key.data(), static_cast<uint32_t>(key.size())));
+    return m_partitions[hash % m_partitions.size()];
+}
+
+bool MMKVPartitioned::removeValuesForKeys(const vector<string> &arrKeys) {
+    vector<vector<string>> partitionKeys(m_partitions.size());
+    for (auto &key : arrKeys) {
+        auto hash = static_cast<uint32_t>(CRC32(0, (const uint8_t *) key.data(), static_cast<uint32_t>(key.size())));
+        partitionKeys[hash % m_partitions.size()].push_back(key);
+    }
+    bool ret = true;
+    for (size_t index = 0; index < m_partitions.size(); index++) {
+        if (!partitionKeys[index].empty()) {
+            ret = m_partitions[index]->removeValuesForKeys(partitionKeys[index]) && ret;
+        }
+    }
+    return ret;
+}
+
+vector<string> MMKVPartitioned::allKeys(bool filterExpire) {
+    vector<string> keys;
+    for (auto kv : m_partitions) {
+        auto partitionKeys = kv->allKeys(filterExpire);
+        keys.insert(keys.end(), make_move_iterator(partitionKeys.begin()), make_move_iterator(partitionKeys.end()));
+    }
+    return keys;
+}
+
+size_t MMKVPartitioned::count(bool filterExpire) {
+    size_t count = 0;
+    for (auto kv : m_partitions) {
+        count += kv->count(filterExpire);
+    }
+    return count;
+}
+
+size_t MMKVPartitioned::totalSize() {
+    size_t size = 0;
+    for (auto kv : m_partitions) {
+        size += kv->totalSize();
+    }
+    return size;
+}
+
+size_t MMKVPartitioned::actualSize() {
+    size_t size = 0;
+    for (auto kv : m_partitions) {
+        size += kv->actualSize();
+    }
+    return size;
+}
+
+void MMKVPartitioned::clearAll(bool keepSpace) {
+    for (auto kv : m_partitions) {
+        kv->clearAll(keepSpace);
+    }
+}
+
+void MMKVPartitioned::trim() {
+    for (auto kv : m_partitions) {
+        kv->trim();
+    }
+}
+
+void MMKVPartitioned::sync(SyncFlag flag) {
+    for (auto kv : m_partitions) {
+        kv->sync(flag);
+    }
+}
+
+void MMKVPartitioned::clearMemoryCache(bool keepSpace) {
+    for (auto kv : m_partitions) {
+        kv->clearMemoryCache(keepSpace);
+    }
+}
+
+void MMKVPartitioned::close() {
+    for (auto kv : m_partitions) {
+        kv->close();
+    }
+    m_partitions.clear();
+}
+
+#endif // !MMKV_APPLE
+
 MMKV_NAMESPACE_END
@@ -39,16 +39,22 @@
 #include <type_traits>
 #include <cstring>
 #include <optional>
+#include <memory>
+#include <new>
+#include <atomic>
+#include <mutex>
 
 namespace mmkv {
 class CodedOutputData;
 class MemoryFile;
 class AESCrypt;
+struct AESCryptStatus;
 struct MMKVMetaInfo;
 class FileLock;
 class InterProcessLock;
 class ThreadLock;
 class NameSpace;
+struct ChangeDispatcher;
 } // namespace mmkv
 
 MMKV_NAMESPACE_BEGIN
@@ -75,6 +81,8 @@ struct MMKVConfig {
 #ifndef MMKV_DISABLE_CRYPT
     bool aes256 = false; // using AES-256 key length
     const std::string *cryptKey = nullptr;
+    // see setCryptMemoryLimit(), 0 for no limit
+    size_t cryptMemoryLimit = 0;
 #endif
 
     const MMKVPath_t *rootPath = nullptr;
@@ -88,7 +96,57 @@ struct MMKVConfig {
 
     std::optional<MMKVRecoverStrategic> recover = std::nullopt; // if not set, use the old style callback
     uint32_t itemSizeLimit = 0; // the size limit of a key-value pair, reject insert if pass limit
+
+    // values larger than this are kept in a side blob file, the log only holds pointers to them
+    // it keeps full write-back cheap for a few large values among many small ones, 0 to disable
+    // only for non-encrypted instances without key expiration
+    // a value streamed by openValueWriter() over it is buffered in memory, and goes to the blob file on commit()
+    size_t blobThreshold = 0;
+
+    // split the file into segments of this size (rounded up to page size), so that compaction rewrites
+    // one segment at a time instead of the whole file, 0 to disable
+    // only for single-process non-encrypted instances without key expiration or value separation,
+    // applies to a new or cleared file, an item larger than a segment is rejected
+    size_t segmentSize = 0;
+
+    // multi-process mode only, lock through a futex in the meta file instead of flock(),
+    // so that uncontended locking costs no syscall, a dead process's lock is taken back by others, in any pid namespace
+    // every process of the file must set it the same, Linux only, read-only instances keep using flock()
+    bool sharedMemoryLock = false;
+
+    // multi-process mode only, trust the generation in the meta file to tell if another process has changed the file,
+    // and let a getter read a copy of the value without the inter-process lock while it stays the same
+    // writers then never shrink the file, and move the generation on before overwriting anything in place
+    // every process of the file must set it the same, older versions don't maintain the generation
+    // a restore from backup shrinking the file while others are reading isn't covered, not on Apple platforms
+    bool optimisticRead = false;
+
+    // multi-process mode only, keep the key index in a hash table file next to the data file, shared by every process,
+    // instead of decoding a dictionary in each of them, so that opening a large file in a new process costs almost nothing
+    // only for non-encrypted instances without key expiration, value separation or segments, not on Apple platforms
+    bool sharedIndex = false;
+
+    // only load keys starting with one of these prefixes, others are skipped while decoding so that memory scales
+    // with the slice in use, the checksum still covers the whole file; the instance is opened read-only
+    // it takes effect on the first open of the ID in a process, not with shared index, not on Apple platforms
+    std::vector<std::string> keyPrefixes;
+
+    // the dictionary of the instance (keys, nodes & decoded values) is allocated from it, so that its memory is
+    // accounted for apart from others, the allocator given to initializeMMKV() is used if it's not set
+    // it must outlive the instance, not on Apple platforms
+    mmkv::MMKVAllocator *allocator = nullptr;
+};
+
+#ifndef MMKV_APPLE
+// the memory an instance holds, see MMKV::memoryUsage()
+struct MMKVMemoryUsage {
+    size_t dictionarySize = 0; // keys & nodes of the dictionary, estimated
+    size_t heapValueSize = 0;  // decrypted values kept on the heap by an encrypted instance
+    size_t mappedSize = 0;     // the data file & the meta file mapped in memory
+
+    size_t totalSize() const { return dictionarySize + heapValueSize + mappedSize; }
 };
+#endif
 
 #define MMKV_OUT
 
@@ -116,9 +174,47 @@ concept MMKV_SUPPORTED_VECTOR_VALUE_TYPE = mmkv_is_vector_v<T> &&
 template <class T>
 concept MMKV_SUPPORTED_VALUE_TYPE = MMKV_SUPPORTED_PRIMITIVE_VALUE_TYPE<T> || MMKV_SUPPORTED_POD_VALUE_TYPE<T> ||
     MMKV_SUPPORTED_VECTOR_VALUE_TYPE<T>;
+
+template <class T>
+concept MMKV_SUPPORTED_FIXED_WIDTH_VALUE_TYPE = MMKV_SUPPORTED_PRIMITIVE_VALUE_TYPE<T> && !std::is_same_v<T, bool>;
+
+template <class T>
+concept MMKV_TRIVIALLY_COPYABLE_TYPE = std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>;
+
+// a struct can declare `static constexpr uint32_t MMKVPODTag = N;` and bump it on any layout change that keeps
+// the same size & alignment, a value stored with a different tag won't be read back by getPOD()
+template <MMKV_TRIVIALLY_COPYABLE_TYPE T>
+constexpr uint32_t mmkv_pod_tag() {
+    if constexpr (requires { T::MMKVPODTag; }) {
+        return static_cast<uint32_t>(T::MMKVPODTag);
+    } else {
+        return 0;
+    }
+}
+
+template <MMKV_TRIVIALLY_COPYABLE_TYPE T>
+class MMKVAlignedView;
+
+template <MMKV_SUPPORTED_FIXED_WIDTH_VALUE_TYPE T>
+using MMKVVectorView = MMKVAlignedView<T>;
+
+template <MMKV_TRIVIALLY_COPYABLE_TYPE T>
+using MMKVPODView = MMKVAlignedView<T>;
 #endif // MMKV_HAS_CPP20
 
+#ifndef MMKV_APPLE
+class MMKVValueWriter;
+class MMKVValueReader;
+class MMKVStore;
+#endif
+
 class MMKV_EXPORT MMKV {
+#ifndef MMKV_APPLE
+public:
+    class KeyHandle;
+
+private:
+#endif
     MMKV(const std::string &mmapID, const MMKVConfig &config);
 #ifdef MMKV_ANDROID
 #ifndef MMKV_OHOS
@@ -141,6 +237,11 @@ class MMKV_EXPORT MMKV {
     MMKVPath_t m_crcPath;
     mmkv::MMKVMap *m_dic;
     mmkv::MMKVMapCrypt *m_dicCrypt;
+    // where the dictionary is allocated from, nullptr for the default heap of MMKV
+    mmkv::MMKVAllocator *m_allocator = nullptr;
+    // a new value whenever entries of the dictionary might have been erased, see KeyHandle
+    uint64_t m_dicEpoch = 0;
+    void invalidateKeyHandles();
 
     size_t m_expectedCapacity;
 
@@ -151,16 +252,40 @@ class MMKV_EXPORT MMKV {
     bool m_needLoadFromFile;
     bool m_hasFullWriteback;
 
+    // zero-copy views pointing into m_file, it's neither moved nor rewritten while there's any, see getVectorView()
+    std::atomic<uint32_t> m_pinnedViews = 0;
+    bool refuseForPinnedViews(const char *operation);
+    // whether a view of the bytes can point into m_file instead of copying them
+    bool isPinnable(const void *ptr, size_t size) const;
+
     uint32_t m_crcDigest;
     mmkv::MemoryFile *m_metaFile;
     mmkv::MMKVMetaInfo *m_metaInfo;
 
     mmkv::AESCrypt *m_crypter;
+#ifndef MMKV_DISABLE_CRYPT
+    size_t m_cryptMemoryLimit = 0;
+    size_t m_cryptMemoryUsage = 0; // maintained on set & remove, recounted on load
+    bool isCryptValueStoredAsOffset(size_t valueSize) const;
+    size_t cryptMemoryBudget() const;
+    void recountCryptMemory();
+#endif
 
     mmkv::ThreadLock *m_lock;
     mmkv::FileLock *m_fileLock;
     mmkv::InterProcessLock *m_sharedProcessLock;
     mmkv::InterProcessLock *m_exclusiveProcessLock;
+    bool m_sharedMemoryLock = false;
+    uint64_t m_metaGeneration = 0; // the meta generation our memory state is in sync with
+    void increaseMetaGeneration();
+    bool m_optimisticRead = false;
+    // called before overwriting bytes that other processes might be reading without the lock
+    void willRewriteInPlace();
+    // point m_fileLock to the lock state in the meta file, again whenever the meta file is remapped
+    void attachSharedMemoryLock();
+#ifdef MMKV_LINUX
+    mmkv::ChangeDispatcher *m_changeDispatcher = nullptr;
+#endif
 
     bool m_enableKeyExpire = false;
     uint32_t m_expiredInSeconds = ExpireNever;
@@ -171,6 +296,31 @@ class MMKV_EXPORT MMKV {
 
     uint32_t m_itemSizeLimit = 0;
 
+    size_t m_blobThreshold = 0;
+    mmkv::MemoryFile *m_blobFile = nullptr;
+
+    size_t m_expectedSegmentSize = 0;
+    size_t m_segmentSize = 0; // non-zero when the file is a segmented log
+    uint32_t m_headSegment = 0;
+    uint32_t m_segmentSequence = 0;
+
+    bool m_enableSharedIndex = false;
+    bool m_sharedIndex = false; // keys are looked up in the index file, m_dic is left empty
+    std::vector<std::string> m_keyPrefixes; // the loaded slice of keys, see MMKVConfig::keyPrefixes
+    const std::vector<std::string> *keyFilter() const { return m_keyPrefixes.empty() ? nullptr : &m_keyPrefixes; }
+    mmkv::MemoryFile *m_indexFile = nullptr;
+
+#ifndef MMKV_APPLE
+    // residency, see setMemoryBudget()
+    std::atomic<uint64_t> m_lastAccess = 0;
+    std::atomic<size_t> m_residentSize = 0; // an estimation, refreshed on load, unload & every now and then
+    size_t m_keyHeapSize = 0;               // average heap bytes of a key, sampled when counted exactly
+    void touchResidency();
+    MMKVMemoryUsage computeMemoryUsage(bool exact);
+    MMKVMemoryUsage updateResidentSize(bool exact);
+    static void enforceMemoryBudget(MMKV *current);
+#endif
+
 #ifdef MMKV_APPLE
 #ifdef __OBJC__
     using MMKVKey_t = NSString *__unsafe_unretained;
@@ -193,6 +343,10 @@ class MMKV_EXPORT MMKV {
     void loadFromFile();
 
     void partialLoadFromFile();
+
+    // another process has compacted the file, move the index along with its items if we can
+    bool reloadFromCompaction(const mmkv::MMKVMetaInfo &metaInfo);
+    void writeCompactionInfo(uint32_t fromSequence, uint32_t fromActualSize, uint32_t fromCRCDigest);
     
 //#if defined(MMKV_APPLE) || defined(MMKV_WIN32)
 // the disk corruption detection is tested in iOS/Win32, but not Android
@@ -238,6 +392,11 @@ class MMKV_EXPORT MMKV {
 
     mmkv::MMBuffer getDataForKey(MMKVKey_t key);
 
+    // the data of a getter, read without processLock when it can be, see MMKVConfig::optimisticRead
+    // otherwise processLock is taken & the data is only valid while it's held
+    mmkv::MMBuffer readDataForKey(MMKVKey_t key, std::unique_lock<mmkv::InterProcessLock> &processLock);
+    bool tryOptimisticRead(MMKVKey_t key, mmkv::MMBuffer &data);
+
     // isDataHolder: avoid memory copying
     bool setDataForKey(mmkv::MMBuffer &&data, MMKVKey_t key, bool isDataHolder = false);
 
@@ -255,6 +414,103 @@ class MMKV_EXPORT MMKV {
     KVHolderRet_t overrideDataWithKey(const mmkv::MMBuffer &data, const mmkv::KeyValueHolder &kvHolder, bool isDataHolder = false);
     KVHolderRet_t overrideDataWithKey(const mmkv::MMBuffer &data, MMKVKey_t key, bool isDataHolder = false);
     bool checkSizeForOverride(size_t size);
+
+    // encode the value straight into m_output, skipping the temporary MMBuffer and its memcpy
+    // writer must write exactly valueSize bytes
+    using ValueWriter_t = void (*)(mmkv::CodedOutputData &output, const void *value);
+    bool canSetDirectly() const {
+        return !m_crypter && !m_enableKeyExpire && !m_enableCompareBeforeSet && !m_enableSharedIndex;
+    }
+    bool setDirectlyForKey(const void *value, size_t valueSize, ValueWriter_t writer, MMKVKey_t key);
+    // append a new value for the key of an existing holder & point the holder to it
+    bool appendDirectlyForHolder(const void *value, size_t valueSize, ValueWriter_t writer, mmkv::KeyValueHolder &kvHolder);
+    KVHolderRet_t doAppendValueWithKey(const void *value, size_t valueSize, ValueWriter_t writer, const mmkv::MMBuffer &key, uint32_t keyLength);
+
+    // value separation: a large value is appended to the blob file, the log holds a pointer of BlobPointerSize instead
+    static constexpr size_t BlobPointerSize = 28;
+    bool shouldSeparateValue(size_t valueSize) const {
+        return mmkv_unlikely(m_blobThreshold > 0) && valueSize > m_blobThreshold && valueSize > BlobPointerSize &&
+               !m_crypter && !m_enableKeyExpire && !m_segmentSize;
+    }
+    bool setBlobForKey(const void *value, size_t valueSize, ValueWriter_t writer, MMKVKey_t key);
+    bool appendBlobValue(const void *value, size_t valueSize, ValueWriter_t writer, mmkv::MMBuffer &pointer);
+    mmkv::MMBuffer resolveBlobValue(mmkv::MMBuffer &&data);
+    bool openBlobFileIfNeeded(bool create);
+    void closeBlobFile();
+    bool ensureBlobFileSize(size_t incomingSize);
+    // move live values to a fresh blob file, then point the log to it
+    bool collectBlobGarbage(size_t incomingSize);
+    void resetBlobFile();
+
+    // segmented log: records are appended to the head segment, a full one is replaced by a free segment,
+    // and the segment with the most garbage gets its live records copied to the head & is recycled
+    bool loadFromSegments();
+    bool formatSegments(size_t fromIndex);
+    bool growSegments();
+    void openHeadSegment(uint32_t index);
+    void resetSegmentOutput();
+    bool ensureSegmentSpace(size_t size);
+    bool switchHeadSegment();
+    void commitSegmentAppend(const uint8_t *ptr, size_t size);
+    bool compactSegment(uint32_t index, bool dropTombstones);
+    bool compactAllSegments();
+    void trimSegments();
+
+#ifndef MMKV_APPLE
+    // shared index: writers update it under the exclusive lock, every process looks keys up there directly,
+    // the dictionary is only filled while a full write-back needs it, then handed back to the index
+    bool openSharedIndexIfNeeded(bool create);
+    void closeSharedIndex();
+    // use the index if it's in sync with the file
+    bool attachSharedIndex();
+    // another process has changed the file, it has updated the index as well
+    void syncSharedIndex();
+    bool findInSharedIndex(MMKVKey_t key, mmkv::KeyValueHolder &kvHolder);
+    void putSharedIndex(MMKVKey_t key, const mmkv::KeyValueHolder &kvHolder);
+    void eraseSharedIndex(MMKVKey_t key);
+    size_t sharedIndexCount();
+    std::vector<std::string> sharedIndexKeys();
+    size_t forEachInSharedIndex(bool (*func)(std::string_view, const mmkv::MMBuffer &, void *), void *context);
+    void loadDictionaryFromSharedIndex();
+    void saveDictionaryToSharedIndex();
+
+    // ordered index: built on the first prefix/range call, then kept in step with single-key writes,
+    // any other change leaves it behind m_metaGeneration and it's rebuilt on the next call
+    mmkv::MMKVOrderedKeys *m_orderedKeys = nullptr;
+    uint64_t m_orderedKeysGeneration = 0;
+    void prepareOrderedKeys();
+    bool hasKeyInMemory(std::string_view key);
+    size_t keyCountInMemory();
+    // walk keys from begin in order, while they are before end (unless it's empty) and start with prefix
+    // withValue: visit with the value as forEach() does, skipping expired keys
+    size_t walkOrderedKeys(std::string_view begin, std::string_view end, std::string_view prefix, bool withValue,
+                           bool (*func)(std::string_view, const mmkv::MMBuffer &, void *), void *context);
+    // hand a value from the dictionary to func as forEach() does, return true to stop
+    bool visitKeyValue(std::string_view key, mmkv::MMBuffer &&raw, uint32_t now,
+                       bool (*func)(std::string_view, const mmkv::MMBuffer &, void *), void *context, size_t &count);
+
+    // the holder of handle.key() in the dictionary, nullptr if there's none; a cached one is used while the epoch stays
+    void *resolveHandle(KeyHandle &handle);
+    mmkv::MMBuffer getDataForHandle(KeyHandle &handle);
+    bool setDirectlyForHandle(const void *value, size_t valueSize, ValueWriter_t writer, KeyHandle &handle);
+
+    // the logical stores handed out by storeWithID(), they live as long as the container
+    std::unordered_map<std::string, MMKVStore *> *m_stores = nullptr;
+
+    // follows a single-key write in the ordered index, it's left behind if anything else has changed
+    class OrderedKeysUpdate {
+        MMKV *m_kv;
+        std::string_view m_key;
+        uint64_t m_generation = 0;
+        size_t m_count = 0;
+        bool m_hadKey = false;
+        bool m_active = false;
+
+    public:
+        OrderedKeysUpdate(MMKV *kv, std::string_view key);
+        ~OrderedKeysUpdate();
+    };
+#endif
 #ifdef MMKV_APPLE
 #ifdef __OBJC__
     mmkv::MMBuffer getDataForKey(std::string_view key);
@@ -291,6 +547,46 @@ class MMKV_EXPORT MMKV {
     void shared_lock();
     void shared_unlock();
 
+#ifndef MMKV_APPLE
+    friend class MMKVValueWriter;
+    friend class MMKVValueReader;
+#endif
+
+#ifdef MMKV_HAS_CPP20
+    template <MMKV_TRIVIALLY_COPYABLE_TYPE T>
+    friend class MMKVAlignedView;
+
+    // the tag & the type code tell what's stored by setAlignedBytes(), it's read back with the same ones
+    static constexpr uint8_t AlignedVectorTag = 0xA1;
+    static constexpr uint8_t AlignedPODTag = 0xA2;
+
+    // element size, signedness & floating point, a vector is read back as the type it's written
+    template <MMKV_SUPPORTED_FIXED_WIDTH_VALUE_TYPE T>
+    static constexpr uint8_t alignedVectorTypeCode() {
+        return static_cast<uint8_t>(sizeof(T) | (std::is_floating_point_v<T> ? 0x40 : 0) | (std::is_signed_v<T> ? 0x80 : 0));
+    }
+
+    struct PODFingerprint {
+        uint32_t size;
+        uint32_t alignment;
+        uint32_t tag;
+    };
+
+    template <MMKV_TRIVIALLY_COPYABLE_TYPE T>
+    static constexpr PODFingerprint podFingerprint() {
+        return {static_cast<uint32_t>(sizeof(T)), static_cast<uint32_t>(alignof(T)), mmkv_pod_tag<T>()};
+    }
+
+    bool setAlignedBytes(const void *ptr, size_t size, uint8_t tag, const void *typeCode, size_t typeCodeSize,
+                         size_t alignment, MMKVKey_t key, uint32_t expireDuration);
+    // locate the elements of a value written by setAlignedBytes()
+    bool parseAlignedBytes(const mmkv::MMBuffer &data, uint8_t tag, const void *typeCode, size_t typeCodeSize,
+                           size_t elementSize, size_t &offset, size_t &size) const;
+
+    template <MMKV_TRIVIALLY_COPYABLE_TYPE T>
+    bool getAlignedView(MMKVKey_t key, uint8_t tag, const void *typeCode, size_t typeCodeSize, MMKVAlignedView<T> &view);
+#endif
+
     // assuming rootPath is absolute
     static MMKV *getMMKVWithID(const std::string &mmapID, const MMKVConfig &config);
 
@@ -300,7 +596,10 @@ class MMKV_EXPORT MMKV {
 
 public:
     // call this before getting any MMKV instance
-    static void initializeMMKV(const MMKVPath_t &rootDir, MMKVLogLevel logLevel = MMKVLogInfo, mmkv::MMKVHandler *handler = nullptr);
+    // allocator: MMKV takes its heap memory from it instead of malloc(), it's only taken on the first call,
+    // which must come before anything else of MMKV, and it must live as long as the process does
+    static void initializeMMKV(const MMKVPath_t &rootDir, MMKVLogLevel logLevel = MMKVLogInfo, mmkv::MMKVHandler *handler = nullptr,
+                               mmkv::MMKVAllocator *allocator = nullptr);
 
     // a generic purpose instance
     static MMKV *defaultMMKV(MMKVMode mode = MMKV_SINGLE_PROCESS, const std::string *cryptKey = nullptr, bool aes256 = false);
@@ -370,6 +669,15 @@ public:
     // just reset cryptKey (will not encrypt or decrypt anything)
     // usually you should call this method after other process reKey() the multi-process mmkv
     void checkReSetCryptKey(const std::string *cryptKey, bool aes256 = false);
+
+    // cap the heap memory an encrypted instance spends on decrypted values, 0 for no limit
+    // beyond it, values are kept by offset & decrypted from the file on each access, like those over 256 bytes
+    // lowering it below cryptMemoryUsage() drops the memory cache, the next access reloads within the limit
+    void setCryptMemoryLimit(size_t limit);
+    size_t cryptMemoryLimit() const { return m_cryptMemoryLimit; }
+
+    // the heap memory held by decrypted values, keys & those small enough to live in the dictionary node not counted
+    size_t cryptMemoryUsage();
 #endif
 
     bool set(bool value, MMKVKey_t key);
@@ -510,6 +818,59 @@ public:
 
     template<MMKV_SUPPORTED_VECTOR_VALUE_TYPE T>
     bool getVector(MMKVKey_t key, T &result);
+
+    // opt-in aligned, fixed-width encoding of numeric vectors, the elements are written with a single memcpy,
+    // aligned to alignof(T) in the file, read it back by getVectorView() instead of getVector()
+    template<MMKV_SUPPORTED_FIXED_WIDTH_VALUE_TYPE T>
+    bool setAlignedVector(std::span<const T> value, MMKVKey_t key) {
+        return setAlignedVector(value, key, m_expiredInSeconds);
+    }
+
+    template<MMKV_SUPPORTED_FIXED_WIDTH_VALUE_TYPE T>
+    bool setAlignedVector(std::span<const T> value, MMKVKey_t key, uint32_t expireDuration) {
+        constexpr auto typeCode = alignedVectorTypeCode<T>();
+        return setAlignedBytes(value.data(), value.size_bytes(), AlignedVectorTag, &typeCode, sizeof(typeCode),
+                               alignof(T), key, expireDuration);
+    }
+
+    template<MMKV_SUPPORTED_FIXED_WIDTH_VALUE_TYPE T>
+    bool setAlignedVector(const std::vector<T> &value, MMKVKey_t key) {
+        return setAlignedVector(std::span<const T>(value), key, m_expiredInSeconds);
+    }
+
+    // zero-copy read of a vector written by setAlignedVector(), the view points into the file & pins it without any lock,
+    // until then a write that needs a full writeback or a larger file fails, so do clearAll(), trim() & restore
+    // it's an aligned copy instead if the elements have been moved off alignment by a full writeback,
+    // or the instance is multi-process, encrypted or segmented; either way the instance must outlive the view
+    template<MMKV_SUPPORTED_FIXED_WIDTH_VALUE_TYPE T>
+    bool getVectorView(MMKVKey_t key, MMKVVectorView<T> &view) {
+        constexpr auto typeCode = alignedVectorTypeCode<T>();
+        return getAlignedView(key, AlignedVectorTag, &typeCode, sizeof(typeCode), view);
+    }
+
+    // trivially copyable structs, stored as raw bytes along with a fingerprint of size, alignment & mmkv_pod_tag<T>()
+    template<MMKV_TRIVIALLY_COPYABLE_TYPE T>
+    bool setPOD(const T &value, MMKVKey_t key) {
+        return setPOD(value, key, m_expiredInSeconds);
+    }
+
+    template<MMKV_TRIVIALLY_COPYABLE_TYPE T>
+    bool setPOD(const T &value, MMKVKey_t key, uint32_t expireDuration) {
+        constexpr auto fingerprint = podFingerprint<T>();
+        return setAlignedBytes(&value, sizeof(T), AlignedPODTag, &fingerprint, sizeof(fingerprint), alignof(T), key,
+                               expireDuration);
+    }
+
+    // return false if the key doesn't exist or the fingerprint doesn't match
+    template<MMKV_TRIVIALLY_COPYABLE_TYPE T>
+    bool getPOD(MMKVKey_t key, T &value);
+
+    // zero-copy read of a value written by setPOD(), the same as getVectorView()
+    template<MMKV_TRIVIALLY_COPYABLE_TYPE T>
+    bool getPODView(MMKVKey_t key, MMKVPODView<T> &view) {
+        constexpr auto fingerprint = podFingerprint<T>();
+        return getAlignedView(key, AlignedPODTag, &fingerprint, sizeof(fingerprint), view) && view.size() == 1;
+    }
 #endif // MMKV_HAS_CPP20
 
     // inplaceModification is recommended for faster speed
@@ -519,6 +880,17 @@ public:
 
     bool getBytes(MMKVKey_t key, mmkv::MMBuffer &result);
 
+#ifndef MMKV_APPLE
+    // stream a value of exactly expectedSize bytes into the file chunk by chunk, it's read back by getBytes()
+    // the writer holds the write lock until it's committed or cancelled, don't modify this instance meanwhile
+    bool openValueWriter(MMKVKey_t key, size_t expectedSize, MMKVValueWriter &writer);
+    bool openValueWriter(MMKVKey_t key, size_t expectedSize, uint32_t expireDuration, MMKVValueWriter &writer);
+
+    // stream a value written by set(MMBuffer) or openValueWriter() out of the file chunk by chunk
+    // the reader holds the read lock until it's closed
+    bool openValueReader(MMKVKey_t key, MMKVValueReader &reader);
+#endif
+
     bool getVector(MMKVKey_t key, std::vector<std::string> &result);
 
     bool getBool(MMKVKey_t key, bool defaultValue = false, MMKV_OUT bool *hasValue = nullptr);
@@ -592,6 +964,99 @@ public:
     std::vector<std::string> allKeys(bool filterExpire = false);
 
     bool removeValuesForKeys(const std::vector<std::string> &arrKeys);
+
+    // getBytes() of every key under one lock, a missing key gets std::nullopt
+    std::vector<std::optional<mmkv::MMBuffer>> getBytesForKeys(const std::vector<std::string_view> &keys);
+
+    // set(MMBuffer) of every key under one lock, appended to the file at once when nothing needs special handling
+    bool setBytesForKeys(const std::vector<std::string_view> &keys, const std::vector<mmkv::MMBuffer> &values);
+
+    // visit every key with its encoded value (what getBytes() & co. decode) under one lock, nothing is copied:
+    // both point into the mapping (the value is decrypted into a temporary buffer for encrypted instances),
+    // only valid inside the call; expired keys are skipped; don't modify the instance inside the call
+    // return true from func to stop, return the number of keys visited
+    typedef bool (*ForEachFunc_t)(std::string_view key, const mmkv::MMBuffer &value, void *context);
+    size_t forEach(ForEachFunc_t func, void *context);
+
+    // the bytes of a string/bytes value given by forEach(), pointing into it, false if it isn't one
+    static bool bytesView(const mmkv::MMBuffer &value, mmkv::MMBuffer &result);
+
+    template <typename F>
+    size_t forEach(F &&func) {
+        return forEach(
+            [](std::string_view key, const mmkv::MMBuffer &value, void *context) {
+                return static_cast<bool>((*static_cast<std::remove_reference_t<F> *>(context))(key, value));
+            },
+            &func);
+    }
+
+    // prefix & range calls are served by an ordered index of keys,
+    // it's built on the first call (O(n log n)) and kept up to date afterward
+    // filterExpire: skip expired keys, keep in mind it comes with cost
+    std::vector<std::string> keysWithPrefix(std::string_view prefix, bool filterExpire = false);
+    size_t countPrefix(std::string_view prefix, bool filterExpire = false);
+
+    // remove every key starting with prefix by appending a deletion for each one, no full write-back
+    // an empty prefix is rejected, use clearAll() instead; return the number of keys removed
+    size_t removePrefix(std::string_view prefix);
+
+    // forEach() over keys in [begin, end) in byte order, an empty end means no upper bound
+    size_t forEachInRange(std::string_view begin, std::string_view end, ForEachFunc_t func, void *context);
+
+    template <typename F>
+    size_t forEachInRange(std::string_view begin, std::string_view end, F &&func) {
+        return forEachInRange(
+            begin, end,
+            [](std::string_view key, const mmkv::MMBuffer &value, void *context) {
+                return static_cast<bool>((*static_cast<std::remove_reference_t<F> *>(context))(key, value));
+            },
+            &func);
+    }
+
+    // container mode: many small logical stores packed in the file of this instance instead of a file each,
+    // every record of a store carries the store id in front of its key, see MMKVStore
+    // return the same store for the same id, nullptr for an empty id or one containing '\0'
+    MMKVStore *storeWithID(const std::string &storeID);
+
+    // the ids of the stores that have any key in the container, in byte order
+    std::vector<std::string> allStoreIDs();
+
+    // a key resolved once, for a key that's read or written over & over:
+    // the holder it has found is cached, so a later call skips hashing & probing the dictionary,
+    // it's probed again after anything might have erased it (remove, trim, reload, another process's change)
+    // a handle belongs to the instance that resolved it, don't share one between threads
+    class KeyHandle {
+        std::string m_key;
+        void *m_holder = nullptr;
+        uint64_t m_epoch = 0;
+        friend class MMKV;
+
+    public:
+        KeyHandle() = default;
+        explicit KeyHandle(std::string_view key) : m_key(key) {}
+        const std::string &key() const { return m_key; }
+    };
+
+    // the key doesn't have to exist yet, the handle picks it up once it's set
+    KeyHandle resolveKey(std::string_view key);
+
+    bool set(bool value, KeyHandle &handle);
+    bool set(int32_t value, KeyHandle &handle);
+    bool set(uint32_t value, KeyHandle &handle);
+    bool set(int64_t value, KeyHandle &handle);
+    bool set(uint64_t value, KeyHandle &handle);
+    bool set(float value, KeyHandle &handle);
+    bool set(double value, KeyHandle &handle);
+
+    bool getBool(KeyHandle &handle, bool defaultValue = false, MMKV_OUT bool *hasValue = nullptr);
+    int32_t getInt32(KeyHandle &handle, int32_t defaultValue = 0, MMKV_OUT bool *hasValue = nullptr);
+    uint32_t getUInt32(KeyHandle &handle, uint32_t defaultValue = 0, MMKV_OUT bool *hasValue = nullptr);
+    int64_t getInt64(KeyHandle &handle, int64_t defaultValue = 0, MMKV_OUT bool *hasValue = nullptr);
+    uint64_t getUInt64(KeyHandle &handle, uint64_t defaultValue = 0, MMKV_OUT bool *hasValue = nullptr);
+    float getFloat(KeyHandle &handle, float defaultValue = 0, MMKV_OUT bool *hasValue = nullptr);
+    double getDouble(KeyHandle &handle, double defaultValue = 0, MMKV_OUT bool *hasValue = nullptr);
+    bool getString(KeyHandle &handle, std::string &result);
+    bool getBytes(KeyHandle &handle, mmkv::MMBuffer &result);
 #endif // MMKV_APPLE
 
     bool removeValueForKey(MMKVKey_t key);
@@ -619,6 +1084,18 @@ public:
     // keepSpace: remove all keys but keep the file size not changed, running faster
     void clearMemoryCache(bool keepSpace = false);
 
+#ifndef MMKV_APPLE
+    // the memory the instance holds right now, it doesn't load the instance
+    MMKVMemoryUsage memoryUsage();
+
+    // keep the memory of all instances within the budget, 0 for no limit, checked whenever an instance loads
+    // and every now and then on access
+    // the least recently used instances are unloaded by clearMemoryCache(), to be loaded again on the next access;
+    // an instance in use by another thread, or locked by the current one, is skipped
+    static void setMemoryBudget(size_t budget);
+    static size_t memoryBudget();
+#endif
+
     // you don't need to call this, really, I mean it
     // unless you worry about running out of battery
     void sync(SyncFlag flag = MMKV_SYNC);
@@ -658,6 +1135,15 @@ public:
     // check if content been changed by other process
     void checkContentChanged();
 
+#ifdef MMKV_LINUX
+    // multi-process mode only, watch for changes by other processes on a background thread,
+    // onContentChangedByOuterProcess() is called on that thread right after a change instead of on the next access
+    // return an eventfd that becomes readable on every such change, poll() it & read() it to reset, -1 on failure
+    // not inherited by a forked child, enable it again in the child if needed
+    int enableChangeNotification();
+    void disableChangeNotification();
+#endif
+
     // register a unified callback handler for MMKV
     static void registerHandler(mmkv::MMKVHandler *handler);
     static void unRegisterHandler();
@@ -684,6 +1170,165 @@ public:
     friend class mmkv::NameSpace;
 };
 
+#ifndef MMKV_APPLE
+// writes a value straight into the mmap, encrypting it on the fly for an encrypted instance
+// nothing is visible until commit(), an uncommitted value is discarded on cancel() or destruction
+class MMKV_EXPORT MMKVValueWriter {
+    MMKV *m_kv = nullptr; // not null when the writer is open
+    std::string m_key;
+    size_t m_expectedSize = 0;
+    size_t m_written = 0;
+    uint32_t m_expireDuration = 0;
+    uint32_t m_valueLength = 0;
+    size_t m_entrySize = 0;
+    uint32_t m_crcDigest = 0;
+    // a small encrypted value is kept in memory by MMKV anyway, it's collected here and set() on commit
+    bool m_isBuffered = false;
+    mmkv::MMBuffer m_buffer;
+#ifndef MMKV_DISABLE_CRYPT
+    std::unique_ptr<mmkv::AESCryptStatus> m_cryptStatus;
+#endif
+
+    // encrypt & checksum the bytes just written to the file
+    void seal(uint8_t *ptr, size_t size);
+    void close();
+
+    friend class MMKV;
+
+public:
+    MMKVValueWriter();
+    ~MMKVValueWriter();
+
+    // return false if the writer is not open or it goes beyond expectedSize
+    bool write(const void *ptr, size_t size);
+    bool write(const mmkv::MMBuffer &data) { return write(data.getPtr(), data.length()); }
+
+    // fail & cancel if less than expectedSize bytes are written
+    bool commit();
+    void cancel();
+
+    bool isOpen() const { return m_kv != nullptr; }
+    size_t expectedSize() const { return m_expectedSize; }
+    size_t written() const { return m_written; }
+
+    // just forbid it for possibly misuse
+    MMKVValueWriter(const MMKVValueWriter &other) = delete;
+    MMKVValueWriter &operator=(const MMKVValueWriter &other) = delete;
+};
+
+// reads a value straight out of the mmap, decrypting it on the fly for an encrypted instance
+class MMKV_EXPORT MMKVValueReader {
+    MMKV *m_kv = nullptr; // not null when the reader points into the file & holds the read lock
+    const uint8_t *m_ptr = nullptr;
+    size_t m_size = 0;
+    size_t m_position = 0;
+    // the value is copied out when it's not in the file as it is
+    mmkv::MMBuffer m_buffer;
+#ifndef MMKV_DISABLE_CRYPT
+    std::unique_ptr<mmkv::AESCrypt> m_decrypter;
+#endif
+
+    friend class MMKV;
+
+public:
+    MMKVValueReader();
+    ~MMKVValueReader();
+
+    // copy at most size bytes out, return the count copied, 0 at the end of the value
+    size_t read(void *ptr, size_t size);
+
+    void close();
+
+    size_t size() const { return m_size; }
+    size_t remaining() const { return m_size - m_position; }
+
+    // just forbid it for possibly misuse
+    MMKVValueReader(const MMKVValueReader &other) = delete;
+    MMKVValueReader &operator=(const MMKVValueReader &other) = delete;
+};
+
+// a logical store inside a container instance, see MMKV::storeWithID()
+// it has its own keys, expiration & clearAll(), backed by the file, dictionary & crypt key of the container
+class MMKV_EXPORT MMKVStore {
+    MMKV *m_container;
+    std::string m_storeID;
+    std::string m_keyPrefix;
+    std::atomic<bool> m_enableKeyExpire{false};
+    std::atomic<uint32_t> m_expiredInSeconds{MMKV::ExpireNever};
+
+    MMKVStore(MMKV *container, const std::string &storeID);
+    std::string storeKey(std::string_view key) const;
+
+    friend class MMKV;
+
+public:
+    // the prefix of every key of the store inside the container,
+    // pass it in MMKVConfig::keyPrefixes to load only some stores of a container
+    static std::string keyPrefix(std::string_view storeID);
+
+    MMKV *container() const { return m_container; }
+    const std::string &storeID() const { return m_storeID; }
+
+    // any value MMKV::set() takes
+    template <typename T>
+    bool set(const T &value, std::string_view key) {
+        if (key.empty()) {
+            return false;
+        }
+        if (m_enableKeyExpire.load(std::memory_order_relaxed)) {
+            return m_container->set(value, storeKey(key), m_expiredInSeconds.load(std::memory_order_relaxed));
+        }
+        return m_container->set(value, storeKey(key));
+    }
+
+    template <typename T>
+    bool set(const T &value, std::string_view key, uint32_t expireDuration) {
+        if (key.empty()) {
+            return false;
+        }
+        return m_container->set(value, storeKey(key), expireDuration);
+    }
+
+    bool getBool(std::string_view key, bool defaultValue = false, MMKV_OUT bool *hasValue = nullptr);
+    int32_t getInt32(std::string_view key, int32_t defaultValue = 0, MMKV_OUT bool *hasValue = nullptr);
+    uint32_t getUInt32(std::string_view key, uint32_t defaultValue = 0, MMKV_OUT bool *hasValue = nullptr);
+    int64_t getInt64(std::string_view key, int64_t defaultValue = 0, MMKV_OUT bool *hasValue = nullptr);
+    uint64_t getUInt64(std::string_view key, uint64_t defaultValue = 0, MMKV_OUT bool *hasValue = nullptr);
+    float getFloat(std::string_view key, float defaultValue = 0, MMKV_OUT bool *hasValue = nullptr);
+    double getDouble(std::string_view key, double defaultValue = 0, MMKV_OUT bool *hasValue = nullptr);
+    bool getString(std::string_view key, std::string &result, bool inplaceModification = true);
+    mmkv::MMBuffer getBytes(std::string_view key);
+    bool getBytes(std::string_view key, mmkv::MMBuffer &result);
+
+    // any vector MMKV::getVector() takes
+    template <typename T>
+    bool getVector(std::string_view key, T &result) {
+        return m_container->getVector(storeKey(key), result);
+    }
+
+    bool containsKey(std::string_view key);
+    bool removeValueForKey(std::string_view key);
+
+    // filterExpire: skip expired keys, keep in mind it comes with cost
+    size_t count(bool filterExpire = false);
+    std::vector<std::string> allKeys(bool filterExpire = false);
+
+    // remove every key of the store, the other stores of the container are left alone
+    // return the number of keys removed
+    size_t clearAll();
+
+    // the default expiration duration of the keys set from now on, ExpireNever (0) for none
+    // the container must have key expiration on, e.g. opened with MMKVConfig::enableKeyExpire, or it fails
+    bool enableAutoKeyExpire(uint32_t expiredInSeconds = 0);
+    // the keys set from now on take the default of the container
+    void disableAutoKeyExpire();
+
+    // just forbid it for possibly misuse
+    MMKVStore(const MMKVStore &other) = delete;
+    MMKVStore &operator=(const MMKVStore &other) = delete;
+};
+#endif // !MMKV_APPLE
+
 #if defined(MMKV_HAS_CPP20)
 template<MMKV_SUPPORTED_VECTOR_VALUE_TYPE T>
 bool MMKV::set(const T& value, MMKVKey_t key, uint32_t expireDuration) {
@@ -724,6 +1369,111 @@ bool MMKV::getVector(MMKVKey_t key, T &result) {
     return ret;
 }
 
+// a read-only view of the elements written by MMKV::setAlignedVector() or MMKV::setPOD()
+template <MMKV_TRIVIALLY_COPYABLE_TYPE T>
+class MMKVAlignedView {
+    struct AlignedDeleter {
+        void operator()(void *ptr) const { ::operator delete(ptr, std::align_val_t(alignof(T))); }
+    };
+
+    MMKV *m_kv = nullptr; // not null when the view points into the file & pins it
+    std::unique_ptr<void, AlignedDeleter> m_copy;
+    std::span<const T> m_span;
+
+    friend class MMKV;
+
+public:
+    MMKVAlignedView() = default;
+    MMKVAlignedView(const MMKVAlignedView &other) = delete;
+    MMKVAlignedView &operator=(const MMKVAlignedView &other) = delete;
+
+    MMKVAlignedView(MMKVAlignedView &&other) noexcept
+        : m_kv(other.m_kv), m_copy(std::move(other.m_copy)), m_span(other.m_span) {
+        other.m_kv = nullptr;
+        other.m_span = {};
+    }
+
+    ~MMKVAlignedView() { reset(); }
+
+    // no lock is taken, it can be reset or destroyed on any thread
+    void reset() {
+        if (m_kv) {
+            m_kv->m_pinnedViews.fetch_sub(1);
+            m_kv = nullptr;
+        }
+        m_span = {};
+        m_copy.reset();
+    }
+
+    std::span<const T> span() const { return m_span; }
+    const T *data() const { return m_span.data(); }
+    size_t size() const { return m_span.size(); }
+    bool empty() const { return m_span.empty(); }
+    const T &operator[](size_t index) const { return m_span[index]; }
+    auto begin() const { return m_span.begin(); }
+    auto end() const { return m_span.end(); }
+
+    // the value of MMKVPODView
+    const T &value() const { return m_span.front(); }
+    const T *operator->() const { return m_span.data(); }
+
+    // whether the elements are read straight from the file
+    bool isZeroCopy() const { return m_kv != nullptr; }
+};
+
+template <MMKV_TRIVIALLY_COPYABLE_TYPE T>
+bool MMKV::getAlignedView(MMKVKey_t key, uint8_t tag, const void *typeCode, size_t typeCodeSize, MMKVAlignedView<T> &view) {
+    view.reset();
+    if (isKeyEmpty(key)) {
+        return false;
+    }
+    shared_lock();
+
+    size_t offset = 0, size = 0;
+    auto data = getDataForKey(key);
+    if (!parseAlignedBytes(data, tag, typeCode, typeCodeSize, sizeof(T), offset, size)) {
+        shared_unlock();
+        return false;
+    }
+    auto ptr = (const uint8_t *) data.getPtr() + offset;
+    auto count = size / sizeof(T);
+    if (reinterpret_cast<uintptr_t>(ptr) % alignof(T) == 0 && isPinnable(ptr, size)) {
+        // pinned under the lock, so no writer can be in the middle of moving it
+        m_pinnedViews.fetch_add(1);
+        view.m_kv = this;
+        view.m_span = std::span<const T>((const T *) ptr, count);
+    } else {
+        if (size > 0) {
+            view.m_copy.reset(::operator new(size, std::align_val_t(alignof(T))));
+            memcpy(view.m_copy.get(), ptr, size);
+        }
+        view.m_span = std::span<const T>((const T *) view.m_copy.get(), count);
+    }
+    shared_unlock();
+    return true;
+}
+
+template <MMKV_TRIVIALLY_COPYABLE_TYPE T>
+bool MMKV::getPOD(MMKVKey_t key, T &value) {
+    if (isKeyEmpty(key)) {
+        return false;
+    }
+    shared_lock();
+
+    bool ret = false;
+    size_t offset = 0, size = 0;
+    constexpr auto fingerprint = podFingerprint<T>();
+    auto data = getDataForKey(key);
+    if (parseAlignedBytes(data, AlignedPODTag, &fingerprint, sizeof(fingerprint), sizeof(T), offset, size) &&
+        size == sizeof(T)) {
+        memcpy((void *) &value, (const uint8_t *) data.getPtr() + offset, sizeof(T));
+        ret = true;
+    }
+
+    shared_unlock();
+    return ret;
+}
+
 #ifdef MMKV_APPLE
 #ifdef __OBJC__
 template<MMKV_SUPPORTED_VECTOR_VALUE_TYPE T>
@@ -736,6 +1486,124 @@ bool getVector(std::string_view key, T &result) {
 
 #endif // MMKV_HAS_CPP20
 
+#ifndef MMKV_APPLE
+// a logical store with keys hashed across partitionCount MMKV instances, named "<mmapID>.<index>of<partitionCount>"
+// each partition has its own file, lock & compaction, so writers of different partitions don't block each other,
+// even across processes, and each full write-back is 1/partitionCount the size
+// keep partitionCount unchanged for a store, a different count opens another set of files
+class MMKV_EXPORT MMKVPartitioned {
+    using MMKVKey_t = std::string_view;
+
+    std::vector<MMKV *> m_partitions;
+
+    explicit MMKVPartitioned(std::vector<MMKV *> &&partitions) : m_partitions(std::move(partitions)) {}
+
+public:
+    MMKVPartitioned() = default;
+
+    static MMKVPartitioned mmkvWithID(const std::string &mmapID, uint32_t partitionCount, const MMKVConfig &config = MMKVConfig());
+
+    static bool removeStorage(const std::string &mmapID, uint32_t partitionCount, const MMKVPath_t *rootPath = nullptr);
+
+    bool isValid() const { return !m_partitions.empty(); }
+
+    size_t partitionCount() const { return m_partitions.size(); }
+
+    MMKV *partitionAt(size_t index) const { return m_partitions[index]; }
+
+    // the same key always goes to the same partition, in any process
+    MMKV *partitionForKey(MMKVKey_t key) const;
+
+    template <class T>
+    bool set(const T &value, MMKVKey_t key) { return partitionForKey(key)->set(value, key); }
+
+    template <class T>
+    bool set(const T &value, MMKVKey_t key, uint32_t expireDuration) {
+        return partitionForKey(key)->set(value, key, expireDuration);
+    }
+
+    bool getString(MMKVKey_t key, std::string &result, bool inplaceModification = true) {
+        return partitionForKey(key)->getString(key, result, inplaceModification);
+    }
+
+    mmkv::MMBuffer getBytes(MMKVKey_t key) { return partitionForKey(key)->getBytes(key); }
+
+    bool getBytes(MMKVKey_t key, mmkv::MMBuffer &result) { return partitionForKey(key)->getBytes(key, result); }
+
+    bool getVector(MMKVKey_t key, std::vector<std::string> &result) {
+        return partitionForKey(key)->getVector(key, result);
+    }
+
+#ifdef MMKV_HAS_CPP20
+    template <MMKV_SUPPORTED_VECTOR_VALUE_TYPE T>
+    bool getVector(MMKVKey_t key, T &result) { return partitionForKey(key)->getVector(key, result); }
+
+    template <MMKV_TRIVIALLY_COPYABLE_TYPE T>
+    bool getPOD(MMKVKey_t key, T &value) { return partitionForKey(key)->getPOD(key, value); }
+#endif
+
+    bool getBool(MMKVKey_t key, bool defaultValue = false, MMKV_OUT bool *hasValue = nullptr) {
+        return partitionForKey(key)->getBool(key, defaultValue, hasValue);
+    }
+
+    int32_t getInt32(MMKVKey_t key, int32_t defaultValue = 0, MMKV_OUT bool *hasValue = nullptr) {
+        return partitionForKey(key)->getInt32(key, defaultValue, hasValue);
+    }
+
+    uint32_t getUInt32(MMKVKey_t key, uint32_t defaultValue = 0, MMKV_OUT bool *hasValue = nullptr) {
+        return partitionForKey(key)->getUInt32(key, defaultValue, hasValue);
+    }
+
+    int64_t getInt64(MMKVKey_t key, int64_t defaultValue = 0, MMKV_OUT bool *hasValue = nullptr) {
+        return partitionForKey(key)->getInt64(key, defaultValue, hasValue);
+    }
+
+    uint64_t getUInt64(MMKVKey_t key, uint64_t defaultValue = 0, MMKV_OUT bool *hasValue = nullptr) {
+        return partitionForKey(key)->getUInt64(key, defaultValue, hasValue);
+    }
+
+    float getFloat(MMKVKey_t key, float defaultValue = 0, MMKV_OUT bool *hasValue = nullptr) {
+        return partitionForKey(key)->getFloat(key, defaultValue, hasValue);
+    }
+
+    double getDouble(MMKVKey_t key, double defaultValue = 0, MMKV_OUT bool *hasValue = nullptr) {
+        return partitionForKey(key)->getDouble(key, defaultValue, hasValue);
+    }
+
+    size_t getValueSize(MMKVKey_t key, bool actualSize) { return partitionForKey(key)->getValueSize(key, actualSize); }
+
+    int32_t writeValueToBuffer(MMKVKey_t key, void *ptr, int32_t size) {
+        return partitionForKey(key)->writeValueToBuffer(key, ptr, size);
+    }
+
+    bool containsKey(MMKVKey_t key) { return partitionForKey(key)->containsKey(key); }
+
+    bool removeValueForKey(MMKVKey_t key) { return partitionForKey(key)->removeValueForKey(key); }
+
+    // each partition is done separately, it's not atomic across partitions
+    bool removeValuesForKeys(const std::vector<std::string> &arrKeys);
+
+    std::vector<std::string> allKeys(bool filterExpire = false);
+
+    size_t count(bool filterExpire = false);
+
+    size_t totalSize();
+
+    size_t actualSize();
+
+    void clearAll(bool keepSpace = false);
+
+    void trim();
+
+    void sync(SyncFlag flag = MMKV_SYNC);
+
+    void clearMemoryCache(bool keepSpace = false);
+
+    // close all partitions, this object is no longer valid afterward
+    void close();
+};
+#endif // !MMKV_APPLE
+
 MMKV_NAMESPACE_END
 
 namespace mmkv {
@@ -52,6 +52,19 @@ public:
     virtual void onMMKVContentLoadSuccessfully(const std::string &mmapID) {}
 };
 
+// routes heap memory of MMKV, to an arena of the app or for memory accounting,
+// it's called from any thread, so it has to be thread-safe
+class MMKVAllocator {
+public:
+    virtual ~MMKVAllocator() = default;
+
+    // aligned as malloc() does, return nullptr on failure
+    virtual void *allocate(size_t size) = 0;
+
+    // ptr is never nullptr
+    virtual void deallocate(void *ptr) = 0;
+};
+
 } // namespace mmkv
 
 #endif
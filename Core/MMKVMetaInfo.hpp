@@ -23,6 +23,7 @@
 #ifdef __cplusplus
 
 #include "aes/AESCrypt.h"
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 
@@ -71,6 +72,7 @@ struct MMKVMetaInfo {
 
     enum MMKVMetaInfoFlag : uint64_t {
         EnableKeyExipre = 1 << 0,
+        EnableSegmentedLog = 1 << 1,
     };
     bool hasFlag(MMKVMetaInfoFlag flag) { return (m_flags & flag) != 0; }
     void setFlag(MMKVMetaInfoFlag flag) { m_flags |= flag; }
@@ -96,6 +98,50 @@ struct MMKVMetaInfo {
 
 static_assert(sizeof(MMKVMetaInfo) <= (4 * 1024), "MMKVMetaInfo lager than one pagesize");
 
+// written by a full write-back that moves the items together in offset order,
+// so that other processes can move their index along instead of decoding the whole file again
+struct MMKVCompactionInfo {
+    uint32_t fromSequence = 0;
+    uint32_t fromActualSize = 0;
+    uint32_t fromCRCDigest = 0;
+    uint32_t toSequence = 0;
+    uint32_t toActualSize = 0;
+    uint32_t toCRCDigest = 0;
+    uint32_t itemCount = 0;
+    uint32_t _reserved = 0;
+};
+
+constexpr size_t CompactionInfoOffset = 512;
+static_assert(sizeof(MMKVMetaInfo) <= CompactionInfoOffset, "MMKVMetaInfo overlaps the compaction info");
+
+// the shared-memory inter-process lock lives in the meta file after MMKVMetaInfo, leave room for it to grow
+constexpr size_t SharedMemoryLockOffset = 1024;
+static_assert(sizeof(MMKVMetaInfo) <= SharedMemoryLockOffset, "MMKVMetaInfo overlaps the shared-memory lock");
+
+// increased on every change of the meta info, other processes tell a change by one atomic load instead of locking
+constexpr size_t MetaGenerationOffset = SharedMemoryLockOffset - 64;
+static_assert(CompactionInfoOffset + sizeof(MMKVCompactionInfo) <= MetaGenerationOffset, "compaction info overlaps the meta generation");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "meta generation requires lock-free 64-bit atomics");
+
+inline std::atomic<uint64_t> *metaGeneration(void *metaMemory) {
+    MMKV_ASSERT(metaMemory);
+    return reinterpret_cast<std::atomic<uint64_t> *>(static_cast<uint8_t *>(metaMemory) + MetaGenerationOffset);
+}
+
+// lets processes sleep until the meta info changes instead of polling for it
+struct MMKVChangeNotifier {
+    std::atomic<uint32_t> sequence;  // futex word, increased on a change if anyone is waiting
+    std::atomic<int32_t> waiter;     // pid of the only waiting process, -1 for more than one, 0 for none
+};
+
+constexpr size_t ChangeNotifierOffset = MetaGenerationOffset + sizeof(uint64_t);
+static_assert(ChangeNotifierOffset + sizeof(MMKVChangeNotifier) <= SharedMemoryLockOffset, "change notifier overlaps the shared-memory lock");
+
+inline MMKVChangeNotifier *changeNotifier(void *metaMemory) {
+    MMKV_ASSERT(metaMemory);
+    return reinterpret_cast<MMKVChangeNotifier *>(static_cast<uint8_t *>(metaMemory) + ChangeNotifierOffset);
+}
+
 } // namespace mmkv
 
 #endif
@@ -23,6 +23,8 @@
 
 // disable encryption & decryption to reduce some code
 // #define MMKV_DISABLE_CRYPT
+// keep the dictionary on the default heap instead of a per-instance arena
+// #define MMKV_DISABLE_ARENA
 //#define MMKV_DISABLE_FLUTTER
 
 // using POSIX implementation
@@ -33,6 +35,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <set>
 
 constexpr auto MMKV_VERSION = "v2.4.2";
 
@@ -124,6 +127,13 @@ using MMKVPath_t = std::string;
 
 #endif // MMKV_WIN32
 
+#if !defined(MMKV_APPLE) && !defined(MMKV_DISABLE_ARENA) && __has_include(<memory_resource>)
+#    include <memory_resource>
+#    ifdef __cpp_lib_memory_resource
+#        define MMKV_HAS_ARENA
+#    endif
+#endif
+
 #ifdef MMKV_ANDROID
 #define MMKV_EXPORT __attribute__((visibility("default")))
 #else
@@ -178,6 +188,7 @@ extern MMKV_EXPORT size_t DEFAULT_MMAP_SIZE;
 
 class MMBuffer;
 struct KeyValueHolder;
+class MMKVAllocator;
 
 #ifdef MMKV_DISABLE_CRYPT
 using KeyValueHolderCrypt = KeyValueHolder;
@@ -253,8 +264,45 @@ struct KeyEqualer {
     }
 };
 using MMKVVector = std::vector<std::pair<std::string, mmkv::MMBuffer>>;
+#ifdef MMKV_HAS_ARENA
+// hands chunks to an arena, from a MMKVAllocator or the default heap of MMKV
+class AllocatorResource : public std::pmr::memory_resource {
+    MMKVAllocator *m_allocator;
+
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *ptr, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+public:
+    explicit AllocatorResource(MMKVAllocator *allocator) : m_allocator(allocator) {}
+};
+
+struct ArenaUpstream {
+    AllocatorResource m_upstream;
+    explicit ArenaUpstream(MMKVAllocator *allocator) : m_upstream(allocator) {}
+};
+
+// the dictionary of an instance, keys & nodes included, is carved out of its own slab arena,
+// which is released as a whole on reload or clear, instead of freeing entries one by one
+class MMKVArena : private ArenaUpstream, public std::pmr::unsynchronized_pool_resource {
+public:
+    explicit MMKVArena(MMKVAllocator *allocator = nullptr)
+        : ArenaUpstream(allocator), std::pmr::unsynchronized_pool_resource(&m_upstream) {}
+};
+using MMKVMap = std::pmr::unordered_map<std::pmr::string, mmkv::KeyValueHolder, KeyHasher, KeyEqualer>;
+using MMKVMapCrypt = std::pmr::unordered_map<std::pmr::string, mmkv::KeyValueHolderCrypt, KeyHasher, KeyEqualer>;
+
+// the arena of a dictionary, nullptr if it's on the default heap
+template <typename T>
+MMKVArena *arenaOfDictionary(const T &dic) {
+    return dynamic_cast<MMKVArena *>(dic.get_allocator().resource());
+}
+#else
 using MMKVMap = std::unordered_map<std::string, mmkv::KeyValueHolder, KeyHasher, KeyEqualer>;
 using MMKVMapCrypt = std::unordered_map<std::string, mmkv::KeyValueHolderCrypt, KeyHasher, KeyEqualer>;
+#endif
+// keys in byte order, std::less<> enables heterogeneous lookup
+using MMKVOrderedKeys = std::set<std::string, std::less<>>;
 #endif // MMKV_APPLE
 
 template <typename T>
@@ -87,12 +87,12 @@ MMKV::MMKV(const string &mmapID, const MMKVConfig &config)
 #    ifndef MMKV_DISABLE_CRYPT
     auto cryptKey = config.cryptKey;
     if (cryptKey && cryptKey->length() > 0) {
-        m_dicCrypt = new MMKVMapCrypt();
+        m_dicCrypt = newDictionary<MMKVMapCrypt>(m_allocator);
         m_crypter = new AESCrypt(cryptKey->data(), cryptKey->length(), nullptr, 0, config.aes256);
     } else
 #    endif
     {
-        m_dic = new MMKVMap();
+        m_dic = newDictionary<MMKVMap>(m_allocator);
     }
 
     m_needLoadFromFile = true;
@@ -105,6 +105,8 @@ MMKV::MMKV(const string &mmapID, const MMKVConfig &config)
 
     m_recoverStrategic = config.recover;
     m_itemSizeLimit = config.itemSizeLimit;
+    m_blobThreshold = isAshmem() ? 0 : config.blobThreshold;
+    m_expectedSegmentSize = isAshmem() ? 0 : roundUp<size_t>(config.segmentSize, DEFAULT_MMAP_SIZE);
 
     if (config.enableKeyExpire.has_value()) {
         configAutoExipreIfNeeded(config);
@@ -153,12 +155,12 @@ MMKV::MMKV(const string &mmapID, int ashmemFD, int ashmemMetaFD, const MMKVConfi
 #    ifndef MMKV_DISABLE_CRYPT
     auto cryptKey = config.cryptKey;
     if (cryptKey && cryptKey->length() > 0) {
-        m_dicCrypt = new MMKVMapCrypt();
+        m_dicCrypt = newDictionary<MMKVMapCrypt>(m_allocator);
         m_crypter = new AESCrypt(cryptKey->data(), cryptKey->length(), nullptr, 0, config.aes256);
     } else
 #    endif
     {
-        m_dic = new MMKVMap();
+        m_dic = newDictionary<MMKVMap>(m_allocator);
     }
 
     m_needLoadFromFile = true;
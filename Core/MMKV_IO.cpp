@@ -41,6 +41,7 @@
 #include <ctime>
 #include <filesystem>
 #include <limits>
+#include <random>
 
 #ifdef MMKV_IOS
 #    include "MMKV_OSX.h"
@@ -55,6 +56,11 @@
 #ifndef MMKV_WIN32
 #    include <unistd.h>
 #endif
+#ifdef MMKV_LINUX
+#    include <climits>
+#    include <linux/futex.h>
+#    include <sys/syscall.h>
+#endif
 
 using namespace std;
 using namespace mmkv;
@@ -87,6 +93,14 @@ void MMKV::loadFromFile() {
     }
     if (!m_file->isFileValid()) {
         MMKVError("file [%s] not valid", m_path.c_str());
+    } else if (loadFromSegments()) {
+        // loaded from the segmented log
+#ifndef MMKV_APPLE
+    } else if (attachSharedIndex()) {
+        MMKVInfo("loaded [%s] with %zu key-values from shared index, actual size %zu", m_mmapID.c_str(),
+                 sharedIndexCount(), m_actualSize);
+        notifyContentLoaded();
+#endif
     } else {
         // error checking
         bool loadFromFile = false, needFullWriteback = false;
@@ -105,23 +119,29 @@ void MMKV::loadFromFile() {
             } else {
                 clearDictionary(m_dic);
             }
+            invalidateKeyHandles();
             if (needFullWriteback) {
 #ifndef MMKV_DISABLE_CRYPT
                 if (m_crypter) {
-                    MiniPBCoder::greedyDecodeMap(*m_dicCrypt, inputBuffer, m_crypter);
+                    m_cryptMemoryUsage = 0;
+                    MiniPBCoder::greedyDecodeMap(*m_dicCrypt, inputBuffer, m_crypter, 0, keyFilter(),
+                                                 cryptMemoryBudget());
+                    recountCryptMemory();
                 } else
 #endif
                 {
-                    MiniPBCoder::greedyDecodeMap(*m_dic, inputBuffer);
+                    MiniPBCoder::greedyDecodeMap(*m_dic, inputBuffer, 0, keyFilter());
                 }
             } else {
 #ifndef MMKV_DISABLE_CRYPT
                 if (m_crypter) {
-                    MiniPBCoder::decodeMap(*m_dicCrypt, inputBuffer, m_crypter);
+                    m_cryptMemoryUsage = 0;
+                    MiniPBCoder::decodeMap(*m_dicCrypt, inputBuffer, m_crypter, 0, keyFilter(), cryptMemoryBudget());
+                    recountCryptMemory();
                 } else
 #endif
                 {
-                    MiniPBCoder::decodeMap(*m_dic, inputBuffer);
+                    MiniPBCoder::decodeMap(*m_dic, inputBuffer, 0, keyFilter());
                 }
             }
             m_output = new CodedOutputData(ptr + Fixed32Size, m_file->getFileSize() - Fixed32Size);
@@ -149,6 +169,9 @@ void MMKV::loadFromFile() {
         }
         auto count = m_crypter ? m_dicCrypt->size() : m_dic->size();
         MMKVInfo("loaded [%s] with %zu key-values", m_mmapID.c_str(), count);
+#ifndef MMKV_APPLE
+        saveDictionaryToSharedIndex();
+#endif
         notifyContentLoaded();
 //        auto keys = allKeys();
 //        for (size_t index = 0; index < count; index++) {
@@ -157,6 +180,10 @@ void MMKV::loadFromFile() {
     }
 
     m_needLoadFromFile = false;
+#ifndef MMKV_APPLE
+    updateResidentSize(true);
+    enforceMemoryBudget(this);
+#endif
 }
 
 // read from last m_position
@@ -182,13 +209,17 @@ void MMKV::partialLoadFromFile() {
                 m_crcDigest = (uint32_t) CRC32(m_crcDigest, basePtr + position, (z_size_t) addedSize);
                 if (m_crcDigest == m_metaInfo->m_crcDigest) {
                     MMBuffer inputBuffer(basePtr, m_actualSize, MMBufferNoCopy);
+                    // deletions appended by others erase entries
+                    invalidateKeyHandles();
 #ifndef MMKV_DISABLE_CRYPT
                     if (m_crypter) {
-                        MiniPBCoder::greedyDecodeMap(*m_dicCrypt, inputBuffer, m_crypter, position);
+                        MiniPBCoder::greedyDecodeMap(*m_dicCrypt, inputBuffer, m_crypter, position, keyFilter(),
+                                                     cryptMemoryBudget());
+                        recountCryptMemory();
                     } else
 #endif
                     {
-                        MiniPBCoder::greedyDecodeMap(*m_dic, inputBuffer, position);
+                        MiniPBCoder::greedyDecodeMap(*m_dic, inputBuffer, position, keyFilter());
                     }
                     m_output->seek(addedSize);
                     m_hasFullWriteback = false;
@@ -207,6 +238,96 @@ void MMKV::partialLoadFromFile() {
     loadFromFile();
 }
 
+constexpr uint32_t ItemSizeHolderSize = 4;
+
+// a full write-back by another process only moves the items together in offset order,
+// we can do the same to our index as long as we had exactly the same items before it
+bool MMKV::reloadFromCompaction(const MMKVMetaInfo &metaInfo) {
+    // a slice of keys can't tell where the others have gone
+    if (m_crypter || m_enableKeyExpire || m_segmentSize || keyFilter() || !m_file->isFileValid() || !m_metaFile->isFileValid()) {
+        return false;
+    }
+    MMKVCompactionInfo info;
+    memcpy(&info, (uint8_t *) m_metaFile->getMemory() + CompactionInfoOffset, sizeof(info));
+    if (info.toSequence != metaInfo.m_sequence || info.fromSequence != m_metaInfo->m_sequence ||
+        info.fromActualSize != m_actualSize || info.fromCRCDigest != m_crcDigest || info.itemCount != m_dic->size()) {
+        return false;
+    }
+    // sort by offset, keep the offset next to the holder, it's much quicker than chasing every holder
+    vector<pair<uint32_t, KeyValueHolder *>> vec;
+    vec.reserve(m_dic->size());
+    size_t totalSize = ItemSizeHolderSize;
+    for (auto &itr : *m_dic) {
+        vec.emplace_back(itr.second.offset, &itr.second);
+        totalSize += itr.second.computedKVSize + itr.second.valueSize;
+    }
+    if (totalSize != info.toActualSize) {
+        return false;
+    }
+    auto fileSize = m_file->getActualFileSize();
+    if (fileSize != m_file->getFileSize()) {
+        m_file->clearMemoryCache();
+        m_file->reloadFromFile(m_expectedCapacity);
+        if (!m_file->isFileValid()) {
+            return false;
+        }
+    }
+    fileSize = m_file->getFileSize();
+    if (info.toActualSize + Fixed32Size > fileSize) {
+        return false;
+    }
+    // the file might have been replaced by something else in the meantime, e.g. restore from backup
+    auto ptr = (uint8_t *) m_file->getMemory();
+    auto crcDigest = (uint32_t) CRC32(0, ptr + Fixed32Size, (z_size_t) info.toActualSize);
+    if (crcDigest != info.toCRCDigest) {
+        MMKVWarning("[%s] compaction crc %u not match %u", m_mmapID.c_str(), crcDigest, info.toCRCDigest);
+        return false;
+    }
+
+    sort(vec.begin(), vec.end(), [](const auto &left, const auto &right) { return left.first < right.first; });
+    uint32_t offset = ItemSizeHolderSize;
+    for (auto &pair : vec) {
+        auto kvHolder = pair.second;
+        kvHolder->offset = offset;
+        offset += kvHolder->computedKVSize + kvHolder->valueSize;
+    }
+    closeBlobFile();
+
+    m_actualSize = info.toActualSize;
+    m_crcDigest = info.toCRCDigest;
+    m_metaInfo->m_sequence = info.toSequence;
+    m_metaInfo->m_actualSize = info.toActualSize;
+    m_metaInfo->m_crcDigest = info.toCRCDigest;
+    delete m_output;
+    m_output = new CodedOutputData(ptr + Fixed32Size, fileSize - Fixed32Size);
+    m_output->seek(m_actualSize);
+    m_hasFullWriteback = false;
+    MMKVInfo("[%s] moved %zu items along with compaction, actualSize %zu", m_mmapID.c_str(), vec.size(), m_actualSize);
+
+    if (metaInfo.m_actualSize != info.toActualSize || metaInfo.m_crcDigest != info.toCRCDigest) {
+        // more items appended after the compaction
+        partialLoadFromFile();
+    } else {
+        m_metaInfo->read(m_metaFile->getMemory());
+    }
+    return true;
+}
+
+void MMKV::writeCompactionInfo(uint32_t fromSequence, uint32_t fromActualSize, uint32_t fromCRCDigest) {
+    if (!isMultiProcess() || !m_metaFile->isFileValid()) {
+        return;
+    }
+    MMKVCompactionInfo info;
+    info.fromSequence = fromSequence;
+    info.fromActualSize = fromActualSize;
+    info.fromCRCDigest = fromCRCDigest;
+    info.toSequence = m_metaInfo->m_sequence;
+    info.toActualSize = static_cast<uint32_t>(m_actualSize);
+    info.toCRCDigest = m_crcDigest;
+    info.itemCount = static_cast<uint32_t>(m_dic->size());
+    memcpy((uint8_t *) m_metaFile->getMemory() + CompactionInfoOffset, &info, sizeof(info));
+}
+
 static bool deleteOrRenameFile(const MMKVPath_t &src) {
     if (!deleteFile(src)) {
         fs::path path = src;
@@ -231,6 +352,9 @@ bool MMKV::checkFileHasDiskError() {
         m_metaFile->clearMemoryCache();
         deleteOrRenameFile(m_metaFile->getPath());
         m_metaFile->reloadFromFile();
+        if (m_sharedMemoryLock) {
+            attachSharedMemoryLock();
+        }
     }
 
     if (!m_file->isFileValid()) {
@@ -251,6 +375,9 @@ bool MMKV::checkFileHasDiskError() {
 void MMKV::loadMetaInfoAndCheck() {
     if (!m_metaFile->isFileValid()) {
         m_metaFile->reloadFromFile();
+        if (m_sharedMemoryLock) {
+            attachSharedMemoryLock();
+        }
     }
     if (!m_metaFile->isFileValid()) {
         MMKVError("file [%s] not valid", m_metaFile->getPath().c_str());
@@ -267,6 +394,7 @@ void MMKV::loadMetaInfoAndCheck() {
         return;
     }
 
+    m_metaGeneration = metaGeneration(m_metaFile->getMemory())->load(std::memory_order_acquire);
     m_metaInfo->read(m_metaFile->getMemory());
 
     if (isReadOnly()) {
@@ -282,6 +410,7 @@ void MMKV::loadMetaInfoAndCheck() {
         m_metaInfo->m_version = MMKVVersionActualSize;
         m_metaInfo->m_flags = 0;
         m_metaInfo->write(m_metaFile->getMemory());
+        increaseMetaGeneration();
     }
 
     if (m_metaInfo->m_version >= MMKVVersionFlag) {
@@ -295,6 +424,7 @@ void MMKV::loadMetaInfoAndCheck() {
         if (m_metaInfo->m_flags != 0) {
             m_metaInfo->m_flags = 0;
             m_metaInfo->write(m_metaFile->getMemory());
+            increaseMetaGeneration();
         }
     }
 }
@@ -377,6 +507,9 @@ void MMKV::checkDataValid(bool &loadFromFile, bool &needFullWriteback) {
 }
 
 void MMKV::checkLoadData() {
+#ifndef MMKV_APPLE
+    touchResidency();
+#endif
     if (m_needLoadFromFile) {
         SCOPED_LOCK(m_sharedProcessLock);
 
@@ -391,6 +524,12 @@ void MMKV::checkLoadData() {
     if (!m_metaFile->isFileValid()) {
         return;
     }
+    // every change of the meta info comes with a new generation, nothing to check if it stays the same
+    // only trusted when asked to, a process of an older version changes the file without moving it on
+    auto generation = metaGeneration(m_metaFile->getMemory());
+    if (m_optimisticRead && generation->load(std::memory_order_acquire) == m_metaGeneration) {
+        return;
+    }
     SCOPED_LOCK(m_sharedProcessLock);
 
     MMKVMetaInfo metaInfo;
@@ -399,14 +538,26 @@ void MMKV::checkLoadData() {
         MMKVInfo("[%s] oldSeq %u, newSeq %u", m_mmapID.c_str(), m_metaInfo->m_sequence, metaInfo.m_sequence);
         SCOPED_LOCK(m_sharedProcessLock);
 
-        clearMemoryCache();
-        loadFromFile();
+#ifndef MMKV_APPLE
+        if (m_sharedIndex) {
+            syncSharedIndex();
+        } else
+#endif
+        if (!reloadFromCompaction(metaInfo)) {
+            clearMemoryCache();
+            loadFromFile();
+        }
         notifyContentChanged();
     } else if ((m_metaInfo->m_crcDigest != metaInfo.m_crcDigest) || (m_metaInfo->m_actualSize != metaInfo.m_actualSize)) {
         MMKVDebug("[%s] crcDigest %u -> %u, actualSize %u -> %u", m_mmapID.c_str(), m_metaInfo->m_crcDigest,
                   metaInfo.m_crcDigest, m_metaInfo->m_actualSize, metaInfo.m_actualSize);
         SCOPED_LOCK(m_sharedProcessLock);
 
+#ifndef MMKV_APPLE
+        if (m_sharedIndex) {
+            syncSharedIndex();
+        } else
+#endif
         // looks like this is no longer needed
         // for we inc sequence on truncate()/trim()/expandAndWriteBack()/fullWriteBack() etc
         /*size_t fileSize = m_file->getActualFileSize();
@@ -419,10 +570,10 @@ void MMKV::checkLoadData() {
         }
         notifyContentChanged();
     }
+    // writers hold the exclusive lock, no one but us could have changed it since
+    m_metaGeneration = generation->load(std::memory_order_acquire);
 }
 
-constexpr uint32_t ItemSizeHolderSize = 4;
-
 static bool encodedValueLength(size_t dataLength, bool isDataHolder, uint32_t &result) {
     constexpr auto MaxEncodedLength = numeric_limits<uint32_t>::max();
     if (dataLength > MaxEncodedLength) {
@@ -483,6 +634,47 @@ static pair<MMBuffer, size_t> prepareEncode(const MMKVMap &dic) {
 }
 
 #ifndef MMKV_DISABLE_CRYPT
+#    ifndef MMKV_APPLE
+// values held in memory are streamed into one exact-size buffer, without copying keys & values into a MMKVVector
+static pair<MMBuffer, size_t> prepareEncode(const MMKVMapCrypt &dic) {
+    size_t totalSize = 0;
+    uint64_t memoryValueSize = 0;
+    // make some room for placeholder
+    uint32_t smallestOffet = 5 + 1; // 5 is the largest size needed to encode varint32
+    for (auto &itr : dic) {
+        auto &kvHolder = itr.second;
+        if (kvHolder.type == KeyValueHolderType_Offset) {
+            totalSize += kvHolder.pbKeyValueSize + kvHolder.keySize + kvHolder.valueSize;
+            smallestOffet = min(smallestOffet, kvHolder.offset);
+        } else {
+            auto keySize = static_cast<uint32_t>(itr.first.size());
+            auto valueSize = static_cast<uint32_t>(kvHolder.toMMBuffer(nullptr, nullptr).length());
+            memoryValueSize += pbRawVarint32Size(keySize) + keySize + pbRawVarint32Size(valueSize) + valueSize;
+        }
+    }
+    if (smallestOffet > 5) {
+        smallestOffet = ItemSizeHolderSize;
+    }
+    totalSize += smallestOffet;
+    if (memoryValueSize == 0) {
+        return make_pair(MMBuffer(), totalSize);
+    }
+    auto sizeOfMap = static_cast<uint32_t>(memoryValueSize);
+    MMBuffer buffer(pbRawVarint32Size(sizeOfMap) + memoryValueSize);
+    CodedOutputData output(buffer.getPtr(), buffer.length());
+    output.writeUInt32(sizeOfMap);
+    for (auto &itr : dic) {
+        auto &kvHolder = itr.second;
+        if (kvHolder.type != KeyValueHolderType_Offset) {
+            // a key is encoded the same as bytes, without copying it to a std::string
+            output.writeData(MMBuffer((void *) itr.first.data(), itr.first.size(), MMBufferNoCopy));
+            output.writeData(kvHolder.toMMBuffer(nullptr, nullptr));
+        }
+    }
+    totalSize += sizeOfMap;
+    return make_pair(std::move(buffer), totalSize);
+}
+#    else
 static pair<MMBuffer, size_t> prepareEncode(const MMKVMapCrypt &dic) {
     MMKVVector vec;
     size_t totalSize = 0;
@@ -510,7 +702,8 @@ static pair<MMBuffer, size_t> prepareEncode(const MMKVMapCrypt &dic) {
     totalSize += sizeOfMap;
     return make_pair(std::move(buffer), totalSize);
 }
-#endif
+#    endif // MMKV_APPLE
+#endif // MMKV_DISABLE_CRYPT
 
 static pair<MMBuffer, size_t> prepareEncode(MMKVVector &&vec) {
     // make some room for placeholder
@@ -533,12 +726,30 @@ bool MMKV::ensureMemorySize(size_t newSize) {
         MMKVWarning("[%s] file readonly", m_mmapID.c_str());
         return false;
     }
+    if (mmkv_unlikely(m_segmentSize)) {
+        return ensureSegmentSpace(newSize);
+    }
 
-    if (newSize >= m_output->spaceLeft() || (m_crypter ? m_dicCrypt->empty() : m_dic->empty())) {
+#ifndef MMKV_APPLE
+    bool isEmpty = m_crypter ? m_dicCrypt->empty() : (m_sharedIndex ? sharedIndexCount() == 0 : m_dic->empty());
+#else
+    bool isEmpty = m_crypter ? m_dicCrypt->empty() : m_dic->empty();
+#endif
+    // an empty one is written back from scratch, unless a view is still pointing into it
+    if (newSize >= m_output->spaceLeft() || (isEmpty && m_pinnedViews.load() == 0)) {
         // remove expired keys
         if (m_enableKeyExpire) {
             filterExpiredKeys();
         }
+#ifndef MMKV_APPLE
+        if (mmkv_unlikely(m_sharedIndex)) {
+            // the write-back works on m_dic, the keys go back to the index with their new offsets
+            loadDictionaryFromSharedIndex();
+            auto ret = expandAndWriteBack(newSize, prepareEncode(*m_dic), !m_dic->empty());
+            saveDictionaryToSharedIndex();
+            return ret;
+        }
+#endif
         // try a full rewrite to make space
         auto preparedData = m_crypter ? prepareEncode(*m_dicCrypt) : prepareEncode(*m_dic);
         // dic.empty() means inserting key-value for the first time, no need to call msync()
@@ -566,6 +777,9 @@ bool MMKV::checkSizeLimit(size_t size, const MMBuffer &keyData, uint32_t originK
 
 // try a full rewrite to make space
 bool MMKV::expandAndWriteBack(size_t newSize, std::pair<mmkv::MMBuffer, size_t> preparedData, bool needSync) {
+    if (refuseForPinnedViews("expanding")) {
+        return false;
+    }
     auto fileSize = m_file->getFileSize();
     auto sizeOfDic = preparedData.second;
     size_t lenNeeded = sizeOfDic + Fixed32Size + newSize;
@@ -663,222 +877,2027 @@ bool MMKV::writeActualSize(size_t size, uint32_t crcDigest, const void *iv, bool
         MMKVInfo("[%s] increase sequence to %u, crc %u, actualSize %u", m_mmapID.c_str(), m_metaInfo->m_sequence,
                  m_metaInfo->m_crcDigest, m_metaInfo->m_actualSize);
     }
-    if (m_metaInfo->m_version < MMKVVersionFlag) {
-        m_metaInfo->m_flags = 0;
-        m_metaInfo->m_version = MMKVVersionFlag;
-        needsFullWrite = true;
+    if (m_metaInfo->m_version < MMKVVersionFlag) {
+        m_metaInfo->m_flags = 0;
+        m_metaInfo->m_version = MMKVVersionFlag;
+        needsFullWrite = true;
+    }
+    if (mmkv_unlikely(needsFullWrite)) {
+        m_metaInfo->write(m_metaFile->getMemory());
+    } else {
+        m_metaInfo->writeCRCAndActualSizeOnly(m_metaFile->getMemory());
+    }
+    increaseMetaGeneration();
+    return true;
+}
+
+void MMKV::willRewriteInPlace() {
+    // a getter reading without the lock tells the rewrite by the generation changed underneath it
+    if (m_optimisticRead && m_metaFile->isFileValid()) {
+        increaseMetaGeneration();
+    }
+}
+
+bool MMKV::refuseForPinnedViews(const char *operation) {
+    auto count = m_pinnedViews.load();
+    if (count > 0) {
+        MMKVWarning("[%s] %s refused, %u zero-copy views are pointing into the file", m_mmapID.c_str(), operation, count);
+        return true;
+    }
+    return false;
+}
+
+bool MMKV::isPinnable(const void *ptr, size_t size) const {
+    // other processes rewrite the file behind our back, so does a segmented log on switching segments
+    if (isMultiProcess() || m_segmentSize || !m_file->isFileValid()) {
+        return false;
+    }
+    auto begin = (const uint8_t *) m_file->getMemory();
+    auto bytes = (const uint8_t *) ptr;
+    return bytes >= begin && bytes + size <= begin + m_file->getFileSize();
+}
+
+void MMKV::increaseMetaGeneration() {
+    // sequentially consistent against the waiter, see enableChangeNotification()
+    auto generation = metaGeneration(m_metaFile->getMemory())->fetch_add(1);
+    // we are still in sync if nobody else has changed it
+    if (generation == m_metaGeneration) {
+        m_metaGeneration = generation + 1;
+    }
+#ifdef MMKV_LINUX
+    // no need to wake up ourselves for our own change
+    auto notifier = changeNotifier(m_metaFile->getMemory());
+    auto waiter = notifier->waiter.load();
+    if (mmkv_unlikely(waiter != 0) && waiter != currentPid() && notifier->waiter.exchange(0) != 0) {
+        wakeChangeListeners(m_metaFile->getMemory());
+    }
+#endif
+}
+
+#ifdef MMKV_LINUX
+void wakeChangeListeners(void *metaMemory) {
+    auto notifier = changeNotifier(metaMemory);
+    notifier->sequence.fetch_add(1);
+    syscall(SYS_futex, &notifier->sequence, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+#endif
+
+MMBuffer MMKV::getRawDataForKey(MMKVKey_t key) {
+    checkLoadData();
+#ifndef MMKV_APPLE
+    if (mmkv_unlikely(m_sharedIndex)) {
+        KeyValueHolder kvHolder;
+        if (findInSharedIndex(key, kvHolder)) {
+            auto basePtr = (uint8_t *) (m_file->getMemory()) + Fixed32Size;
+            return kvHolder.toMMBuffer(basePtr);
+        }
+        return MMBuffer();
+    }
+#endif
+#ifndef MMKV_DISABLE_CRYPT
+    if (m_crypter) {
+        auto itr = m_dicCrypt->find(key);
+        if (itr != m_dicCrypt->end()) {
+            auto basePtr = (uint8_t *) (m_file->getMemory()) + Fixed32Size;
+            return itr->second.toMMBuffer(basePtr, m_crypter);
+        }
+    } else
+#endif
+    {
+        auto itr = m_dic->find(key);
+        if (itr != m_dic->end()) {
+            auto basePtr = (uint8_t *) (m_file->getMemory()) + Fixed32Size;
+            return itr->second.toMMBuffer(basePtr);
+        }
+    }
+    MMBuffer nan;
+    return nan;
+}
+
+mmkv::MMBuffer MMKV::getDataForKey(MMKVKey_t key) {
+    auto data = mmkv_unlikely(m_enableKeyExpire) ? getDataWithoutMTimeForKey(key) : getRawDataForKey(key);
+    if (mmkv_unlikely(data.length() == BlobPointerSize) && !m_crypter) {
+        return resolveBlobValue(std::move(data));
+    }
+    return data;
+}
+
+mmkv::MMBuffer MMKV::readDataForKey(MMKVKey_t key, std::unique_lock<InterProcessLock> &processLock) {
+    MMBuffer data;
+    if (mmkv_unlikely(m_optimisticRead) && tryOptimisticRead(key, data)) {
+        return data;
+    }
+    processLock.lock();
+    return getDataForKey(key);
+}
+
+// the way of a seqlock: writers move the generation on before rewriting anything in place & after changing the meta info,
+// a copy taken while it stays the one our memory state is in sync with can't be torn, nor point to a stale offset
+bool MMKV::tryOptimisticRead(MMKVKey_t key, MMBuffer &data) {
+    if (m_needLoadFromFile || m_enableKeyExpire || m_sharedIndex || !m_metaFile->isFileValid()) {
+        return false;
+    }
+    auto generation = metaGeneration(m_metaFile->getMemory());
+    auto seen = generation->load(std::memory_order_acquire);
+    if (seen != m_metaGeneration) {
+        return false;
+    }
+    auto raw = getRawDataForKey(key);
+    if (m_crypter) {
+        // decrypted onto the heap, or kept in memory of the dictionary
+        data = std::move(raw);
+    } else if (raw.length() == BlobPointerSize) {
+        // resolving it reads the blob file, which the generation doesn't cover
+        return false;
+    } else if (raw.length() > 0) {
+        data = MMBuffer(raw.getPtr(), raw.length());
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (generation->load(std::memory_order_relaxed) != seen) {
+        data = MMBuffer();
+        return false;
+    }
+    return true;
+}
+
+#ifndef MMKV_DISABLE_CRYPT
+// for Apple watch simulator
+#    if defined(TARGET_OS_SIMULATOR) && defined(TARGET_CPU_X86)
+static AESCryptStatus t_status;
+#    else
+thread_local AESCryptStatus t_status;
+#    endif
+
+// a medium value that doesn't fit in what's left of the memory limit is kept by offset, just like a large one
+bool MMKV::isCryptValueStoredAsOffset(size_t valueSize) const {
+    if (KeyValueHolderCrypt::isValueStoredAsOffset(valueSize)) {
+        return true;
+    }
+    return valueSize > KeyValueHolderCrypt::SmallBufferSize() && valueSize > cryptMemoryBudget();
+}
+
+size_t MMKV::cryptMemoryBudget() const {
+    if (m_cryptMemoryLimit == 0) {
+        return SIZE_MAX;
+    }
+    return (m_cryptMemoryLimit > m_cryptMemoryUsage) ? m_cryptMemoryLimit - m_cryptMemoryUsage : 0;
+}
+
+// values overridden while decoding are counted by the decoder, the dictionary tells the truth
+void MMKV::recountCryptMemory() {
+    m_cryptMemoryUsage = 0;
+    if (m_crypter) {
+        for (auto &itr : *m_dicCrypt) {
+            m_cryptMemoryUsage += itr.second.memoryUsage();
+        }
+    }
+}
+#endif // MMKV_DISABLE_CRYPT
+
+bool MMKV::setDataForKey(MMBuffer &&data, MMKVKey_t key, bool isDataHolder) {
+    if ((!isDataHolder && data.length() == 0) || isKeyEmpty(key)) {
+        return false;
+    }
+    uint32_t valueLength = 0;
+    if (!encodedValueLength(data.length(), isDataHolder, valueLength)) {
+        MMKVError("[%s] reject value too large to encode: %zu", m_mmapID.c_str(), data.length());
+        return false;
+    }
+    if (shouldSeparateValue(valueLength)) {
+        return setBlobForKey(&data, valueLength, isDataHolder ? writeDataHolderValue : writeRawValue, key);
+    }
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_exclusiveProcessLock);
+    checkLoadData();
+#ifndef MMKV_APPLE
+    OrderedKeysUpdate orderedKeysUpdate(this, key);
+#endif
+
+#ifndef MMKV_DISABLE_CRYPT
+    if (m_crypter) {
+        if (isDataHolder) {
+            auto sizeNeededForData = pbRawVarint32Size((uint32_t) data.length()) + data.length();
+            if (!isCryptValueStoredAsOffset(sizeNeededForData)) {
+                data = MiniPBCoder::encodeDataWithObject(data);
+                isDataHolder = false;
+            }
+        }
+        auto itr = m_dicCrypt->find(key);
+        if (itr != m_dicCrypt->end()) {
+            bool onlyOneKey = !isMultiProcess() && m_dicCrypt->size() == 1 && m_pinnedViews.load() == 0;
+#    ifdef MMKV_APPLE
+            KVHolderRet_t ret;
+            if (onlyOneKey) {
+                ret = overrideDataWithKey(data, key, itr->second, isDataHolder);
+            } else {
+                ret = appendDataWithKey(data, key, itr->second, isDataHolder);
+            }
+#    else
+            KVHolderRet_t ret;
+            if (onlyOneKey) {
+                ret = overrideDataWithKey(data, key, isDataHolder);
+            } else {
+                ret = appendDataWithKey(data, key, isDataHolder);
+            }
+#    endif
+            if (!ret.first) {
+                return false;
+            }
+            KeyValueHolderCrypt kvHolder;
+            if (isCryptValueStoredAsOffset(ret.second.valueSize)) {
+                kvHolder = KeyValueHolderCrypt(ret.second.keySize, ret.second.valueSize, ret.second.offset);
+                memcpy(&kvHolder.cryptStatus, &t_status, sizeof(t_status));
+            } else {
+                kvHolder = KeyValueHolderCrypt(std::move(data));
+            }
+            m_cryptMemoryUsage += kvHolder.memoryUsage();
+            if (mmkv_likely(!m_enableKeyExpire)) {
+                m_cryptMemoryUsage -= itr->second.memoryUsage();
+                itr->second = std::move(kvHolder);
+            } else {
+                itr = m_dicCrypt->find(key);
+                if (itr != m_dicCrypt->end()) {
+                    m_cryptMemoryUsage -= itr->second.memoryUsage();
+                    itr->second = std::move(kvHolder);
+                } else {
+                    // in case filterExpiredKeys() is triggered
+                    m_dicCrypt->emplace(key, std::move(kvHolder));
+                    mmkv_retain_key(key);
+                }
+            }
+        } else {
+            bool needOverride = !isMultiProcess() && m_dicCrypt->empty() && m_actualSize > 0 && m_pinnedViews.load() == 0;
+            KVHolderRet_t ret;
+            if (needOverride) {
+                ret = overrideDataWithKey(data, key, isDataHolder);
+            } else {
+                ret = appendDataWithKey(data, key, isDataHolder);
+            }
+            if (!ret.first) {
+                return false;
+            }
+            if (isCryptValueStoredAsOffset(ret.second.valueSize)) {
+                auto r = m_dicCrypt->emplace(
+                    key, KeyValueHolderCrypt(ret.second.keySize, ret.second.valueSize, ret.second.offset));
+                if (r.second) {
+                    memcpy(&(r.first->second.cryptStatus), &t_status, sizeof(t_status));
+                }
+            } else {
+                auto r = m_dicCrypt->emplace(key, KeyValueHolderCrypt(std::move(data)));
+                if (r.second) {
+                    m_cryptMemoryUsage += r.first->second.memoryUsage();
+                }
+            }
+            mmkv_retain_key(key);
+        }
+    } else
+#endif // MMKV_DISABLE_CRYPT
+    {
+        // compare data before appending to file
+        auto isSameData = [&](const KeyValueHolder &kvHolder) {
+            auto basePtr = (uint8_t *) (m_file->getMemory()) + Fixed32Size;
+            MMBuffer oldValueData = kvHolder.toMMBuffer(basePtr);
+            if (isDataHolder) {
+                try {
+                    // read extra holder header bytes and to real MMBuffer
+                    oldValueData = CodedInputData::readRealData(oldValueData);
+                    return oldValueData == data;
+                } catch (std::exception &exception) {
+                    MMKVWarning("compareBeforeSet exception: %s", exception.what());
+                } catch (...) {
+                    MMKVWarning("compareBeforeSet fail");
+                }
+                return false;
+            }
+            return oldValueData == data;
+        };
+#ifndef MMKV_APPLE
+        if (mmkv_unlikely(m_sharedIndex)) {
+            KeyValueHolder kvHolder;
+            if (isCompareBeforeSetEnabled() && findInSharedIndex(key, kvHolder) && isSameData(kvHolder)) {
+                return true;
+            }
+            auto ret = appendDataWithKey(data, key, isDataHolder);
+            if (!ret.first) {
+                return false;
+            }
+            putSharedIndex(key, ret.second);
+            m_hasFullWriteback = false;
+            return true;
+        }
+#endif
+        auto itr = m_dic->find(key);
+        if (itr != m_dic->end()) {
+            if (isCompareBeforeSetEnabled() && isSameData(itr->second)) {
+                // MMKVInfo("[key] %s, set the same data", key.c_str());
+                return true;
+            }
+
+            bool onlyOneKey = !isMultiProcess() && m_dic->size() == 1 && m_pinnedViews.load() == 0;
+            if (mmkv_likely(!m_enableKeyExpire)) {
+                KVHolderRet_t ret;
+                if (onlyOneKey) {
+                    ret = overrideDataWithKey(data, itr->second, isDataHolder);
+                } else {
+                    ret = appendDataWithKey(data, itr->second, isDataHolder);
+                }
+                if (!ret.first) {
+                    return false;
+                }
+                itr->second = std::move(ret.second);
+            } else {
+                KVHolderRet_t ret;
+                if (onlyOneKey) {
+                    ret = overrideDataWithKey(data, key, isDataHolder);
+                } else {
+                    ret = appendDataWithKey(data, key, isDataHolder);
+                }
+                if (!ret.first) {
+                    return false;
+                }
+                itr = m_dic->find(key);
+                if (itr != m_dic->end()) {
+                    itr->second = std::move(ret.second);
+                } else {
+                    // in case filterExpiredKeys() is triggered
+                    m_dic->emplace(key, std::move(ret.second));
+                    mmkv_retain_key(key);
+                }
+            }
+        } else {
+            bool needOverride = !isMultiProcess() && m_dic->empty() && m_actualSize > 0 && m_pinnedViews.load() == 0;
+            KVHolderRet_t ret;
+            if (needOverride) {
+                ret = overrideDataWithKey(data, key, isDataHolder);
+            } else {
+                ret = appendDataWithKey(data, key, isDataHolder);
+            }
+            if (!ret.first) {
+                return false;
+            }
+            m_dic->emplace(key, std::move(ret.second));
+            mmkv_retain_key(key);
+        }
+    }
+    m_hasFullWriteback = false;
+    return true;
+}
+
+bool MMKV::appendDirectlyForHolder(const void *value, size_t valueSize, ValueWriter_t writer, KeyValueHolder &kvHolder) {
+    uint32_t keyLength = kvHolder.keySize;
+    size_t rawKeySize = keyLength + pbRawVarint32Size(keyLength);
+    // ensureMemorySize() might change kvHolder.offset, so have to do it early
+    {
+        EncodedEntrySize entry;
+        if (!encodedEntrySize(rawKeySize, keyLength, valueSize, false, entry) || !ensureMemorySize(entry.totalSize)) {
+            return false;
+        }
+    }
+    auto basePtr = (uint8_t *) m_file->getMemory() + Fixed32Size;
+    MMBuffer keyData(basePtr + kvHolder.offset, rawKeySize, MMBufferNoCopy);
+    auto ret = doAppendValueWithKey(value, valueSize, writer, keyData, keyLength);
+    if (!ret.first) {
+        return false;
+    }
+    kvHolder = std::move(ret.second);
+    return true;
+}
+
+bool MMKV::setDirectlyForKey(const void *value, size_t valueSize, ValueWriter_t writer, MMKVKey_t key) {
+    if (isKeyEmpty(key)) {
+        return false;
+    }
+#ifdef MMKV_APPLE
+    auto keyLength = [key lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+#else
+    auto keyLength = key.size();
+#endif
+    // reject before the fallback path might allocate a temporary buffer
+    EncodedEntrySize entry;
+    if (keyLength > KeySizeLimit || !encodedEntrySize(keyLength, static_cast<uint32_t>(keyLength), valueSize, false, entry)) {
+        MMKVError("[%s] reject unrepresentable key/value lengths, key=%zu, value=%zu", m_mmapID.c_str(), keyLength, valueSize);
+        return false;
+    }
+    if (shouldSeparateValue(valueSize)) {
+        return setBlobForKey(value, valueSize, writer, key);
+    }
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_exclusiveProcessLock);
+    checkLoadData();
+#ifndef MMKV_APPLE
+    OrderedKeysUpdate orderedKeysUpdate(this, key);
+#endif
+
+    auto itr = m_dic->find(key);
+    bool needOverride = !isMultiProcess() && m_pinnedViews.load() == 0 &&
+                        ((itr != m_dic->end()) ? (m_dic->size() == 1) : (m_dic->empty() && m_actualSize > 0));
+    if (mmkv_unlikely(needOverride || !canSetDirectly())) {
+        // rare path, encode into a temporary buffer and let setDataForKey() handle it
+        MMBuffer data(valueSize);
+        CodedOutputData output(data.getPtr(), data.length());
+        writer(output, value);
+        return setDataForKey(std::move(data), key);
+    }
+
+    if (itr != m_dic->end()) {
+        if (!appendDirectlyForHolder(value, valueSize, writer, itr->second)) {
+            return false;
+        }
+    } else {
+#ifdef MMKV_APPLE
+        auto oData = [key dataUsingEncoding:NSUTF8StringEncoding];
+        auto keyData = MMBuffer(oData, MMBufferNoCopy);
+#else
+        auto keyData = MMBuffer((void *) key.data(), key.size(), MMBufferNoCopy);
+#endif
+        auto ret = doAppendValueWithKey(value, valueSize, writer, keyData, static_cast<uint32_t>(keyData.length()));
+        if (!ret.first) {
+            return false;
+        }
+        m_dic->emplace(key, std::move(ret.second));
+        mmkv_retain_key(key);
+    }
+    m_hasFullWriteback = false;
+    return true;
+}
+
+#ifndef MMKV_APPLE
+void *MMKV::resolveHandle(KeyHandle &handle) {
+    if (mmkv_likely(handle.m_holder && handle.m_epoch == m_dicEpoch)) {
+        return handle.m_holder;
+    }
+    void *holder = nullptr;
+#    ifndef MMKV_DISABLE_CRYPT
+    if (m_crypter) {
+        auto itr = m_dicCrypt->find(handle.m_key);
+        if (itr != m_dicCrypt->end()) {
+            holder = &itr->second;
+        }
+    } else
+#    endif
+    {
+        auto itr = m_dic->find(handle.m_key);
+        if (itr != m_dic->end()) {
+            holder = &itr->second;
+        }
+    }
+    // a missing key isn't cached, it might be inserted without a new epoch
+    handle.m_holder = holder;
+    handle.m_epoch = m_dicEpoch;
+    return holder;
+}
+
+MMBuffer MMKV::getDataForHandle(KeyHandle &handle) {
+    checkLoadData();
+    if (mmkv_unlikely(m_sharedIndex || m_enableKeyExpire)) {
+        // no holder in the dictionary to cache, or the expire time has to be checked on every read
+        return getDataForKey(handle.m_key);
+    }
+    auto holder = resolveHandle(handle);
+    if (!holder) {
+        return MMBuffer();
+    }
+    auto basePtr = (uint8_t *) (m_file->getMemory()) + Fixed32Size;
+#    ifndef MMKV_DISABLE_CRYPT
+    if (m_crypter) {
+        return static_cast<KeyValueHolderCrypt *>(holder)->toMMBuffer(basePtr, m_crypter);
+    }
+#    endif
+    auto data = static_cast<KeyValueHolder *>(holder)->toMMBuffer(basePtr);
+    if (mmkv_unlikely(data.length() == BlobPointerSize)) {
+        return resolveBlobValue(std::move(data));
+    }
+    return data;
+}
+
+bool MMKV::setDirectlyForHandle(const void *value, size_t valueSize, ValueWriter_t writer, KeyHandle &handle) {
+    if (shouldSeparateValue(valueSize)) {
+        return setDirectlyForKey(value, valueSize, writer, handle.m_key);
+    }
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_exclusiveProcessLock);
+    checkLoadData();
+
+    auto kvHolder = static_cast<KeyValueHolder *>(resolveHandle(handle));
+    // a new key, or the only key of the file that setDirectlyForKey() overrides instead of appending
+    if (!kvHolder || (!isMultiProcess() && m_dic->size() == 1)) {
+        return setDirectlyForKey(value, valueSize, writer, handle.m_key);
+    }
+    OrderedKeysUpdate orderedKeysUpdate(this, handle.m_key);
+    if (!appendDirectlyForHolder(value, valueSize, writer, *kvHolder)) {
+        return false;
+    }
+    m_hasFullWriteback = false;
+    return true;
+}
+
+bool MMKV::setBytesForKeys(const vector<string_view> &keys, const vector<MMBuffer> &values) {
+    if (keys.size() != values.size()) {
+        MMKVError("[%s] %zu keys for %zu values", m_mmapID.c_str(), keys.size(), values.size());
+        return false;
+    }
+    if (isReadOnly()) {
+        MMKVWarning("[%s] file readonly", m_mmapID.c_str());
+        return false;
+    }
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_exclusiveProcessLock);
+    checkLoadData();
+
+    // the items are encoded as set(MMBuffer) does: [key length][key][value length][data length][data]
+    vector<EncodedEntrySize> entries(keys.size());
+    size_t totalSize = 0;
+    bool appendAtOnce = canSetDirectly() && !m_segmentSize;
+    for (size_t index = 0; index < keys.size(); index++) {
+        auto &key = keys[index];
+        if (isKeyEmpty(key) ||
+            !encodedEntrySize(key.size(), static_cast<uint32_t>(key.size()), values[index].length(), true, entries[index])) {
+            MMKVError("[%s] reject unrepresentable key/value lengths, key=%zu, value=%zu", m_mmapID.c_str(), key.size(),
+                      values[index].length());
+            return false;
+        }
+        MMBuffer keyData((void *) key.data(), key.size(), MMBufferNoCopy);
+        if (!checkSizeLimit(entries[index].totalSize, keyData, static_cast<uint32_t>(key.size()))) {
+            return false;
+        }
+        appendAtOnce = appendAtOnce && !shouldSeparateValue(entries[index].valueLength);
+        totalSize += entries[index].totalSize;
+    }
+    if (!appendAtOnce || totalSize > numeric_limits<uint32_t>::max()) {
+        // encryption, expiration and the like go one by one, still without letting anyone in between
+        bool ret = true;
+        for (size_t index = 0; index < keys.size(); index++) {
+            ret = set(values[index], keys[index]) && ret;
+        }
+        return ret;
+    }
+    if (totalSize == 0) {
+        return true;
+    }
+    if (!ensureMemorySize(totalSize) || !isFileValid()) {
+        return false;
+    }
+
+    auto startOffset = m_actualSize;
+    try {
+        for (size_t index = 0; index < keys.size(); index++) {
+            m_output->writeData(MMBuffer((void *) keys[index].data(), keys[index].size(), MMBufferNoCopy));
+            m_output->writeRawVarint32((int32_t) entries[index].valueLength);
+            m_output->writeData(values[index]);
+        }
+    } catch (std::exception &e) {
+        MMKVError("%s", e.what());
+        m_output->setPosition(startOffset);
+        return false;
+    }
+    // one checksum update and one meta write for the whole batch
+    m_actualSize += totalSize;
+    updateCRCDigest((uint8_t *) m_file->getMemory() + Fixed32Size + startOffset, totalSize);
+
+    auto offset = static_cast<uint32_t>(startOffset);
+    for (size_t index = 0; index < keys.size(); index++) {
+        auto &key = keys[index];
+        KeyValueHolder kvHolder(static_cast<uint32_t>(key.size()), entries[index].valueLength, offset);
+        offset += static_cast<uint32_t>(entries[index].totalSize);
+        auto itr = m_dic->find(key);
+        if (itr != m_dic->end()) {
+            itr->second = kvHolder;
+        } else {
+            m_dic->emplace(key, kvHolder);
+        }
+    }
+    m_hasFullWriteback = false;
+    return true;
+}
+#endif // !MMKV_APPLE
+
+// ---- value separation ----
+
+#pragma pack(push, 1)
+
+struct BlobFileHeader {
+    uint64_t magic;
+    uint64_t fileID;
+    uint64_t usedSize;
+    uint64_t reserved;
+};
+
+// the value stored in the log in place of a separated value
+struct BlobPointer {
+    uint64_t magic;
+    uint64_t fileID;
+    uint64_t offset;
+    uint32_t length;
+};
+
+#pragma pack(pop)
+
+constexpr uint64_t BlobFileMagic = 0x424F4C42564B4D4DULL;    // "MMKVBLOB"
+constexpr uint64_t BlobPointerMagic = 0x5254504F564B4D4DULL; // "MMKVOPTR"
+
+static void initBlobFileHeader(BlobFileHeader *header, uint64_t oldFileID) {
+    random_device device;
+    do {
+        header->fileID = (static_cast<uint64_t>(device()) << 32) | device();
+    } while (header->fileID == oldFileID);
+    header->usedSize = sizeof(BlobFileHeader);
+    header->reserved = 0;
+    header->magic = BlobFileMagic;
+}
+
+// the pointer sits at the beginning of the value, followed by the expire time if it's turned on afterwards
+template <typename F>
+static void forEachBlobPointer(MMKVMap &dic, uint8_t *basePtr, F &&callback) {
+    for (auto &pair : dic) {
+        auto &kvHolder = pair.second;
+        if (kvHolder.valueSize != sizeof(BlobPointer) && kvHolder.valueSize != sizeof(BlobPointer) + Fixed32Size) {
+            continue;
+        }
+        auto ptr = basePtr + kvHolder.offset + kvHolder.computedKVSize;
+        BlobPointer pointer;
+        memcpy(&pointer, ptr, sizeof(pointer));
+        if (pointer.magic == BlobPointerMagic) {
+            callback(ptr, pointer);
+        }
+    }
+}
+
+static size_t liveBlobSize(MMKVMap &dic, uint8_t *basePtr, uint64_t fileID) {
+    size_t liveSize = 0;
+    forEachBlobPointer(dic, basePtr, [&](uint8_t *, const BlobPointer &pointer) {
+        if (pointer.fileID == fileID) {
+            liveSize += pointer.length;
+        }
+    });
+    return liveSize;
+}
+
+bool MMKV::setBlobForKey(const void *value, size_t valueSize, ValueWriter_t writer, MMKVKey_t key) {
+    static_assert(sizeof(BlobPointer) == BlobPointerSize, "BlobPointerSize mismatch");
+    if (isReadOnly()) {
+        MMKVWarning("[%s] file readonly", m_mmapID.c_str());
+        return false;
+    }
+    SCOPED_LOCK(m_lock);
+    SCOPED_LOCK(m_exclusiveProcessLock);
+    checkLoadData();
+
+    MMBuffer pointer;
+    if (!appendBlobValue(value, valueSize, writer, pointer)) {
+        return false;
+    }
+    return setDataForKey(std::move(pointer), key, false);
+}
+
+bool MMKV::appendBlobValue(const void *value, size_t valueSize, ValueWriter_t writer, MMBuffer &pointerData) {
+    if (valueSize > numeric_limits<uint32_t>::max() || !openBlobFileIfNeeded(true)) {
+        return false;
+    }
+    auto header = (BlobFileHeader *) m_blobFile->getMemory();
+    if (header->usedSize > m_blobFile->getFileSize()) {
+        // extended by another process
+        closeBlobFile();
+        if (!openBlobFileIfNeeded(true)) {
+            return false;
+        }
+        header = (BlobFileHeader *) m_blobFile->getMemory();
+    }
+    if (header->usedSize + valueSize > m_blobFile->getFileSize()) {
+        if (!ensureBlobFileSize(valueSize)) {
+            return false;
+        }
+        header = (BlobFileHeader *) m_blobFile->getMemory();
+    }
+
+    auto offset = header->usedSize;
+    CodedOutputData output((uint8_t *) m_blobFile->getMemory() + offset, valueSize);
+    writer(output, value);
+    header->usedSize = offset + valueSize;
+
+    BlobPointer pointer = {BlobPointerMagic, header->fileID, offset, static_cast<uint32_t>(valueSize)};
+    pointerData = MMBuffer(&pointer, sizeof(pointer));
+    return true;
+}
+
+MMBuffer MMKV::resolveBlobValue(MMBuffer &&data) {
+    BlobPointer pointer;
+    memcpy(&pointer, data.getPtr(), sizeof(pointer));
+    if (pointer.magic != BlobPointerMagic || !openBlobFileIfNeeded(false)) {
+        return std::move(data);
+    }
+    auto header = (BlobFileHeader *) m_blobFile->getMemory();
+    auto end = pointer.offset + pointer.length;
+    if (pointer.fileID == header->fileID && end > m_blobFile->getFileSize()) {
+        // appended by another process
+        closeBlobFile();
+        if (!openBlobFileIfNeeded(false)) {
+            return MMBuffer();
+        }
+        header = (BlobFileHeader *) m_blobFile->getMemory();
+    }
+    if (pointer.fileID != header->fileID || pointer.offset < sizeof(BlobFileHeader) || end > header->usedSize ||
+        end > m_blobFile->getFileSize()) {
+        MMKVError("[%s] invalid blob pointer, offset %llu, length %u, blob file used size %llu", m_mmapID.c_str(),
+                  (unsigned long long) pointer.offset, pointer.length, (unsigned long long) header->usedSize);
+        return MMBuffer();
+    }
+    return MMBuffer((uint8_t *) m_blobFile->getMemory() + pointer.offset, pointer.length, MMBufferNoCopy);
+}
+
+bool MMKV::openBlobFileIfNeeded(bool create) {
+    if (m_blobFile) {
+        return true;
+    }
+    if (m_crypter) {
+        return false;
+    }
+    auto blobPath = m_path + BLOB_SUFFIX;
+    auto tmpPath = m_path + BLOB_TMP_SUFFIX;
+    if (!isReadOnly() && isFileExist(tmpPath)) {
+        // collectBlobGarbage() was interrupted, finish it if the log points to the new file already
+        bool pointedTo = false;
+        {
+#ifndef MMKV_ANDROID
+            MemoryFile tmpFile(tmpPath, 0, true);
+#else
+            MemoryFile tmpFile(tmpPath, MMFILE_TYPE_FILE, 0, true);
+#endif
+            if (tmpFile.isFileValid() && tmpFile.getFileSize() >= sizeof(BlobFileHeader)) {
+                auto header = (const BlobFileHeader *) tmpFile.getMemory();
+                auto basePtr = (uint8_t *) m_file->getMemory() + Fixed32Size;
+                forEachBlobPointer(*m_dic, basePtr, [&](uint8_t *, const BlobPointer &pointer) {
+                    pointedTo = pointedTo || (header->magic == BlobFileMagic && pointer.fileID == header->fileID);
+                });
+            }
+        }
+        if (pointedTo) {
+            MMKVInfo("[%s] finish interrupted blob garbage collection", m_mmapID.c_str());
+            tryAtomicRename(tmpPath, blobPath);
+        } else {
+            deleteFile(tmpPath);
+        }
+    }
+    if (!create && !isFileExist(blobPath)) {
+        return false;
+    }
+
+#ifndef MMKV_ANDROID
+    auto file = new MemoryFile(blobPath, DEFAULT_MMAP_SIZE, isReadOnly(), true);
+#else
+    auto file = new MemoryFile(blobPath, MMFILE_TYPE_FILE, DEFAULT_MMAP_SIZE, isReadOnly(), true);
+#endif
+    if (!file->isFileValid() || file->getFileSize() < sizeof(BlobFileHeader)) {
+        MMKVError("[%s] fail to open blob file", m_mmapID.c_str());
+        delete file;
+        return false;
+    }
+    auto header = (BlobFileHeader *) file->getMemory();
+    if (header->magic != BlobFileMagic) {
+        if (isReadOnly()) {
+            MMKVError("[%s] invalid blob file", m_mmapID.c_str());
+            delete file;
+            return false;
+        }
+        initBlobFileHeader(header, 0);
+    }
+    m_blobFile = file;
+    return true;
+}
+
+void MMKV::closeBlobFile() {
+    delete m_blobFile;
+    m_blobFile = nullptr;
+}
+
+bool MMKV::ensureBlobFileSize(size_t incomingSize) {
+    auto header = (BlobFileHeader *) m_blobFile->getMemory();
+    auto liveSize = liveBlobSize(*m_dic, (uint8_t *) m_file->getMemory() + Fixed32Size, header->fileID);
+    // collect lazily, only when the file is full & at least half of it is garbage
+    auto dataSize = static_cast<size_t>(header->usedSize) - sizeof(BlobFileHeader);
+    if (dataSize > 0 && dataSize - liveSize >= dataSize / 2) {
+        return collectBlobGarbage(incomingSize);
+    }
+
+    auto oldSize = m_blobFile->getFileSize();
+    auto fileSize = oldSize;
+    while (header->usedSize + incomingSize > fileSize) {
+        fileSize *= 2;
+    }
+    MMKVInfo("extending [%s] blob file size from %zu to %zu, incoming size:%zu", m_mmapID.c_str(), oldSize, fileSize,
+             incomingSize);
+    return m_blobFile->truncate(fileSize) && m_blobFile->isFileValid();
+}
+
+bool MMKV::collectBlobGarbage(size_t incomingSize) {
+    auto blobPath = m_path + BLOB_SUFFIX;
+    auto tmpPath = m_path + BLOB_TMP_SUFFIX;
+    auto oldHeader = (const BlobFileHeader *) m_blobFile->getMemory();
+    auto oldPtr = (const uint8_t *) m_blobFile->getMemory();
+
+    vector<pair<uint8_t *, BlobPointer>> livePointers;
+    size_t liveSize = 0;
+    auto basePtr = (uint8_t *) m_file->getMemory() + Fixed32Size;
+    forEachBlobPointer(*m_dic, basePtr, [&](uint8_t *ptr, const BlobPointer &pointer) {
+        if (pointer.fileID == oldHeader->fileID) {
+            livePointers.emplace_back(ptr, pointer);
+            liveSize += pointer.length;
+        }
+    });
+    // keep the order of the old file
+    sort(livePointers.begin(), livePointers.end(),
+         [](const auto &left, const auto &right) { return left.second.offset < right.second.offset; });
+    size_t fileSize = DEFAULT_MMAP_SIZE;
+    while (sizeof(BlobFileHeader) + liveSize + incomingSize > fileSize) {
+        fileSize *= 2;
+    }
+    MMKVInfo("collecting [%s] blob garbage, used size %llu, live size %zu, new file size %zu", m_mmapID.c_str(),
+             (unsigned long long) oldHeader->usedSize, liveSize, fileSize);
+
+    // 1. copy live values to the new file
+    if (isFileExist(tmpPath)) {
+        deleteFile(tmpPath);
+    }
+    {
+#ifndef MMKV_ANDROID
+        MemoryFile tmpFile(tmpPath, fileSize);
+#else
+        MemoryFile tmpFile(tmpPath, MMFILE_TYPE_FILE, fileSize);
+#endif
+        if (!tmpFile.isFileValid() || tmpFile.getFileSize() < fileSize) {
+            MMKVError("[%s] fail to create blob file for garbage collection", m_mmapID.c_str());
+            return false;
+        }
+        auto header = (BlobFileHeader *) tmpFile.getMemory();
+        auto ptr = (uint8_t *) tmpFile.getMemory();
+        initBlobFileHeader(header, oldHeader->fileID);
+        auto offset = header->usedSize;
+        for (auto &item : livePointers) {
+            memcpy(ptr + offset, oldPtr + item.second.offset, item.second.length);
+            item.second.fileID = header->fileID;
+            item.second.offset = offset;
+            offset += item.second.length;
+        }
+        header->usedSize = offset;
+        tmpFile.msync(MMKV_SYNC);
+    }
+
+    // 2. point the log to the new file, the pointers are rewritten in place
+    for (auto &item : livePointers) {
+        memcpy(item.first, &item.second, sizeof(BlobPointer));
+    }
+    m_crcDigest = (uint32_t) CRC32(0, basePtr, (uint32_t) m_actualSize);
+    writeActualSize(m_actualSize, m_crcDigest, nullptr, IncreaseSequence);
+    m_file->msync(MMKV_SYNC);
+    m_metaFile->msync(MMKV_SYNC);
+
+    // 3. replace the old file, openBlobFileIfNeeded() redoes it if we're interrupted before
+    closeBlobFile();
+    if (!tryAtomicRename(tmpPath, blobPath)) {
+        MMKVError("[%s] fail to replace blob file", m_mmapID.c_str());
+        return false;
+    }
+    return openBlobFileIfNeeded(true);
+}
+
+void MMKV::resetBlobFile() {
+    if (!openBlobFileIfNeeded(false)) {
+        return;
+    }
+    auto header = (BlobFileHeader *) m_blobFile->getMemory();
+    initBlobFileHeader(header, header->fileID);
+    if (m_blobFile->getFileSize() > DEFAULT_MMAP_SIZE) {
+        m_blobFile->truncate(DEFAULT_MMAP_SIZE);
+    }
+}
+
+// ---- segmented log ----
+
+#pragma pack(push, 1)
+
+// every segment starts with Fixed32Size reserved bytes (the legacy actual size for the first one) & this header
+struct SegmentHeader {
+    uint32_t magic;
+    uint32_t segmentSize;
+    uint32_t sequence; // 0 for a free segment
+    uint32_t usedSize;
+    uint32_t crcDigest;
+};
+
+#pragma pack(pop)
+
+constexpr uint32_t SegmentMagic = 0x4D474553; // "SEGM"
+
+// offsets are relative to the beginning of the data (after Fixed32Size), the same as KeyValueHolder::offset
+static SegmentHeader *segmentHeader(MemoryFile *file, size_t segmentSize, size_t index) {
+    return (SegmentHeader *) ((uint8_t *) file->getMemory() + Fixed32Size + index * segmentSize);
+}
+
+static size_t segmentDataOffset(size_t segmentSize, size_t index) {
+    return index * segmentSize + sizeof(SegmentHeader);
+}
+
+static size_t segmentCapacity(size_t segmentSize) {
+    return segmentSize - Fixed32Size - sizeof(SegmentHeader);
+}
+
+// the segment id of a record is implied by its offset
+static vector<size_t> segmentLiveSizes(const MMKVMap &dic, size_t segmentSize, size_t count) {
+    vector<size_t> liveSizes(count, 0);
+    for (auto &pair : dic) {
+        auto &kvHolder = pair.second;
+        auto index = kvHolder.offset / segmentSize;
+        if (index < count) {
+            liveSizes[index] += kvHolder.computedKVSize + kvHolder.valueSize;
+        }
+    }
+    return liveSizes;
+}
+
+bool MMKV::loadFromSegments() {
+#ifdef MMKV_APPLE
+    return false;
+#else
+    bool isSegmented = m_metaInfo->m_version >= MMKVVersionFlag && m_metaInfo->hasFlag(MMKVMetaInfo::EnableSegmentedLog);
+    if (!isSegmented) {
+        if (m_expectedSegmentSize == 0 || isReadOnly()) {
+            return false;
+        }
+        if (m_crypter || isMultiProcess() || m_enableKeyExpire || m_blobThreshold > 0) {
+            MMKVWarning("[%s] segmented log is only for single-process non-encrypted instances without key expiration "
+                        "or value separation",
+                        m_mmapID.c_str());
+            return false;
+        }
+        if (readActualSize() > 0) {
+            MMKVWarning("[%s] keep using the existing single log, call clearAll() to switch to segmented log",
+                        m_mmapID.c_str());
+            return false;
+        }
+    } else if (m_crypter) {
+        MMKVError("[%s] can't open a segmented log with encryption", m_mmapID.c_str());
+        return false;
+    } else if (isMultiProcess()) {
+        MMKVWarning("[%s] segmented log won't see changes from other processes", m_mmapID.c_str());
+    }
+
+    clearDictionary(m_dic);
+    invalidateKeyHandles();
+    m_actualSize = 0;
+    m_segmentSequence = 0;
+    m_segmentSize = 0;
+    auto fileSize = m_file->getFileSize();
+    if (isSegmented && fileSize >= Fixed32Size + sizeof(SegmentHeader)) {
+        auto header = (const SegmentHeader *) ((uint8_t *) m_file->getMemory() + Fixed32Size);
+        auto segmentSize = static_cast<size_t>(header->segmentSize);
+        if (header->magic == SegmentMagic && segmentSize >= DEFAULT_MMAP_SIZE && segmentSize % DEFAULT_MMAP_SIZE == 0 &&
+            fileSize % segmentSize == 0 && fileSize / segmentSize >= 2) {
+            m_segmentSize = segmentSize;
+            if (m_expectedSegmentSize != 0 && m_expectedSegmentSize != segmentSize) {
+                MMKVInfo("[%s] keep the existing segment size %zu", m_mmapID.c_str(), segmentSize);
+            }
+        } else {
+            MMKVError("[%s] invalid segment header, discard everything", m_mmapID.c_str());
+        }
+    }
+    if (!m_segmentSize) {
+        m_segmentSize = m_expectedSegmentSize ? m_expectedSegmentSize : DEFAULT_MMAP_SIZE;
+        if (isReadOnly() || !formatSegments(0)) {
+            m_segmentSize = 0;
+            return false;
+        }
+        if (!isSegmented) {
+            m_metaInfo->setFlag(MMKVMetaInfo::EnableSegmentedLog);
+            writeActualSize(0, 0, nullptr, IncreaseSequence);
+        }
+    }
+
+    // replay segments in the order they are written
+    auto count = m_file->getFileSize() / m_segmentSize;
+    auto capacity = segmentCapacity(m_segmentSize);
+    vector<pair<uint32_t, uint32_t>> segments; // pair(sequence, index)
+    for (size_t index = 0; index < count; index++) {
+        auto header = segmentHeader(m_file, m_segmentSize, index);
+        if (header->magic != SegmentMagic || header->segmentSize != m_segmentSize || header->usedSize > capacity) {
+            MMKVError("[%s] invalid header of segment %zu, discard it", m_mmapID.c_str(), index);
+            if (!isReadOnly()) {
+                *header = {SegmentMagic, static_cast<uint32_t>(m_segmentSize), 0, 0, 0};
+            }
+            continue;
+        }
+        if (header->sequence != 0) {
+            segments.emplace_back(header->sequence, static_cast<uint32_t>(index));
+        }
+    }
+    sort(segments.begin(), segments.end());
+    auto basePtr = (uint8_t *) m_file->getMemory() + Fixed32Size;
+    for (auto &[sequence, index] : segments) {
+        auto header = segmentHeader(m_file, m_segmentSize, index);
+        auto offset = segmentDataOffset(m_segmentSize, index);
+        auto crcDigest = (uint32_t) CRC32(0, basePtr + offset, header->usedSize);
+        if (crcDigest != header->crcDigest) {
+            MMKVError("[%s] check crc of segment %u fail, keep whatever decoded", m_mmapID.c_str(), index);
+        }
+        MMBuffer inputBuffer(basePtr, offset + header->usedSize, MMBufferNoCopy);
+        MiniPBCoder::greedyDecodeMap(*m_dic, inputBuffer, offset, keyFilter());
+        m_actualSize += header->usedSize;
+        m_segmentSequence = sequence;
+    }
+
+    if (segments.empty()) {
+        if (!isReadOnly()) {
+            openHeadSegment(0);
+        } else {
+            m_headSegment = 0;
+            resetSegmentOutput();
+        }
+    } else {
+        m_headSegment = segments.back().second;
+        resetSegmentOutput();
+    }
+    MMKVInfo("loaded [%s] with %zu key-values from %zu segments of size %zu, actual size %zu", m_mmapID.c_str(),
+             m_dic->size(), segments.size(), m_segmentSize, m_actualSize);
+    notifyContentLoaded();
+    return true;
+#endif
+}
+
+// the file is at least 2 segments, one for the head & one to switch to
+bool MMKV::formatSegments(size_t fromIndex) {
+    auto fileSize = m_file->getFileSize();
+    auto expectedSize = std::max(m_segmentSize * 2, roundUp(fileSize, m_segmentSize));
+    if (fileSize != expectedSize) {
+        if (!m_file->truncate(expectedSize) || !isFileValid()) {
+            return false;
+        }
+    }
+    auto count = m_file->getFileSize() / m_segmentSize;
+    for (size_t index = fromIndex; index < count; index++) {
+        *segmentHeader(m_file, m_segmentSize, index) = {SegmentMagic, static_cast<uint32_t>(m_segmentSize), 0, 0, 0};
+    }
+    return true;
+}
+
+bool MMKV::growSegments() {
+    auto oldSize = m_file->getFileSize();
+    auto fileSize = oldSize * 2;
+    MMKVInfo("extending [%s] segmented file size from %zu to %zu", m_mmapID.c_str(), oldSize, fileSize);
+    if (!m_file->truncate(fileSize) || !isFileValid()) {
+        return false;
+    }
+    if (!formatSegments(oldSize / m_segmentSize)) {
+        return false;
+    }
+    resetSegmentOutput();
+    return true;
+}
+
+void MMKV::openHeadSegment(uint32_t index) {
+    auto header = segmentHeader(m_file, m_segmentSize, index);
+    header->usedSize = 0;
+    header->crcDigest = 0;
+    header->sequence = ++m_segmentSequence;
+    m_headSegment = index;
+    resetSegmentOutput();
+}
+
+// the file might have been remapped
+void MMKV::resetSegmentOutput() {
+    auto header = segmentHeader(m_file, m_segmentSize, m_headSegment);
+    auto ptr = (uint8_t *) m_file->getMemory() + Fixed32Size + segmentDataOffset(m_segmentSize, m_headSegment);
+    delete m_output;
+    m_output = new CodedOutputData(ptr, segmentCapacity(m_segmentSize));
+    m_output->seek(header->usedSize);
+}
+
+void MMKV::commitSegmentAppend(const uint8_t *ptr, size_t size) {
+    auto header = segmentHeader(m_file, m_segmentSize, m_headSegment);
+    header->crcDigest = (uint32_t) CRC32(header->crcDigest, ptr, (uint32_t) size);
+    header->usedSize += static_cast<uint32_t>(size);
+    m_actualSize += size;
+}
+
+// move the head to a free segment, extend the file if there's none
+bool MMKV::switchHeadSegment() {
+    auto count = m_file->getFileSize() / m_segmentSize;
+    for (size_t index = 0; index < count; index++) {
+        if (index != m_headSegment && segmentHeader(m_file, m_segmentSize, index)->sequence == 0) {
+            openHeadSegment(static_cast<uint32_t>(index));
+            return true;
+        }
+    }
+    if (!growSegments()) {
+        return false;
+    }
+    openHeadSegment(static_cast<uint32_t>(count));
+    return true;
+}
+
+bool MMKV::ensureSegmentSpace(size_t size) {
+    auto capacity = segmentCapacity(m_segmentSize);
+    if (size > capacity) {
+        MMKVError("[%s] item size %zu exceeds segment capacity %zu", m_mmapID.c_str(), size, capacity);
+        return false;
+    }
+    if (size <= m_output->spaceLeft()) {
+        return true;
+    }
+    if (!switchHeadSegment()) {
+        return false;
+    }
+
+    // recycle one segment if no free one is left, so that the next switch doesn't need to extend the file
+    auto count = m_file->getFileSize() / m_segmentSize;
+    auto liveSizes = segmentLiveSizes(*m_dic, m_segmentSize, count);
+    uint32_t victim = 0, oldestSequence = 0;
+    size_t maxGarbage = 0;
+    for (size_t index = 0; index < count; index++) {
+        auto header = segmentHeader(m_file, m_segmentSize, index);
+        if (header->sequence == 0) {
+            return true;
+        }
+        if (index == m_headSegment) {
+            continue;
+        }
+        if (oldestSequence == 0 || header->sequence < oldestSequence) {
+            oldestSequence = header->sequence;
+        }
+        auto garbage = header->usedSize - liveSizes[index];
+        if (garbage > maxGarbage && liveSizes[index] + size <= m_output->spaceLeft()) {
+            maxGarbage = garbage;
+            victim = static_cast<uint32_t>(index);
+        }
+    }
+    // not worth copying a mostly live segment, the file will be extended instead
+    if (maxGarbage >= capacity / 4) {
+        auto isOldest = segmentHeader(m_file, m_segmentSize, victim)->sequence == oldestSequence;
+        return compactSegment(victim, isOldest);
+    }
+    return true;
+}
+
+// copy live records of the segment to the head, then free it
+// a deletion mark is dropped only from the oldest segment, there might be older values of the key otherwise
+bool MMKV::compactSegment(uint32_t index, bool dropTombstones) {
+#ifdef MMKV_APPLE
+    return false;
+#else
+    auto header = segmentHeader(m_file, m_segmentSize, index);
+    auto offset = segmentDataOffset(m_segmentSize, index);
+    auto usedSize = header->usedSize;
+    auto basePtr = (uint8_t *) m_file->getMemory() + Fixed32Size;
+
+    vector<pair<KeyValueHolder, KeyValueHolder *>> records;
+    CodedInputData input(basePtr, offset + usedSize);
+    if (!input.trySeek(offset)) {
+        return false;
+    }
+    string key;
+    while (!input.isAtEnd()) {
+        KeyValueHolder kvHolder;
+        if (!input.tryReadString(kvHolder, key) || !input.tryReadData(kvHolder)) {
+            MMKVError("[%s] fail to decode segment %u, drop the rest of it", m_mmapID.c_str(), index);
+            break;
+        }
+        auto itr = m_dic->find(key);
+        if (itr != m_dic->end()) {
+            if (itr->second.offset == kvHolder.offset) {
+                records.emplace_back(kvHolder, &itr->second);
+            }
+        } else if (kvHolder.valueSize == 0 && !dropTombstones) {
+            records.emplace_back(kvHolder, nullptr);
+        }
+    }
+
+    for (auto &[kvHolder, liveHolder] : records) {
+        size_t size = kvHolder.computedKVSize + kvHolder.valueSize;
+        if (size > m_output->spaceLeft() && !switchHeadSegment()) {
+            return false;
+        }
+        basePtr = (uint8_t *) m_file->getMemory() + Fixed32Size;
+        auto ptr = m_output->curWritePointer();
+        m_output->writeRawData(MMBuffer(basePtr + kvHolder.offset, size, MMBufferNoCopy));
+        commitSegmentAppend(ptr, size);
+        if (liveHolder) {
+            liveHolder->offset = static_cast<uint32_t>(ptr - basePtr);
+        }
+    }
+
+    header = segmentHeader(m_file, m_segmentSize, index);
+    header->sequence = 0;
+    header->usedSize = 0;
+    header->crcDigest = 0;
+    m_actualSize -= usedSize;
+    return true;
+#endif
+}
+
+// the full write-back of a segmented log: compact every segment, oldest first
+bool MMKV::compactAllSegments() {
+    if (segmentHeader(m_file, m_segmentSize, m_headSegment)->usedSize > 0 && !switchHeadSegment()) {
+        return false;
+    }
+    vector<pair<uint32_t, uint32_t>> segments; // pair(sequence, index)
+    auto count = m_file->getFileSize() / m_segmentSize;
+    for (size_t index = 0; index < count; index++) {
+        auto header = segmentHeader(m_file, m_segmentSize, index);
+        if (header->sequence != 0 && index != m_headSegment) {
+            segments.emplace_back(header->sequence, static_cast<uint32_t>(index));
+        }
+    }
+    sort(segments.begin(), segments.end());
+    for (auto &pair : segments) {
+        if (!compactSegment(pair.second, true)) {
+            return false;
+        }
+    }
+    m_hasFullWriteback = true;
+    return true;
+}
+
+// drop free segments from the end of the file, keeping a spare one
+void MMKV::trimSegments() {
+    if (!compactAllSegments()) {
+        return;
+    }
+    auto count = m_file->getFileSize() / m_segmentSize;
+    size_t lastUsed = 0;
+    for (size_t index = 0; index < count; index++) {
+        if (segmentHeader(m_file, m_segmentSize, index)->sequence != 0) {
+            lastUsed = index;
+        }
+    }
+    auto fileSize = std::max<size_t>(lastUsed + 2, 2) * m_segmentSize;
+    if (fileSize >= m_file->getFileSize()) {
+        MMKVInfo("there's no need to trim %s with size %zu, actualSize %zu", m_mmapID.c_str(), m_file->getFileSize(),
+                 m_actualSize);
+        return;
+    }
+    MMKVInfo("trimming %s from %zu to %zu, actualSize %zu", m_mmapID.c_str(), m_file->getFileSize(), fileSize,
+             m_actualSize);
+    if (m_file->truncate(fileSize) && isFileValid()) {
+        resetSegmentOutput();
+    }
+}
+
+#ifndef MMKV_APPLE
+
+// ---- shared index ----
+
+#pragma pack(push, 1)
+
+// an open addressing hash table from keys to the offsets of their latest items, with linear probing
+struct SharedIndexHeader {
+    uint32_t magic;
+    uint32_t capacity; // slot count, a power of 2
+    uint32_t count;    // live keys
+    uint32_t used;     // live keys & removed marks
+    // the state of the file the index is in sync with
+    uint32_t sequence;
+    uint32_t actualSize;
+    uint32_t crcDigest;
+    uint32_t reserved[9];
+};
+
+struct SharedIndexSlot {
+    uint32_t hash;
+    uint32_t offset;
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(SharedIndexHeader) == 64, "shared index header size changed");
+
+constexpr uint32_t SharedIndexMagic = 0x58444E49; // "INDX"
+// an item never starts before ItemSizeHolderSize, so these offsets are free to mark a slot
+constexpr uint32_t EmptySlot = 0;
+constexpr uint32_t RemovedSlot = 1;
+constexpr uint32_t MinSharedIndexCapacity = 256;
+
+static size_t sharedIndexFileSize(uint32_t capacity) {
+    return sizeof(SharedIndexHeader) + static_cast<size_t>(capacity) * sizeof(SharedIndexSlot);
+}
+
+// keep the load factor under 1/2 after a rebuild
+static uint32_t sharedIndexCapacity(size_t count) {
+    uint32_t capacity = MinSharedIndexCapacity;
+    while (capacity < count * 2) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+static uint32_t sharedIndexHash(string_view key) {
+    return (uint32_t) CRC32(0, (const uint8_t *) key.data(), (z_size_t) key.size());
+}
+
+static SharedIndexSlot *sharedIndexSlots(SharedIndexHeader *header) {
+    return (SharedIndexSlot *) (header + 1);
+}
+
+static void stampSharedIndex(SharedIndexHeader *header, const MMKVMetaInfo &metaInfo) {
+    header->sequence = metaInfo.m_sequence;
+    header->actualSize = metaInfo.m_actualSize;
+    header->crcDigest = metaInfo.m_crcDigest;
+}
+
+// the table might have been grown by another process, map the whole of it
+static SharedIndexHeader *mappedSharedIndex(MemoryFile *file) {
+    if (!file || !file->isFileValid()) {
+        return nullptr;
+    }
+    auto header = (SharedIndexHeader *) file->getMemory();
+    auto capacity = header->capacity;
+    if (header->magic != SharedIndexMagic || capacity < MinSharedIndexCapacity || (capacity & (capacity - 1)) != 0 ||
+        header->count > header->used || header->used >= capacity) {
+        return nullptr;
+    }
+    if (sharedIndexFileSize(capacity) > file->getFileSize()) {
+        file->clearMemoryCache();
+        file->reloadFromFile();
+        if (!file->isFileValid()) {
+            return nullptr;
+        }
+        header = (SharedIndexHeader *) file->getMemory();
+        if (header->capacity != capacity || sharedIndexFileSize(capacity) > file->getFileSize()) {
+            return nullptr;
+        }
+    }
+    return header;
+}
+
+// an empty table of the capacity, the file is extended if needed
+static SharedIndexHeader *resetSharedIndex(MemoryFile *file, uint32_t capacity) {
+    auto fileSize = sharedIndexFileSize(capacity);
+    if (fileSize > file->getFileSize() && (!file->truncate(fileSize) || !file->isFileValid())) {
+        return nullptr;
+    }
+    auto header = (SharedIndexHeader *) file->getMemory();
+    memset(sharedIndexSlots(header), 0, fileSize - sizeof(SharedIndexHeader));
+    header->capacity = capacity;
+    header->count = 0;
+    header->used = 0;
+    return header;
+}
+
+// for a key that is known not to be in the table
+static void insertSharedIndexSlot(SharedIndexHeader *header, uint32_t hash, uint32_t offset) {
+    auto slots = sharedIndexSlots(header);
+    auto mask = header->capacity - 1;
+    auto index = hash & mask;
+    while (slots[index].offset != EmptySlot) {
+        index = (index + 1) & mask;
+    }
+    slots[index].hash = hash;
+    slots[index].offset = offset;
+}
+
+// the item at offset: varint key length, key, varint value length, value
+static bool readIndexedItem(const uint8_t *basePtr, size_t actualSize, uint32_t offset, string_view &key,
+                            KeyValueHolder &kvHolder) {
+    if (offset < ItemSizeHolderSize || offset >= actualSize) {
+        return false;
+    }
+    CodedInputData input(basePtr + offset, actualSize - offset);
+    uint32_t keyLength = 0, valueLength = 0;
+    if (!input.tryReadUInt32(keyLength) || keyLength == 0 || keyLength > KeySizeLimit || !input.trySeek(keyLength) ||
+        !input.tryReadUInt32(valueLength)) {
+        return false;
+    }
+    kvHolder = KeyValueHolder(keyLength, valueLength, offset);
+    if (kvHolder.computedKVSize + static_cast<size_t>(valueLength) > actualSize - offset) {
+        return false;
+    }
+    key = string_view((const char *) basePtr + offset + pbRawVarint32Size(keyLength), keyLength);
+    return true;
+}
+
+// return the slot of the key, or nullptr with the first reusable slot on the way
+static SharedIndexSlot *probeSharedIndex(SharedIndexHeader *header, string_view key, uint32_t hash,
+                                         const uint8_t *basePtr, size_t actualSize, KeyValueHolder &kvHolder,
+                                         SharedIndexSlot **freeSlot = nullptr) {
+    auto slots = sharedIndexSlots(header);
+    auto mask = header->capacity - 1;
+    SharedIndexSlot *reusable = nullptr;
+    for (uint32_t index = hash & mask, probed = 0; probed <= mask; index = (index + 1) & mask, probed++) {
+        auto slot = slots + index;
+        if (slot->offset == EmptySlot) {
+            reusable = reusable ? reusable : slot;
+            break;
+        }
+        if (slot->offset == RemovedSlot) {
+            reusable = reusable ? reusable : slot;
+        } else if (slot->hash == hash) {
+            string_view itemKey;
+            if (readIndexedItem(basePtr, actualSize, slot->offset, itemKey, kvHolder) && itemKey == key) {
+                return slot;
+            }
+        }
+    }
+    if (freeSlot) {
+        *freeSlot = reusable;
+    }
+    return nullptr;
+}
+
+// rehash the live slots into a table large enough for count keys, removed marks are dropped
+static SharedIndexHeader *growSharedIndex(MemoryFile *file, uint32_t count) {
+    auto header = (SharedIndexHeader *) file->getMemory();
+    auto slots = sharedIndexSlots(header);
+    vector<SharedIndexSlot> liveSlots;
+    liveSlots.reserve(header->count);
+    for (uint32_t index = 0; index < header->capacity; index++) {
+        if (slots[index].offset > RemovedSlot) {
+            liveSlots.push_back(slots[index]);
+        }
+    }
+    header = resetSharedIndex(file, sharedIndexCapacity(std::max<size_t>(count, liveSlots.size())));
+    if (!header) {
+        return nullptr;
+    }
+    for (auto &slot : liveSlots) {
+        insertSharedIndexSlot(header, slot.hash, slot.offset);
+    }
+    header->count = header->used = static_cast<uint32_t>(liveSlots.size());
+    return header;
+}
+
+bool MMKV::openSharedIndexIfNeeded(bool create) {
+    if (m_indexFile) {
+        return true;
+    }
+    auto indexPath = m_path + INDEX_SUFFIX;
+    if (!create && !isFileExist(indexPath)) {
+        return false;
+    }
+#ifndef MMKV_ANDROID
+    auto file = new MemoryFile(indexPath, DEFAULT_MMAP_SIZE, isReadOnly(), true);
+#else
+    auto file = new MemoryFile(indexPath, MMFILE_TYPE_FILE, DEFAULT_MMAP_SIZE, isReadOnly(), true);
+#endif
+    if (!file->isFileValid() || file->getFileSize() < sharedIndexFileSize(MinSharedIndexCapacity)) {
+        MMKVError("[%s] fail to open shared index file", m_mmapID.c_str());
+        delete file;
+        return false;
+    }
+    m_indexFile = file;
+    return true;
+}
+
+void MMKV::closeSharedIndex() {
+    delete m_indexFile;
+    m_indexFile = nullptr;
+    m_sharedIndex = false;
+}
+
+bool MMKV::attachSharedIndex() {
+    if (!m_enableSharedIndex || m_crypter || m_enableKeyExpire || m_segmentSize ||
+        m_metaInfo->m_version < MMKVVersionActualSize || !openSharedIndexIfNeeded(false)) {
+        return false;
+    }
+    auto header = mappedSharedIndex(m_indexFile);
+    if (!header || header->sequence != m_metaInfo->m_sequence || header->actualSize != m_metaInfo->m_actualSize ||
+        header->crcDigest != m_metaInfo->m_crcDigest) {
+        return false;
+    }
+    auto fileSize = m_file->getFileSize();
+    if (static_cast<size_t>(header->actualSize) + Fixed32Size > fileSize) {
+        return false;
+    }
+    // the writer has checked the file before updating the index, no need to check it again
+    clearDictionary(m_dic);
+    invalidateKeyHandles();
+    m_actualSize = header->actualSize;
+    m_crcDigest = header->crcDigest;
+    delete m_output;
+    m_output = new CodedOutputData((uint8_t *) m_file->getMemory() + Fixed32Size, fileSize - Fixed32Size);
+    m_output->seek(m_actualSize);
+    m_hasFullWriteback = false;
+    m_sharedIndex = true;
+    return true;
+}
+
+void MMKV::syncSharedIndex() {
+    auto oldSequence = m_metaInfo->m_sequence;
+    m_metaInfo->read(m_metaFile->getMemory());
+    // the file is only resized along with a new sequence
+    if (m_metaInfo->m_sequence != oldSequence && m_file->getActualFileSize() != m_file->getFileSize()) {
+        m_file->clearMemoryCache();
+        m_file->reloadFromFile(m_expectedCapacity);
+    }
+    if (!m_file->isFileValid() || !attachSharedIndex()) {
+        // someone has written without updating the index, or has died in the middle of it
+        MMKVInfo("[%s] shared index out of sync, reload from file", m_mmapID.c_str());
+        clearMemoryCache();
+        loadFromFile();
+    }
+}
+
+bool MMKV::findInSharedIndex(MMKVKey_t key, KeyValueHolder &kvHolder) {
+    auto header = mappedSharedIndex(m_indexFile);
+    if (!header) {
+        return false;
+    }
+    auto basePtr = (const uint8_t *) m_file->getMemory() + Fixed32Size;
+    return probeSharedIndex(header, key, sharedIndexHash(key), basePtr, m_actualSize, kvHolder) != nullptr;
+}
+
+void MMKV::putSharedIndex(MMKVKey_t key, const KeyValueHolder &kvHolder) {
+    if (m_sharedIndex) {
+        auto header = mappedSharedIndex(m_indexFile);
+        if (header && static_cast<uint64_t>(header->used + 1) * 4 > static_cast<uint64_t>(header->capacity) * 3) {
+            header = growSharedIndex(m_indexFile, header->count + 1);
+        }
+        if (header) {
+            auto basePtr = (const uint8_t *) m_file->getMemory() + Fixed32Size;
+            auto hash = sharedIndexHash(key);
+            KeyValueHolder oldHolder;
+            SharedIndexSlot *freeSlot = nullptr;
+            if (auto slot = probeSharedIndex(header, key, hash, basePtr, m_actualSize, oldHolder, &freeSlot)) {
+                slot->offset = kvHolder.offset;
+            } else if (freeSlot) {
+                header->used += (freeSlot->offset == EmptySlot) ? 1 : 0;
+                header->count++;
+                freeSlot->hash = hash;
+                freeSlot->offset = kvHolder.offset;
+            }
+            stampSharedIndex(header, *m_metaInfo);
+            return;
+        }
+        // the index is left out of sync, whoever loads the file next rebuilds it
+        MMKVError("[%s] fail to update shared index, fallback to dictionary", m_mmapID.c_str());
+        loadDictionaryFromSharedIndex();
+    }
+    auto itr = m_dic->find(key);
+    if (itr != m_dic->end()) {
+        itr->second = kvHolder;
+    } else {
+        m_dic->emplace(key, kvHolder);
+    }
+}
+
+void MMKV::eraseSharedIndex(MMKVKey_t key) {
+    if (m_sharedIndex) {
+        if (auto header = mappedSharedIndex(m_indexFile)) {
+            auto basePtr = (const uint8_t *) m_file->getMemory() + Fixed32Size;
+            KeyValueHolder kvHolder;
+            if (auto slot = probeSharedIndex(header, key, sharedIndexHash(key), basePtr, m_actualSize, kvHolder)) {
+                slot->offset = RemovedSlot;
+                header->count--;
+            }
+            stampSharedIndex(header, *m_metaInfo);
+            return;
+        }
+        MMKVError("[%s] fail to update shared index, fallback to dictionary", m_mmapID.c_str());
+        loadDictionaryFromSharedIndex();
+    }
+    auto itr = m_dic->find(key);
+    if (itr != m_dic->end()) {
+        m_dic->erase(itr);
+        invalidateKeyHandles();
+    }
+}
+
+size_t MMKV::sharedIndexCount() {
+    auto header = mappedSharedIndex(m_indexFile);
+    return header ? header->count : 0;
+}
+
+vector<string> MMKV::sharedIndexKeys() {
+    vector<string> keys;
+    auto header = mappedSharedIndex(m_indexFile);
+    if (!header) {
+        return keys;
+    }
+    keys.reserve(header->count);
+    auto slots = sharedIndexSlots(header);
+    auto basePtr = (const uint8_t *) m_file->getMemory() + Fixed32Size;
+    for (uint32_t index = 0; index < header->capacity; index++) {
+        string_view key;
+        KeyValueHolder kvHolder;
+        if (slots[index].offset > RemovedSlot && readIndexedItem(basePtr, m_actualSize, slots[index].offset, key, kvHolder)) {
+            keys.emplace_back(key);
+        }
+    }
+    return keys;
+}
+
+size_t MMKV::forEachInSharedIndex(ForEachFunc_t func, void *context) {
+    auto header = mappedSharedIndex(m_indexFile);
+    if (!header) {
+        return 0;
+    }
+    size_t count = 0;
+    auto now = mmkv_unlikely(m_enableKeyExpire) ? getCurrentTimeInSecond() : 0;
+    auto slots = sharedIndexSlots(header);
+    auto basePtr = (uint8_t *) m_file->getMemory() + Fixed32Size;
+    for (uint32_t index = 0; index < header->capacity; index++) {
+        string_view key;
+        KeyValueHolder kvHolder;
+        if (slots[index].offset > RemovedSlot && readIndexedItem(basePtr, m_actualSize, slots[index].offset, key, kvHolder)) {
+            if (visitKeyValue(key, kvHolder.toMMBuffer(basePtr), now, func, context, count)) {
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+// lend the keys to m_dic, the index is out of use until they are saved back
+void MMKV::loadDictionaryFromSharedIndex() {
+    if (!m_sharedIndex) {
+        return;
+    }
+    m_sharedIndex = false;
+    clearDictionary(m_dic);
+    invalidateKeyHandles();
+
+    auto basePtr = (const uint8_t *) m_file->getMemory() + Fixed32Size;
+    bool loaded = false;
+    if (auto header = mappedSharedIndex(m_indexFile)) {
+        m_dic->reserve(header->count);
+        auto slots = sharedIndexSlots(header);
+        loaded = true;
+        for (uint32_t index = 0; index < header->capacity && loaded; index++) {
+            string_view key;
+            KeyValueHolder kvHolder;
+            if (slots[index].offset <= RemovedSlot) {
+                continue;
+            }
+            loaded = readIndexedItem(basePtr, m_actualSize, slots[index].offset, key, kvHolder);
+            if (loaded) {
+                m_dic->emplace(key, kvHolder);
+            }
+        }
+    }
+    if (!loaded) {
+        MMKVError("[%s] shared index corrupted, decode from file", m_mmapID.c_str());
+        clearDictionary(m_dic);
+        invalidateKeyHandles();
+        MMBuffer inputBuffer((void *) basePtr, m_actualSize, MMBufferNoCopy);
+        MiniPBCoder::decodeMap(*m_dic, inputBuffer);
+    }
+}
+
+// rebuild the index from m_dic, which is emptied afterwards
+void MMKV::saveDictionaryToSharedIndex() {
+    if (!m_enableSharedIndex || m_sharedIndex || m_crypter || m_enableKeyExpire || m_segmentSize ||
+        isReadOnly() || !isFileValid() || m_metaInfo->m_version < MMKVVersionActualSize) {
+        return;
+    }
+    SCOPED_LOCK(m_exclusiveProcessLock);
+    if (!openSharedIndexIfNeeded(true)) {
+        return;
+    }
+    // so that a half-built table is never taken as valid
+    ((SharedIndexHeader *) m_indexFile->getMemory())->magic = 0;
+    auto capacity = sharedIndexCapacity(m_dic->size());
+    // give back the space of a much larger table from before
+    auto fileSize = roundUp<size_t>(sharedIndexFileSize(capacity), DEFAULT_MMAP_SIZE);
+    if (m_indexFile->getFileSize() > fileSize * 2) {
+        m_indexFile->truncate(fileSize);
+    }
+    auto header = m_indexFile->isFileValid() ? resetSharedIndex(m_indexFile, capacity) : nullptr;
+    if (!header) {
+        MMKVError("[%s] fail to build shared index of capacity %u", m_mmapID.c_str(), capacity);
+        closeSharedIndex();
+        return;
+    }
+    for (auto &itr : *m_dic) {
+        insertSharedIndexSlot(header, sharedIndexHash(itr.first), itr.second.offset);
+    }
+    header->count = header->used = static_cast<uint32_t>(m_dic->size());
+    stampSharedIndex(header, *m_metaInfo);
+    header->magic = SharedIndexMagic;
+
+    MMKVInfo("[%s] built shared index of %zu keys, capacity %u", m_mmapID.c_str(), m_dic->size(), capacity);
+    clearDictionary(m_dic);
+    invalidateKeyHandles();
+    m_sharedIndex = true;
+}
+
+bool MMKV::openValueWriter(MMKVKey_t key, size_t expectedSize, MMKVValueWriter &writer) {
+    return openValueWriter(key, expectedSize, m_expiredInSeconds, writer);
+}
+
+bool MMKV::openValueWriter(MMKVKey_t key, size_t expectedSize, uint32_t expireDuration, MMKVValueWriter &writer) {
+    writer.cancel();
+    if (isKeyEmpty(key)) {
+        return false;
+    }
+    if (isReadOnly()) {
+        MMKVWarning("[%s] file readonly", m_mmapID.c_str());
+        return false;
+    }
+    if (!m_enableKeyExpire) {
+        assert(expireDuration == ExpireNever && "setting expire duration without calling enableAutoKeyExpire() first");
+    }
+    // [key][value length][data length][data][expire time if enabled], the same as set(MMBuffer)
+    uint32_t dataHolderLength = 0;
+    EncodedEntrySize entry;
+    size_t expireSize = m_enableKeyExpire ? Fixed32Size : 0;
+    if (key.size() > KeySizeLimit || !encodedValueLength(expectedSize, true, dataHolderLength) ||
+        !encodedEntrySize(key.size(), static_cast<uint32_t>(key.size()), dataHolderLength + expireSize, false, entry) ||
+        dataHolderLength > numeric_limits<int32_t>::max()) {
+        MMKVError("[%s] reject value too large to encode: %zu", m_mmapID.c_str(), expectedSize);
+        return false;
+    }
+    writer.m_key = string(key);
+    writer.m_expectedSize = expectedSize;
+    writer.m_expireDuration = expireDuration;
+#ifndef MMKV_DISABLE_CRYPT
+    if (m_crypter && !KeyValueHolderCrypt::isValueStoredAsOffset(entry.valueLength)) {
+        writer.m_isBuffered = true;
+        writer.m_buffer = MMBuffer(expectedSize);
+        writer.m_kv = this;
+        return true;
+    }
+#endif
+    if (shouldSeparateValue(dataHolderLength)) {
+        // the blob file takes a value as a whole, set() it there on commit()
+        writer.m_isBuffered = true;
+        writer.m_buffer = MMBuffer(expectedSize);
+        writer.m_kv = this;
+        return true;
+    }
+
+    m_lock->lock();
+    m_exclusiveProcessLock->lock();
+    checkLoadData();
+    if (m_segmentSize) {
+        // a record never spans segments, set() it as a whole on commit()
+        m_exclusiveProcessLock->unlock();
+        m_lock->unlock();
+        writer.m_isBuffered = true;
+        writer.m_buffer = MMBuffer(expectedSize);
+        writer.m_kv = this;
+        return true;
+    }
+
+    auto keyData = MMBuffer((void *) key.data(), key.size(), MMBufferNoCopy);
+    if (!checkSizeLimit(entry.totalSize, keyData, static_cast<uint32_t>(key.size())) ||
+        !ensureMemorySize(entry.totalSize) || !isFileValid()) {
+        m_exclusiveProcessLock->unlock();
+        m_lock->unlock();
+        return false;
+    }
+    writer.m_kv = this;
+    writer.m_valueLength = entry.valueLength;
+    writer.m_entrySize = entry.totalSize;
+    writer.m_crcDigest = m_crcDigest;
+#ifndef MMKV_DISABLE_CRYPT
+    if (m_crypter) {
+        // for the kv holder & for rolling back on cancel()
+        writer.m_cryptStatus = make_unique<AESCryptStatus>();
+        m_crypter->getCurStatus(*writer.m_cryptStatus);
+    }
+#endif
+    // the value stays invisible until commit() moves m_actualSize past it
+    auto ptr = m_output->curWritePointer();
+    m_output->writeData(keyData);
+    m_output->writeRawVarint32(static_cast<int32_t>(entry.valueLength));
+    m_output->writeRawVarint32(static_cast<int32_t>(expectedSize));
+    writer.seal(ptr, static_cast<size_t>(m_output->curWritePointer() - ptr));
+    return true;
+}
+
+MMKVValueWriter::MMKVValueWriter() = default;
+
+MMKVValueWriter::~MMKVValueWriter() {
+    cancel();
+}
+
+void MMKVValueWriter::seal(uint8_t *ptr, size_t size) {
+#ifndef MMKV_DISABLE_CRYPT
+    if (m_kv->m_crypter) {
+        m_kv->m_crypter->encrypt(ptr, ptr, size);
+    }
+#endif
+    m_crcDigest = (uint32_t) CRC32(m_crcDigest, ptr, (uint32_t) size);
+}
+
+bool MMKVValueWriter::write(const void *ptr, size_t size) {
+    if (!m_kv) {
+        return false;
+    }
+    if (size > m_expectedSize - m_written) {
+        MMKVError("[%s] value of expected size %zu overflow, written %zu, incoming %zu", m_kv->m_mmapID.c_str(),
+                  m_expectedSize, m_written, size);
+        return false;
     }
-    if (mmkv_unlikely(needsFullWrite)) {
-        m_metaInfo->write(m_metaFile->getMemory());
+    if (m_isBuffered) {
+        memcpy((uint8_t *) m_buffer.getPtr() + m_written, ptr, size);
     } else {
-        m_metaInfo->writeCRCAndActualSizeOnly(m_metaFile->getMemory());
+        auto output = m_kv->m_output;
+        auto dst = output->curWritePointer();
+        output->writeRawData(MMBuffer((void *) ptr, size, MMBufferNoCopy));
+        seal(dst, size);
     }
+    m_written += size;
     return true;
 }
 
-MMBuffer MMKV::getRawDataForKey(MMKVKey_t key) {
-    checkLoadData();
+bool MMKVValueWriter::commit() {
+    if (!m_kv) {
+        return false;
+    }
+    auto kv = m_kv;
+    if (m_written != m_expectedSize) {
+        MMKVError("[%s] value of expected size %zu only written %zu", kv->m_mmapID.c_str(), m_expectedSize, m_written);
+        cancel();
+        return false;
+    }
+    if (m_isBuffered) {
+        auto ret = kv->set(m_buffer, m_key, m_expireDuration);
+        close();
+        return ret;
+    }
+
+    if (mmkv_unlikely(kv->m_enableKeyExpire)) {
+        auto time = (m_expireDuration != MMKV::ExpireNever) ? MMKV::safeExpirationPlusCurrentTime(m_expireDuration)
+                                                             : MMKV::ExpireNever;
+        auto dst = kv->m_output->curWritePointer();
+        kv->m_output->writeRawLittleEndian32(UInt32ToInt32(time));
+        seal(dst, Fixed32Size);
+    }
+    auto keyLength = static_cast<uint32_t>(m_key.size());
+    auto offset = static_cast<uint32_t>(kv->m_actualSize);
+    kv->m_actualSize += m_entrySize;
+    kv->m_crcDigest = m_crcDigest;
+    kv->writeActualSize(kv->m_actualSize, kv->m_crcDigest, nullptr, KeepSequence);
+
 #ifndef MMKV_DISABLE_CRYPT
-    if (m_crypter) {
-        auto itr = m_dicCrypt->find(key);
-        if (itr != m_dicCrypt->end()) {
-            auto basePtr = (uint8_t *) (m_file->getMemory()) + Fixed32Size;
-            return itr->second.toMMBuffer(basePtr, m_crypter);
+    if (kv->m_crypter) {
+        KeyValueHolderCrypt kvHolder(keyLength, m_valueLength, offset);
+        memcpy(&kvHolder.cryptStatus, m_cryptStatus.get(), sizeof(AESCryptStatus));
+        kv->m_cryptMemoryUsage += kvHolder.memoryUsage();
+        auto itr = kv->m_dicCrypt->find(m_key);
+        if (itr != kv->m_dicCrypt->end()) {
+            kv->m_cryptMemoryUsage -= itr->second.memoryUsage();
+            itr->second = std::move(kvHolder);
+        } else {
+            kv->m_dicCrypt->emplace(m_key, std::move(kvHolder));
         }
     } else
 #endif
     {
-        auto itr = m_dic->find(key);
-        if (itr != m_dic->end()) {
-            auto basePtr = (uint8_t *) (m_file->getMemory()) + Fixed32Size;
-            return itr->second.toMMBuffer(basePtr);
+        KeyValueHolder kvHolder(keyLength, m_valueLength, offset);
+#ifndef MMKV_APPLE
+        if (kv->m_sharedIndex) {
+            kv->putSharedIndex(m_key, kvHolder);
+        } else
+#endif
+        {
+            auto itr = kv->m_dic->find(m_key);
+            if (itr != kv->m_dic->end()) {
+                itr->second = kvHolder;
+            } else {
+                kv->m_dic->emplace(m_key, kvHolder);
+            }
         }
     }
-    MMBuffer nan;
-    return nan;
+    kv->m_hasFullWriteback = false;
+    close();
+    return true;
 }
 
-mmkv::MMBuffer MMKV::getDataForKey(MMKVKey_t key) {
-    if (mmkv_unlikely(m_enableKeyExpire)) {
-        return getDataWithoutMTimeForKey(key);
+void MMKVValueWriter::cancel() {
+    if (m_kv && !m_isBuffered) {
+        // drop whatever is written beyond m_actualSize
+        m_kv->m_output->setPosition(m_kv->m_actualSize);
+#ifndef MMKV_DISABLE_CRYPT
+        if (m_kv->m_crypter) {
+            m_kv->m_crypter->resetStatus(*m_cryptStatus);
+        }
+#endif
     }
-    return getRawDataForKey(key);
+    close();
 }
 
+void MMKVValueWriter::close() {
+    if (m_kv && !m_isBuffered) {
+        m_kv->m_exclusiveProcessLock->unlock();
+        m_kv->m_lock->unlock();
+    }
+    m_kv = nullptr;
+    m_key.clear();
+    m_expectedSize = 0;
+    m_written = 0;
+    m_isBuffered = false;
+    m_buffer = MMBuffer();
 #ifndef MMKV_DISABLE_CRYPT
-// for Apple watch simulator
-#    if defined(TARGET_OS_SIMULATOR) && defined(TARGET_CPU_X86)
-static AESCryptStatus t_status;
-#    else
-thread_local AESCryptStatus t_status;
-#    endif
-#endif // MMKV_DISABLE_CRYPT
+    m_cryptStatus.reset();
+#endif
+}
 
-bool MMKV::setDataForKey(MMBuffer &&data, MMKVKey_t key, bool isDataHolder) {
-    if ((!isDataHolder && data.length() == 0) || isKeyEmpty(key)) {
-        return false;
-    }
-    uint32_t ignoredValueLength = 0;
-    if (!encodedValueLength(data.length(), isDataHolder, ignoredValueLength)) {
-        MMKVError("[%s] reject value too large to encode: %zu", m_mmapID.c_str(), data.length());
+bool MMKV::openValueReader(MMKVKey_t key, MMKVValueReader &reader) {
+    reader.close();
+    if (isKeyEmpty(key)) {
         return false;
     }
-    SCOPED_LOCK(m_lock);
-    SCOPED_LOCK(m_exclusiveProcessLock);
+    shared_lock();
     checkLoadData();
 
 #ifndef MMKV_DISABLE_CRYPT
-    if (m_crypter) {
-        if (isDataHolder) {
-            auto sizeNeededForData = pbRawVarint32Size((uint32_t) data.length()) + data.length();
-            if (!KeyValueHolderCrypt::isValueStoredAsOffset(sizeNeededForData)) {
-                data = MiniPBCoder::encodeDataWithObject(data);
-                isDataHolder = false;
-            }
-        }
+    // an offset-stored value is decrypted chunk by chunk, the expire time at its tail needs a full decryption though
+    if (m_crypter && !m_enableKeyExpire) {
         auto itr = m_dicCrypt->find(key);
-        if (itr != m_dicCrypt->end()) {
-            bool onlyOneKey = !isMultiProcess() && m_dicCrypt->size() == 1;
-#    ifdef MMKV_APPLE
-            KVHolderRet_t ret;
-            if (onlyOneKey) {
-                ret = overrideDataWithKey(data, key, itr->second, isDataHolder);
-            } else {
-                ret = appendDataWithKey(data, key, itr->second, isDataHolder);
-            }
-#    else
-            KVHolderRet_t ret;
-            if (onlyOneKey) {
-                ret = overrideDataWithKey(data, key, isDataHolder);
-            } else {
-                ret = appendDataWithKey(data, key, isDataHolder);
-            }
-#    endif
-            if (!ret.first) {
-                return false;
-            }
-            KeyValueHolderCrypt kvHolder;
-            if (KeyValueHolderCrypt::isValueStoredAsOffset(ret.second.valueSize)) {
-                kvHolder = KeyValueHolderCrypt(ret.second.keySize, ret.second.valueSize, ret.second.offset);
-                memcpy(&kvHolder.cryptStatus, &t_status, sizeof(t_status));
-            } else {
-                kvHolder = KeyValueHolderCrypt(std::move(data));
-            }
-            if (mmkv_likely(!m_enableKeyExpire)) {
-                itr->second = std::move(kvHolder);
-            } else {
-                itr = m_dicCrypt->find(key);
-                if (itr != m_dicCrypt->end()) {
-                    itr->second = std::move(kvHolder);
-                } else {
-                    // in case filterExpiredKeys() is triggered
-                    m_dicCrypt->emplace(key, std::move(kvHolder));
-                    mmkv_retain_key(key);
-                }
-            }
-        } else {
-            bool needOverride = !isMultiProcess() && m_dicCrypt->empty() && m_actualSize > 0;
-            KVHolderRet_t ret;
-            if (needOverride) {
-                ret = overrideDataWithKey(data, key, isDataHolder);
-            } else {
-                ret = appendDataWithKey(data, key, isDataHolder);
-            }
-            if (!ret.first) {
-                return false;
-            }
-            if (KeyValueHolderCrypt::isValueStoredAsOffset(ret.second.valueSize)) {
-                auto r = m_dicCrypt->emplace(
-                    key, KeyValueHolderCrypt(ret.second.keySize, ret.second.valueSize, ret.second.offset));
-                if (r.second) {
-                    memcpy(&(r.first->second.cryptStatus), &t_status, sizeof(t_status));
-                }
-            } else {
-                m_dicCrypt->emplace(key, KeyValueHolderCrypt(std::move(data)));
+        if (itr != m_dicCrypt->end() && itr->second.type == KeyValueHolderType_Offset) {
+            auto &kvHolder = itr->second;
+            auto ptr = (const uint8_t *) m_file->getMemory() + Fixed32Size + kvHolder.offset;
+            auto decrypter = make_unique<AESCrypt>(m_crypter->cloneWithStatus(kvHolder.cryptStatus));
+            uint8_t buffer[16];
+            size_t position = kvHolder.pbKeyValueSize + kvHolder.keySize;
+            for (size_t index = 0; index < position; index += sizeof(buffer)) {
+                decrypter->decrypt(ptr + index, buffer, std::min(sizeof(buffer), position - index));
             }
-            mmkv_retain_key(key);
-        }
-    } else
-#endif // MMKV_DISABLE_CRYPT
-    {
-        auto itr = m_dic->find(key);
-        if (itr != m_dic->end()) {
-            // compare data before appending to file
-            if (isCompareBeforeSetEnabled()) {
-                auto basePtr = (uint8_t *) (m_file->getMemory()) + Fixed32Size;
-                MMBuffer oldValueData = itr->second.toMMBuffer(basePtr);
-                if (isDataHolder) {
-                    CodedInputData inputData(oldValueData.getPtr(), oldValueData.length());
-                    try {
-                        // read extra holder header bytes and to real MMBuffer
-                        oldValueData = CodedInputData::readRealData(oldValueData);
-                        if (oldValueData == data) {
-                            // MMKVInfo("[key] %s, set the same data", key.c_str());
-                            return true;
-                        }
-                    } catch (std::exception &exception) {
-                        MMKVWarning("compareBeforeSet exception: %s", exception.what());
-                    } catch (...) {
-                        MMKVWarning("compareBeforeSet fail");
-                    }
-                } else {
-                    if (oldValueData == data) {
-                        //  MMKVInfo("[key] %s, set the same data", key.c_str());
+            // the length of the data holder, one byte at a time
+            uint32_t length = 0;
+            size_t end = position + kvHolder.valueSize;
+            for (uint32_t shift = 0; position < end && shift < 35; shift += 7) {
+                uint8_t byte = 0;
+                decrypter->decrypt(ptr + position, &byte, 1);
+                position++;
+                length |= static_cast<uint32_t>(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0) {
+                    if (length == end - position) {
+                        reader.m_kv = this;
+                        reader.m_ptr = ptr + position;
+                        reader.m_size = length;
+                        reader.m_decrypter = std::move(decrypter);
                         return true;
                     }
+                    break;
                 }
             }
+            MMKVError("[%s] decode fail", m_mmapID.c_str());
+            shared_unlock();
+            return false;
+        }
+    }
+#endif
 
-            bool onlyOneKey = !isMultiProcess() && m_dic->size() == 1;
-            if (mmkv_likely(!m_enableKeyExpire)) {
-                KVHolderRet_t ret;
-                if (onlyOneKey) {
-                    ret = overrideDataWithKey(data, itr->second, isDataHolder);
-                } else {
-                    ret = appendDataWithKey(data, itr->second, isDataHolder);
-                }
-                if (!ret.first) {
-                    return false;
-                }
-                itr->second = std::move(ret.second);
-            } else {
-                KVHolderRet_t ret;
-                if (onlyOneKey) {
-                    ret = overrideDataWithKey(data, key, isDataHolder);
-                } else {
-                    ret = appendDataWithKey(data, key, isDataHolder);
-                }
-                if (!ret.first) {
-                    return false;
-                }
-                itr = m_dic->find(key);
-                if (itr != m_dic->end()) {
-                    itr->second = std::move(ret.second);
-                } else {
-                    // in case filterExpiredKeys() is triggered
-                    m_dic->emplace(key, std::move(ret.second));
-                    mmkv_retain_key(key);
-                }
-            }
-        } else {
-            bool needOverride = !isMultiProcess() && m_dic->empty() && m_actualSize > 0;
-            KVHolderRet_t ret;
-            if (needOverride) {
-                ret = overrideDataWithKey(data, key, isDataHolder);
-            } else {
-                ret = appendDataWithKey(data, key, isDataHolder);
-            }
-            if (!ret.first) {
-                return false;
-            }
-            m_dic->emplace(key, std::move(ret.second));
-            mmkv_retain_key(key);
+    auto data = getDataForKey(key);
+    MMBuffer value;
+    CodedInputData input(data.getPtr(), data.length());
+    if (data.length() == 0 || !input.tryReadData(value, false)) {
+        if (data.length() > 0) {
+            MMKVError("[%s] decode fail", m_mmapID.c_str());
         }
+        shared_unlock();
+        return false;
+    }
+    reader.m_size = value.length();
+    if (!m_crypter) {
+        reader.m_kv = this;
+        reader.m_ptr = (const uint8_t *) value.getPtr();
+    } else {
+        // it's decrypted into memory already
+        reader.m_buffer = MMBuffer(value.getPtr(), value.length());
+        reader.m_ptr = (const uint8_t *) reader.m_buffer.getPtr();
+        shared_unlock();
     }
-    m_hasFullWriteback = false;
     return true;
 }
 
+MMKVValueReader::MMKVValueReader() = default;
+
+MMKVValueReader::~MMKVValueReader() {
+    close();
+}
+
+size_t MMKVValueReader::read(void *ptr, size_t size) {
+    auto length = std::min(size, m_size - m_position);
+    if (length == 0) {
+        return 0;
+    }
+#ifndef MMKV_DISABLE_CRYPT
+    if (m_decrypter) {
+        m_decrypter->decrypt(m_ptr + m_position, ptr, length);
+    } else
+#endif
+    {
+        memcpy(ptr, m_ptr + m_position, length);
+    }
+    m_position += length;
+    return length;
+}
+
+void MMKVValueReader::close() {
+    if (m_kv) {
+        m_kv->shared_unlock();
+        m_kv = nullptr;
+    }
+    m_ptr = nullptr;
+    m_size = 0;
+    m_position = 0;
+    m_buffer = MMBuffer();
+#ifndef MMKV_DISABLE_CRYPT
+    m_decrypter.reset();
+#endif
+}
+
+#endif // !MMKV_APPLE
+
 template <typename T>
 static void eraseHelper(T& container, std::string_view key) {
     auto itr = container.find(key);
@@ -891,6 +2910,22 @@ bool MMKV::removeDataForKey(MMKVKey_t key) {
     if (isKeyEmpty(key)) {
         return false;
     }
+#ifndef MMKV_APPLE
+    OrderedKeysUpdate orderedKeysUpdate(this, key);
+    if (mmkv_unlikely(m_sharedIndex)) {
+        KeyValueHolder kvHolder;
+        if (!findInSharedIndex(key, kvHolder)) {
+            return false;
+        }
+        m_hasFullWriteback = false;
+        static MMBuffer nan;
+        auto ret = appendDataWithKey(nan, key);
+        if (ret.first) {
+            eraseSharedIndex(key);
+        }
+        return ret.first;
+    }
+#endif
 #ifndef MMKV_DISABLE_CRYPT
     if (m_crypter) {
         auto itr = m_dicCrypt->find(key);
@@ -908,6 +2943,7 @@ bool MMKV::removeDataForKey(MMKVKey_t key) {
                     }
                 }
                 auto oldKey = itr->first;
+                m_cryptMemoryUsage -= itr->second.memoryUsage();
                 m_dicCrypt->erase(itr);
                 [oldKey release];
             }
@@ -915,10 +2951,14 @@ bool MMKV::removeDataForKey(MMKVKey_t key) {
             auto ret = appendDataWithKey(nan, key);
             if (ret.first) {
                 if (mmkv_unlikely(m_enableKeyExpire)) {
-                    eraseHelper(*m_dicCrypt, key);
-                } else {
+                    // filterExpiredKeys() may invalid itr
+                    itr = m_dicCrypt->find(key);
+                }
+                if (itr != m_dicCrypt->end()) {
+                    m_cryptMemoryUsage -= itr->second.memoryUsage();
                     m_dicCrypt->erase(itr);
                 }
+                invalidateKeyHandles();
             }
 #    endif
             return ret.first;
@@ -950,6 +2990,7 @@ bool MMKV::removeDataForKey(MMKVKey_t key) {
                 } else {
                     m_dic->erase(itr);
                 }
+                invalidateKeyHandles();
 #endif
             }
             return ret.first;
@@ -961,12 +3002,24 @@ bool MMKV::removeDataForKey(MMKVKey_t key) {
 
 KVHolderRet_t
 MMKV::doAppendDataWithKey(const MMBuffer &data, const MMBuffer &keyData, bool isDataHolder, uint32_t originKeyLength) {
-    EncodedEntrySize entry;
-    if (!encodedEntrySize(keyData.length(), originKeyLength, data.length(), isDataHolder, entry)) {
+    uint32_t valueLength = 0;
+    if (!encodedValueLength(data.length(), isDataHolder, valueLength)) {
         MMKVError("[%s] reject unrepresentable key/value lengths, keyData=%zu, key=%u, value=%zu",
                   m_mmapID.c_str(), keyData.length(), originKeyLength, data.length());
         return make_pair(false, KeyValueHolder());
     }
+    auto writer = isDataHolder ? writeDataHolderValue : writeRawValue;
+    return doAppendValueWithKey(&data, valueLength, writer, keyData, originKeyLength);
+}
+
+KVHolderRet_t MMKV::doAppendValueWithKey(
+    const void *value, size_t valueSize, ValueWriter_t writer, const MMBuffer &keyData, uint32_t originKeyLength) {
+    EncodedEntrySize entry;
+    if (!encodedEntrySize(keyData.length(), originKeyLength, valueSize, false, entry)) {
+        MMKVError("[%s] reject unrepresentable key/value lengths, keyData=%zu, key=%u, value=%zu",
+                  m_mmapID.c_str(), keyData.length(), originKeyLength, valueSize);
+        return make_pair(false, KeyValueHolder());
+    }
     auto isKeyEncoded = entry.keyAlreadyEncoded;
     auto valueLength = entry.valueLength;
     auto size = entry.totalSize;
@@ -983,7 +3036,7 @@ MMKV::doAppendDataWithKey(const MMBuffer &data, const MMBuffer &keyData, bool is
 
 #ifndef MMKV_DISABLE_CRYPT
     if (m_crypter) {
-        if (KeyValueHolderCrypt::isValueStoredAsOffset(valueLength)) {
+        if (isCryptValueStoredAsOffset(valueLength)) {
             m_crypter->getCurStatus(t_status);
         }
     }
@@ -994,10 +3047,8 @@ MMKV::doAppendDataWithKey(const MMBuffer &data, const MMBuffer &keyData, bool is
         } else {
             m_output->writeData(keyData);
         }
-        if (isDataHolder) {
-            m_output->writeRawVarint32((int32_t) valueLength);
-        }
-        m_output->writeData(data); // note: write size of data
+        m_output->writeRawVarint32((int32_t) valueLength);
+        writer(*m_output, value);
     } catch (std::exception &e) {
         MMKVError("%s", e.what());
         return make_pair(false, KeyValueHolder());
@@ -1006,6 +3057,12 @@ MMKV::doAppendDataWithKey(const MMBuffer &data, const MMBuffer &keyData, bool is
         return make_pair(false, KeyValueHolder());
     }
 
+    if (mmkv_unlikely(m_segmentSize)) {
+        auto ptr = m_output->curWritePointer() - size;
+        auto offset = static_cast<uint32_t>(ptr - ((uint8_t *) m_file->getMemory() + Fixed32Size));
+        commitSegmentAppend(ptr, size);
+        return make_pair(true, KeyValueHolder(originKeyLength, valueLength, offset));
+    }
     auto offset = static_cast<uint32_t>(m_actualSize);
     auto ptr = (uint8_t *) m_file->getMemory() + Fixed32Size + m_actualSize;
 #ifndef MMKV_DISABLE_CRYPT
@@ -1059,7 +3116,7 @@ KVHolderRet_t MMKV::doOverrideDataWithKey(const MMBuffer &data,
         if (m_crypter) {
             auto ptr = (uint8_t *) m_file->getMemory() + Fixed32Size;
             m_crypter->encrypt(ptr, ptr, m_actualSize);
-            if (KeyValueHolderCrypt::isValueStoredAsOffset(valueLength)) {
+            if (isCryptValueStoredAsOffset(valueLength)) {
                 m_crypter->getCurStatus(t_status);
             }
         }
@@ -1099,6 +3156,10 @@ bool MMKV::checkSizeForOverride(size_t size) {
         MMKVWarning("[%s] file not valid", m_mmapID.c_str());
         return false;
     }
+    // a segmented log always appends
+    if (m_segmentSize) {
+        return false;
+    }
 
     // only override if the file can hole it without ftruncate()
     auto fileSize = m_file->getFileSize();
@@ -1207,6 +3268,15 @@ bool MMKV::fullWriteback(AESCrypt *newCrypter, bool onlyWhileExpire) {
             return true;
         }
     }
+#ifndef MMKV_APPLE
+    if (mmkv_unlikely(m_sharedIndex)) {
+        SCOPED_LOCK(m_exclusiveProcessLock);
+        loadDictionaryFromSharedIndex();
+        auto ret = fullWriteback(newCrypter, onlyWhileExpire);
+        saveDictionaryToSharedIndex();
+        return ret;
+    }
+#endif
 
     auto isEmpty = m_crypter ? m_dicCrypt->empty() : m_dic->empty();
     if (isEmpty) {
@@ -1215,6 +3285,9 @@ bool MMKV::fullWriteback(AESCrypt *newCrypter, bool onlyWhileExpire) {
     }
 
     SCOPED_LOCK(m_exclusiveProcessLock);
+    if (m_segmentSize) {
+        return compactAllSegments();
+    }
     auto preparedData = m_crypter ? prepareEncode(*m_dicCrypt) : prepareEncode(*m_dic);
     auto sizeOfDic = preparedData.second;
     if (sizeOfDic > 0) {
@@ -1396,6 +3469,9 @@ static void fullWriteBackWholeData(MMBuffer allData, size_t totalSize, CodedOutp
 
 #ifndef MMKV_DISABLE_CRYPT
 bool MMKV::doFullWriteBack(pair<MMBuffer, size_t> prepared, AESCrypt *newCrypter, bool needSync) {
+    if (refuseForPinnedViews("full writeback")) {
+        return false;
+    }
     auto ptr = (uint8_t *) m_file->getMemory();
     auto totalSize = prepared.second;
 
@@ -1408,6 +3484,12 @@ bool MMKV::doFullWriteBack(pair<MMBuffer, size_t> prepared, AESCrypt *newCrypter
         encrypter->resetIV(newIV, sizeof(newIV));
     }
 
+    // let other processes move their index along if all we do is moving the items together
+    bool isCompaction = false;
+    auto fromSequence = m_metaInfo->m_sequence;
+    auto fromActualSize = static_cast<uint32_t>(m_actualSize);
+    auto fromCRCDigest = m_crcDigest;
+    willRewriteInPlace();
     delete m_output;
     m_output = new CodedOutputData(ptr + Fixed32Size, m_file->getFileSize() - Fixed32Size);
     if (m_crypter) {
@@ -1421,6 +3503,7 @@ bool MMKV::doFullWriteBack(pair<MMBuffer, size_t> prepared, AESCrypt *newCrypter
         }
     } else {
         memmoveDictionary(*m_dic, m_output, ptr, encrypter, totalSize);
+        isCompaction = !encrypter;
     }
 
     m_actualSize = totalSize;
@@ -1429,6 +3512,9 @@ bool MMKV::doFullWriteBack(pair<MMBuffer, size_t> prepared, AESCrypt *newCrypter
     } else {
         recalculateCRCDigestWithIV(nullptr);
     }
+    if (isCompaction) {
+        writeCompactionInfo(fromSequence, fromActualSize, fromCRCDigest);
+    }
     m_hasFullWriteback = true;
     // make sure lastConfirmedMetaInfo is saved if needed
     if (needSync) {
@@ -1440,9 +3526,18 @@ bool MMKV::doFullWriteBack(pair<MMBuffer, size_t> prepared, AESCrypt *newCrypter
 #else // MMKV_DISABLE_CRYPT
 
 bool MMKV::doFullWriteBack(pair<MMBuffer, size_t> prepared, AESCrypt *, bool needSync) {
+    if (refuseForPinnedViews("full writeback")) {
+        return false;
+    }
     auto ptr = (uint8_t *) m_file->getMemory();
     auto totalSize = prepared.second;
 
+    // let other processes move their index along if all we do is moving the items together
+    bool isCompaction = false;
+    auto fromSequence = m_metaInfo->m_sequence;
+    auto fromActualSize = static_cast<uint32_t>(m_actualSize);
+    auto fromCRCDigest = m_crcDigest;
+    willRewriteInPlace();
     delete m_output;
     m_output = new CodedOutputData(ptr + Fixed32Size, m_file->getFileSize() - Fixed32Size);
     if (prepared.first.length() != 0) {
@@ -1451,10 +3546,14 @@ bool MMKV::doFullWriteBack(pair<MMBuffer, size_t> prepared, AESCrypt *, bool nee
     } else {
         constexpr AESCrypt *encrypter = nullptr;
         memmoveDictionary(*m_dic, m_output, ptr, encrypter, totalSize);
+        isCompaction = true;
     }
 
     m_actualSize = totalSize;
     recalculateCRCDigestWithIV(nullptr);
+    if (isCompaction) {
+        writeCompactionInfo(fromSequence, fromActualSize, fromCRCDigest);
+    }
     m_hasFullWriteback = true;
     // make sure lastConfirmedMetaInfo is saved if needed
     if (needSync) {
@@ -1477,6 +3576,14 @@ bool MMKV::reKey(const string &cryptKey, bool aes256) {
         MMKVWarning("[%s] file not valid", m_mmapID.c_str());
         return false;
     }
+    if (m_segmentSize && !cryptKey.empty()) {
+        MMKVError("[%s] segmented log doesn't support encryption", m_mmapID.c_str());
+        return false;
+    }
+    if (m_enableSharedIndex && !cryptKey.empty()) {
+        MMKVError("[%s] shared index doesn't support encryption", m_mmapID.c_str());
+        return false;
+    }
 
     bool ret = false;
     if (m_crypter) {
@@ -1507,7 +3614,7 @@ bool MMKV::reKey(const string &cryptKey, bool aes256) {
                 delete m_crypter;
                 m_crypter = nullptr;
                 if (!m_dic) {
-                    m_dic = new MMKVMap();
+                    m_dic = newDictionary<MMKVMap>(m_allocator);
                 }
             }
         }
@@ -1521,7 +3628,7 @@ bool MMKV::reKey(const string &cryptKey, bool aes256) {
             if (ret) {
                 m_crypter = newCrypt;
                 if (!m_dicCrypt) {
-                    m_dicCrypt = new MMKVMapCrypt();
+                    m_dicCrypt = newDictionary<MMKVMapCrypt>(m_allocator);
                 }
             } else {
                 delete newCrypt;
@@ -1551,17 +3658,37 @@ void MMKV::trim() {
         MMKVWarning("[%s] file not valid", m_mmapID.c_str());
         return;
     }
+    if (refuseForPinnedViews("trim")) {
+        return;
+    }
 
     if (m_actualSize == 0) {
         clearAll();
         return;
-    } else if (m_file->getFileSize() <= m_expectedCapacity) {
+    }
+    if (openBlobFileIfNeeded(false)) {
+        auto header = (const BlobFileHeader *) m_blobFile->getMemory();
+        auto liveSize = liveBlobSize(*m_dic, (uint8_t *) m_file->getMemory() + Fixed32Size, header->fileID);
+        if (sizeof(BlobFileHeader) + liveSize < header->usedSize) {
+            collectBlobGarbage(0);
+        }
+    }
+    if (m_segmentSize) {
+        trimSegments();
+        return;
+    }
+    if (m_file->getFileSize() <= m_expectedCapacity) {
         return;
     }
 
     if (!fullWriteback()) {
         return;
     }
+    if (m_optimisticRead) {
+        // other processes might be reading without the lock, past the new end of the file
+        MMKVInfo("[%s] keeps its file size %zu for optimistic read", m_mmapID.c_str(), m_file->getFileSize());
+        return;
+    }
     auto oldSize = m_file->getFileSize();
     auto fileSize = oldSize;
     while (fileSize > (m_actualSize + Fixed32Size) * 2) {
@@ -1600,6 +3727,9 @@ void MMKV::clearAll(bool keepSpace) {
         MMKVWarning("[%s] file not valid", m_mmapID.c_str());
         return;
     }
+    if (refuseForPinnedViews("clearAll")) {
+        return;
+    }
 
     if (m_file->getFileSize() == m_expectedCapacity && m_actualSize == 0) {
         MMKVInfo("nothing to clear for [%s]", m_mmapID.c_str());
@@ -1615,9 +3745,15 @@ void MMKV::clearAll(bool keepSpace) {
     }
 #endif
 
+    // other processes might be reading without the lock, past the new end of the file
+    keepSpace = keepSpace || m_optimisticRead;
+    willRewriteInPlace();
     if (!keepSpace) {
         m_file->truncate(m_expectedCapacity);
     }
+    if (m_segmentSize && !formatSegments(0)) {
+        return;
+    }
 
 #ifndef MMKV_DISABLE_CRYPT
     if (m_crypter) {
@@ -1629,6 +3765,7 @@ void MMKV::clearAll(bool keepSpace) {
 #endif
 
     m_metaFile->msync(MMKV_SYNC);
+    resetBlobFile();
 
     clearMemoryCache(keepSpace);
     loadFromFile();
@@ -1777,14 +3914,21 @@ bool MMKV::removeStorage(const std::string &mmapID, const MMKVPath_t *relatePath
     }
     MMKVInfo("remove storage [%s]", realID.c_str());
 
+    auto deleteBlobFile = [&kvPath = kvPath] {
+        if (isFileExist(kvPath + BLOB_SUFFIX)) {
+            deleteFile(kvPath + BLOB_SUFFIX);
+        }
+    };
     if (crcPath.empty()) {
         deleteFile(kvPath);
+        deleteBlobFile();
         return true;
     }
 
     File crcFile(crcPath, OpenFlag::ReadOnly);
     if (!crcFile.isFileValid()) {
         deleteFile(kvPath);
+        deleteBlobFile();
         return true;
     }
     FileLock fileLock(crcFile.getFd());
@@ -1799,6 +3943,10 @@ bool MMKV::removeStorage(const std::string &mmapID, const MMKVPath_t *relatePath
 
     deleteFile(kvPath);
     deleteFile(crcPath);
+    deleteBlobFile();
+    if (isFileExist(kvPath + INDEX_SUFFIX)) {
+        deleteFile(kvPath + INDEX_SUFFIX);
+    }
 
     return true;
 }
@@ -1830,6 +3978,9 @@ uint32_t MMKV::safeExpirationPlusCurrentTime(uint32_t expireDuration) {
 }
 
 bool MMKV::doFullWriteBack(MMKVVector &&vec) {
+    if (refuseForPinnedViews("full writeback")) {
+        return false;
+    }
     auto preparedData = prepareEncode(std::move(vec));
 
     // must clean before write-back and after prepareEncode()
@@ -1838,6 +3989,7 @@ bool MMKV::doFullWriteBack(MMKVVector &&vec) {
     } else {
         clearDictionary(m_dic);
     }
+    invalidateKeyHandles();
 
     bool ret = false;
     auto sizeOfDic = preparedData.second;
@@ -1899,6 +4051,14 @@ bool MMKV::enableAutoKeyExpire(uint32_t expiredInSeconds) {
         MMKVWarning("[%s] file not valid", m_mmapID.c_str());
         return false;
     }
+    if (m_segmentSize) {
+        MMKVError("[%s] segmented log doesn't support key expiration", m_mmapID.c_str());
+        return false;
+    }
+    if (m_enableSharedIndex) {
+        MMKVError("[%s] shared index doesn't support key expiration", m_mmapID.c_str());
+        return false;
+    }
 
     if (m_enableCompareBeforeSet) {
         MMKVError("enableCompareBeforeSet will be invalid when Expiration is on");
@@ -2125,7 +4285,9 @@ size_t MMKV::filterExpiredKeys() {
             memcpy(&time, ptr, sizeof(time));
             if (time != ExpireNever && time <= now) {
                 auto oldKey = itr->first;
+                m_cryptMemoryUsage -= kvHolder.memoryUsage();
                 itr = m_dicCrypt->erase(itr);
+                invalidateKeyHandles();
 #    ifdef MMKV_APPLE
                 MMKVInfo("deleting expired key [%@], due date %u", oldKey, time);
                 [oldKey release];
@@ -2159,6 +4321,7 @@ size_t MMKV::filterExpiredKeys() {
             if (time != ExpireNever && time <= now) {
                 auto oldKey = itr->first;
                 itr = m_dic->erase(itr);
+                invalidateKeyHandles();
 #ifdef MMKV_APPLE
                 MMKVInfo("deleting expired key [%@], due date %u", oldKey, time);
                 [oldKey release];
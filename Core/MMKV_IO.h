@@ -23,6 +23,7 @@
 #ifdef __cplusplus
 
 #include "MMKV.h"
+#include "CodedOutputData.h"
 
 MMKV_NAMESPACE_BEGIN
 
@@ -35,16 +36,37 @@ MMKVPath_t mappedKVPathWithID(const std::string &mmapID, const MMKVPath_t *rootP
 #endif
 MMKVPath_t crcPathWithPath(const MMKVPath_t &kvPath);
 
+#ifdef MMKV_LINUX
+// wake up every process waiting for a change of the meta file
+void wakeChangeListeners(void *metaMemory);
+#endif
+
 MMKVRecoverStrategic onMMKVCRCCheckFail(const std::string &mmapID);
 MMKVRecoverStrategic onMMKVFileLengthError(const std::string &mmapID);
 
 #ifndef MMKV_WIN32
 constexpr auto SPECIAL_CHARACTER_DIRECTORY_NAME = "specialCharacter";
 constexpr auto CRC_SUFFIX = ".crc";
+constexpr auto BLOB_SUFFIX = ".blob";
+constexpr auto BLOB_TMP_SUFFIX = ".blob.tmp";
+constexpr auto INDEX_SUFFIX = ".idx";
 #else
 constexpr auto SPECIAL_CHARACTER_DIRECTORY_NAME = L"specialCharacter";
 constexpr auto CRC_SUFFIX = L".crc";
+constexpr auto BLOB_SUFFIX = L".blob";
+constexpr auto BLOB_TMP_SUFFIX = L".blob.tmp";
+constexpr auto INDEX_SUFFIX = L".idx";
+#endif
+
+template <typename T>
+T *newDictionary(mmkv::MMKVAllocator *allocator) {
+#ifdef MMKV_HAS_ARENA
+    return new T(new mmkv::MMKVArena(allocator));
+#else
+    (void) allocator;
+    return new T();
 #endif
+}
 
 template <typename T>
 void clearDictionary(T *dic) {
@@ -55,10 +77,43 @@ void clearDictionary(T *dic) {
     for (auto &pair : *dic) {
         [pair.first release];
     }
+#endif
+#ifdef MMKV_HAS_ARENA
+    if (auto arena = mmkv::arenaOfDictionary(*dic)) {
+        // plain holders own nothing outside the arena, so the entries are dropped without visiting them,
+        // while an encrypted one might hold a value on the heap
+        if constexpr (!std::is_trivially_destructible_v<typename T::mapped_type>) {
+            dic->~T();
+        }
+        arena->release();
+        new (dic) T(arena);
+        return;
+    }
 #endif
     dic->clear();
 }
 
+template <typename T>
+void deleteDictionary(T *dic) {
+#ifdef MMKV_HAS_ARENA
+    auto arena = dic ? mmkv::arenaOfDictionary(*dic) : nullptr;
+    clearDictionary(dic);
+    delete dic;
+    delete arena;
+#else
+    delete dic;
+#endif
+}
+
+// value payload of a data holder: varint length + raw bytes
+inline void writeDataHolderValue(mmkv::CodedOutputData &output, const void *value) {
+    output.writeData(*(const mmkv::MMBuffer *) value);
+}
+
+inline void writeRawValue(mmkv::CodedOutputData &output, const void *value) {
+    output.writeRawData(*(const mmkv::MMBuffer *) value);
+}
+
 enum : bool {
     KeepSequence = false,
     IncreaseSequence = true,
@@ -25,6 +25,8 @@
 #include "PBEncodeItem.hpp"
 #include "PBUtility.h"
 #include "MMKVLog.h"
+#include <limits>
+#include <stdexcept>
 
 #ifdef MMKV_APPLE
 #    if __has_feature(objc_arc)
@@ -36,8 +38,7 @@ using namespace std;
 
 namespace mmkv {
 
-MiniPBCoder::MiniPBCoder() : m_encodeItems(new std::vector<PBEncodeItem>()) {
-}
+MiniPBCoder::MiniPBCoder() = default;
 
 MiniPBCoder::MiniPBCoder(const MMBuffer *inputBuffer, AESCrypt *crypter) : MiniPBCoder() {
     m_inputBuffer = inputBuffer;
@@ -64,6 +65,12 @@ MiniPBCoder::~MiniPBCoder() {
 
 // encode
 
+void MiniPBCoder::ensureEncodeItems() {
+    if (!m_encodeItems) {
+        m_encodeItems = new std::vector<PBEncodeItem, HeapAllocator<PBEncodeItem>>();
+    }
+}
+
 // write object using prepared m_encodeItems[]
 void MiniPBCoder::writeRootObject() {
     for (size_t index = 0, total = m_encodeItems->size(); index < total; index++) {
@@ -77,24 +84,6 @@ void MiniPBCoder::writeRootObject() {
                 m_outputData->writeUInt32(encodeItem->valueSize);
                 break;
             }
-#ifdef MMKV_HAS_CPP20
-            case PBEncodeItemType_Int32: {
-                m_outputData->writeInt32(encodeItem->value.int32Value);
-                break;
-            }
-            case PBEncodeItemType_UInt32: {
-                m_outputData->writeUInt32(encodeItem->value.uint32Value);
-                break;
-            }
-            case PBEncodeItemType_Int64: {
-                m_outputData->writeInt64(encodeItem->value.int64Value);
-                break;
-            }
-            case PBEncodeItemType_UInt64: {
-                m_outputData->writeUInt64(encodeItem->value.uint64Value);
-                break;
-            }
-#endif // MMKV_HAS_CPP20
             case PBEncodeItemType_String: {
                 m_outputData->writeString(*(encodeItem->value.strValue));
                 break;
@@ -235,286 +224,332 @@ size_t MiniPBCoder::prepareObjectForEncode(const string &str) {
     return index;
 }
 
-size_t MiniPBCoder::prepareObjectForEncode(const MMKV_STRING_CONTAINER &v) {
-    m_encodeItems->push_back(PBEncodeItem());
-    PBEncodeItem *encodeItem = &(m_encodeItems->back());
-    size_t index = m_encodeItems->size() - 1;
-    {
-        encodeItem->type = PBEncodeItemType_Container;
-        encodeItem->value.bufferValue = nullptr;
+// allocation-free encoding of containers
 
-        for (const auto &str : v) {
-            size_t itemIndex = prepareObjectForEncode(str);
-            if (itemIndex < m_encodeItems->size()) {
-                (*m_encodeItems)[index].valueSize += (*m_encodeItems)[itemIndex].compiledSize;
-            }
+struct StringItemCoder {
+    static uint64_t size(const string &str) { return pbRawVarint32Size(static_cast<uint32_t>(str.size())) + str.size(); }
+    static void write(CodedOutputData &output, const string &str) { output.writeString(str); }
+};
+
+#ifndef MMKV_APPLE
+struct KeyValueItemCoder {
+    static uint64_t size(const pair<string, MMBuffer> &kv) {
+        if (kv.first.empty()) {
+            return 0;
+        }
+        auto valueSize = static_cast<uint32_t>(kv.second.length());
+        return StringItemCoder::size(kv.first) + pbRawVarint32Size(valueSize) + valueSize;
+    }
+    static void write(CodedOutputData &output, const pair<string, MMBuffer> &kv) {
+        if (!kv.first.empty()) {
+            output.writeString(kv.first);
+            output.writeData(kv.second);
         }
+    }
+};
+#endif
 
-        encodeItem = &(*m_encodeItems)[index];
+#ifdef MMKV_HAS_CPP20
+struct Int32ItemCoder {
+    static uint64_t size(int32_t value) { return pbInt32Size(value); }
+    static void write(CodedOutputData &output, int32_t value) { output.writeInt32(value); }
+};
+
+struct UInt32ItemCoder {
+    static uint64_t size(uint32_t value) { return pbUInt32Size(value); }
+    static void write(CodedOutputData &output, uint32_t value) { output.writeUInt32(value); }
+};
+
+struct Int64ItemCoder {
+    static uint64_t size(int64_t value) { return pbInt64Size(value); }
+    static void write(CodedOutputData &output, int64_t value) { output.writeInt64(value); }
+};
+
+struct UInt64ItemCoder {
+    static uint64_t size(uint64_t value) { return pbUInt64Size(value); }
+    static void write(CodedOutputData &output, uint64_t value) { output.writeUInt64(value); }
+};
+#endif // MMKV_HAS_CPP20
+
+// the size of all items, excluding the container's own length prefix
+template <typename Coder, typename T>
+static bool containerValueSize(const T &container, uint32_t &result) {
+    uint64_t valueSize = 0;
+    for (const auto &item : container) {
+        valueSize += Coder::size(item);
     }
-    encodeItem->compiledSize = pbRawVarint32Size(encodeItem->valueSize) + encodeItem->valueSize;
+    if (valueSize > numeric_limits<uint32_t>::max()) {
+        MMKVError("container too large to encode: %llu", (unsigned long long) valueSize);
+        return false;
+    }
+    result = static_cast<uint32_t>(valueSize);
+    return true;
+}
 
-    return index;
+template <typename Coder, typename T>
+static void writeContainer(const T &container, uint32_t valueSize, CodedOutputData &output) {
+    output.writeUInt32(valueSize);
+    for (const auto &item : container) {
+        Coder::write(output, item);
+    }
 }
 
-#ifdef MMKV_HAS_CPP20
+template <typename Coder, typename T>
+static size_t encodedSizeOfContainer(const T &container) {
+    uint32_t valueSize = 0;
+    if (!containerValueSize<Coder>(container, valueSize)) {
+        return 0;
+    }
+    return pbRawVarint32Size(valueSize) + static_cast<size_t>(valueSize);
+}
 
-size_t MiniPBCoder::prepareObjectForEncode(const std::span<const int32_t> &vec) {
-    m_encodeItems->push_back(PBEncodeItem());
-    PBEncodeItem *encodeItem = &(m_encodeItems->back());
-    size_t index = m_encodeItems->size() - 1;
-    {
-        encodeItem->type = PBEncodeItemType_Container;
-        encodeItem->value.bufferValue = nullptr;
+template <typename Coder, typename T>
+static bool encodeContainerToOutput(const T &container, CodedOutputData &output) {
+    uint32_t valueSize = 0;
+    if (!containerValueSize<Coder>(container, valueSize)) {
+        return false;
+    }
+    try {
+        writeContainer<Coder>(container, valueSize, output);
+        return true;
+    } catch (const std::exception &exception) {
+        MMKVError("%s", exception.what());
+    } catch (...) {
+        MMKVError("encode fail");
+    }
+    return false;
+}
 
-        for (const auto value : vec) {
-            PBEncodeItem item;
-            item.type = PBEncodeItemType_Int32;
-            item.value.int32Value = value;
-            item.compiledSize = pbInt32Size(value);
+// one exact-size MMBuffer, no PBEncodeItem nor CodedOutputData on the heap
+template <typename Coder, typename T>
+static MMBuffer encodeContainer(const T &container) {
+    uint32_t valueSize = 0;
+    if (!containerValueSize<Coder>(container, valueSize)) {
+        return MMBuffer();
+    }
+    try {
+        MMBuffer result(pbRawVarint32Size(valueSize) + static_cast<size_t>(valueSize));
+        CodedOutputData output(result.getPtr(), result.length());
+        writeContainer<Coder>(container, valueSize, output);
+        return result;
+    } catch (const std::exception &exception) {
+        MMKVError("%s", exception.what());
+    } catch (...) {
+        MMKVError("encode fail");
+    }
+    return MMBuffer();
+}
 
-            (*m_encodeItems)[index].valueSize += item.compiledSize;
-            m_encodeItems->push_back(std::move(item));
-        }
+MMBuffer MiniPBCoder::getEncodeData(const MMKV_STRING_CONTAINER &obj) {
+    return encodeContainer<StringItemCoder>(obj);
+}
 
-        encodeItem = &(*m_encodeItems)[index];
-    }
-    encodeItem->compiledSize = pbRawVarint32Size(encodeItem->valueSize) + encodeItem->valueSize;
+size_t MiniPBCoder::encodedSizeOfObject(const MMKV_STRING_CONTAINER &obj) {
+    return encodedSizeOfContainer<StringItemCoder>(obj);
+}
 
-    return index;
+bool MiniPBCoder::encodeObjectToOutput(const MMKV_STRING_CONTAINER &obj, CodedOutputData &output) {
+    return encodeContainerToOutput<StringItemCoder>(obj, output);
 }
 
-size_t MiniPBCoder::prepareObjectForEncode(const std::span<const uint32_t> &vec) {
-    m_encodeItems->push_back(PBEncodeItem());
-    PBEncodeItem *encodeItem = &(m_encodeItems->back());
-    size_t index = m_encodeItems->size() - 1;
-    {
-        encodeItem->type = PBEncodeItemType_Container;
-        encodeItem->value.bufferValue = nullptr;
+#ifndef MMKV_APPLE
+MMBuffer MiniPBCoder::getEncodeData(const MMKVVector &obj) {
+    return encodeContainer<KeyValueItemCoder>(obj);
+}
 
-        for (const auto value : vec) {
-            PBEncodeItem item;
-            item.type = PBEncodeItemType_UInt32;
-            item.value.uint32Value = value;
-            item.compiledSize = pbUInt32Size(value);
+size_t MiniPBCoder::encodedSizeOfObject(const MMKVVector &obj) {
+    return encodedSizeOfContainer<KeyValueItemCoder>(obj);
+}
 
-            (*m_encodeItems)[index].valueSize += item.compiledSize;
-            m_encodeItems->push_back(std::move(item));
-        }
+bool MiniPBCoder::encodeObjectToOutput(const MMKVVector &obj, CodedOutputData &output) {
+    return encodeContainerToOutput<KeyValueItemCoder>(obj, output);
+}
+#endif // MMKV_APPLE
 
-        encodeItem = &(*m_encodeItems)[index];
-    }
-    encodeItem->compiledSize = pbRawVarint32Size(encodeItem->valueSize) + encodeItem->valueSize;
+#ifdef MMKV_HAS_CPP20
+MMBuffer MiniPBCoder::getEncodeData(const std::span<const int32_t> &obj) {
+    return encodeContainer<Int32ItemCoder>(obj);
+}
 
-    return index;
+size_t MiniPBCoder::encodedSizeOfObject(const std::span<const int32_t> &obj) {
+    return encodedSizeOfContainer<Int32ItemCoder>(obj);
 }
 
-size_t MiniPBCoder::prepareObjectForEncode(const std::span<const int64_t> &vec) {
-    m_encodeItems->push_back(PBEncodeItem());
-    PBEncodeItem *encodeItem = &(m_encodeItems->back());
-    size_t index = m_encodeItems->size() - 1;
-    {
-        encodeItem->type = PBEncodeItemType_Container;
-        encodeItem->value.bufferValue = nullptr;
+bool MiniPBCoder::encodeObjectToOutput(const std::span<const int32_t> &obj, CodedOutputData &output) {
+    return encodeContainerToOutput<Int32ItemCoder>(obj, output);
+}
 
-        for (const auto value : vec) {
-            PBEncodeItem item;
-            item.type = PBEncodeItemType_Int64;
-            item.value.int64Value = value;
-            item.compiledSize = pbInt64Size(value);
+MMBuffer MiniPBCoder::getEncodeData(const std::span<const uint32_t> &obj) {
+    return encodeContainer<UInt32ItemCoder>(obj);
+}
 
-            (*m_encodeItems)[index].valueSize += item.compiledSize;
-            m_encodeItems->push_back(std::move(item));
-        }
+size_t MiniPBCoder::encodedSizeOfObject(const std::span<const uint32_t> &obj) {
+    return encodedSizeOfContainer<UInt32ItemCoder>(obj);
+}
 
-        encodeItem = &(*m_encodeItems)[index];
-    }
-    encodeItem->compiledSize = pbRawVarint32Size(encodeItem->valueSize) + encodeItem->valueSize;
+bool MiniPBCoder::encodeObjectToOutput(const std::span<const uint32_t> &obj, CodedOutputData &output) {
+    return encodeContainerToOutput<UInt32ItemCoder>(obj, output);
+}
 
-    return index;
+MMBuffer MiniPBCoder::getEncodeData(const std::span<const int64_t> &obj) {
+    return encodeContainer<Int64ItemCoder>(obj);
 }
 
-size_t MiniPBCoder::prepareObjectForEncode(const std::span<const uint64_t> &vec) {
-    m_encodeItems->push_back(PBEncodeItem());
-    PBEncodeItem *encodeItem = &(m_encodeItems->back());
-    size_t index = m_encodeItems->size() - 1;
-    {
-        encodeItem->type = PBEncodeItemType_Container;
-        encodeItem->value.bufferValue = nullptr;
+size_t MiniPBCoder::encodedSizeOfObject(const std::span<const int64_t> &obj) {
+    return encodedSizeOfContainer<Int64ItemCoder>(obj);
+}
 
-        for (const auto value : vec) {
-            PBEncodeItem item;
-            item.type = PBEncodeItemType_UInt64;
-            item.value.uint64Value = value;
-            item.compiledSize = pbUInt64Size(value);
+bool MiniPBCoder::encodeObjectToOutput(const std::span<const int64_t> &obj, CodedOutputData &output) {
+    return encodeContainerToOutput<Int64ItemCoder>(obj, output);
+}
 
-            (*m_encodeItems)[index].valueSize += item.compiledSize;
-            m_encodeItems->push_back(std::move(item));
-        }
+MMBuffer MiniPBCoder::getEncodeData(const std::span<const uint64_t> &obj) {
+    return encodeContainer<UInt64ItemCoder>(obj);
+}
 
-        encodeItem = &(*m_encodeItems)[index];
-    }
-    encodeItem->compiledSize = pbRawVarint32Size(encodeItem->valueSize) + encodeItem->valueSize;
+size_t MiniPBCoder::encodedSizeOfObject(const std::span<const uint64_t> &obj) {
+    return encodedSizeOfContainer<UInt64ItemCoder>(obj);
+}
 
-    return index;
+bool MiniPBCoder::encodeObjectToOutput(const std::span<const uint64_t> &obj, CodedOutputData &output) {
+    return encodeContainerToOutput<UInt64ItemCoder>(obj, output);
 }
 
 #endif // MMKV_HAS_CPP20
 
 vector<string> MiniPBCoder::decodeOneVector() {
     vector<string> v;
+    if (!decodeOneVector(v)) {
+        throw out_of_range("InvalidProtocolBuffer truncatedMessage");
+    }
+    return v;
+}
 
-    m_inputData->readInt32();
+bool MiniPBCoder::decodeOneVector(std::vector<std::string> &result) {
+    int32_t ignoredSize = 0;
+    if (!m_inputData->tryReadInt32(ignoredSize)) {
+        MMKVError("decode fail");
+        return false;
+    }
 
     while (!m_inputData->isAtEnd()) {
-        auto value = m_inputData->readString();
-        v.push_back(std::move(value));
+        string value;
+        if (!m_inputData->tryReadString(value)) {
+            MMKVError("decode fail");
+            return false;
+        }
+        result.push_back(std::move(value));
     }
-
-    return v;
+    return true;
 }
 
 #ifdef MMKV_HAS_CPP20
 
-bool MiniPBCoder::decodeOneVector(std::vector<bool> &result) {
-    try {
-        auto size = m_inputData->readUInt32();
-        result.reserve(size / pbBoolSize());
+// packed repeated field: the size of all items, then the items
+// fixedSize: the encoded size of one item if it's fixed, used for reserving memory
+template <typename T, typename U, bool (CodedInputData::*tryRead)(U &)>
+static bool decodePackedVector(CodedInputData &input, std::vector<T> &result, size_t fixedSize = 0) {
+    uint32_t size = 0;
+    if (!input.tryReadUInt32(size)) {
+        MMKVError("decode fail");
+        return false;
+    }
+    if (fixedSize > 0) {
+        result.reserve(size / fixedSize);
+    }
 
-        while (!m_inputData->isAtEnd()) {
-            auto value = m_inputData->readBool();
-            result.push_back(value);
+    while (!input.isAtEnd()) {
+        U value;
+        if (!(input.*tryRead)(value)) {
+            MMKVError("decode fail");
+            return false;
         }
-        return true;
-    } catch (std::exception &exception) {
-        MMKVError("%s", exception.what());
-    } catch (...) {
-        MMKVError("decode fail");
+        result.push_back(value);
     }
-    return false;
+    return true;
 }
 
-bool MiniPBCoder::decodeOneVector(std::vector<int32_t> &result) {
-    try {
-        m_inputData->readInt32();
-
-        while (!m_inputData->isAtEnd()) {
-            auto value = m_inputData->readInt32();
-            result.push_back(value);
-        }
-        return true;
-    } catch (std::exception &exception) {
-        MMKVError("%s", exception.what());
-    } catch (...) {
+// packed varints are decoded in bulk, see pbDecodeVarints32()
+template <typename T>
+static bool decodePackedVarints(CodedInputData &input, std::vector<T> &result) {
+    uint32_t size = 0;
+    if (!input.tryReadUInt32(size) || !input.tryReadPackedVarints(result)) {
         MMKVError("decode fail");
+        return false;
     }
-    return false;
+    return true;
 }
 
-bool MiniPBCoder::decodeOneVector(std::vector<uint32_t> &result) {
-    try {
-        m_inputData->readInt32();
+bool MiniPBCoder::decodeOneVector(std::vector<bool> &result) {
+    return decodePackedVector<bool, bool, &CodedInputData::tryReadBool>(*m_inputData, result, pbBoolSize());
+}
 
-        while (!m_inputData->isAtEnd()) {
-            auto value = m_inputData->readUInt32();
-            result.push_back(value);
-        }
-        return true;
-    } catch (std::exception &exception) {
-        MMKVError("%s", exception.what());
-    } catch (...) {
-        MMKVError("decode fail");
-    }
-    return false;
+bool MiniPBCoder::decodeOneVector(std::vector<int32_t> &result) {
+    return decodePackedVarints(*m_inputData, result);
 }
 
-bool MiniPBCoder::decodeOneVector(std::vector<int64_t> &result) {
-    try {
-        m_inputData->readInt32();
+bool MiniPBCoder::decodeOneVector(std::vector<uint32_t> &result) {
+    return decodePackedVarints(*m_inputData, result);
+}
 
-        while (!m_inputData->isAtEnd()) {
-            auto value = m_inputData->readInt64();
-            result.push_back(value);
-        }
-        return true;
-    } catch (std::exception &exception) {
-        MMKVError("%s", exception.what());
-    } catch (...) {
-        MMKVError("decode fail");
-    }
-    return false;
+bool MiniPBCoder::decodeOneVector(std::vector<int64_t> &result) {
+    return decodePackedVarints(*m_inputData, result);
 }
 
 bool MiniPBCoder::decodeOneVector(std::vector<uint64_t> &result) {
-    try {
-        m_inputData->readInt32();
-
-        while (!m_inputData->isAtEnd()) {
-            auto value = m_inputData->readUInt64();
-            result.push_back(value);
-        }
-        return true;
-    } catch (std::exception &exception) {
-        MMKVError("%s", exception.what());
-    } catch (...) {
-        MMKVError("decode fail");
-    }
-    return false;
+    return decodePackedVarints(*m_inputData, result);
 }
 
 bool MiniPBCoder::decodeOneVector(std::vector<float> &result) {
-    try {
-        auto size = m_inputData->readUInt32();
-        result.reserve(size / pbFloatSize());
-
-        while (!m_inputData->isAtEnd()) {
-            auto value = m_inputData->readFloat();
-            result.push_back(value);
-        }
-        return true;
-    } catch (std::exception &exception) {
-        MMKVError("%s", exception.what());
-    } catch (...) {
-        MMKVError("decode fail");
-    }
-    return false;
+    return decodePackedVector<float, float, &CodedInputData::tryReadFloat>(*m_inputData, result, pbFloatSize());
 }
 
 bool MiniPBCoder::decodeOneVector(std::vector<double> &result) {
-    try {
-        auto size = m_inputData->readUInt32();
-        result.reserve(size / pbDoubleSize());
+    return decodePackedVector<double, double, &CodedInputData::tryReadDouble>(*m_inputData, result, pbDoubleSize());
+}
 
-        while (!m_inputData->isAtEnd()) {
-            auto value = m_inputData->readDouble();
-            result.push_back(value);
+#endif // MMKV_HAS_CPP20
+
+#ifndef MMKV_APPLE
+static bool hasAnyPrefix(const string &key, const vector<string> &prefixes) {
+    for (const auto &prefix : prefixes) {
+        if (key.compare(0, prefix.size(), prefix) == 0) {
+            return true;
         }
-        return true;
-    } catch (std::exception &exception) {
-        MMKVError("%s", exception.what());
-    } catch (...) {
-        MMKVError("decode fail");
     }
     return false;
 }
 
-#endif // MMKV_HAS_CPP20
-
-#ifndef MMKV_APPLE
+// the loader is on the hot path, decode without exceptions
 void MiniPBCoder::decodeOneMap(MMKVMap &dic, size_t position, bool greedy) {
     auto block = [position, this](MMKVMap &dictionary) {
         if (position) {
-            m_inputData->seek(position);
+            if (!m_inputData->trySeek(position)) {
+                return false;
+            }
         } else {
-            m_inputData->readInt32();
+            int32_t ignoredSize = 0;
+            if (!m_inputData->tryReadInt32(ignoredSize)) {
+                return false;
+            }
         }
+        string key;
         while (!m_inputData->isAtEnd()) {
             KeyValueHolder kvHolder;
-            const auto &key = m_inputData->readString(kvHolder);
+            if (!m_inputData->tryReadString(kvHolder, key)) {
+                return false;
+            }
             if (key.length() > 0) {
-                m_inputData->readData(kvHolder);
+                if (!m_inputData->tryReadData(kvHolder)) {
+                    return false;
+                }
+                // skipped without a copy of the value, a deletion of it has nothing to erase either
+                if (m_keyPrefixes && !hasAnyPrefix(key, *m_keyPrefixes)) {
+                    continue;
+                }
                 if (kvHolder.valueSize > 0) {
-                    dictionary[key] = std::move(kvHolder);
+                    // the key is allocated the way the dictionary does
+                    dictionary.insert_or_assign(MMKVMap::key_type(key, dictionary.get_allocator()), std::move(kvHolder));
                 } else {
                     auto itr = dictionary.find(key);
                     if (itr != dictionary.end()) {
@@ -523,25 +558,20 @@ void MiniPBCoder::decodeOneMap(MMKVMap &dic, size_t position, bool greedy) {
                 }
             }
         }
+        return true;
     };
 
     if (greedy) {
-        try {
-            block(dic);
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("prepare encode fail");
+        // keep whatever decoded before the error
+        if (!block(dic)) {
+            MMKVError("fail to decode map, %zu items recovered", dic.size());
         }
     } else {
-        try {
-            MMKVMap tmpDic;
-            block(tmpDic);
+        MMKVMap tmpDic(dic.get_allocator());
+        if (block(tmpDic)) {
             dic.swap(tmpDic);
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("prepare encode fail");
+        } else {
+            MMKVError("fail to decode map, InvalidProtocolBuffer");
         }
     }
 }
@@ -549,19 +579,39 @@ void MiniPBCoder::decodeOneMap(MMKVMap &dic, size_t position, bool greedy) {
 #    ifndef MMKV_DISABLE_CRYPT
 
 void MiniPBCoder::decodeOneMap(MMKVMapCrypt &dic, size_t position, bool greedy) {
+#ifdef MMKV_HAS_ARENA
+    m_inputDataDecrpt->setArena(arenaOfDictionary(dic));
+#endif
     auto block = [position, this](MMKVMapCrypt &dictionary) {
         if (position) {
-            m_inputDataDecrpt->seek(position);
+            if (!m_inputDataDecrpt->trySeek(position)) {
+                return false;
+            }
         } else {
-            m_inputDataDecrpt->readInt32();
+            int32_t ignoredSize = 0;
+            if (!m_inputDataDecrpt->tryReadInt32(ignoredSize)) {
+                return false;
+            }
         }
+        string key;
         while (!m_inputDataDecrpt->isAtEnd()) {
             KeyValueHolderCrypt kvHolder;
-            const auto &key = m_inputDataDecrpt->readString(kvHolder);
+            if (!m_inputDataDecrpt->tryReadString(kvHolder, key)) {
+                return false;
+            }
             if (key.length() > 0) {
-                m_inputDataDecrpt->readData(kvHolder);
+                // skipped without a copy of the value, neither taking the arena nor the memory budget
+                if (m_keyPrefixes && !hasAnyPrefix(key, *m_keyPrefixes)) {
+                    if (!m_inputDataDecrpt->trySkipData()) {
+                        return false;
+                    }
+                    continue;
+                }
+                if (!m_inputDataDecrpt->tryReadData(kvHolder)) {
+                    return false;
+                }
                 if (kvHolder.realValueSize() > 0) {
-                    dictionary[key] = std::move(kvHolder);
+                    dictionary.insert_or_assign(MMKVMapCrypt::key_type(key, dictionary.get_allocator()), std::move(kvHolder));
                 } else {
                     auto itr = dictionary.find(key);
                     if (itr != dictionary.end()) {
@@ -570,25 +620,20 @@ void MiniPBCoder::decodeOneMap(MMKVMapCrypt &dic, size_t position, bool greedy)
                 }
             }
         }
+        return true;
     };
 
     if (greedy) {
-        try {
-            block(dic);
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("prepare encode fail");
+        // keep whatever decoded before the error
+        if (!block(dic)) {
+            MMKVError("fail to decode map, %zu items recovered", dic.size());
         }
     } else {
-        try {
-            MMKVMapCrypt tmpDic;
-            block(tmpDic);
+        MMKVMapCrypt tmpDic(dic.get_allocator());
+        if (block(tmpDic)) {
             dic.swap(tmpDic);
-        } catch (std::exception &exception) {
-            MMKVError("%s", exception.what());
-        } catch (...) {
-            MMKVError("prepare encode fail");
+        } else {
+            MMKVError("fail to decode map, InvalidProtocolBuffer");
         }
     }
 }
@@ -641,25 +686,33 @@ MMBuffer MiniPBCoder::getEncodeData(const std::span<const double> &value) {
 }
 #endif // MMKV_HAS_CPP20
 
-void MiniPBCoder::decodeMap(MMKVMap &dic, const MMBuffer &oData, size_t position) {
+void MiniPBCoder::decodeMap(MMKVMap &dic, const MMBuffer &oData, size_t position, const vector<string> *keyPrefixes) {
     MiniPBCoder oCoder(&oData);
+    oCoder.m_keyPrefixes = keyPrefixes;
     oCoder.decodeOneMap(dic, position, false);
 }
 
-void MiniPBCoder::greedyDecodeMap(MMKVMap &dic, const MMBuffer &oData, size_t position) {
+void MiniPBCoder::greedyDecodeMap(MMKVMap &dic, const MMBuffer &oData, size_t position, const vector<string> *keyPrefixes) {
     MiniPBCoder oCoder(&oData);
+    oCoder.m_keyPrefixes = keyPrefixes;
     oCoder.decodeOneMap(dic, position, true);
 }
 
 #ifndef MMKV_DISABLE_CRYPT
 
-void MiniPBCoder::decodeMap(MMKVMapCrypt &dic, const MMBuffer &oData, AESCrypt *crypter, size_t position) {
+void MiniPBCoder::decodeMap(MMKVMapCrypt &dic, const MMBuffer &oData, AESCrypt *crypter, size_t position,
+                            const vector<string> *keyPrefixes, size_t memoryBudget) {
     MiniPBCoder oCoder(&oData, crypter);
+    oCoder.m_keyPrefixes = keyPrefixes;
+    oCoder.m_inputDataDecrpt->setMemoryBudget(memoryBudget);
     oCoder.decodeOneMap(dic, position, false);
 }
 
-void MiniPBCoder::greedyDecodeMap(MMKVMapCrypt &dic, const MMBuffer &oData, AESCrypt *crypter, size_t position) {
+void MiniPBCoder::greedyDecodeMap(MMKVMapCrypt &dic, const MMBuffer &oData, AESCrypt *crypter, size_t position,
+                                  const vector<string> *keyPrefixes, size_t memoryBudget) {
     MiniPBCoder oCoder(&oData, crypter);
+    oCoder.m_keyPrefixes = keyPrefixes;
+    oCoder.m_inputDataDecrpt->setMemoryBudget(memoryBudget);
     oCoder.decodeOneMap(dic, position, true);
 }
 
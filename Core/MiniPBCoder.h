@@ -26,6 +26,7 @@
 
 #include "MMBuffer.h"
 #include <cstdint>
+#include <type_traits>
 #ifdef MMKV_HAS_CPP20
 #  include <span>
 #  define MMKV_STRING_CONTAINER std::span<const std::string>
@@ -49,7 +50,9 @@ class MMKV_EXPORT MiniPBCoder {
 
     MMBuffer *m_outputBuffer = nullptr;
     CodedOutputData *m_outputData = nullptr;
-    std::vector<PBEncodeItem> *m_encodeItems = nullptr;
+    std::vector<PBEncodeItem, HeapAllocator<PBEncodeItem>> *m_encodeItems = nullptr;
+    // decodeOneMap() keeps only keys starting with one of them if set
+    const std::vector<std::string> *m_keyPrefixes = nullptr;
 
     MiniPBCoder();
     explicit MiniPBCoder(const MMBuffer *inputBuffer, AESCrypt *crypter = nullptr);
@@ -57,13 +60,32 @@ class MMKV_EXPORT MiniPBCoder {
 
     void writeRootObject();
 
+    // m_encodeItems[] is only needed by objects that can't be encoded in one pass
+    void ensureEncodeItems();
+
     size_t prepareObjectForEncode(const MMKVVector &vec);
     size_t prepareObjectForEncode(const MMBuffer &buffer);
 
     template <typename T>
     MMBuffer getEncodeData(const T &obj) {
-        size_t index = prepareObjectForEncode(obj);
-        return writePreparedItems(index);
+        // route convertible containers (std::span<T>, fixed extent spans, etc.) to the allocation-free encoders
+        if constexpr (std::is_convertible_v<const T &, MMKV_STRING_CONTAINER>) {
+            return getEncodeData(MMKV_STRING_CONTAINER(obj));
+#ifdef MMKV_HAS_CPP20
+        } else if constexpr (std::is_convertible_v<const T &, std::span<const int32_t>>) {
+            return getEncodeData(std::span<const int32_t>(obj));
+        } else if constexpr (std::is_convertible_v<const T &, std::span<const uint32_t>>) {
+            return getEncodeData(std::span<const uint32_t>(obj));
+        } else if constexpr (std::is_convertible_v<const T &, std::span<const int64_t>>) {
+            return getEncodeData(std::span<const int64_t>(obj));
+        } else if constexpr (std::is_convertible_v<const T &, std::span<const uint64_t>>) {
+            return getEncodeData(std::span<const uint64_t>(obj));
+#endif
+        } else {
+            ensureEncodeItems();
+            size_t index = prepareObjectForEncode(obj);
+            return writePreparedItems(index);
+        }
     }
 
     MMBuffer writePreparedItems(size_t index);
@@ -74,13 +96,19 @@ class MMKV_EXPORT MiniPBCoder {
 #endif
 
     size_t prepareObjectForEncode(const std::string &str);
-    size_t prepareObjectForEncode(const MMKV_STRING_CONTAINER &vector);
     std::vector<std::string> decodeOneVector();
+    bool decodeOneVector(std::vector<std::string> &result);
+
+    // containers of plain types skip m_encodeItems[], see encodedSizeOfObject()
+    MMBuffer getEncodeData(const MMKV_STRING_CONTAINER &obj);
+#ifndef MMKV_APPLE
+    MMBuffer getEncodeData(const MMKVVector &obj);
+#endif
 #ifdef MMKV_HAS_CPP20
-    size_t prepareObjectForEncode(const std::span<const int32_t> &vec);
-    size_t prepareObjectForEncode(const std::span<const uint32_t> &vec);
-    size_t prepareObjectForEncode(const std::span<const int64_t> &vec);
-    size_t prepareObjectForEncode(const std::span<const uint64_t> &vec);
+    MMBuffer getEncodeData(const std::span<const int32_t> &obj);
+    MMBuffer getEncodeData(const std::span<const uint32_t> &obj);
+    MMBuffer getEncodeData(const std::span<const int64_t> &obj);
+    MMBuffer getEncodeData(const std::span<const uint64_t> &obj);
 
     bool decodeOneVector(std::vector<bool> &result);
     bool decodeOneVector(std::vector<int32_t> &result);
@@ -111,18 +139,45 @@ public:
     // opt encoding a single MMBuffer
     static MMBuffer encodeDataWithObject(const MMBuffer &obj);
 
+    // allocation-free encoding: the exact size is computed in one pass without any intermediate item,
+    // then the object is streamed into the caller's output
+    // return 0 if the object is too large to encode
+    static size_t encodedSizeOfObject(const MMKV_STRING_CONTAINER &obj);
+    static bool encodeObjectToOutput(const MMKV_STRING_CONTAINER &obj, CodedOutputData &output);
+#ifndef MMKV_APPLE
+    static size_t encodedSizeOfObject(const MMKVVector &obj);
+    static bool encodeObjectToOutput(const MMKVVector &obj, CodedOutputData &output);
+#endif
+#ifdef MMKV_HAS_CPP20
+    static size_t encodedSizeOfObject(const std::span<const int32_t> &obj);
+    static bool encodeObjectToOutput(const std::span<const int32_t> &obj, CodedOutputData &output);
+    static size_t encodedSizeOfObject(const std::span<const uint32_t> &obj);
+    static bool encodeObjectToOutput(const std::span<const uint32_t> &obj, CodedOutputData &output);
+    static size_t encodedSizeOfObject(const std::span<const int64_t> &obj);
+    static bool encodeObjectToOutput(const std::span<const int64_t> &obj, CodedOutputData &output);
+    static size_t encodedSizeOfObject(const std::span<const uint64_t> &obj);
+    static bool encodeObjectToOutput(const std::span<const uint64_t> &obj, CodedOutputData &output);
+#endif // MMKV_HAS_CPP20
+
     // return empty result if there's any error
-    static void decodeMap(MMKVMap &dic, const MMBuffer &oData, size_t position = 0);
+    // keyPrefixes: only keep keys starting with one of them, others are skipped, not on Apple platforms
+    static void decodeMap(MMKVMap &dic, const MMBuffer &oData, size_t position = 0,
+                          const std::vector<std::string> *keyPrefixes = nullptr);
 
     // decode as much data as possible before any error happens
-    static void greedyDecodeMap(MMKVMap &dic, const MMBuffer &oData, size_t position = 0);
+    static void greedyDecodeMap(MMKVMap &dic, const MMBuffer &oData, size_t position = 0,
+                                const std::vector<std::string> *keyPrefixes = nullptr);
 
 #ifndef MMKV_DISABLE_CRYPT
     // return empty result if there's any error
-    static void decodeMap(MMKVMapCrypt &dic, const MMBuffer &oData, AESCrypt *crypter, size_t position = 0);
+    // memoryBudget: bytes of medium values to keep decrypted in memory, the rest are decrypted on access
+    static void decodeMap(MMKVMapCrypt &dic, const MMBuffer &oData, AESCrypt *crypter, size_t position = 0,
+                          const std::vector<std::string> *keyPrefixes = nullptr, size_t memoryBudget = SIZE_MAX);
 
     // decode as much data as possible before any error happens
-    static void greedyDecodeMap(MMKVMapCrypt &dic, const MMBuffer &oData, AESCrypt *crypter, size_t position = 0);
+    static void greedyDecodeMap(MMKVMapCrypt &dic, const MMBuffer &oData, AESCrypt *crypter, size_t position = 0,
+                                const std::vector<std::string> *keyPrefixes = nullptr,
+                                size_t memoryBudget = SIZE_MAX);
 #endif // MMKV_DISABLE_CRYPT
 
     static std::vector<std::string> decodeVector(const MMBuffer &oData);
@@ -35,15 +35,6 @@ enum PBEncodeItemType {
     PBEncodeItemType_Data,
     PBEncodeItemType_Container,
     PBEncodeItemType_String,
-#ifdef MMKV_HAS_CPP20
-    PBEncodeItemType_Int32,
-    PBEncodeItemType_UInt32,
-    PBEncodeItemType_Int64,
-    PBEncodeItemType_UInt64,
-//    PBEncodeItemType_Bool,
-//    PBEncodeItemType_Float,
-//    PBEncodeItemType_Double,
-#endif // MMKV_HAS_CPP20
 #ifdef MMKV_APPLE
     PBEncodeItemType_NSString,
     PBEncodeItemType_NSData,
@@ -57,15 +48,6 @@ struct PBEncodeItem {
     uint32_t valueSize;
     union {
         const MMBuffer *bufferValue;
-#ifdef MMKV_HAS_CPP20
-//        bool boolValue;
-        int32_t int32Value;
-        int64_t int64Value;
-        uint32_t uint32Value;
-        uint64_t uint64Value;
-#endif // MMKV_HAS_CPP20
-        //        float floatValue;
-//        double doubleValue;
         const std::string *strValue;
 #ifdef MMKV_APPLE
         void *objectValue;
@@ -19,6 +19,18 @@
  */
 #include "MMBuffer.h"
 #include "PBUtility.h"
+#include <atomic>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#    define MMKV_USE_X86_VARINT_SIMD
+#    include <immintrin.h>
+#    define TARGET_SSE41 __attribute__((target("sse4.1")))
+#    define TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#elif defined(__aarch64__)
+#    define MMKV_USE_NEON_VARINT_SIMD
+#    include <arm_neon.h>
+#endif
 
 namespace mmkv {
 
@@ -58,4 +70,303 @@ uint32_t pbUInt64Size(uint64_t value) {
     return 10;
 }
 
+// bulk varint decoding
+
+constexpr size_t MaxVarintSize = 10;
+
+// decode one varint of any length, return its size, or 0 if it's malformed or truncated
+template <typename T>
+static inline size_t decodeOneVarint(const uint8_t *ptr, const uint8_t *end, T *output) {
+    uint64_t result = 0;
+    for (size_t index = 0; index < MaxVarintSize && ptr + index < end; index++) {
+        auto byte = ptr[index];
+        result |= static_cast<uint64_t>(byte & 0x7f) << (7 * index);
+        if (byte < 0x80) {
+            *output = static_cast<T>(result);
+            return index + 1;
+        }
+    }
+    return 0;
+}
+
+// decode the varints starting before limit, return the position after them, or nullptr if malformed
+template <typename T>
+static inline const uint8_t *decodeVarintsBefore(const uint8_t *ptr, const uint8_t *limit, const uint8_t *end,
+                                                 T *&output) {
+    while (ptr < limit) {
+        if (*ptr < 0x80) {
+            *output++ = *ptr++;
+            continue;
+        }
+        auto size = decodeOneVarint(ptr, end, output++);
+        if (size == 0) {
+            return nullptr;
+        }
+        ptr += size;
+    }
+    return ptr;
+}
+
+template <typename T>
+static bool decodeVarintsScalar(const uint8_t *ptr, size_t size, T *output) {
+    return decodeVarintsBefore(ptr, ptr + size, ptr + size, output) != nullptr;
+}
+
+static bool countVarintsScalar(const uint8_t *ptr, size_t size, size_t &count) {
+    size_t result = 0;
+    for (size_t index = 0; index < size; index++) {
+        result += (ptr[index] < 0x80);
+    }
+    count = result;
+    return size == 0 || ptr[size - 1] < 0x80;
+}
+
+struct VarintDecoder {
+    const char *name;
+    bool (*count)(const uint8_t *ptr, size_t size, size_t &count);
+    bool (*decode32)(const uint8_t *ptr, size_t size, uint32_t *output);
+    bool (*decode64)(const uint8_t *ptr, size_t size, uint64_t *output);
+};
+
+static const VarintDecoder ScalarVarintDecoder = {"scalar", countVarintsScalar, decodeVarintsScalar<uint32_t>,
+                                                  decodeVarintsScalar<uint64_t>};
+
+// A block of N bytes is decoded at once in two common cases:
+//   * N single-byte varints: widen each byte
+//   * N / 2 two-byte varints: merge the 7-bit halves of each 16-bit lane, then widen
+// Any other block is decoded one varint at a time, a varint crossing the block boundary is finished in place.
+
+#ifdef MMKV_USE_X86_VARINT_SIMD
+
+// widen 8 uint16 lanes
+template <typename T>
+TARGET_SSE41 static inline void widen16SSE41(__m128i lanes, T *output) {
+    if constexpr (sizeof(T) == sizeof(uint32_t)) {
+        _mm_storeu_si128((__m128i *) output, _mm_cvtepu16_epi32(lanes));
+        _mm_storeu_si128((__m128i *) output + 1, _mm_cvtepu16_epi32(_mm_srli_si128(lanes, 8)));
+    } else {
+        for (int i = 0; i < 4; i++) {
+            _mm_storeu_si128((__m128i *) output + i, _mm_cvtepu16_epi64(lanes));
+            lanes = _mm_srli_si128(lanes, 4);
+        }
+    }
+}
+
+// widen 16 uint8 lanes
+template <typename T>
+TARGET_SSE41 static inline void widen8SSE41(__m128i bytes, T *output) {
+    widen16SSE41(_mm_cvtepu8_epi16(bytes), output);
+    widen16SSE41(_mm_cvtepu8_epi16(_mm_srli_si128(bytes, 8)), output + 8);
+}
+
+template <typename T>
+TARGET_SSE41 static bool decodeVarintsSSE41(const uint8_t *ptr, size_t size, T *output) {
+    auto end = ptr + size;
+    while (end - ptr >= 16) {
+        auto bytes = _mm_loadu_si128((const __m128i *) ptr);
+        auto continues = static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+        if (continues == 0) {
+            widen8SSE41(bytes, output);
+            output += 16;
+            ptr += 16;
+        } else if (continues == 0x5555) {
+            auto low = _mm_and_si128(bytes, _mm_set1_epi16(0x007f));
+            auto high = _mm_srli_epi16(_mm_and_si128(bytes, _mm_set1_epi16(0x7f00)), 1);
+            widen16SSE41(_mm_or_si128(low, high), output);
+            output += 8;
+            ptr += 16;
+        } else if (!(ptr = decodeVarintsBefore(ptr, ptr + 16, end, output))) {
+            return false;
+        }
+    }
+    return decodeVarintsBefore(ptr, end, end, output) != nullptr;
+}
+
+TARGET_SSE41 static bool countVarintsSSE41(const uint8_t *ptr, size_t size, size_t &count) {
+    size_t result = 0, index = 0;
+    for (; index + 16 <= size; index += 16) {
+        auto bytes = _mm_loadu_si128((const __m128i *) (ptr + index));
+        result += 16 - __builtin_popcount(static_cast<uint32_t>(_mm_movemask_epi8(bytes)));
+    }
+    size_t tail = 0;
+    countVarintsScalar(ptr + index, size - index, tail);
+    count = result + tail;
+    return size == 0 || ptr[size - 1] < 0x80;
+}
+
+// widen 16 uint16 lanes
+template <typename T>
+TARGET_AVX2 static inline void widen16AVX2(__m256i lanes, T *output) {
+    auto out = (__m256i *) output;
+    auto low = _mm256_castsi256_si128(lanes);
+    auto high = _mm256_extracti128_si256(lanes, 1);
+    if constexpr (sizeof(T) == sizeof(uint32_t)) {
+        _mm256_storeu_si256(out, _mm256_cvtepu16_epi32(low));
+        _mm256_storeu_si256(out + 1, _mm256_cvtepu16_epi32(high));
+    } else {
+        _mm256_storeu_si256(out, _mm256_cvtepu16_epi64(low));
+        _mm256_storeu_si256(out + 1, _mm256_cvtepu16_epi64(_mm_srli_si128(low, 8)));
+        _mm256_storeu_si256(out + 2, _mm256_cvtepu16_epi64(high));
+        _mm256_storeu_si256(out + 3, _mm256_cvtepu16_epi64(_mm_srli_si128(high, 8)));
+    }
+}
+
+// widen 32 uint8 lanes
+template <typename T>
+TARGET_AVX2 static inline void widen8AVX2(__m256i bytes, T *output) {
+    widen16AVX2(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes)), output);
+    widen16AVX2(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1)), output + 16);
+}
+
+template <typename T>
+TARGET_AVX2 static bool decodeVarintsAVX2(const uint8_t *ptr, size_t size, T *output) {
+    auto end = ptr + size;
+    while (end - ptr >= 32) {
+        auto bytes = _mm256_loadu_si256((const __m256i *) ptr);
+        auto continues = static_cast<uint32_t>(_mm256_movemask_epi8(bytes));
+        if (continues == 0) {
+            widen8AVX2(bytes, output);
+            output += 32;
+            ptr += 32;
+        } else if (continues == 0x55555555) {
+            auto low = _mm256_and_si256(bytes, _mm256_set1_epi16(0x007f));
+            auto high = _mm256_srli_epi16(_mm256_and_si256(bytes, _mm256_set1_epi16(0x7f00)), 1);
+            widen16AVX2(_mm256_or_si256(low, high), output);
+            output += 16;
+            ptr += 32;
+        } else if (!(ptr = decodeVarintsBefore(ptr, ptr + 32, end, output))) {
+            return false;
+        }
+    }
+    return decodeVarintsBefore(ptr, end, end, output) != nullptr;
+}
+
+TARGET_AVX2 static bool countVarintsAVX2(const uint8_t *ptr, size_t size, size_t &count) {
+    size_t result = 0, index = 0;
+    for (; index + 32 <= size; index += 32) {
+        auto bytes = _mm256_loadu_si256((const __m256i *) (ptr + index));
+        result += 32 - __builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(bytes)));
+    }
+    size_t tail = 0;
+    countVarintsScalar(ptr + index, size - index, tail);
+    count = result + tail;
+    return size == 0 || ptr[size - 1] < 0x80;
+}
+
+static const VarintDecoder SSE41VarintDecoder = {"sse4.1", countVarintsSSE41, decodeVarintsSSE41<uint32_t>,
+                                                 decodeVarintsSSE41<uint64_t>};
+static const VarintDecoder AVX2VarintDecoder = {"avx2", countVarintsAVX2, decodeVarintsAVX2<uint32_t>,
+                                                decodeVarintsAVX2<uint64_t>};
+
+static const VarintDecoder *bestVarintDecoder() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        return &AVX2VarintDecoder;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return &SSE41VarintDecoder;
+    }
+    return &ScalarVarintDecoder;
+}
+
+#elif defined(MMKV_USE_NEON_VARINT_SIMD)
+
+// widen 8 uint16 lanes
+template <typename T>
+static inline void widen16NEON(uint16x8_t lanes, T *output) {
+    uint32x4_t words[] = {vmovl_u16(vget_low_u16(lanes)), vmovl_high_u16(lanes)};
+    for (auto word : words) {
+        if constexpr (sizeof(T) == sizeof(uint32_t)) {
+            vst1q_u32((uint32_t *) output, word);
+        } else {
+            vst1q_u64((uint64_t *) output, vmovl_u32(vget_low_u32(word)));
+            vst1q_u64((uint64_t *) output + 2, vmovl_high_u32(word));
+        }
+        output += 4;
+    }
+}
+
+template <typename T>
+static bool decodeVarintsNEON(const uint8_t *ptr, size_t size, T *output) {
+    auto end = ptr + size;
+    while (end - ptr >= 16) {
+        auto bytes = vld1q_u8(ptr);
+        if (vmaxvq_u8(bytes) < 0x80) {
+            widen16NEON(vmovl_u8(vget_low_u8(bytes)), output);
+            widen16NEON(vmovl_high_u8(bytes), output + 8);
+            output += 16;
+            ptr += 16;
+            continue;
+        }
+        // NEON has no movemask, narrow each byte of the comparison into a nibble instead
+        auto continues = vcgeq_u8(bytes, vdupq_n_u8(0x80));
+        auto mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(continues), 4)), 0);
+        if (mask == 0x0f0f0f0f0f0f0f0fULL) {
+            auto lanes = vreinterpretq_u16_u8(bytes);
+            auto low = vandq_u16(lanes, vdupq_n_u16(0x007f));
+            auto high = vshrq_n_u16(vandq_u16(lanes, vdupq_n_u16(0x7f00)), 1);
+            widen16NEON(vorrq_u16(low, high), output);
+            output += 8;
+            ptr += 16;
+        } else if (!(ptr = decodeVarintsBefore(ptr, ptr + 16, end, output))) {
+            return false;
+        }
+    }
+    return decodeVarintsBefore(ptr, end, end, output) != nullptr;
+}
+
+static bool countVarintsNEON(const uint8_t *ptr, size_t size, size_t &count) {
+    size_t result = 0, index = 0;
+    for (; index + 16 <= size; index += 16) {
+        // each stop byte becomes 1
+        auto stops = vshrq_n_u8(vcltq_u8(vld1q_u8(ptr + index), vdupq_n_u8(0x80)), 7);
+        result += vaddvq_u8(stops);
+    }
+    size_t tail = 0;
+    countVarintsScalar(ptr + index, size - index, tail);
+    count = result + tail;
+    return size == 0 || ptr[size - 1] < 0x80;
+}
+
+static const VarintDecoder NEONVarintDecoder = {"neon", countVarintsNEON, decodeVarintsNEON<uint32_t>,
+                                                decodeVarintsNEON<uint64_t>};
+
+static const VarintDecoder *bestVarintDecoder() {
+    // NEON is mandatory on aarch64
+    return &NEONVarintDecoder;
+}
+
+#else
+
+static const VarintDecoder *bestVarintDecoder() {
+    return &ScalarVarintDecoder;
+}
+
+#endif // MMKV_USE_X86_VARINT_SIMD
+
+static std::atomic<const VarintDecoder *> &currentVarintDecoder() {
+    static std::atomic<const VarintDecoder *> decoder(bestVarintDecoder());
+    return decoder;
+}
+
+bool pbCountVarints(const uint8_t *ptr, size_t size, size_t &count) {
+    return currentVarintDecoder().load(std::memory_order_relaxed)->count(ptr, size, count);
+}
+
+bool pbDecodeVarints32(const uint8_t *ptr, size_t size, uint32_t *output) {
+    return currentVarintDecoder().load(std::memory_order_relaxed)->decode32(ptr, size, output);
+}
+
+bool pbDecodeVarints64(const uint8_t *ptr, size_t size, uint64_t *output) {
+    return currentVarintDecoder().load(std::memory_order_relaxed)->decode64(ptr, size, output);
+}
+
+const char *pbVarintDecoderName() {
+    return currentVarintDecoder().load(std::memory_order_relaxed)->name;
+}
+
+void pbUseScalarVarintDecoder(bool useScalar) {
+    currentVarintDecoder().store(useScalar ? &ScalarVarintDecoder : bestVarintDecoder());
+}
+
 } // namespace mmkv
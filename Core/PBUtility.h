@@ -25,6 +25,7 @@
 #include "MMKVPredef.h"
 #include "MMBuffer.h"
 
+#include <cstddef>
 #include <cstdint>
 
 namespace mmkv {
@@ -143,6 +144,21 @@ static inline uint32_t pbMMBufferSize(const MMBuffer &data) {
 
 constexpr uint32_t Fixed32Size = pbFixed32Size();
 
+// bulk decoding of packed varints, accelerated by AVX2/SSE4.1 (selected at runtime) or NEON
+// count the varints in [ptr, ptr + size), return false if the last one is truncated
+extern bool pbCountVarints(const uint8_t *ptr, size_t size, size_t &count);
+
+// decode the varints counted above into output, return false on malformed (longer than 10 bytes) varint
+// the upper bits are discarded the same way as CodedInputData::readInt32() & readInt64()
+extern bool pbDecodeVarints32(const uint8_t *ptr, size_t size, uint32_t *output);
+extern bool pbDecodeVarints64(const uint8_t *ptr, size_t size, uint64_t *output);
+
+// the name of the decoder in use, for logging & benchmark
+extern const char *pbVarintDecoderName();
+
+// for testing & benchmark only: fallback to the scalar decoder
+extern void pbUseScalarVarintDecoder(bool useScalar);
+
 } // namespace mmkv
 
 #endif
@@ -65,9 +65,10 @@ public:
     void lock();
     void unlock();
 
-#ifndef MMKV_WIN32
     bool try_lock();
-#endif
+
+    // only meaningful to the owner: whether it holds the lock just once, i.e. it's not nested in another scope of it
+    bool isOwnedOnce() const { return m_lockCount == 1; }
 
     static void ThreadOnce(ThreadOnceToken_t *onceToken, void (*callback)(void));
 
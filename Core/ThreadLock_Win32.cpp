@@ -60,6 +60,14 @@ void ThreadLock::unlock() {
     LeaveCriticalSection(&m_lock);
 }
 
+bool ThreadLock::try_lock() {
+    if (TryEnterCriticalSection(&m_lock)) {
+        ++m_lockCount;
+        return true;
+    }
+    return false;
+}
+
 void ThreadLock::ThreadOnce(ThreadOnceToken_t *onceToken, void (*callback)()) {
     if (!onceToken || !callback) {
         assert(onceToken);
@@ -459,6 +459,62 @@ MMKV_EXPORT void *mmkv_decode_bytes(MMKVHandle_t handle, const char *key, uint64
     return nullptr;
 }
 
+/* ── Batch ─────────────────────────────────────────────────────────── */
+
+MMKV_EXPORT void *mmkv_multi_get(MMKVHandle_t handle, const char **keyArray, uint64_t count, int64_t *lengthArray) {
+    MMKV *kv = kvFromHandle(handle);
+    if (!kv || !keyArray || !lengthArray || count == 0) {
+        return nullptr;
+    }
+    vector<string_view> keys;
+    keys.reserve(count);
+    for (uint64_t i = 0; i < count; i++) {
+        keys.emplace_back(keyArray[i] ? keyArray[i] : "");
+    }
+    auto values = kv->getBytesForKeys(keys);
+    size_t totalSize = 0;
+    bool found = false;
+    for (const auto &value : values) {
+        if (value) {
+            totalSize += value->length();
+            found = true;
+        }
+    }
+    // Keep empty values distinguishable from no value at all.
+    char *arena = found ? static_cast<char *>(malloc(totalSize > 0 ? totalSize : 1)) : nullptr;
+    size_t offset = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        if (arena && values[i]) {
+            memcpy(arena + offset, values[i]->getPtr(), values[i]->length());
+            offset += values[i]->length();
+            lengthArray[i] = static_cast<int64_t>(values[i]->length());
+        } else {
+            lengthArray[i] = -1;
+        }
+    }
+    return arena;
+}
+
+MMKV_EXPORT bool mmkv_multi_set(MMKVHandle_t handle, const char **keyArray, const void **valueArray,
+                                const uint64_t *lengthArray, uint64_t count) {
+    MMKV *kv = kvFromHandle(handle);
+    if (!kv || !keyArray || !valueArray || !lengthArray) {
+        return false;
+    }
+    vector<string_view> keys;
+    vector<MMBuffer> values;
+    keys.reserve(count);
+    values.reserve(count);
+    for (uint64_t i = 0; i < count; i++) {
+        if (!keyArray[i] || !valueArray[i]) {
+            return false;
+        }
+        keys.emplace_back(keyArray[i]);
+        values.emplace_back((void *) valueArray[i], static_cast<size_t>(lengthArray[i]), MMBufferNoCopy);
+    }
+    return kv->setBytesForKeys(keys, values);
+}
+
 /* ── Encryption ────────────────────────────────────────────────────── */
 
 #ifndef MMKV_DISABLE_CRYPT
@@ -537,6 +593,20 @@ MMKV_EXPORT char **mmkv_all_keys(MMKVHandle_t handle, uint64_t *lengthPtr, bool
     return nullptr;
 }
 
+MMKV_EXPORT uint64_t mmkv_for_each(MMKVHandle_t handle, mmkv_visitor_t visitor, void *context) {
+    MMKV *kv = kvFromHandle(handle);
+    if (!kv || !visitor) {
+        return 0;
+    }
+    return kv->forEach([visitor, context](string_view key, const MMBuffer &value) {
+        MMBuffer bytes;
+        if (MMKV::bytesView(value, bytes)) {
+            return visitor(key.data(), static_cast<uint32_t>(key.size()), bytes.getPtr(), bytes.length(), context);
+        }
+        return visitor(key.data(), static_cast<uint32_t>(key.size()), nullptr, 0, context);
+    });
+}
+
 MMKV_EXPORT bool mmkv_contains_key(MMKVHandle_t handle, const char *key) {
     MMKV *kv = kvFromHandle(handle);
     if (kv && key) { return kv->containsKey(key); }
@@ -873,6 +943,8 @@ MMKV_EXPORT bool mmkv_namespace_check_exist(MMKVNameSpace_t handle, const char *
 
 /* ── Memory management ─────────────────────────────────────────────── */
 
+// everything the bridge hands out is copied into malloc()-ed memory,
+// never memory taken from the allocator given to initializeMMKV()
 MMKV_EXPORT void mmkv_free(void *ptr) {
     free(ptr);
 }
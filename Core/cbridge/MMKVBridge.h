@@ -145,6 +145,21 @@ MMKV_CBRIDGE_API char *mmkv_decode_string(MMKVHandle_t handle, const char *key);
    Returns NULL if not found. */
 MMKV_CBRIDGE_API void *mmkv_decode_bytes(MMKVHandle_t handle, const char *key, uint64_t *lengthPtr);
 
+/* ── Batch ─────────────────────────────────────────────────────────── */
+
+/* Read the string/bytes values of count keys in one call, under one lock.
+   lengthArray (count entries, caller-supplied) receives each value's length,
+   or -1 if the key is missing. The values are packed back to back in the
+   returned malloc'd arena in key order, missing keys taking no room — caller
+   must call mmkv_free() on it once. Returns NULL if none of the keys is found. */
+MMKV_CBRIDGE_API void *mmkv_multi_get(MMKVHandle_t handle, const char **keyArray, uint64_t count, int64_t *lengthArray);
+/* Write count string/bytes values in one call, under one lock, appended to the
+   file at once if the instance has no encryption, expiration or compare-before-set.
+   valueArray[i]/lengthArray[i] are as in mmkv_encode_bytes(), except that NULL
+   values are rejected. Nothing is written if any key or value is invalid. */
+MMKV_CBRIDGE_API bool mmkv_multi_set(MMKVHandle_t handle, const char **keyArray, const void **valueArray,
+                                     const uint64_t *lengthArray, uint64_t count);
+
 /* ── Value inspection ──────────────────────────────────────────────── */
 
 /* Return the size of the key's value.
@@ -169,6 +184,15 @@ MMKV_CBRIDGE_API void mmkv_check_reset_crypt_key(MMKVHandle_t handle, const char
 /* Returns malloc'd array of malloc'd strings. *lengthPtr receives count.
    Caller must free each string and then the array with mmkv_free(). */
 MMKV_CBRIDGE_API char **mmkv_all_keys(MMKVHandle_t handle, uint64_t *lengthPtr, bool filterExpire);
+/* Visit every key and its string/bytes value under one lock, without copying
+   them. key (not null-terminated) and value point into the mapped file, or a
+   temporary buffer for encrypted instances, and are only valid during the call.
+   value is NULL if the value isn't a string or bytes. Expired keys are skipped.
+   Return true from the visitor to stop. Don't modify the instance inside it.
+   Returns the number of keys visited. */
+typedef bool (*mmkv_visitor_t)(const char *key, uint32_t keyLength, const void *value, uint64_t valueLength,
+                               void *context);
+MMKV_CBRIDGE_API uint64_t mmkv_for_each(MMKVHandle_t handle, mmkv_visitor_t visitor, void *context);
 MMKV_CBRIDGE_API bool mmkv_contains_key(MMKVHandle_t handle, const char *key);
 MMKV_CBRIDGE_API uint64_t mmkv_count(MMKVHandle_t handle, bool filterExpire);
 MMKV_CBRIDGE_API uint64_t mmkv_total_size(MMKVHandle_t handle);
@@ -267,7 +291,7 @@ MMKV_CBRIDGE_API bool mmkv_namespace_check_exist(MMKVNameSpace_t ns, const char
 /* ── Memory management ─────────────────────────────────────────────── */
 
 /* Free any heap pointer returned by mmkv_decode_string, mmkv_decode_bytes,
-   mmkv_all_keys, mmkv_crypt_key, etc. */
+   mmkv_multi_get, mmkv_all_keys, mmkv_crypt_key, etc. */
 MMKV_CBRIDGE_API void mmkv_free(void *ptr);
 
 #ifdef __cplusplus
@@ -366,17 +366,12 @@ MMKV_EXPORT void *decodeBytes(void *handle, const char *oKey, uint64_t *lengthPt
         auto hasValue = kv->getBytes(key, value);
         if (hasValue) {
             if (value.length() > 0) {
-                if (value.isStoredOnStack()) {
-                    auto result = malloc(value.length());
-                    if (result) {
-                        memcpy(result, value.getPtr(), value.length());
-                        *lengthPtr = value.length();
-                    }
-                    return result;
+                auto length = value.length();
+                // freed by the caller with free()
+                auto result = value.detachToMalloc();
+                if (result) {
+                    *lengthPtr = length;
                 }
-                void *result = value.getPtr();
-                *lengthPtr = value.length();
-                value.detach();
                 return result;
             }
             *lengthPtr = 0;
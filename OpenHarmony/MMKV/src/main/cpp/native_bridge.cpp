@@ -180,7 +180,8 @@ static napi_value BoolArrayToNValue(napi_env env, const vector<bool> &value) {
 
 static void my_finalizer(napi_env env, void *finalize_data, void *finalize_hint) {
     // MMKVInfo("free %p", finalize_data);
-    free(finalize_data);
+    // detached from an MMBuffer, it might be taken from the allocator given to initializeMMKV()
+    freeMemory(finalize_data);
 }
 
 static MMBuffer NValueToMMBuffer(napi_env env, napi_value value, bool maybeUndefined = false) {
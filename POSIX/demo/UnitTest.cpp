@@ -19,12 +19,18 @@
  */
 
 #include <MMKV/MMKV.h>
+#include "CodedInputData.h"
 #include "CodedOutputData.h"
+#include "MiniPBCoder.h"
+#include "PBUtility.h"
 #include "aes/AESCrypt.h"
 #include "crc32/Checksum.h"
+#include "InterProcessLock.h"
+#include "MMKVMetaInfo.hpp"
 #include "MemoryFile.h"
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstdio>
@@ -34,9 +40,16 @@
 #include <iostream>
 #include <limits.h>
 #include <limits>
+#include <map>
 #include <numeric>
+#include <poll.h>
+#include <random>
+#include <sched.h>
 #include <new>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
@@ -665,6 +678,1795 @@ void testMinimalBackupRestore(const string &rootDir) {
     printf("test minimal backup and restore hardening: passed\n");
 }
 
+static void writeDirectEncodingSample(MMKV *mmkv) {
+    mmkv->clearAll();
+    assert(mmkv->set(true, "bool"));
+    assert(mmkv->set(numeric_limits<int32_t>::min(), "int32"));
+    assert(mmkv->set(numeric_limits<uint32_t>::max(), "uint32"));
+    assert(mmkv->set(numeric_limits<int64_t>::min(), "int64"));
+    assert(mmkv->set(numeric_limits<uint64_t>::max(), "uint64"));
+    assert(mmkv->set(3.14f, "float"));
+    assert(mmkv->set(numeric_limits<double>::max(), "double"));
+    assert(mmkv->set(string(300, 's'), "string"));
+    assert(mmkv->set(string(), "empty"));
+    // override existing keys, the key bytes get reused from the file
+    assert(mmkv->set(-1, "int32"));
+    assert(mmkv->set(string("short"), "string"));
+}
+
+void testDirectEncoding(MMKV *mmkv) {
+    // compare-before-set forces the MMBuffer path, the file layout must be identical
+    auto reference = MMKV::mmkvWithID("direct_encoding_reference");
+    reference->enableCompareBeforeSet();
+    writeDirectEncodingSample(mmkv);
+    writeDirectEncodingSample(reference);
+    assert(mmkv->actualSize() == reference->actualSize());
+    reference->clearAll();
+    reference->close();
+
+    // single key goes through the override path
+    mmkv->clearAll();
+    assert(mmkv->set(1, "only"));
+    assert(mmkv->set(2, "only"));
+    assert(mmkv->getInt32("only") == 2);
+
+    auto reload = MMKV::mmkvWithID("direct_encoding_reload");
+    writeDirectEncodingSample(reload);
+    reload->close();
+    reload = MMKV::mmkvWithID("direct_encoding_reload");
+    string value;
+    assert(reload->getBool("bool"));
+    assert(reload->getInt32("int32") == -1);
+    assert(reload->getUInt32("uint32") == numeric_limits<uint32_t>::max());
+    assert(reload->getInt64("int64") == numeric_limits<int64_t>::min());
+    assert(reload->getUInt64("uint64") == numeric_limits<uint64_t>::max());
+    assert(reload->getFloat("float") == 3.14f);
+    assert(reload->getDouble("double") == numeric_limits<double>::max());
+    assert(reload->getString("string", value) && value == "short");
+    assert(reload->getString("empty", value) && value.empty());
+    assert(reload->count() == 9);
+    reload->clearAll();
+    mmkv->clearAll();
+
+    printf("test direct encoding: passed\n");
+}
+
+void testExceptionFreeDecode(MMKV *mmkv) {
+    int32_t i32 = 0;
+    const uint8_t varint[] = {0x96, 0x01};
+    assert(CodedInputData(varint, sizeof(varint)).tryReadInt32(i32) && i32 == 150);
+
+    const uint8_t truncatedVarint[] = {0x80, 0x80};
+    assert(!CodedInputData(truncatedVarint, sizeof(truncatedVarint)).tryReadInt32(i32));
+
+    const uint8_t malformedVarint[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    int64_t i64 = 0;
+    assert(!CodedInputData(malformedVarint, sizeof(malformedVarint)).tryReadInt64(i64));
+
+    double d = 0;
+    const uint8_t truncatedFixed[] = {1, 2, 3};
+    assert(!CodedInputData(truncatedFixed, sizeof(truncatedFixed)).tryReadDouble(d));
+    assert(!CodedInputData(truncatedFixed, sizeof(truncatedFixed)).trySeek(4));
+
+    string str;
+    const uint8_t truncatedString[] = {0x05, 'a', 'b'};
+    assert(!CodedInputData(truncatedString, sizeof(truncatedString)).tryReadString(str));
+
+    MMBuffer data;
+    const uint8_t negativeSize[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x0F};
+    assert(!CodedInputData(negativeSize, sizeof(negativeSize)).tryReadData(data));
+
+    // the throwing API keeps its contract
+    bool thrown = false;
+    try {
+        CodedInputData(truncatedString, sizeof(truncatedString)).readString();
+    } catch (const out_of_range &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // one valid item followed by a truncated one
+    array<uint8_t, 32> storage{};
+    CodedOutputData output(storage.data(), storage.size());
+    output.writeUInt32(0);
+    output.writeString("key");
+    output.writeData(MMBuffer((void *) "value", 5, MMBufferNoCopy));
+    output.writeString("key2");
+    output.writeUInt32(10);
+    MMBuffer mapData(storage.data(), output.getPosition(), MMBufferNoCopy);
+
+    MMKVMap dic;
+    MiniPBCoder::decodeMap(dic, mapData);
+    assert(dic.empty());
+    MiniPBCoder::greedyDecodeMap(dic, mapData);
+    assert(dic.size() == 1 && dic.find(string("key")) != dic.end());
+
+    vector<string> strings;
+    assert(!MiniPBCoder::decodeVector(MMBuffer((void *) truncatedString, sizeof(truncatedString), MMBufferNoCopy), strings));
+
+    // a corrupted value reads as missing instead of throwing
+    mmkv->set((int32_t) 200, "exception_free");
+    bool hasValue = false;
+    assert(mmkv->getInt32("exception_free", -1, &hasValue) == 200 && hasValue);
+    assert(!mmkv->getString("exception_free", str));
+    assert(!mmkv->getBytes("exception_free", data));
+    assert(mmkv->getDouble("exception_free", -1.0, &hasValue) == -1.0 && !hasValue);
+    mmkv->removeValueForKey("exception_free");
+
+    printf("test exception-free decode: passed\n");
+}
+
+// runs of one-byte or two-byte varints are decoded by blocks, the rest one by one
+template <typename T>
+static vector<T> makeVarintSample(size_t count, uint32_t seed) {
+    mt19937_64 engine(seed);
+    vector<T> values;
+    while (values.size() < count) {
+        auto run = engine() % 70;
+        auto bits = engine() % (sizeof(T) * 8 + 1);
+        for (size_t i = 0; i < run && values.size() < count; i++) {
+            auto value = (bits == 0) ? 0 : engine() >> (64 - bits);
+            values.push_back(static_cast<T>(value));
+        }
+    }
+    return values;
+}
+
+template <typename T>
+static MMBuffer encodeVarintSample(const vector<T> &values) {
+    MMBuffer buffer(values.size() * 10);
+    CodedOutputData output(buffer.getPtr(), buffer.length());
+    for (auto value : values) {
+        if constexpr (sizeof(T) == sizeof(uint32_t)) {
+            output.writeInt32(static_cast<int32_t>(value));
+        } else {
+            output.writeInt64(static_cast<int64_t>(value));
+        }
+    }
+    return MMBuffer(buffer.getPtr(), output.getPosition());
+}
+
+template <typename T>
+static void checkBulkVarintDecode(const vector<T> &values) {
+    auto data = encodeVarintSample(values);
+
+    vector<T> decoded;
+    CodedInputData input(data.getPtr(), data.length());
+    assert(input.tryReadPackedVarints(decoded) && input.isAtEnd());
+    assert(decoded == values);
+
+    // truncated in the middle of the last varint
+    if (data.length() > 0 && values.back() >= 0x80) {
+        decoded.clear();
+        CodedInputData truncated(data.getPtr(), data.length() - 1);
+        assert(!truncated.tryReadPackedVarints(decoded) && decoded.empty());
+    }
+}
+
+void testBulkVarintDecode() {
+    for (auto useScalar : {false, true}) {
+        pbUseScalarVarintDecoder(useScalar);
+        for (size_t count : {0, 1, 15, 16, 17, 31, 32, 33, 100, 1000, 10000}) {
+            checkBulkVarintDecode(makeVarintSample<int32_t>(count, count));
+            checkBulkVarintDecode(makeVarintSample<uint32_t>(count, count + 1));
+            checkBulkVarintDecode(makeVarintSample<int64_t>(count, count + 2));
+            checkBulkVarintDecode(makeVarintSample<uint64_t>(count, count + 3));
+        }
+
+        // all two-byte varints
+        vector<uint32_t> twoBytes(1000);
+        iota(twoBytes.begin(), twoBytes.end(), 0x80);
+        checkBulkVarintDecode(twoBytes);
+        checkBulkVarintDecode(vector<uint64_t>(twoBytes.begin(), twoBytes.end()));
+
+        // a varint longer than 10 bytes, inside and outside of a SIMD block
+        for (size_t prefix : {0, 30, 40}) {
+            vector<uint8_t> malformed(prefix, 1);
+            malformed.insert(malformed.end(), 11, 0x80);
+            malformed.push_back(1);
+            malformed.insert(malformed.end(), 40, 1);
+            vector<int64_t> decoded;
+            CodedInputData input(malformed.data(), malformed.size());
+            assert(!input.tryReadPackedVarints(decoded));
+        }
+    }
+    pbUseScalarVarintDecoder(false);
+
+    printf("test bulk varint decode (%s): passed\n", pbVarintDecoderName());
+}
+
+template <typename T>
+static void checkAlignedVector(MMKV *mmkv, const vector<T> &values, const string &key, bool zeroCopy) {
+    assert(mmkv->setAlignedVector(values, key));
+    MMKVVectorView<T> view;
+    assert(mmkv->getVectorView(key, view));
+    assert(view.isZeroCopy() == zeroCopy);
+    assert(reinterpret_cast<uintptr_t>(view.data()) % alignof(T) == 0);
+    assert(equal(view.begin(), view.end(), values.begin(), values.end()));
+}
+
+void testAlignedVector(MMKV *mmkv) {
+    vector<float> floats(1000);
+    iota(floats.begin(), floats.end(), 0.5f);
+    vector<double> doubles(floats.begin(), floats.end());
+    vector<int64_t> int64s = {numeric_limits<int64_t>::min(), -1, 0, numeric_limits<int64_t>::max()};
+    vector<uint16_t> uint16s = {1, 2, 3};
+
+    // mix the alignment of the file position
+    mmkv->set("x", "aligned_x");
+    checkAlignedVector(mmkv, floats, "aligned_float", true);
+    mmkv->set("xy", "aligned_x");
+    checkAlignedVector(mmkv, doubles, "aligned_double", true);
+    mmkv->set("xyz", "aligned_x");
+    checkAlignedVector(mmkv, int64s, "aligned_int64", true);
+    checkAlignedVector(mmkv, uint16s, "aligned_uint16", true);
+    checkAlignedVector(mmkv, vector<double>(), "aligned_empty", true);
+
+    MMKVVectorView<int32_t> wrongType;
+    assert(!mmkv->getVectorView("aligned_float", wrongType) && wrongType.empty());
+    assert(!mmkv->getVectorView(KeyNotExist, wrongType));
+    MMKVVectorView<double> notAligned;
+    assert(!mmkv->getVectorView("aligned_x", notAligned));
+
+    // a full writeback moves the elements, whether they're still aligned or not the content survives
+    mmkv->removeValuesForKeys({"aligned_x", "aligned_uint16"});
+    {
+        MMKVVectorView<double> view;
+        assert(mmkv->getVectorView("aligned_double", view));
+        assert(equal(view.begin(), view.end(), doubles.begin(), doubles.end()));
+        auto moved = std::move(view);
+        assert(view.empty() && !view.isZeroCopy());
+        assert(moved.size() == doubles.size() && moved[1] == doubles[1]);
+    }
+
+    // a view pins the file without any lock, the writes that would move it are refused until it's gone
+    {
+        MMKVVectorView<float> view;
+        assert(mmkv->setAlignedVector(floats, "aligned_float"));
+        assert(mmkv->getVectorView("aligned_float", view) && view.isZeroCopy());
+        thread([mmkv] { assert(mmkv->set("appended", "aligned_append")); }).join();
+        string big(mmkv->totalSize(), 'x');
+        assert(!mmkv->set(big, "aligned_big"));
+        mmkv->clearAll();
+        assert(mmkv->containsKey("aligned_float"));
+        assert(equal(view.begin(), view.end(), floats.begin(), floats.end()));
+
+        // dropped on another thread
+        thread([moved = std::move(view)] { assert(moved.isZeroCopy()); }).join();
+        assert(mmkv->set(big, "aligned_big"));
+        string result;
+        assert(mmkv->getString("aligned_append", result) && result == "appended");
+        assert(mmkv->getVectorView("aligned_float", view));
+        assert(equal(view.begin(), view.end(), floats.begin(), floats.end()));
+        mmkv->removeValuesForKeys({"aligned_append", "aligned_big"});
+    }
+
+    // the only key removed, the next one is appended instead of overriding the file from the start
+    auto single = MMKV::mmkvWithID("aligned_vector_single");
+    single->clearAll();
+    // room for the appends, as a pinned file can't be expanded
+    assert(single->set(string(64 * 1024, 'f'), "f"));
+    single->removeValueForKey("f");
+    for (int round = 0; round < 2; round++) {
+        MMKVVectorView<float> view;
+        assert(single->setAlignedVector(floats, "a") && single->getVectorView("a", view) && view.isZeroCopy());
+        single->removeValueForKey("a");
+        assert(single->set(string(100, 'b'), "b"));
+        assert(equal(view.begin(), view.end(), floats.begin(), floats.end()));
+        single->removeValueForKey("b");
+    }
+    single->clearAll();
+
+    // other processes might rewrite the file anytime, so is a decrypted value gone anytime
+    auto multi = MMKV::mmkvWithID("aligned_vector_multi", MMKV_MULTI_PROCESS);
+    checkAlignedVector(multi, doubles, "aligned_double", false);
+    multi->clearAll();
+
+    string aesKey = "aligned";
+    auto crypt = MMKV::mmkvWithID("aligned_vector_crypt", MMKV_SINGLE_PROCESS, &aesKey);
+    checkAlignedVector(crypt, doubles, "aligned_double", false);
+    crypt->clearAll();
+
+    mmkv->removeValuesForKeys({"aligned_float", "aligned_double", "aligned_int64", "aligned_empty"});
+    printf("test aligned vector: passed\n");
+}
+
+struct PODPoint {
+    double x;
+    double y;
+    int32_t id;
+    char name[12];
+};
+
+struct PODPointV2 {
+    static constexpr uint32_t MMKVPODTag = 2;
+    double x;
+    double y;
+    int32_t id;
+    char name[12];
+};
+
+struct alignas(64) PODCacheLine {
+    uint64_t words[8];
+};
+
+void testPOD(MMKV *mmkv) {
+    PODPoint point = {1.5, -2.5, 42, "origin"};
+    mmkv->set("x", "pod_x");
+    assert(mmkv->setPOD(point, "pod_point"));
+    PODPoint decoded = {};
+    assert(mmkv->getPOD("pod_point", decoded));
+    assert(memcmp(&decoded, &point, sizeof(point)) == 0);
+    {
+        MMKVPODView<PODPoint> view;
+        assert(mmkv->getPODView("pod_point", view));
+        assert(view.isZeroCopy() && view->id == 42 && strcmp(view.value().name, "origin") == 0);
+    }
+
+    // same size & alignment but a different tag, or a different size, or not a POD at all
+    PODPointV2 v2 = {};
+    assert(!mmkv->getPOD("pod_point", v2));
+    int64_t wrongSize = 0;
+    assert(!mmkv->getPOD("pod_point", wrongSize));
+    assert(!mmkv->getPOD("pod_x", decoded));
+    assert(!mmkv->getPOD(KeyNotExist, decoded));
+    MMKVVectorView<double> vectorView;
+    assert(!mmkv->getVectorView("pod_point", vectorView));
+
+    PODCacheLine line = {{1, 2, 3, 4, 5, 6, 7, 8}};
+    assert(mmkv->setPOD(line, "pod_line"));
+    {
+        MMKVPODView<PODCacheLine> view;
+        assert(mmkv->getPODView("pod_line", view));
+        assert(reinterpret_cast<uintptr_t>(view.data()) % alignof(PODCacheLine) == 0);
+        assert(view->words[7] == 8);
+    }
+
+    string aesKey = "pod";
+    auto crypt = MMKV::mmkvWithID("pod_crypt", MMKV_SINGLE_PROCESS, &aesKey);
+    assert(crypt->setPOD(point, "pod_point"));
+    {
+        MMKVPODView<PODPoint> view;
+        assert(crypt->getPODView("pod_point", view));
+        assert(!view.isZeroCopy() && view->x == point.x && view->y == point.y);
+    }
+    crypt->clearAll();
+
+    mmkv->removeValuesForKeys({"pod_x", "pod_point", "pod_line"});
+    printf("test POD: passed\n");
+}
+
+static MMBuffer makeStreamValue(size_t size, uint8_t seed) {
+    MMBuffer value(size);
+    auto ptr = (uint8_t *) value.getPtr();
+    for (size_t index = 0; index < size; index++) {
+        ptr[index] = static_cast<uint8_t>(index * 31 + seed);
+    }
+    return value;
+}
+
+static void streamValue(MMKV *kv, const string &key, const MMBuffer &value, size_t chunkSize) {
+    MMKVValueWriter writer;
+    assert(kv->openValueWriter(key, value.length(), writer));
+    auto ptr = (const uint8_t *) value.getPtr();
+    for (size_t offset = 0; offset < value.length(); offset += chunkSize) {
+        assert(writer.write(ptr + offset, min(chunkSize, value.length() - offset)));
+    }
+    assert(writer.commit() && !writer.isOpen());
+}
+
+static void checkStreamValue(MMKV *kv, const string &key, const MMBuffer &value, size_t chunkSize) {
+    assert(kv->getBytes(key) == value);
+    MMKVValueReader reader;
+    assert(kv->openValueReader(key, reader));
+    assert(reader.size() == value.length());
+    vector<uint8_t> chunk(chunkSize);
+    size_t offset = 0;
+    while (auto length = reader.read(chunk.data(), chunk.size())) {
+        assert(memcmp(chunk.data(), (const uint8_t *) value.getPtr() + offset, length) == 0);
+        offset += length;
+    }
+    assert(offset == value.length() && reader.remaining() == 0);
+}
+
+static void testValueStream(MMKV *kv) {
+    auto large = makeStreamValue(3 * 1024 * 1024 + 7, 1);
+    auto small = makeStreamValue(100, 2);
+    kv->set("x", "stream_x");
+    streamValue(kv, "stream_large", large, 64 * 1024 + 3);
+    streamValue(kv, "stream_small", small, 7);
+    checkStreamValue(kv, "stream_large", large, 4096);
+    checkStreamValue(kv, "stream_small", small, 13);
+    string str;
+    assert(kv->getString("stream_x", str) && str == "x");
+
+    // overflow is rejected, a short value is never committed, the old value survives both
+    {
+        MMKVValueWriter writer;
+        assert(kv->openValueWriter("stream_small", 10, writer));
+        assert(!writer.write(large.getPtr(), 11));
+        assert(writer.write(large.getPtr(), 9));
+        assert(!writer.commit() && !writer.isOpen());
+        assert(!writer.write(large.getPtr(), 1));
+    }
+    {
+        MMKVValueWriter writer;
+        assert(kv->openValueWriter("stream_small", large.length(), writer));
+        assert(writer.write(large.getPtr(), large.length() / 2));
+    }
+    checkStreamValue(kv, "stream_small", small, 13);
+    kv->set("y", "stream_y");
+    assert(kv->getString("stream_y", str) && str == "y");
+
+    // a value set the usual way streams out too
+    kv->set(small, "stream_set");
+    checkStreamValue(kv, "stream_set", small, 64);
+    MMKVValueReader reader;
+    assert(!kv->openValueReader(KeyNotExist, reader));
+    assert(!kv->openValueReader("stream_x", reader) || reader.size() == 1);
+    reader.close();
+
+    streamValue(kv, "stream_empty", MMBuffer(), 1);
+    checkStreamValue(kv, "stream_empty", MMBuffer(), 1);
+}
+
+void testValueStream() {
+    auto mmkv = MMKV::mmkvWithID("value_stream_test");
+    mmkv->clearAll();
+    testValueStream(mmkv);
+    mmkv->clearMemoryCache();
+    checkStreamValue(mmkv, "stream_large", makeStreamValue(3 * 1024 * 1024 + 7, 1), 4096);
+    mmkv->clearAll();
+
+#ifndef MMKV_DISABLE_CRYPT
+    string aesKey = "stream";
+    auto crypt = MMKV::mmkvWithID("value_stream_crypt_test", MMKV_SINGLE_PROCESS, &aesKey);
+    crypt->clearAll();
+    testValueStream(crypt);
+    crypt->clearMemoryCache();
+    checkStreamValue(crypt, "stream_large", makeStreamValue(3 * 1024 * 1024 + 7, 1), 4096);
+    checkStreamValue(crypt, "stream_small", makeStreamValue(100, 2), 13);
+    crypt->clearAll();
+#endif
+
+    auto expiring = MMKV::mmkvWithID("value_stream_expire_test");
+    expiring->clearAll();
+    assert(expiring->enableAutoKeyExpire());
+    testValueStream(expiring);
+    expiring->clearAll();
+
+    printf("test value stream: passed\n");
+}
+
+void testBlobSeparation(const string &rootDir) {
+    MMKVConfig config;
+    config.blobThreshold = 4 * 1024;
+    auto mmkv = MMKV::mmkvWithID("blob_separation_test", config);
+    mmkv->clearAll();
+
+    // large values go to the blob file, small ones stay in the log
+    string large(256 * 1024, 'a');
+    auto largeBytes = makeStreamValue(300 * 1024, 3);
+    assert(mmkv->set(large, "blob_string"));
+    assert(mmkv->set(largeBytes, "blob_bytes"));
+    assert(mmkv->set(true, "blob_flag"));
+    assert(mmkv->set("small", "blob_small"));
+    assert(mmkv->actualSize() < 4 * 1024);
+    assert(isFileExist(rootDir + "/blob_separation_test.blob"));
+
+    string str;
+    assert(mmkv->getString("blob_string", str) && str == large);
+    auto bytes = mmkv->getBytes("blob_bytes");
+    assert(bytes.length() == largeBytes.length() && memcmp(bytes.getPtr(), largeBytes.getPtr(), bytes.length()) == 0);
+    assert(mmkv->getBool("blob_flag"));
+    assert(mmkv->getString("blob_small", str) && str == "small");
+
+    // so do streamed ones
+    auto streamed = makeStreamValue(64 * 1024, 4);
+    auto actualSize = mmkv->actualSize();
+    streamValue(mmkv, "blob_streamed", streamed, 4099);
+    assert(mmkv->actualSize() - actualSize < 1024);
+    checkStreamValue(mmkv, "blob_streamed", streamed, 4096);
+
+    // overwrites leave garbage behind, which is collected lazily
+    for (char ch = 'b'; ch <= 'z'; ch++) {
+        large.assign(256 * 1024 + ch, ch);
+        assert(mmkv->set(large, "blob_string"));
+        assert(mmkv->getString("blob_string", str) && str == large);
+    }
+    bytes = mmkv->getBytes("blob_bytes");
+    assert(bytes.length() == largeBytes.length() && memcmp(bytes.getPtr(), largeBytes.getPtr(), bytes.length()) == 0);
+
+    // a small value replaces a separated one
+    assert(mmkv->set("tiny", "blob_bytes"));
+    mmkv->clearMemoryCache();
+    assert(mmkv->getString("blob_string", str) && str == large);
+    assert(mmkv->getString("blob_bytes", str) && str == "tiny");
+
+    mmkv->trim();
+    assert(mmkv->getString("blob_string", str) && str == large);
+    assert(mmkv->getBool("blob_flag"));
+
+    // pointers survive enabling key expiration
+    assert(mmkv->enableAutoKeyExpire());
+    assert(mmkv->getString("blob_string", str) && str == large);
+    assert(mmkv->set(largeBytes, "blob_bytes"));
+    assert(mmkv->disableAutoKeyExpire());
+    assert(mmkv->getString("blob_string", str) && str == large);
+    bytes = mmkv->getBytes("blob_bytes");
+    assert(bytes.length() == largeBytes.length() && memcmp(bytes.getPtr(), largeBytes.getPtr(), bytes.length()) == 0);
+
+    mmkv->clearAll();
+    assert(!mmkv->containsKey("blob_string"));
+    assert(mmkv->set(large, "blob_string"));
+    assert(mmkv->getString("blob_string", str) && str == large);
+    mmkv->close();
+
+    assert(MMKV::removeStorage("blob_separation_test"));
+    assert(!isFileExist(rootDir + "/blob_separation_test.blob"));
+
+    // nor is it left behind without a .crc file
+    mmkv = MMKV::mmkvWithID("blob_separation_test", config);
+    assert(mmkv->set(large, "blob_string"));
+    mmkv->close();
+    assert(deleteFile(rootDir + "/blob_separation_test.crc"));
+    assert(MMKV::removeStorage("blob_separation_test"));
+    assert(!isFileExist(rootDir + "/blob_separation_test"));
+    assert(!isFileExist(rootDir + "/blob_separation_test.blob"));
+
+    printf("test blob separation: passed\n");
+}
+
+static void checkSegmentedLog(MMKV *mmkv, const map<string, string> &expected) {
+    assert(mmkv->count() == expected.size());
+    string value;
+    for (auto &[key, expectedValue] : expected) {
+        assert(mmkv->getString(key, value) && value == expectedValue);
+    }
+}
+
+void testSegmentedLog() {
+    MMKVConfig config;
+    config.segmentSize = 16 * 1024;
+    auto mmkv = MMKV::mmkvWithID("segmented_log_test", config);
+    mmkv->clearAll();
+
+    // overwrites & removals, the file shouldn't grow with the number of writes
+    map<string, string> expected;
+    mt19937 random(33);
+    for (int round = 0; round < 20000; round++) {
+        auto key = "key_" + to_string(random() % 300);
+        if (random() % 5 == 0) {
+            mmkv->removeValueForKey(key);
+            expected.erase(key);
+        } else {
+            string value(random() % 200 + 1, static_cast<char>('a' + round % 26));
+            assert(mmkv->set(value, key));
+            expected[key] = value;
+        }
+    }
+    checkSegmentedLog(mmkv, expected);
+    assert(mmkv->totalSize() <= 32 * config.segmentSize);
+
+    // replay the segments, removed keys stay removed
+    mmkv->clearMemoryCache();
+    checkSegmentedLog(mmkv, expected);
+
+    // an item never spans segments
+    string huge(config.segmentSize, 'h');
+    assert(!mmkv->set(huge, "huge"));
+    assert(!mmkv->containsKey("huge"));
+    {
+        MMKVValueWriter writer;
+        string streamed(1000, 's');
+        assert(mmkv->openValueWriter("streamed", streamed.size(), writer));
+        assert(writer.write(streamed.data(), streamed.size()) && writer.commit());
+        expected["streamed"] = streamed;
+    }
+    assert(!mmkv->enableAutoKeyExpire());
+
+    vector<string> removing;
+    for (auto itr = expected.begin(); itr != expected.end() && removing.size() < 50;) {
+        removing.push_back(itr->first);
+        itr = expected.erase(itr);
+    }
+    assert(mmkv->removeValuesForKeys(removing));
+    checkSegmentedLog(mmkv, expected);
+    mmkv->clearMemoryCache();
+    checkSegmentedLog(mmkv, expected);
+
+    auto oldSize = mmkv->totalSize();
+    mmkv->trim();
+    assert(mmkv->totalSize() <= oldSize);
+    checkSegmentedLog(mmkv, expected);
+    mmkv->close();
+
+    // the layout is kept without asking for it
+    mmkv = MMKV::mmkvWithID("segmented_log_test");
+    checkSegmentedLog(mmkv, expected);
+    assert(mmkv->set("value", "key"));
+    mmkv->clearAll();
+    assert(mmkv->count() == 0);
+    assert(mmkv->set("value", "key"));
+    mmkv->clearMemoryCache();
+    checkSegmentedLog(mmkv, {{"key", "value"}});
+    mmkv->close();
+
+    printf("test segmented log: passed\n");
+}
+
+void testPartitioned() {
+    constexpr uint32_t partitionCount = 4;
+    MMKVConfig config;
+    config.mode = MMKV_MULTI_PROCESS;
+    auto store = MMKVPartitioned::mmkvWithID("partitioned_test", partitionCount, config);
+    assert(store.isValid() && store.partitionCount() == partitionCount);
+    store.clearAll();
+
+    for (int index = 0; index < 200; index++) {
+        auto key = "key_" + to_string(index);
+        assert(store.set(index, key));
+        assert(store.set("value_" + to_string(index), "str_" + to_string(index)));
+        assert(store.partitionForKey(key) == store.partitionForKey(key));
+    }
+    assert(store.set(true, "bool"));
+    assert(store.set(3.5, "double"));
+    assert(store.count() == 402);
+    assert(store.allKeys().size() == 402);
+    for (size_t index = 0; index < partitionCount; index++) {
+        // every partition takes a share of the keys
+        assert(store.partitionAt(index)->count() > 0);
+    }
+    assert(store.getBool("bool") && store.getDouble("double") == 3.5);
+
+    vector<string> removing;
+    for (int index = 0; index < 100; index++) {
+        removing.push_back("key_" + to_string(index));
+    }
+    assert(store.removeValuesForKeys(removing));
+    assert(store.removeValueForKey("bool"));
+    assert(store.count() == 301);
+
+    // reopen, the keys should land in the same partitions
+    store.close();
+    assert(!store.isValid());
+    store = MMKVPartitioned::mmkvWithID("partitioned_test", partitionCount, config);
+    assert(store.count() == 301 && !store.containsKey("bool"));
+    for (int index = 0; index < 200; index++) {
+        auto key = "key_" + to_string(index);
+        assert(store.containsKey(key) == (index >= 100));
+        assert(index < 100 || store.getInt32(key) == index);
+        string value;
+        assert(store.getString("str_" + to_string(index), value) && value == "value_" + to_string(index));
+    }
+
+    store.clearAll();
+    assert(store.count() == 0);
+    store.close();
+    assert(MMKVPartitioned::removeStorage("partitioned_test", partitionCount));
+    for (uint32_t index = 0; index < partitionCount; index++) {
+        assert(!MMKV::checkExist("partitioned_test." + to_string(index) + "of" + to_string(partitionCount)));
+    }
+    assert(!MMKVPartitioned::mmkvWithID("partitioned_test", 0).isValid());
+}
+
+#ifdef MMKV_LINUX
+static void checkSharedMemoryLockRecovery(FileLock &fileLock, LockType lockType) {
+    auto pid = fork();
+    if (pid == 0) {
+        fileLock.lock(lockType);
+        _exit(0);
+    }
+    // a zombie won't unlock anything either
+    siginfo_t info = {};
+    assert(waitid(P_PID, pid, &info, WEXITED | WNOWAIT) == 0);
+    assert(fileLock.lock(ExclusiveLockType));
+    assert(fileLock.unlock(ExclusiveLockType));
+    waitpid(pid, nullptr, 0);
+}
+
+void testSharedMemoryLock(const string &rootDir) {
+    auto path = rootDir + "/shared_memory_lock.file";
+    auto fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, S_IRWXU);
+    assert(fd >= 0 && ftruncate(fd, 4096) == 0);
+    auto ptr = mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    assert(ptr != MAP_FAILED);
+    memset(ptr, 0, 4096);
+    {
+        FileLock fileLock(fd);
+        fileLock.enableSharedMemoryLock(ptr);
+        assert(fileLock.isSharedMemoryLock());
+
+        // taken back from a dead holder
+        checkSharedMemoryLockRecovery(fileLock, SharedLockType);
+        checkSharedMemoryLockRecovery(fileLock, ExclusiveLockType);
+
+        // alive until killed, whatever its pid is
+        {
+            int toParent[2];
+            assert(pipe(toParent) == 0);
+            auto pid = fork();
+            if (pid == 0) {
+                fileLock.lock(ExclusiveLockType);
+                char c = 0;
+                assert(write(toParent[1], &c, 1) == 1);
+                pause();
+                _exit(0);
+            }
+            char c = 0;
+            assert(read(toParent[0], &c, 1) == 1);
+            bool tryAgain = false;
+            assert(!fileLock.try_lock(SharedLockType, &tryAgain) && tryAgain);
+            kill(pid, SIGKILL);
+            siginfo_t info = {};
+            assert(waitid(P_PID, pid, &info, WEXITED | WNOWAIT) == 0);
+            assert(fileLock.lock(ExclusiveLockType));
+            assert(fileLock.unlock(ExclusiveLockType));
+            waitpid(pid, nullptr, 0);
+            close(toParent[0]);
+            close(toParent[1]);
+        }
+
+        // died in another pid namespace, where our pids mean nothing, skipped if we can't make one
+        {
+            auto state = (SharedMemoryLockState *) ptr;
+            auto pid = fork();
+            if (pid == 0) {
+                if (unshare(CLONE_NEWPID) != 0) {
+                    _exit(1);
+                }
+                auto holder = fork();
+                if (holder == 0) {
+                    fileLock.lock(ExclusiveLockType);
+                    _exit(0);
+                }
+                _exit(waitpid(holder, nullptr, 0) == holder ? 0 : 1);
+            }
+            int status = 0;
+            waitpid(pid, &status, 0);
+            if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+                assert(state->writer.load() != 0);
+                assert(fileLock.lock(ExclusiveLockType));
+                assert(fileLock.unlock(ExclusiveLockType));
+            }
+        }
+
+        // excluded by a live holder
+        int toChild[2], toParent[2];
+        assert(pipe(toChild) == 0 && pipe(toParent) == 0);
+        auto pid = fork();
+        if (pid == 0) {
+            fileLock.lock(ExclusiveLockType);
+            char c = 0;
+            assert(write(toParent[1], &c, 1) == 1);
+            assert(read(toChild[0], &c, 1) == 1);
+            fileLock.unlock(ExclusiveLockType);
+            _exit(0);
+        }
+        char c = 0;
+        assert(read(toParent[0], &c, 1) == 1);
+        bool tryAgain = false;
+        assert(!fileLock.try_lock(SharedLockType, &tryAgain) && tryAgain);
+        assert(write(toChild[1], &c, 1) == 1);
+        assert(fileLock.lock(SharedLockType));
+        // upgrade & downgrade
+        assert(fileLock.lock(ExclusiveLockType));
+        assert(fileLock.unlock(ExclusiveLockType));
+        assert(fileLock.unlock(SharedLockType));
+        waitpid(pid, nullptr, 0);
+        for (int pipeFd : {toChild[0], toChild[1], toParent[0], toParent[1]}) {
+            close(pipeFd);
+        }
+    }
+    munmap(ptr, 4096);
+    close(fd);
+
+    // flock() can't tell a parent from its forked children, the shared-memory lock can
+    MMKVConfig config;
+    config.mode = MMKV_MULTI_PROCESS;
+    config.sharedMemoryLock = true;
+    auto mmkv = MMKV::mmkvWithID("shared_memory_lock_test", config);
+    mmkv->clearAll();
+    constexpr int processes = 3;
+    constexpr int loops = 300;
+    vector<pid_t> children;
+    for (int index = 1; index < processes; index++) {
+        auto pid = fork();
+        if (pid == 0) {
+            for (int loop = 0; loop < loops; loop++) {
+                mmkv->lock();
+                mmkv->set(mmkv->getInt32("counter") + 1, "counter");
+                mmkv->unlock();
+            }
+            _exit(0);
+        }
+        children.push_back(pid);
+    }
+    for (int loop = 0; loop < loops; loop++) {
+        mmkv->lock();
+        mmkv->set(mmkv->getInt32("counter") + 1, "counter");
+        mmkv->unlock();
+    }
+    for (auto pid : children) {
+        waitpid(pid, nullptr, 0);
+    }
+    assert(mmkv->getInt32("counter") == processes * loops);
+
+    // a backup doesn't carry the lock state along
+    auto backupDir = rootDir + "/shared_memory_lock_backup";
+    mmkv->lock();
+    assert(MMKV::backupOneToDirectory("shared_memory_lock_test", backupDir));
+    mmkv->unlock();
+    File backupCRC(backupDir + "/shared_memory_lock_test.crc", OpenFlag::ReadOnly);
+    uint8_t lockState[sizeof(SharedMemoryLockState)];
+    assert(pread(backupCRC.getFd(), lockState, sizeof(lockState), SharedMemoryLockOffset) == sizeof(lockState));
+    assert(all_of(begin(lockState), end(lockState), [](uint8_t byte) { return byte == 0; }));
+    mmkv->clearAll();
+}
+
+struct ChangeCounter : public mmkv::MMKVHandler {
+    atomic<int> changes = 0;
+    void onContentChangedByOuterProcess(const string &mmapID) override {
+        if (mmapID == "change_notification_test") {
+            changes++;
+        }
+    }
+};
+
+void testChangeNotification() {
+    auto mmkv = MMKV::mmkvWithID("change_notification_test", MMKV_MULTI_PROCESS);
+    mmkv->clearAll();
+    ChangeCounter handler;
+    MMKV::registerHandler(&handler);
+    auto fd = mmkv->enableChangeNotification();
+    assert(fd >= 0 && mmkv->enableChangeNotification() == fd);
+    pollfd pfd = {fd, POLLIN, 0};
+
+    // our own change is no news
+    mmkv->set(1, "int");
+    assert(poll(&pfd, 1, 100) == 0);
+
+    // a change by another process is pushed without touching the instance
+    auto pid = fork();
+    if (pid == 0) {
+        mmkv->set(2, "int");
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+    assert(poll(&pfd, 1, 1000) == 1);
+    uint64_t count = 0;
+    assert(read(fd, &count, sizeof(count)) == sizeof(count) && count >= 1);
+    assert(handler.changes >= 1);
+    assert(mmkv->getInt32("int") == 2);
+
+    mmkv->disableChangeNotification();
+    MMKV::unRegisterHandler();
+    MMKVConfig config;
+    config.mode = MMKV_SINGLE_PROCESS;
+    assert(MMKV::mmkvWithID("change_notification_single", config)->enableChangeNotification() < 0);
+    mmkv->clearAll();
+}
+#endif
+
+void testMetaGeneration(const string &rootDir) {
+    auto mmkv = MMKV::mmkvWithID("meta_generation_test", MMKV_MULTI_PROCESS);
+    mmkv->clearAll();
+    MemoryFile metaFile(rootDir + "/meta_generation_test.crc", 0, true);
+    assert(metaFile.isFileValid());
+    auto generation = metaGeneration(metaFile.getMemory());
+
+    auto before = generation->load();
+    assert(mmkv->set("parent", "key"));
+    assert(generation->load() > before);
+
+    // reading an unchanged store doesn't change it
+    before = generation->load();
+    string value;
+    assert(mmkv->getString("key", value) && value == "parent");
+    assert(generation->load() == before);
+
+    // a change from another process is noticed
+    auto pid = fork();
+    if (pid == 0) {
+        mmkv->set("child", "key");
+        mmkv->set(true, "child-bool");
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+    assert(generation->load() > before);
+    assert(mmkv->getString("key", value) && value == "child");
+    assert(mmkv->getBool("child-bool"));
+
+    // without optimisticRead the meta info is checked regardless, a writer of an older version doesn't move it on
+    pid = fork();
+    if (pid == 0) {
+        MemoryFile writableMetaFile(rootDir + "/meta_generation_test.crc");
+        auto writableGeneration = metaGeneration(writableMetaFile.getMemory());
+        before = writableGeneration->load();
+        mmkv->set("older", "key");
+        writableGeneration->store(before);
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+    assert(mmkv->getString("key", value) && value == "older");
+    mmkv->clearAll();
+}
+
+// getters read without the lock while another process keeps rewriting the file, never seeing a torn value
+void testOptimisticRead(const string &rootDir) {
+    MMKVConfig config;
+    config.mode = MMKV_MULTI_PROCESS;
+    config.optimisticRead = true;
+
+    // each process opens the file by itself, a forked instance would share the file lock of its parent
+    constexpr int Rounds = 3000;
+    auto pid = fork();
+    if (pid == 0) {
+        auto mmkv = MMKV::mmkvWithID("optimistic_read_test", config);
+        mmkv->clearAll();
+        for (int index = 0; index < 100; index++) {
+            mmkv->set(string(1000, 'b'), "big" + to_string(index));
+        }
+        for (int index = 1; index <= Rounds; index++) {
+            mmkv->set(string(100 + index % 500, 'a' + index % 26), "key");
+            mmkv->set(index, "int");
+            if (index % 500 == 250) {
+                mmkv->clearAll();
+                mmkv->set(string(100, 'a'), "key");
+            }
+        }
+        mmkv->trim();
+        _exit(0);
+    }
+    auto mmkv = MMKV::mmkvWithID("optimistic_read_test", config);
+    int reads = 0;
+    string value;
+    while (waitpid(pid, nullptr, WNOHANG) == 0) {
+        if (mmkv->getString("key", value)) {
+            assert(value.size() >= 100 && value.find_first_not_of(value[0]) == string::npos);
+        }
+        auto number = mmkv->getInt32("int");
+        assert(number >= 0 && number <= Rounds);
+        reads++;
+    }
+    assert(mmkv->getInt32("int") == Rounds && mmkv->getString("key", value));
+    printf("optimistic read: %d reads along %d rounds of writes\n", reads, Rounds);
+
+    // nor does anyone shrink the file under others
+    MemoryFile file(rootDir + "/optimistic_read_test", 0, true);
+    assert(file.getFileSize() > DEFAULT_MMAP_SIZE);
+    mmkv->clearAll();
+}
+
+// another process keeps its index across a compaction, and still gets everything right
+void testDeltaReload() {
+    auto mmkv = MMKV::mmkvWithID("delta_reload_test", MMKV_MULTI_PROCESS);
+    mmkv->clearAll();
+    const string payload(100, 'v');
+    constexpr int KeyCount = 2000;
+    for (int index = 0; index < KeyCount; index++) {
+        mmkv->set(payload + to_string(index), "key" + to_string(index));
+    }
+
+    for (int lagging = 0; lagging < 2; lagging++) {
+        int toChild[2], toParent[2];
+        assert(pipe(toChild) == 0 && pipe(toParent) == 0);
+        auto pid = fork();
+        if (pid == 0) {
+            char c = 0;
+            bool ok = true;
+            for (int round = 0; round < 3 && ok; round++) {
+                ok = ok && read(toChild[0], &c, 1) == 1;
+                // a lagging peer misses the changes right before the compaction
+                if (!lagging || round != 1) {
+                    ok = ok && mmkv->count() == KeyCount + (round > 0 ? 1 : 0);
+                    for (int index = 0; index < KeyCount && ok; index++) {
+                        string value;
+                        ok = mmkv->getString("key" + to_string(index), value) &&
+                             value == ((index % 2 == 0 && round > 0) ? "new" : payload) + to_string(index);
+                    }
+                }
+                ok = ok && write(toParent[1], &c, 1) == 1;
+            }
+            ok = ok && mmkv->getInt32("appended") == 2;
+            _exit(ok ? 0 : 1);
+        }
+        char c = 0;
+        assert(write(toChild[1], &c, 1) == 1 && read(toParent[0], &c, 1) == 1);
+        // leave garbage behind, then squeeze it out
+        for (int index = 0; index < KeyCount; index += 2) {
+            mmkv->set("new" + to_string(index), "key" + to_string(index));
+        }
+        mmkv->set(1, "appended");
+        assert(write(toChild[1], &c, 1) == 1 && read(toParent[0], &c, 1) == 1);
+        mmkv->trim();
+        mmkv->set(2, "appended");
+        assert(write(toChild[1], &c, 1) == 1 && read(toParent[0], &c, 1) == 1);
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        for (int fd : {toChild[0], toChild[1], toParent[0], toParent[1]}) {
+            ::close(fd);
+        }
+        mmkv->removeValueForKey("appended");
+        for (int index = 0; index < KeyCount; index += 2) {
+            mmkv->set(payload + to_string(index), "key" + to_string(index));
+        }
+    }
+    mmkv->clearAll();
+    printf("test delta reload: passed\n");
+}
+
+// every process looks keys up in the same index file, instead of decoding the file on its own
+void testSharedIndex(const string &rootDir) {
+    MMKVConfig config;
+    config.mode = MMKV_MULTI_PROCESS;
+    config.sharedIndex = true;
+    auto mmkv = MMKV::mmkvWithID("shared_index_test", config);
+    mmkv->clearAll();
+    // more keys than the smallest table holds
+    constexpr int KeyCount = 1000;
+    for (int index = 0; index < KeyCount; index++) {
+        mmkv->set("value" + to_string(index), "key" + to_string(index));
+    }
+    assert(access((rootDir + "/shared_index_test.idx").c_str(), F_OK) == 0);
+    assert(mmkv->count() == KeyCount && mmkv->allKeys().size() == KeyCount);
+    mmkv->set("overwritten", "key0");
+    assert(mmkv->removeValueForKey("key1") && !mmkv->removeValueForKey("key1"));
+    assert(!mmkv->containsKey("key1") && mmkv->containsKey("key2") && mmkv->count() == KeyCount - 1);
+    string value;
+    assert(mmkv->getString("key0", value) && value == "overwritten");
+    assert(mmkv->getString("key999", value) && value == "value999");
+
+    // a new process opens it from the index, its changes are seen here
+    auto pid = fork();
+    if (pid == 0) {
+        mmkv->close();
+        auto kv = MMKV::mmkvWithID("shared_index_test", config);
+        string str;
+        bool ok = kv->count() == KeyCount - 1 && kv->getString("key0", str) && str == "overwritten";
+        for (int index = 2; index < KeyCount && ok; index++) {
+            ok = kv->getString("key" + to_string(index), str) && str == "value" + to_string(index);
+        }
+        kv->set("child", "key1");
+        kv->removeValueForKey("key2");
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(mmkv->getString("key1", value) && value == "child");
+    assert(!mmkv->containsKey("key2") && mmkv->count() == KeyCount - 1);
+
+    // full write-backs borrow the keys and hand them back with new offsets
+    vector<string> keys;
+    for (int index = 0; index < KeyCount; index += 2) {
+        keys.push_back("key" + to_string(index));
+    }
+    assert(mmkv->removeValuesForKeys(keys));
+    mmkv->trim();
+    assert(mmkv->count() == KeyCount / 2);
+    for (int index = 1; index < KeyCount; index += 2) {
+        assert(mmkv->getString("key" + to_string(index), value) && value == (index == 1 ? "child" : "value" + to_string(index)));
+    }
+
+    // a process without the index leaves it behind, the next lookup here rebuilds it
+    pid = fork();
+    if (pid == 0) {
+        mmkv->close();
+        MMKVConfig plainConfig;
+        plainConfig.mode = MMKV_MULTI_PROCESS;
+        auto kv = MMKV::mmkvWithID("shared_index_test", plainConfig);
+        kv->set("plain", "key3");
+        _exit(kv->count() == KeyCount / 2 ? 0 : 1);
+    }
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(mmkv->getString("key3", value) && value == "plain");
+    assert(mmkv->getString("key5", value) && value == "value5");
+    assert(mmkv->count() == KeyCount / 2);
+
+    mmkv->clearAll();
+    assert(mmkv->count() == 0 && !mmkv->containsKey("key3"));
+    mmkv->set(1, "int");
+    assert(mmkv->getInt32("int") == 1 && mmkv->allKeys().size() == 1);
+    mmkv->clearAll();
+    printf("test shared index: passed\n");
+}
+
+void testBatchBytes() {
+    auto mmkv = MMKV::mmkvWithID("batch_bytes_test");
+    mmkv->clearAll();
+    vector<string> keyStorage, valueStorage;
+    for (int index = 0; index < 100; index++) {
+        keyStorage.push_back("key" + to_string(index));
+        valueStorage.push_back(string(index, 'v'));
+    }
+    vector<string_view> keys(keyStorage.begin(), keyStorage.end());
+    vector<MMBuffer> values;
+    for (auto &value : valueStorage) {
+        values.emplace_back((void *) value.data(), value.size(), MMBufferNoCopy);
+    }
+    assert(mmkv->setBytesForKeys(keys, values));
+    assert(mmkv->count() == keys.size());
+    string str;
+    assert(mmkv->getString("key99", str) && str == valueStorage[99]);
+
+    // overwritten in the same batch, the last one wins
+    vector<string_view> dupKeys = {"key1", "key1", "extra"};
+    vector<MMBuffer> dupValues;
+    for (auto value : {"first", "second", "new"}) {
+        dupValues.emplace_back((void *) value, strlen(value), MMBufferNoCopy);
+    }
+    assert(mmkv->setBytesForKeys(dupKeys, dupValues));
+    vector<MMBuffer> emptyValues(2);
+    assert(!mmkv->setBytesForKeys({"", "x"}, emptyValues));
+    assert(!mmkv->containsKey("x"));
+
+    keys.push_back("missing");
+    auto results = mmkv->getBytesForKeys(keys);
+    assert(results.size() == keys.size() && !results.back());
+    assert(results[0] && results[0]->length() == 0);
+    assert(results[1] && string((const char *) results[1]->getPtr(), results[1]->length()) == "second");
+    for (size_t index = 2; index < valueStorage.size(); index++) {
+        assert(results[index] && string((const char *) results[index]->getPtr(), results[index]->length()) == valueStorage[index]);
+    }
+
+    // every item survives a reload, the checksum covers the whole batch
+    mmkv->clearMemoryCache();
+    assert(mmkv->count() == keys.size() && mmkv->getString("extra", str) && str == "new");
+    mmkv->clearAll();
+    printf("test batch bytes: passed\n");
+}
+
+static void checkForEach(MMKV *mmkv) {
+    mmkv->set("string-value", "string");
+    mmkv->set(MMBuffer((void *) "\x00\x01", 2, MMBufferNoCopy), "bytes");
+    mmkv->set(numeric_limits<int32_t>::max(), "int");
+    mmkv->set(true, "bool");
+
+    map<string, string> visited;
+    auto count = mmkv->forEach([&](string_view key, const MMBuffer &value) {
+        MMBuffer bytes;
+        visited[string(key)] = MMKV::bytesView(value, bytes) ? string((const char *) bytes.getPtr(), bytes.length()) : "-";
+        return false;
+    });
+    assert(count == mmkv->count() && visited.size() == count);
+    assert(visited["string"] == "string-value" && visited["bytes"] == string("\x00\x01", 2));
+    assert(visited["int"] == "-" && visited["bool"] == "-");
+
+    // stop at the first one
+    assert(mmkv->forEach([](string_view, const MMBuffer &) { return true; }) == 1);
+}
+
+void testForEach() {
+    auto mmkv = MMKV::mmkvWithID("for_each_test");
+    mmkv->clearAll();
+    checkForEach(mmkv);
+    // the expire time isn't part of the value
+    assert(mmkv->enableAutoKeyExpire());
+    mmkv->set("expiring-value", "expiring", 60);
+    size_t expiringCount = 0;
+    mmkv->forEach([&](string_view key, const MMBuffer &value) {
+        MMBuffer bytes;
+        if (key == "expiring") {
+            assert(MMKV::bytesView(value, bytes) && string((const char *) bytes.getPtr(), bytes.length()) == "expiring-value");
+            expiringCount++;
+        }
+        return false;
+    });
+    assert(expiringCount == 1);
+    mmkv->clearAll();
+
+#ifndef MMKV_DISABLE_CRYPT
+    const string cryptKey = "for-each-key";
+    auto encrypted = MMKV::mmkvWithID("for_each_crypt_test", MMKV_SINGLE_PROCESS, &cryptKey);
+    encrypted->clearAll();
+    checkForEach(encrypted);
+    encrypted->clearAll();
+#endif
+
+    MMKVConfig config;
+    config.mode = MMKV_MULTI_PROCESS;
+    config.sharedIndex = true;
+    auto indexed = MMKV::mmkvWithID("for_each_shared_index_test", config);
+    indexed->clearAll();
+    checkForEach(indexed);
+    indexed->clearAll();
+
+    printf("test for each: passed\n");
+}
+
+using ConfigCheck = void (*)(const string &mmapID, MMKVConfig config);
+
+#ifndef MMKV_DISABLE_CRYPT
+// the crypt key is made of the mmapID, so that each file has one of its own
+static void checkEncrypted(const string &mmapID, MMKVConfig config, ConfigCheck check) {
+    auto cryptKey = mmapID;
+    config.cryptKey = &cryptKey;
+    check(mmapID, config);
+}
+#endif
+
+// the same check on a plain instance, then on an encrypted one suffixed by "_crypt"
+static void checkPlainAndEncrypted(const string &mmapID, const MMKVConfig &config, ConfigCheck check) {
+    check(mmapID, config);
+#ifndef MMKV_DISABLE_CRYPT
+    checkEncrypted(mmapID + "_crypt", config, check);
+#endif
+}
+
+static void checkOrderedIndex(const string &mmapID, MMKVConfig config) {
+    auto mmkv = MMKV::mmkvWithID(mmapID, config);
+    mmkv->clearAll();
+    for (auto key : {"user.1.name", "user.1.age", "user.2.name", "user.10.name", "other"}) {
+        mmkv->set(string("value of ") + key, key);
+    }
+    assert(mmkv->keysWithPrefix("user.1.") == vector<string>({"user.1.age", "user.1.name"}));
+    assert(mmkv->countPrefix("user.") == 4 && mmkv->countPrefix("") == 5 && mmkv->countPrefix("none") == 0);
+
+    // followed by later changes
+    mmkv->set("new", "user.1.zip");
+    mmkv->removeValueForKey("user.1.age");
+    assert(mmkv->keysWithPrefix("user.1.") == vector<string>({"user.1.name", "user.1.zip"}));
+
+    vector<string> visited;
+    string value;
+    auto count = mmkv->forEachInRange("user.1", "user.2", [&](string_view key, const MMBuffer &encoded) {
+        MMBuffer bytes;
+        assert(MMKV::bytesView(encoded, bytes));
+        visited.emplace_back(key);
+        value.assign((const char *) bytes.getPtr(), bytes.length());
+        return false;
+    });
+    assert(count == 3 && visited == vector<string>({"user.1.name", "user.1.zip", "user.10.name"}));
+    assert(value == "value of user.10.name");
+
+    // deletions are appended, nothing is written back
+    auto actualSize = mmkv->actualSize();
+    assert(mmkv->removePrefix("") == 0 && mmkv->removePrefix("user.1") == 3);
+    assert(mmkv->actualSize() > actualSize && mmkv->count() == 2);
+    mmkv->clearMemoryCache();
+    assert(mmkv->keysWithPrefix("user.") == vector<string>({"user.2.name"}));
+
+    // changes by another process are seen
+    auto pid = fork();
+    if (pid == 0) {
+        mmkv->close();
+        auto kv = MMKV::mmkvWithID(mmapID, config);
+        kv->set("child", "user.3.name");
+        kv->removeValueForKey("user.2.name");
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+    assert(mmkv->keysWithPrefix("user.") == vector<string>({"user.3.name"}));
+    mmkv->clearAll();
+}
+
+void testOrderedIndex() {
+    MMKVConfig config;
+    config.mode = MMKV_MULTI_PROCESS;
+    checkPlainAndEncrypted("ordered_index_test", config, checkOrderedIndex);
+    config.sharedIndex = true;
+    checkOrderedIndex("ordered_index_shared_test", config);
+
+    // expired keys are only left out on request
+    auto mmkv = MMKV::mmkvWithID("ordered_index_expire_test");
+    mmkv->clearAll();
+    assert(mmkv->enableAutoKeyExpire());
+    mmkv->set("fresh", "key.fresh", 60);
+    mmkv->set("stale", "key.stale", 1);
+    sleep(2);
+    assert(mmkv->countPrefix("key.") == 2 && mmkv->keysWithPrefix("key.", true) == vector<string>({"key.fresh"}));
+    assert(mmkv->forEachInRange("key.", "", [](string_view, const MMBuffer &) { return false; }) == 1);
+    mmkv->clearAll();
+
+    printf("test ordered index: passed\n");
+}
+
+static void checkKeyPrefixes(const string &mmapID, MMKVConfig config) {
+    auto mmkv = MMKV::mmkvWithID(mmapID, config);
+    mmkv->clearAll();
+    for (int index = 0; index < 100; index++) {
+        mmkv->set("push" + to_string(index), "push." + to_string(index));
+        mmkv->set("other" + to_string(index), "other." + to_string(index));
+    }
+    mmkv->set("user", "user.name");
+    mmkv->close();
+
+    config.keyPrefixes = {"push.", "user."};
+    auto slice = MMKV::mmkvWithID(mmapID, config);
+    assert(slice->isReadOnly() && slice->count() == 101);
+    string value;
+    assert(slice->getString("push.42", value) && value == "push42" && slice->getString("user.name", value));
+    assert(!slice->containsKey("other.42") && !slice->set("new", "push.new"));
+
+    // changes by another process are loaded through the same filter, appended or written back
+    for (bool writeBack : {false, true}) {
+        auto pid = fork();
+        if (pid == 0) {
+            slice->close();
+            config.keyPrefixes.clear();
+            auto kv = MMKV::mmkvWithID(mmapID, config);
+            kv->set("new", writeBack ? "push.written" : "push.appended");
+            kv->set("new", writeBack ? "other.written" : "other.appended");
+            kv->removeValueForKey(writeBack ? "push.1" : "push.0");
+            if (writeBack) {
+                kv->removeValuesForKeys({"other.0", "other.1"});
+            }
+            _exit(0);
+        }
+        waitpid(pid, nullptr, 0);
+        assert(slice->containsKey(writeBack ? "push.written" : "push.appended"));
+        assert(!slice->containsKey(writeBack ? "other.written" : "other.appended"));
+        assert(!slice->containsKey(writeBack ? "push.1" : "push.0"));
+    }
+    assert(slice->count() == 101);
+    slice->close();
+
+    config.keyPrefixes.clear();
+    mmkv = MMKV::mmkvWithID(mmapID, config);
+    assert(mmkv->count() == 101 + 100);
+    mmkv->clearAll();
+}
+
+#ifndef MMKV_DISABLE_CRYPT
+// the values of other keys are only decrypted to go on, they take neither memory nor the memory limit
+static void checkKeyPrefixesOfEncrypted(const string &mmapID, MMKVConfig config) {
+    auto mmkv = MMKV::mmkvWithID(mmapID, config);
+    mmkv->clearAll();
+    for (int index = 0; index < 200; index++) {
+        mmkv->set(string(200, 'o'), "other.big." + to_string(index));
+    }
+    mmkv->set(string(200, 'p'), "push.big");
+    mmkv->close();
+    config.keyPrefixes = {"push."};
+    config.cryptMemoryLimit = 4 * 1024;
+    mmkv = MMKV::mmkvWithID(mmapID, config);
+    string value;
+    assert(mmkv->getString("push.big", value) && value == string(200, 'p'));
+    assert(mmkv->cryptMemoryUsage() >= 200 && mmkv->memoryUsage().dictionarySize < 200 * 100);
+    mmkv->close();
+    config.keyPrefixes.clear();
+    config.cryptMemoryLimit = 0;
+    mmkv = MMKV::mmkvWithID(mmapID, config);
+    mmkv->clearAll();
+    mmkv->close();
+}
+#endif
+
+void testKeyPrefixes() {
+    MMKVConfig config;
+    config.mode = MMKV_MULTI_PROCESS;
+    checkPlainAndEncrypted("key_prefixes_test", config, checkKeyPrefixes);
+#ifndef MMKV_DISABLE_CRYPT
+    checkEncrypted("key_prefixes_big_values_test", config, checkKeyPrefixesOfEncrypted);
+#endif
+    printf("test key prefixes: passed\n");
+}
+
+static void checkKeyHandle(const string &mmapID, MMKVConfig config) {
+    auto mmkv = MMKV::mmkvWithID(mmapID, config);
+    mmkv->clearAll();
+    for (int index = 0; index < 100; index++) {
+        mmkv->set(index, "other" + to_string(index));
+    }
+
+    // resolved before the key exists, picked up once it's set
+    auto counter = mmkv->resolveKey("counter");
+    bool hasValue = true;
+    assert(mmkv->getInt64(counter, -1, &hasValue) == -1 && !hasValue);
+    for (int64_t index = 1; index <= 1000; index++) {
+        assert(mmkv->set(index, counter));
+        assert(mmkv->getInt64(counter) == index);
+    }
+    assert(mmkv->getInt64("counter") == 1000);
+    mmkv->set((int64_t) 1001, "counter");
+    assert(mmkv->getInt64(counter) == 1001);
+
+    auto flag = mmkv->resolveKey("flag");
+    auto ratio = mmkv->resolveKey("ratio");
+    auto text = mmkv->resolveKey("text");
+    assert(mmkv->set(true, flag) && mmkv->set(0.5, ratio) && mmkv->set("hello", text.key()));
+    string value;
+    assert(mmkv->getBool(flag) && mmkv->getDouble(ratio) == 0.5 && mmkv->getString(text, value) && value == "hello");
+    MMBuffer bytes;
+    assert(mmkv->getBytes(text, bytes) && bytes.length() == 5);
+
+    // removed, then set again
+    mmkv->removeValueForKey("counter");
+    assert(!mmkv->containsKey("counter") && mmkv->getInt64(counter, -1) == -1);
+    assert(mmkv->set((int64_t) 7, counter) && mmkv->getInt64("counter") == 7);
+    mmkv->removeValuesForKeys({"flag"});
+    assert(!mmkv->getBool(flag, false, &hasValue) && !hasValue);
+
+    // the dictionary is rebuilt
+    mmkv->clearMemoryCache();
+    assert(mmkv->getInt64(counter) == 7 && mmkv->getDouble(ratio) == 0.5);
+    mmkv->trim();
+    assert(mmkv->set((int64_t) 8, counter) && mmkv->getInt64(counter) == 8);
+    mmkv->clearAll();
+    assert(mmkv->getInt64(counter, -1) == -1 && mmkv->getDouble(ratio, -1) == -1);
+    assert(mmkv->set((int64_t) 9, counter) && mmkv->getInt64("counter") == 9);
+
+    // changed & removed by another process
+    for (bool remove : {false, true}) {
+        if (config.mode != MMKV_MULTI_PROCESS) {
+            break;
+        }
+        auto pid = fork();
+        if (pid == 0) {
+            auto kv = MMKV::mmkvWithID(mmapID, config);
+            if (remove) {
+                kv->removeValueForKey("counter");
+            } else {
+                kv->set((int64_t) 10, "counter");
+            }
+            _exit(0);
+        }
+        waitpid(pid, nullptr, 0);
+        assert(mmkv->getInt64(counter, -1) == (remove ? -1 : 10));
+    }
+    assert(mmkv->set((int64_t) 11, counter) && mmkv->getInt64("counter") == 11);
+    mmkv->clearAll();
+}
+
+void testKeyHandle() {
+    MMKVConfig config;
+    config.mode = MMKV_MULTI_PROCESS;
+    checkPlainAndEncrypted("key_handle_test", config, checkKeyHandle);
+    config.mode = MMKV_SINGLE_PROCESS;
+    checkKeyHandle("key_handle_single_test", config);
+
+    // expiring keys are checked on every read
+    config.enableKeyExpire = true;
+    config.expiredInSeconds = 1;
+    auto mmkv = MMKV::mmkvWithID("key_handle_expire_test", config);
+    mmkv->clearAll();
+    auto handle = mmkv->resolveKey("key");
+    assert(mmkv->set(1, handle) && mmkv->getInt32(handle) == 1);
+    sleep(2);
+    assert(mmkv->getInt32(handle, -1) == -1);
+    mmkv->clearAll();
+
+    printf("test key handle: passed\n");
+}
+
+static void checkDictionaryArena(const string &mmapID, MMKVConfig config) {
+    constexpr int keyCount = 1000;
+    auto mmkv = MMKV::mmkvWithID(mmapID, config);
+    mmkv->clearAll();
+    auto valueOf = [](int index, int round) {
+        // a medium value, held in memory by an encrypted instance
+        return "value of a medium size " + to_string(index) + "." + to_string(round) + string(index % 200, 'v');
+    };
+    for (int index = 0; index < keyCount; index++) {
+        mmkv->set(valueOf(index, 0), "key of a long enough name " + to_string(index));
+    }
+    // the dictionary is dropped & decoded again, mixed with values set afterward
+    for (int round = 1; round <= 3; round++) {
+        mmkv->clearMemoryCache();
+        assert(mmkv->count() == static_cast<size_t>(keyCount - (round - 1)));
+        for (int index = 0; index < keyCount; index += round + 1) {
+            mmkv->set(valueOf(index, round), "key of a long enough name " + to_string(index));
+        }
+        mmkv->removeValueForKey("key of a long enough name " + to_string(round));
+    }
+    mmkv->trim();
+    mmkv->clearMemoryCache();
+    string value;
+    assert(mmkv->getString("key of a long enough name 0", value) && value == valueOf(0, 3));
+    assert(mmkv->getString("key of a long enough name 6", value) && value == valueOf(6, 2));
+    assert(mmkv->getString("key of a long enough name 7", value) && value == valueOf(7, 0));
+    assert(!mmkv->containsKey("key of a long enough name 1") && mmkv->count() == keyCount - 3);
+    auto keys = mmkv->allKeys();
+    assert(keys.size() == keyCount - 3);
+    mmkv->clearAll();
+    assert(mmkv->count() == 0);
+}
+
+void testDictionaryArena() {
+    checkPlainAndEncrypted("dictionary_arena_test", MMKVConfig(), checkDictionaryArena);
+    printf("test dictionary arena: passed\n");
+}
+
+// keeps the size in front of each block, so that live bytes can be told on deallocate()
+class CountingAllocator : public MMKVAllocator {
+public:
+    atomic<size_t> m_allocations{0};
+    atomic<int64_t> m_liveBytes{0};
+
+    void *allocate(size_t size) override {
+        auto block = static_cast<max_align_t *>(malloc(sizeof(max_align_t) + size));
+        if (!block) {
+            return nullptr;
+        }
+        *reinterpret_cast<size_t *>(block) = size;
+        m_allocations++;
+        m_liveBytes += size;
+        return block + 1;
+    }
+
+    void deallocate(void *ptr) override {
+        auto block = static_cast<max_align_t *>(ptr) - 1;
+        m_liveBytes -= *reinterpret_cast<size_t *>(block);
+        free(block);
+    }
+};
+
+static void checkAllocator(const string &mmapID, MMKVConfig config) {
+    CountingAllocator allocator;
+    config.allocator = &allocator;
+    auto mmkv = MMKV::mmkvWithID(mmapID, config);
+    mmkv->clearAll();
+
+    const int keyCount = 1000;
+    for (int index = 0; index < keyCount; index++) {
+        mmkv->set("value of a long enough string " + to_string(index), "key of a long enough name " + to_string(index));
+    }
+    mmkv->clearMemoryCache();
+    string value;
+    assert(mmkv->getString("key of a long enough name 7", value) && value == "value of a long enough string 7");
+    assert(mmkv->count() == keyCount);
+#ifdef MMKV_HAS_ARENA
+    // the dictionary lives in an arena fed by the allocator of the instance, every key of it included
+    assert(allocator.m_allocations > 0 && allocator.m_liveBytes > keyCount * 32);
+#endif
+    mmkv->clearAll();
+    mmkv->close();
+    assert(allocator.m_liveBytes == 0);
+}
+
+// in a child process, so that the rest of the tests run on malloc()
+void testGlobalAllocator(const string &rootDir) {
+    auto pid = fork();
+    if (pid == 0) {
+        CountingAllocator allocator;
+        MMKV::initializeMMKV(rootDir, MMKVLogInfo, nullptr, &allocator);
+        auto mmkv = MMKV::mmkvWithID("allocator_global_test");
+        mmkv->clearAll();
+        auto allocations = allocator.m_allocations.load();
+        vector<string> vec = {"key", "value", "of", "a", "vector"};
+        assert(mmkv->set(vec, "vector"));
+        assert(allocator.m_allocations > allocations);
+
+        // handed to a caller across a bridge, who frees it by free()
+        string bytes(100, 'b');
+        assert(mmkv->set(MMBuffer(bytes.data(), bytes.size(), MMBufferNoCopy), "bytes"));
+        auto value = mmkv->getBytes("bytes");
+        auto ptr = value.detachToMalloc();
+        assert(ptr && memcmp(ptr, bytes.data(), bytes.size()) == 0 && value.length() == bytes.size());
+        free(ptr);
+        value = MMBuffer();
+        mmkv->clearAll();
+        mmkv->close();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    printf("test global allocator: passed\n");
+}
+
+void testAllocator() {
+    // detached as it is from malloc()
+    auto mmkv = MMKV::mmkvWithID("allocator_global_test");
+    string bytes(100, 'b');
+    assert(mmkv->set(MMBuffer(bytes.data(), bytes.size(), MMBufferNoCopy), "bytes"));
+    auto value = mmkv->getBytes("bytes");
+    auto valuePtr = value.getPtr();
+    auto ptr = value.detachToMalloc();
+    assert(ptr == valuePtr && memcmp(ptr, bytes.data(), bytes.size()) == 0 && value.length() == 0);
+    free(ptr);
+    mmkv->clearAll();
+
+    checkPlainAndEncrypted("allocator_test", MMKVConfig(), checkAllocator);
+    printf("test allocator: passed\n");
+}
+
+#ifndef MMKV_DISABLE_CRYPT
+static void checkCryptMemoryLimit(const string &mmapID, MMKVConfig config) {
+    const size_t limit = 16 * 1024;
+    config.cryptMemoryLimit = limit;
+    auto mmkv = MMKV::mmkvWithID(mmapID, config);
+    mmkv->clearAll();
+
+    // medium values, each of them would be kept decrypted in memory without a limit
+    const int keyCount = 1000;
+    auto valueOf = [](int index, int round) { return string(100, 'a' + index % 26) + to_string(index * 10 + round); };
+    auto checkValues = [&](int round) {
+        string value;
+        for (int index = 0; index < keyCount; index++) {
+            auto key = "key" + to_string(index);
+            if (index % 10 == 9) {
+                assert(!mmkv->containsKey(key));
+            } else {
+                assert(mmkv->getString(key, value) && value == valueOf(index, index % 3 ? 0 : round));
+            }
+        }
+        assert(mmkv->count() == keyCount - keyCount / 10);
+    };
+    for (int index = 0; index < keyCount; index++) {
+        mmkv->set(valueOf(index, 0), "key" + to_string(index));
+    }
+    assert(mmkv->cryptMemoryUsage() > 0 && mmkv->cryptMemoryUsage() <= limit);
+    // a value streamed over one kept in memory gives the memory back
+    auto usage = mmkv->cryptMemoryUsage();
+    streamValue(mmkv, "key0", makeStreamValue(1024, 3), 100);
+    assert(mmkv->cryptMemoryUsage() < usage);
+    mmkv->set(valueOf(0, 0), "key0");
+    for (int index = 0; index < keyCount; index += 3) {
+        mmkv->set(valueOf(index, 1), "key" + to_string(index));
+    }
+    for (int index = 9; index < keyCount; index += 10) {
+        mmkv->removeValueForKey("key" + to_string(index));
+    }
+    assert(mmkv->cryptMemoryUsage() <= limit);
+    checkValues(1);
+
+    // loaded within the limit, a full write-back moves values kept by offset
+    mmkv->clearMemoryCache();
+    assert(mmkv->cryptMemoryUsage() > 0 && mmkv->cryptMemoryUsage() <= limit);
+    checkValues(1);
+    mmkv->removeValuesForKeys({"key9", "key19"});
+    mmkv->trim();
+    checkValues(1);
+
+    // lowering the limit reloads, lifting it only takes effect on new values & the next load
+    mmkv->setCryptMemoryLimit(limit / 4);
+    assert(mmkv->cryptMemoryUsage() <= limit / 4);
+    checkValues(1);
+    mmkv->setCryptMemoryLimit(0);
+    mmkv->clearMemoryCache();
+    assert(mmkv->cryptMemoryUsage() > (keyCount - keyCount / 10) * valueOf(0, 0).size());
+    checkValues(1);
+
+    mmkv->clearAll();
+    assert(mmkv->cryptMemoryUsage() == 0);
+    mmkv->close();
+}
+
+void testCryptMemoryLimit() {
+    MMKVConfig config;
+    checkEncrypted("crypt_memory_limit_test", config, checkCryptMemoryLimit);
+    config.enableKeyExpire = true;
+    checkEncrypted("crypt_memory_limit_expire_test", config, checkCryptMemoryLimit);
+    printf("test crypt memory limit: passed\n");
+}
+#endif
+
+void testMemoryBudget() {
+    const int instanceCount = 20;
+    const int keyCount = 2000;
+    vector<MMKV *> instances;
+    for (int index = 0; index < instanceCount; index++) {
+        auto kv = MMKV::mmkvWithID("memory_budget_test_" + to_string(index));
+        kv->clearAll();
+        for (int key = 0; key < keyCount; key++) {
+            kv->set(key + index, "key" + to_string(key));
+        }
+        instances.push_back(kv);
+    }
+    auto loaded = instances[0]->memoryUsage();
+    assert(loaded.dictionarySize > keyCount * 16 && loaded.mappedSize > 0 && loaded.heapValueSize == 0);
+    auto isLoaded = [&](MMKV *kv) { return kv->memoryUsage().mappedSize == loaded.mappedSize; };
+    auto checkValues = [&](int index) {
+        auto kv = instances[index];
+        for (int key = 0; key < keyCount; key += 100) {
+            assert(kv->getInt32("key" + to_string(key)) == key + index);
+        }
+    };
+
+    // instances of other tests haven't been touched since, they go first
+    const size_t budget = loaded.totalSize() * 5;
+    MMKV::setMemoryBudget(budget);
+    assert(MMKV::memoryBudget() == budget);
+    for (int index = 0; index < instanceCount; index++) {
+        checkValues(index);
+    }
+    size_t totalSize = 0;
+    for (auto kv : instances) {
+        totalSize += kv->memoryUsage().totalSize();
+    }
+    assert(totalSize <= budget);
+    assert(!isLoaded(instances[0]) && isLoaded(instances[instanceCount - 1]));
+
+    // an instance held by the current thread is left alone, even if it's the least recently used one
+    checkValues(0);
+    instances[0]->lock_thread();
+    for (int index = 1; index < instanceCount; index++) {
+        checkValues(index);
+    }
+    assert(isLoaded(instances[0]));
+    instances[0]->unlock_thread();
+    checkValues(1);
+    assert(!isLoaded(instances[0]));
+    checkValues(0);
+    assert(isLoaded(instances[0]));
+
+    MMKV::setMemoryBudget(0);
+    for (auto kv : instances) {
+        kv->clearAll();
+        kv->close();
+    }
+    printf("test memory budget: passed\n");
+}
+
+static void checkContainer(const string &mmapID, MMKVConfig config) {
+    auto container = MMKV::mmkvWithID(mmapID, config);
+    container->clearAll();
+    assert(!container->storeWithID("") && !container->storeWithID(string("a\0b", 3)));
+    auto alice = container->storeWithID("alice");
+    auto bob = container->storeWithID("bob");
+    assert(container->storeWithID("alice") == alice && alice->storeID() == "alice" && alice->container() == container);
+
+    // the same key in different stores
+    assert(alice->set(1, "age") && bob->set(2, "age") && alice->set("Alice", "name") && !alice->set(3, ""));
+    assert(bob->set(vector<string>({"x", "y"}), "list") && bob->set(true, "flag"));
+    container->set(5, "age");
+    assert(alice->getInt32("age") == 1 && bob->getInt32("age") == 2 && container->getInt32("age") == 5);
+    string value;
+    vector<string> list;
+    assert(alice->getString("name", value) && value == "Alice" && !bob->containsKey("name"));
+    assert(bob->getVector("list", list) && list.size() == 2 && bob->getBool("flag"));
+    assert(alice->count() == 2 && bob->count() == 3 && container->count() == 6);
+    auto keys = alice->allKeys();
+    sort(keys.begin(), keys.end());
+    assert(keys == vector<string>({"age", "name"}));
+    assert(container->allStoreIDs() == vector<string>({"alice", "bob"}));
+
+    // clearAll() of a store leaves the rest of the container alone
+    assert(bob->removeValueForKey("flag") && !bob->containsKey("flag"));
+    assert(bob->clearAll() == 2 && bob->count() == 0 && alice->count() == 2 && container->containsKey("age"));
+    assert(container->allStoreIDs() == vector<string>({"alice"}));
+    assert(bob->set(3, "age"));
+
+    // loaded again from the file, as a whole or only some stores of it
+    container->close();
+    container = MMKV::mmkvWithID(mmapID, config);
+    alice = container->storeWithID("alice");
+    assert(alice->getInt32("age") == 1 && container->storeWithID("bob")->getInt32("age") == 3);
+    container->close();
+    auto sliceConfig = config;
+    sliceConfig.keyPrefixes = {MMKVStore::keyPrefix("bob")};
+    container = MMKV::mmkvWithID(mmapID, sliceConfig);
+    assert(container->count() == 1 && container->storeWithID("bob")->getInt32("age") == 3);
+    assert(!container->storeWithID("alice")->containsKey("age"));
+    container->close();
+
+    // expiration of one store, which never rewrites the container on its own
+    container = MMKV::mmkvWithID(mmapID, config);
+    alice = container->storeWithID("alice");
+    assert(!alice->enableAutoKeyExpire(1) && !container->isExpirationEnabled());
+    container->close();
+    auto expiringConfig = config;
+    expiringConfig.enableKeyExpire = true;
+    container = MMKV::mmkvWithID(mmapID, expiringConfig);
+    alice = container->storeWithID("alice");
+    bob = container->storeWithID("bob");
+    assert(alice->getInt32("age") == 1 && bob->getInt32("age") == 3);
+    assert(alice->enableAutoKeyExpire(1));
+    alice->set("soon", "temp");
+    bob->set("later", "temp");
+    bob->set("sooner", "other", 1);
+    sleep(2);
+    assert(alice->count(true) == 2 && alice->count() == 3 && bob->count(true) == 2);
+    assert(!alice->containsKey("temp") && bob->containsKey("temp") && !bob->containsKey("other"));
+    alice->disableAutoKeyExpire();
+    alice->set("kept", "temp");
+    sleep(2);
+    assert(alice->containsKey("temp"));
+    container->clearAll();
+    assert(container->allStoreIDs().empty());
+    container->close();
+}
+
+void testContainer() {
+    checkPlainAndEncrypted("container_test", MMKVConfig(), checkContainer);
+    printf("test container: passed\n");
+}
+
 void testRemove(MMKV *mmkv) {
     auto ret = mmkv->set(true, "bool_1");
     ret &= mmkv->set(numeric_limits<int32_t>::max(), "int_1");
@@ -720,6 +2522,7 @@ int main(int argc, char *argv[]) {
 
     string rootDir = argc > 1 ? argv[1] : "/tmp/mmkv";
     assert(mkPath(rootDir));
+    testGlobalAllocator(rootDir);
     MMKV::initializeMMKV(rootDir);
 
     auto mmkv = MMKV::mmkvWithID("unit_test");
@@ -738,12 +2541,39 @@ int main(int argc, char *argv[]) {
     testRemove(mmkv);
     testOversizedKey(mmkv);
     testOversizedValue(mmkv);
+    testDirectEncoding(mmkv);
+    testExceptionFreeDecode(mmkv);
+    testBulkVarintDecode();
+    testAlignedVector(mmkv);
+    testPOD(mmkv);
+    testValueStream();
+    testBlobSeparation(rootDir);
+    testSegmentedLog();
+    testPartitioned();
+#ifdef MMKV_LINUX
+    testSharedMemoryLock(rootDir);
+    testChangeNotification();
+#endif
+    testMetaGeneration(rootDir);
+    testOptimisticRead(rootDir);
+    testDeltaReload();
+    testSharedIndex(rootDir);
+    testBatchBytes();
+    testForEach();
+    testOrderedIndex();
+    testKeyPrefixes();
+    testKeyHandle();
+    testDictionaryArena();
+    testAllocator();
+    testMemoryBudget();
+    testContainer();
     testCodedOutputBounds();
     testExpirationOverflow();
     testExpirationAlignment();
     testArmCRC32();
 #ifndef MMKV_DISABLE_CRYPT
     testCryptoRandomAndWipe();
+    testCryptMemoryLimit();
 #endif
     testLongDirectoryWalk(rootDir);
     testMinimalBackupRestore(rootDir);
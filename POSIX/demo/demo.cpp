@@ -19,10 +19,14 @@
  */
 
 #include <MMKV/MMKV.h>
+#include <MMKV/MiniPBCoder.h>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdio>
 #include <iostream>
 #include <limits>
+#include <poll.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <string>
@@ -37,13 +41,39 @@
 #include <cmath>
 #include <cinttypes> // For PRId64 & PRIu64
 #include <sys/mman.h>
+#include <thread>
 
 // it's not a must-have for most app so do it the handy way
 #include "../../Core/InterProcessLock.h"
+#include "../../Core/PBUtility.h"
 
 using namespace std;
 using namespace mmkv;
 
+// counts the heap memory of the instances it's given to by MMKVConfig::allocator
+class TrackingAllocator : public MMKVAllocator {
+public:
+    atomic<int64_t> m_liveBytes{0};
+    atomic<size_t> m_allocations{0};
+
+    void *allocate(size_t size) override {
+        auto block = static_cast<max_align_t *>(malloc(sizeof(max_align_t) + size));
+        if (!block) {
+            return nullptr;
+        }
+        *reinterpret_cast<size_t *>(block) = size;
+        m_liveBytes += size;
+        m_allocations++;
+        return block + 1;
+    }
+
+    void deallocate(void *ptr) override {
+        auto block = static_cast<max_align_t *>(ptr) - 1;
+        m_liveBytes -= *reinterpret_cast<size_t *>(block);
+        free(block);
+    }
+};
+
 string to_string(const std::string& str) {  return str; }
 
 template <class T>
@@ -352,6 +382,218 @@ void testInterProcessLock() {
     close(fd);
 }
 
+void testSharedMemoryLockSpeed() {
+    using hclock = chrono::high_resolution_clock;
+    constexpr int loops = 200000;
+
+    for (bool sharedMemoryLock : {false, true}) {
+        MMKVConfig config;
+        config.mode = MMKV_MULTI_PROCESS;
+        config.sharedMemoryLock = sharedMemoryLock;
+        auto mmkv = MMKV::mmkvWithID(sharedMemoryLock ? "testSharedMemoryLockSpeed_shm" : "testSharedMemoryLockSpeed", config);
+        mmkv->set(1, "int");
+
+        // every read takes & releases the shared lock, every write the exclusive one
+        auto start = hclock::now();
+        int64_t sum = 0;
+        for (int loop = 0; loop < loops; loop++) {
+            sum += mmkv->getInt32("int");
+        }
+        long long readCost = chrono::duration_cast<chrono::milliseconds>(hclock::now() - start).count();
+        start = hclock::now();
+        for (int loop = 0; loop < loops / 10; loop++) {
+            mmkv->set(loop, "int");
+        }
+        long long writeCost = chrono::duration_cast<chrono::milliseconds>(hclock::now() - start).count();
+        printf("%s lock: %d reads cost %lld ms, %d writes cost %lld ms, sum %" PRId64 "\n",
+               sharedMemoryLock ? "shared-memory" : "file", loops, readCost, loops / 10, writeCost, sum);
+        mmkv->clearAll();
+    }
+}
+
+void testMetaGenerationSpeed() {
+    using hclock = chrono::high_resolution_clock;
+    constexpr int loops = 200000;
+
+    for (int round = 0; round < 4; round++) {
+        MMKVConfig config;
+        config.mode = round > 0 ? MMKV_MULTI_PROCESS : MMKV_SINGLE_PROCESS;
+        config.sharedMemoryLock = (round == 2);
+        config.optimisticRead = (round == 3);
+        const char *names[] = {"single-process", "multi-process", "multi-process with shared-memory lock",
+                               "multi-process with optimistic read"};
+        auto mmkv = MMKV::mmkvWithID("testMetaGenerationSpeed" + to_string(round), config);
+        mmkv->set(1, "int");
+
+        // no one changes the store, with optimistic read a getter costs no inter-process lock
+        auto start = hclock::now();
+        int64_t sum = 0;
+        for (int loop = 0; loop < loops; loop++) {
+            sum += mmkv->getInt32("int");
+        }
+        long long used = chrono::duration_cast<chrono::milliseconds>(hclock::now() - start).count();
+        printf("%s: %d reads of an unchanged store cost %lld ms, sum %" PRId64 "\n", names[round], loops, used, sum);
+        mmkv->clearAll();
+    }
+}
+
+void testDeltaReloadSpeed() {
+    using hclock = chrono::high_resolution_clock;
+    constexpr int keyCount = 100000;
+    auto mmkv = MMKV::mmkvWithID("testDeltaReloadSpeed", MMKV_MULTI_PROCESS);
+    mmkv->clearAll();
+    for (int index = 0; index < keyCount; index++) {
+        mmkv->set(index, "key" + to_string(index));
+    }
+
+    int toChild[2], toParent[2];
+    if (pipe(toChild) != 0 || pipe(toParent) != 0) {
+        return;
+    }
+    auto pid = fork();
+    if (pid == 0) {
+        char c = 0;
+        for (int round = 0; round < 2; round++) {
+            read(toChild[0], &c, 1);
+            mmkv->getInt32("key0");
+            write(toParent[1], &c, 1);
+        }
+        read(toChild[0], &c, 1);
+
+        // the other process has compacted the file, move our index along
+        auto start = hclock::now();
+        auto value = mmkv->getInt32("key1");
+        long long delta = chrono::duration_cast<chrono::microseconds>(hclock::now() - start).count();
+
+        mmkv->clearMemoryCache();
+        start = hclock::now();
+        value += mmkv->getInt32("key1");
+        long long full = chrono::duration_cast<chrono::microseconds>(hclock::now() - start).count();
+        printf("reload %zu keys after a compaction: %lld us moving the index along, %lld us loading again, value %d\n",
+               mmkv->count(), delta, full, value);
+        fflush(stdout);
+        _exit(0);
+    }
+    char c = 0;
+    write(toChild[1], &c, 1);
+    read(toParent[0], &c, 1);
+    for (int index = 0; index < keyCount; index += 2) {
+        mmkv->set(index + 1, "key" + to_string(index));
+    }
+    // the peer has seen everything before the compaction
+    write(toChild[1], &c, 1);
+    read(toParent[0], &c, 1);
+    mmkv->trim();
+    write(toChild[1], &c, 1);
+    waitpid(pid, nullptr, 0);
+    for (int fd : {toChild[0], toChild[1], toParent[0], toParent[1]}) {
+        ::close(fd);
+    }
+    mmkv->clearAll();
+}
+
+// what opening a large multi-process store costs a new process, with and without the shared index
+void testSharedIndexSpeed() {
+    using hclock = chrono::high_resolution_clock;
+    constexpr int keyCount = 200000;
+    constexpr int loops = 100000;
+    for (bool sharedIndex : {false, true}) {
+        MMKVConfig config;
+        config.mode = MMKV_MULTI_PROCESS;
+        config.sharedIndex = sharedIndex;
+        auto mmkv = MMKV::mmkvWithID("testSharedIndexSpeed", config);
+        mmkv->clearAll();
+        for (int index = 0; index < keyCount; index++) {
+            mmkv->set(index, "key" + to_string(index));
+        }
+
+        auto pid = fork();
+        if (pid == 0) {
+            mmkv->close();
+            TrackingAllocator allocator;
+            config.allocator = &allocator;
+            auto start = hclock::now();
+            auto kv = MMKV::mmkvWithID("testSharedIndexSpeed", config);
+            auto value = kv->getInt32("key0");
+            long long openCost = chrono::duration_cast<chrono::microseconds>(hclock::now() - start).count();
+            size_t newCount = allocator.m_allocations;
+
+            start = hclock::now();
+            for (int loop = 0; loop < loops; loop++) {
+                value += kv->getInt32("key" + to_string(loop * 7 % keyCount));
+            }
+            long long getCost = chrono::duration_cast<chrono::milliseconds>(hclock::now() - start).count();
+            printf("sharedIndex %d, open %d keys in a new process: %lld us, %zu dictionary allocations, %d gets: %lld ms, value %d\n",
+                   sharedIndex, keyCount, openCost, newCount, loops, getCost, value);
+            fflush(stdout);
+            _exit(0);
+        }
+        waitpid(pid, nullptr, 0);
+        mmkv->clearAll();
+        mmkv->close();
+        MMKV::removeStorage("testSharedIndexSpeed");
+    }
+}
+
+#ifdef MMKV_LINUX
+void testChangeNotificationSpeed() {
+    using hclock = chrono::steady_clock;
+    constexpr int rounds = 200;
+    constexpr int loops = 10000;
+    auto mmkv = MMKV::mmkvWithID("testChangeNotificationSpeed", MMKV_MULTI_PROCESS);
+    mmkv->clearAll();
+
+    // fork before there's a dispatcher thread
+    int toChild[2];
+    if (pipe(toChild) != 0) {
+        return;
+    }
+    auto pid = fork();
+    if (pid == 0) {
+        ::close(toChild[1]);
+        char c = 0;
+        while (read(toChild[0], &c, 1) == 1) {
+            auto now = chrono::duration_cast<chrono::microseconds>(hclock::now().time_since_epoch()).count();
+            mmkv->set((int64_t) now, "time");
+        }
+        _exit(0);
+    }
+
+    // what a listener costs the writers
+    auto start = hclock::now();
+    for (int loop = 0; loop < loops; loop++) {
+        mmkv->set(loop, "int" + to_string(loop));
+    }
+    long long quiet = chrono::duration_cast<chrono::milliseconds>(hclock::now() - start).count();
+    auto fd = mmkv->enableChangeNotification();
+    start = hclock::now();
+    for (int loop = 0; loop < loops; loop++) {
+        mmkv->set(loop, "int" + to_string(loop));
+    }
+    long long listened = chrono::duration_cast<chrono::milliseconds>(hclock::now() - start).count();
+    printf("%d writes cost %lld ms, %lld ms with a listener\n", loops, quiet, listened);
+
+    // how soon a change from another process is pushed
+    pollfd pfd = {fd, POLLIN, 0};
+    long long total = 0;
+    char c = 0;
+    for (int round = 0; round < rounds && fd >= 0; round++) {
+        write(toChild[1], &c, 1);
+        poll(&pfd, 1, -1);
+        auto now = chrono::duration_cast<chrono::microseconds>(hclock::now().time_since_epoch()).count();
+        uint64_t count = 0;
+        read(fd, &count, sizeof(count));
+        total += now - mmkv->getInt64("time");
+    }
+    ::close(toChild[1]);
+    waitpid(pid, nullptr, 0);
+    ::close(toChild[0]);
+    printf("change by another process pushed in %lld us on average\n", total / rounds);
+    mmkv->disableChangeNotification();
+    mmkv->clearAll();
+}
+#endif
+
 void cornetSizeTest() {
     string aesKey = "aes";
     auto mmkv = MMKV::mmkvWithID("cornerSize", MMKV_MULTI_PROCESS, &aesKey);
@@ -897,6 +1139,300 @@ void testGetStringSpeed() {
     printf("old_method = %" PRId64 ", new_method = %" PRId64 "\n", end1 - start1, end2 - start2);
 }
 
+void testEncodeContainerSpeed() {
+    constexpr int loops = 10000;
+    vector<string> strings;
+    vector<int64_t> numbers;
+    for (int64_t index = 0; index < 1000; index++) {
+        strings.push_back("string-" + to_string(index));
+        numbers.push_back(index * numeric_limits<int32_t>::max());
+    }
+
+    auto start = getTimeInMs();
+    for (int i = 0; i < loops; i++) {
+        auto data = MiniPBCoder::encodeDataWithObject(std::span(strings));
+        assert(data.length() == MiniPBCoder::encodedSizeOfObject(std::span(strings)));
+    }
+    auto end = getTimeInMs();
+    printf("encode vector<string>[%zu] %d times, cost: %" PRIu64 " ms\n", strings.size(), loops, end - start);
+
+    start = getTimeInMs();
+    for (int i = 0; i < loops; i++) {
+        auto data = MiniPBCoder::encodeDataWithObject(std::span(numbers));
+    }
+    end = getTimeInMs();
+    printf("encode vector<int64_t>[%zu] %d times, cost: %" PRIu64 " ms\n", numbers.size(), loops, end - start);
+
+#ifndef MMKV_DISABLE_CRYPT
+    // values of an encrypted instance are held in memory, a full writeback encodes all of them
+    string aesKey = "cryptKey";
+    auto mmkv = MMKV::mmkvWithID("testEncodeContainerSpeed", MMKV_SINGLE_PROCESS, &aesKey);
+    for (size_t index = 0; index < strings.size(); index++) {
+        mmkv->set(numbers[index], strings[index]);
+    }
+    start = getTimeInMs();
+    for (int i = 0; i < loops / 10; i++) {
+        // removing more than one key triggers a full writeback
+        mmkv->set(i, "writeback-0");
+        mmkv->set(i, "writeback-1");
+        mmkv->removeValuesForKeys({"writeback-0", "writeback-1"});
+    }
+    end = getTimeInMs();
+    printf("full writeback of %zu encrypted keys %d times, cost: %" PRIu64 " ms\n", mmkv->count(), loops / 10,
+           end - start);
+    mmkv->clearAll();
+#endif
+}
+
+// feature vectors of 100k ints, compare the bulk varint decoder against the scalar one
+void testDecodeVectorSpeed() {
+    constexpr int loops = 1000;
+    constexpr size_t count = 100000;
+    auto mmkv = MMKV::mmkvWithID("testDecodeVectorSpeed", MMKV_SINGLE_PROCESS);
+    vector<int32_t> small, medium, mixed;
+    vector<int64_t> large;
+    srand(static_cast<unsigned>(time(nullptr)));
+    for (size_t index = 0; index < count; index++) {
+        small.push_back(rand() % 128);
+        medium.push_back(rand() % (1 << 14));
+        mixed.push_back((index % 4 == 0) ? rand() : rand() % 128);
+        large.push_back(static_cast<int64_t>(rand()) * rand());
+    }
+    mmkv->set(std::span(small), "small");
+    mmkv->set(std::span(medium), "medium");
+    mmkv->set(std::span(mixed), "mixed");
+    mmkv->set(std::span(large), "large");
+
+    auto bench = [&](const char *key, auto sample) {
+        for (auto useScalar : {true, false}) {
+            pbUseScalarVarintDecoder(useScalar);
+            auto start = getTimeInMs();
+            for (int i = 0; i < loops; i++) {
+                sample.clear();
+                mmkv->getVector(key, sample);
+            }
+            auto end = getTimeInMs();
+            printf("decode %s vector[%zu] with %s %d times, cost: %" PRIu64 " ms\n", key, sample.size(),
+                   pbVarintDecoderName(), loops, end - start);
+        }
+    };
+    bench("small", vector<int32_t>());
+    bench("medium", vector<int32_t>());
+    bench("mixed", vector<int32_t>());
+    bench("large", vector<int64_t>());
+    mmkv->clearAll();
+}
+
+// 1M floats, compare the packed encoding against the aligned fixed-width one
+void testAlignedVectorSpeed() {
+    constexpr int loops = 100;
+    auto mmkv = MMKV::mmkvWithID("testAlignedVectorSpeed", MMKV_SINGLE_PROCESS);
+    vector<float> floats(1000 * 1000);
+    for (size_t index = 0; index < floats.size(); index++) {
+        floats[index] = static_cast<float>(index) * 0.5f;
+    }
+
+    auto start = getTimeInMs();
+    for (int i = 0; i < loops; i++) {
+        mmkv->set(floats, "packed");
+    }
+    auto end = getTimeInMs();
+    printf("set packed vector<float>[%zu] %d times, cost: %" PRIu64 " ms\n", floats.size(), loops, end - start);
+
+    start = getTimeInMs();
+    for (int i = 0; i < loops; i++) {
+        mmkv->setAlignedVector(floats, "aligned");
+    }
+    end = getTimeInMs();
+    printf("set aligned vector<float>[%zu] %d times, cost: %" PRIu64 " ms\n", floats.size(), loops, end - start);
+
+    double sum = 0;
+    start = getTimeInMs();
+    for (int i = 0; i < loops; i++) {
+        vector<float> result;
+        mmkv->getVector("packed", result);
+        sum += result.back();
+    }
+    end = getTimeInMs();
+    printf("getVector() vector<float>[%zu] %d times, cost: %" PRIu64 " ms\n", floats.size(), loops, end - start);
+
+    start = getTimeInMs();
+    for (int i = 0; i < loops; i++) {
+        MMKVVectorView<float> view;
+        mmkv->getVectorView("aligned", view);
+        sum += view[view.size() - 1];
+    }
+    end = getTimeInMs();
+    printf("getVectorView() vector<float>[%zu] %d times, cost: %" PRIu64 " ms, checksum %f\n", floats.size(), loops,
+           end - start, sum);
+    mmkv->clearAll();
+}
+
+// a 32MB value, set() needs it all in memory while the writer only needs one chunk at a time
+void testValueStreamSpeed() {
+    constexpr size_t valueSize = 32 * 1024 * 1024;
+    constexpr size_t chunkSize = 64 * 1024;
+    auto mmkv = MMKV::mmkvWithID("testValueStreamSpeed", MMKV_SINGLE_PROCESS);
+    vector<uint8_t> chunk(chunkSize);
+    for (size_t index = 0; index < chunk.size(); index++) {
+        chunk[index] = static_cast<uint8_t>(index);
+    }
+
+    auto start = getTimeInMs();
+    {
+        MMBuffer value(valueSize);
+        for (size_t offset = 0; offset < valueSize; offset += chunkSize) {
+            memcpy((uint8_t *) value.getPtr() + offset, chunk.data(), chunkSize);
+        }
+        mmkv->set(value, "set");
+    }
+    auto end = getTimeInMs();
+    printf("set() %zu bytes, cost: %" PRIu64 " ms\n", valueSize, end - start);
+
+    start = getTimeInMs();
+    {
+        MMKVValueWriter writer;
+        mmkv->openValueWriter("stream", valueSize, writer);
+        for (size_t offset = 0; offset < valueSize; offset += chunkSize) {
+            writer.write(chunk.data(), chunkSize);
+        }
+        writer.commit();
+    }
+    end = getTimeInMs();
+    printf("openValueWriter() %zu bytes, cost: %" PRIu64 " ms\n", valueSize, end - start);
+
+    size_t sum = 0;
+    start = getTimeInMs();
+    {
+        auto value = mmkv->getBytes("stream");
+        sum += value.length();
+    }
+    end = getTimeInMs();
+    printf("getBytes() %zu bytes, cost: %" PRIu64 " ms\n", valueSize, end - start);
+
+    start = getTimeInMs();
+    {
+        MMKVValueReader reader;
+        mmkv->openValueReader("stream", reader);
+        while (auto length = reader.read(chunk.data(), chunk.size())) {
+            sum += length;
+        }
+    }
+    end = getTimeInMs();
+    printf("openValueReader() %zu bytes, cost: %" PRIu64 " ms, checksum %zu\n", valueSize, end - start, sum);
+    mmkv->clearAll();
+}
+
+// 64 x 1MB values next to many small values, every full writeback copies the large values unless they're separated
+void testBlobSeparationSpeed() {
+    constexpr size_t blobCount = 64;
+    constexpr size_t blobSize = 1024 * 1024;
+    constexpr int flagCount = 1000;
+    constexpr int loops = 100;
+    MMBuffer blob(blobSize);
+    memset(blob.getPtr(), 'b', blobSize);
+    string flag(1000, 'f');
+
+    for (size_t threshold : {size_t(0), size_t(64 * 1024)}) {
+        MMKVConfig config;
+        config.mode = MMKV_SINGLE_PROCESS;
+        config.blobThreshold = threshold;
+        auto mmkv = MMKV::mmkvWithID(threshold ? "testBlobSeparationSpeed_blob" : "testBlobSeparationSpeed", config);
+        mmkv->clearAll();
+        for (size_t index = 0; index < blobCount; index++) {
+            mmkv->set(blob, "blob_" + to_string(index));
+        }
+
+        auto start = getTimeInMs();
+        for (int loop = 0; loop < loops; loop++) {
+            for (int index = 0; index < flagCount; index++) {
+                flag[0] = static_cast<char>(loop);
+                mmkv->set(flag, "flag_" + to_string(index));
+            }
+        }
+        auto end = getTimeInMs();
+        printf("blobThreshold %zu, %d small writes next to %zu MB values, file size %zu, cost: %" PRIu64 " ms\n",
+               threshold, loops * flagCount, blobCount * blobSize / 1024 / 1024, mmkv->totalSize(), end - start);
+
+        // trim() does a full writeback
+        start = getTimeInMs();
+        mmkv->trim();
+        end = getTimeInMs();
+        printf("blobThreshold %zu, trim() to file size %zu, cost: %" PRIu64 " ms\n", threshold, mmkv->totalSize(),
+               end - start);
+        mmkv->clearAll();
+    }
+}
+
+// overwrites on a store of 8MB live data, the single log rewrites all of it on each full write-back
+// while a segmented log copies one segment at a time
+void testSegmentedLogSpeed() {
+    using hclock = chrono::high_resolution_clock;
+    constexpr int keyCount = 8000;
+    constexpr int loops = 100000;
+    string value(1000, 'v');
+
+    for (size_t segmentSize : {size_t(0), size_t(256 * 1024)}) {
+        MMKVConfig config;
+        config.segmentSize = segmentSize;
+        auto mmkv = MMKV::mmkvWithID(segmentSize ? "testSegmentedLogSpeed_segmented" : "testSegmentedLogSpeed", config);
+        mmkv->clearAll();
+        for (int index = 0; index < keyCount; index++) {
+            mmkv->set(value, "key_" + to_string(index));
+        }
+
+        long long maxCost = 0;
+        auto start = hclock::now();
+        for (int loop = 0; loop < loops; loop++) {
+            value[0] = static_cast<char>(loop);
+            auto setStart = hclock::now();
+            mmkv->set(value, "key_" + to_string(loop % keyCount));
+            maxCost = max<long long>(maxCost, chrono::duration_cast<chrono::microseconds>(hclock::now() - setStart).count());
+        }
+        long long used = chrono::duration_cast<chrono::milliseconds>(hclock::now() - start).count();
+        printf("segmentSize %zu, %d overwrites, file size %zu, cost: %lld ms, slowest set(): %lld us\n", segmentSize,
+               loops, mmkv->totalSize(), used, maxCost);
+        mmkv->clearAll();
+    }
+}
+
+void testPartitionedSpeed() {
+    using hclock = chrono::high_resolution_clock;
+    constexpr uint32_t partitionCount = 4;
+    constexpr int threads = 4;
+    constexpr int loops = 50000;
+    string value(100, 'v');
+    MMKVConfig config;
+    config.mode = MMKV_MULTI_PROCESS;
+
+    for (uint32_t count : {uint32_t(1), partitionCount}) {
+        auto store = MMKVPartitioned::mmkvWithID("testPartitionedSpeed", count, config);
+        store.clearAll();
+        long long maxCost[threads] = {};
+        auto start = hclock::now();
+        vector<thread> workers;
+        for (int index = 0; index < threads; index++) {
+            workers.emplace_back([&store, &value, &maxCost, index] {
+                for (int loop = 0; loop < loops; loop++) {
+                    auto setStart = hclock::now();
+                    store.set(value, "key_" + to_string(index) + "_" + to_string(loop % 1000));
+                    auto cost = chrono::duration_cast<chrono::microseconds>(hclock::now() - setStart).count();
+                    maxCost[index] = max<long long>(maxCost[index], cost);
+                }
+            });
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+        long long used = chrono::duration_cast<chrono::milliseconds>(hclock::now() - start).count();
+        printf("%u partitions, %d threads x %d sets, cost: %lld ms, slowest set(): %lld us\n", count, threads, loops,
+               used, *max_element(maxCost, maxCost + threads));
+        store.clearAll();
+        store.close();
+        MMKVPartitioned::removeStorage("testPartitionedSpeed", count);
+    }
+}
+
 void printVector(vector<string> &v) {
     printf("testCompareBeforeSet: string<vector>: ");
     if (v.empty()) {
@@ -1441,6 +1977,377 @@ void testOversizedKey() {
     printf("test oversized key: passed\n");
 }
 
+void testPrefixSpeed() {
+    using hclock = chrono::high_resolution_clock;
+    constexpr int userCount = 10000;
+    constexpr int fieldCount = 10;
+    constexpr int loops = 100;
+    auto mmkv = MMKV::mmkvWithID("testPrefixSpeed");
+    mmkv->clearAll();
+    for (int user = 0; user < userCount; user++) {
+        for (int field = 0; field < fieldCount; field++) {
+            mmkv->set(field, "user." + to_string(user) + ".field" + to_string(field));
+        }
+    }
+
+    size_t found = 0;
+    auto start = hclock::now();
+    for (int loop = 0; loop < loops; loop++) {
+        auto prefix = "user." + to_string(loop) + ".";
+        for (const auto &key : mmkv->allKeys()) {
+            found += (key.compare(0, prefix.size(), prefix) == 0);
+        }
+    }
+    long long scanCost = chrono::duration_cast<chrono::microseconds>(hclock::now() - start).count();
+
+    start = hclock::now();
+    for (int loop = 0; loop < loops; loop++) {
+        found += mmkv->keysWithPrefix("user." + to_string(loop) + ".").size();
+    }
+    long long prefixCost = chrono::duration_cast<chrono::microseconds>(hclock::now() - start).count();
+
+    // the index follows each change instead of being rebuilt
+    start = hclock::now();
+    for (int loop = 0; loop < loops; loop++) {
+        mmkv->set(loop, "user.new" + to_string(loop));
+        found += mmkv->countPrefix("user.new");
+    }
+    long long updateCost = chrono::duration_cast<chrono::microseconds>(hclock::now() - start).count();
+
+    start = hclock::now();
+    auto removed = mmkv->removePrefix("user.1.");
+    long long removePrefixCost = chrono::duration_cast<chrono::microseconds>(hclock::now() - start).count();
+    start = hclock::now();
+    auto keys = mmkv->keysWithPrefix("user.2.");
+    mmkv->removeValuesForKeys(keys);
+    long long removeKeysCost = chrono::duration_cast<chrono::microseconds>(hclock::now() - start).count();
+
+    printf("%d keys, %d prefix lookups: allKeys() & filter %lld us, keysWithPrefix() %lld us (first one builds the "
+           "index); set & countPrefix() %d times: %lld us; remove %zu keys: removePrefix() %lld us, "
+           "removeValuesForKeys() %lld us, found %zu\n",
+           userCount * fieldCount, loops, scanCost, prefixCost, loops, updateCost, removed, removePrefixCost,
+           removeKeysCost, found);
+    mmkv->clearAll();
+}
+
+void testKeyPrefixesSpeed() {
+    using hclock = chrono::high_resolution_clock;
+    constexpr int keyCount = 200000;
+    MMKVConfig config;
+    config.mode = MMKV_MULTI_PROCESS;
+    auto mmkv = MMKV::mmkvWithID("testKeyPrefixesSpeed", config);
+    mmkv->clearAll();
+    for (int index = 0; index < keyCount; index++) {
+        // one key in a hundred is the slice we care about
+        auto key = (index % 100 == 0 ? "push." : "feed.") + to_string(index);
+        mmkv->set("value of " + key, key);
+    }
+    mmkv->close();
+
+    for (bool slice : {false, true}) {
+        if (slice) {
+            config.keyPrefixes = {"push."};
+        }
+        TrackingAllocator allocator;
+        config.allocator = &allocator;
+        auto start = hclock::now();
+        auto kv = MMKV::mmkvWithID("testKeyPrefixesSpeed", config);
+        auto count = kv->count();
+        long long loadCost = chrono::duration_cast<chrono::microseconds>(hclock::now() - start).count();
+        printf("keyPrefixes %d, load %zu of %d keys: %lld us, %lld KB held by the dictionary\n", slice, count,
+               keyCount, loadCost, (long long) allocator.m_liveBytes.load() / 1024);
+        kv->close();
+    }
+    MMKV::removeStorage("testKeyPrefixesSpeed");
+}
+
+void testKeyHandleSpeed() {
+    using hclock = chrono::high_resolution_clock;
+    constexpr int loops = 1000000;
+    auto mmkv = MMKV::mmkvWithID("testKeyHandleSpeed");
+    mmkv->clearAll();
+    for (int index = 0; index < 100000; index++) {
+        mmkv->set(index, "some.fairly.long.namespace.for.a.setting." + to_string(index));
+    }
+    const string key = "some.fairly.long.namespace.for.a.setting.counter";
+    auto handle = mmkv->resolveKey(key);
+    mmkv->set((int64_t) 0, key);
+
+    for (bool byHandle : {false, true}) {
+        int64_t sum = 0;
+        auto start = hclock::now();
+        for (int index = 0; index < loops; index++) {
+            sum += byHandle ? mmkv->getInt64(handle) : mmkv->getInt64(key);
+        }
+        long long getCost = chrono::duration_cast<chrono::microseconds>(hclock::now() - start).count();
+        start = hclock::now();
+        for (int64_t index = 0; index < loops / 10; index++) {
+            byHandle ? mmkv->set(index, handle) : mmkv->set(index, key);
+        }
+        long long setCost = chrono::duration_cast<chrono::microseconds>(hclock::now() - start).count();
+        printf("by handle %d, %d getInt64: %lld us, %d set: %lld us (%lld)\n", byHandle, loops, getCost, loops / 10,
+               setCost, (long long) sum);
+    }
+    MMKV::removeStorage("testKeyHandleSpeed");
+}
+
+// resident set size in KB, 0 if it's unknown
+static long residentSize() {
+    long size = 0, resident = 0;
+    auto file = fopen("/proc/self/statm", "r");
+    if (file) {
+        if (fscanf(file, "%ld %ld", &size, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(file);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void testDictionaryArenaSpeed() {
+    using hclock = chrono::high_resolution_clock;
+    constexpr int keyCount = 1000000;
+    constexpr int threadCount = 4;
+    constexpr int rounds = 5;
+    string cryptKey = "arena";
+    for (bool crypt : {false, true}) {
+        MMKVConfig config;
+        config.cryptKey = crypt ? &cryptKey : nullptr;
+        auto mmapID = [](int index) { return "testDictionaryArenaSpeed" + to_string(index); };
+        // written by a child process, so that the heap of the loader is clean
+        auto pid = fork();
+        if (pid == 0) {
+            for (int index = 0; index < threadCount; index++) {
+                auto kv = MMKV::mmkvWithID(mmapID(index), config);
+                for (int key = 0; key < keyCount / threadCount; key++) {
+                    kv->set("value of the setting " + to_string(key), "com.example.settings.key." + to_string(key));
+                }
+            }
+            _exit(0);
+        }
+        waitpid(pid, nullptr, 0);
+
+        pid = fork();
+        if (pid == 0) {
+            TrackingAllocator allocator;
+            config.allocator = &allocator;
+            auto rss = residentSize();
+            auto start = hclock::now();
+            vector<MMKV *> instances;
+            for (int index = 0; index < threadCount; index++) {
+                instances.push_back(MMKV::mmkvWithID(mmapID(index), config));
+                instances.back()->count();
+            }
+            long long loadCost = chrono::duration_cast<chrono::milliseconds>(hclock::now() - start).count();
+            size_t newCount = allocator.m_allocations;
+            rss = residentSize() - rss;
+
+            start = hclock::now();
+            for (auto kv : instances) {
+                kv->clearMemoryCache();
+            }
+            long long clearCost = chrono::duration_cast<chrono::microseconds>(hclock::now() - start).count();
+
+            // every thread reloads its own instance over & over, they only share the heap
+            start = hclock::now();
+            vector<thread> threads;
+            for (auto kv : instances) {
+                threads.emplace_back([kv] {
+                    for (int round = 0; round < rounds; round++) {
+                        kv->count();
+                        kv->clearMemoryCache();
+                    }
+                });
+            }
+            for (auto &t : threads) {
+                t.join();
+            }
+            long long threadCost = chrono::duration_cast<chrono::milliseconds>(hclock::now() - start).count();
+            printf("crypt %d, load %d keys: %lld ms, %zu dictionary allocations, rss +%ld KB, clear: %lld us, "
+                   "%d threads reload %d times: %lld ms\n",
+                   crypt, keyCount, loadCost, newCount, rss, clearCost, threadCount, rounds, threadCost);
+            fflush(stdout);
+            _exit(0);
+        }
+        waitpid(pid, nullptr, 0);
+        for (int index = 0; index < threadCount; index++) {
+            MMKV::removeStorage(mmapID(index));
+        }
+    }
+}
+
+void testCryptMemoryLimitSpeed() {
+    using hclock = chrono::high_resolution_clock;
+    constexpr int keyCount = 200000;
+    string cryptKey = "memory-limit";
+    MMKVConfig config;
+    config.cryptKey = &cryptKey;
+    string mmapID = "testCryptMemoryLimitSpeed";
+    auto kv = MMKV::mmkvWithID(mmapID, config);
+    for (int key = 0; key < keyCount; key++) {
+        kv->set(string(100, 'v') + to_string(key), "com.example.settings.key." + to_string(key));
+    }
+    kv->close();
+
+    for (size_t limit : {size_t(0), size_t(1024 * 1024)}) {
+        config.cryptMemoryLimit = limit;
+        auto start = hclock::now();
+        kv = MMKV::mmkvWithID(mmapID, config);
+        kv->count();
+        long long loadCost = chrono::duration_cast<chrono::milliseconds>(hclock::now() - start).count();
+
+        start = hclock::now();
+        string value;
+        for (int key = 0; key < keyCount; key++) {
+            kv->getString("com.example.settings.key." + to_string(key), value);
+        }
+        long long readCost = chrono::duration_cast<chrono::milliseconds>(hclock::now() - start).count();
+        printf("crypt memory limit %zu KB, load %d values: %lld ms, %zu KB held, read all: %lld ms\n", limit / 1024,
+               keyCount, loadCost, kv->cryptMemoryUsage() / 1024, readCost);
+        kv->close();
+    }
+    MMKV::removeStorage(mmapID);
+}
+
+// many small per-user stores, a file each vs all of them in one container
+void testContainerSpeed() {
+    using hclock = chrono::high_resolution_clock;
+    constexpr int storeCount = 2000;
+    constexpr int keyCount = 10;
+    const string containerID = "testContainerSpeed";
+    auto mmapID = [](int index) { return "testContainerSpeed_user" + to_string(index); };
+    auto pid = fork();
+    if (pid == 0) {
+        auto container = MMKV::mmkvWithID(containerID);
+        for (int index = 0; index < storeCount; index++) {
+            auto kv = MMKV::mmkvWithID(mmapID(index));
+            auto store = container->storeWithID("user" + to_string(index));
+            for (int key = 0; key < keyCount; key++) {
+                kv->set(index + key, "setting" + to_string(key));
+                store->set(index + key, "setting" + to_string(key));
+            }
+        }
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+
+    // cold start in a fresh process, every store is opened & read once
+    for (bool useContainer : {false, true}) {
+        pid = fork();
+        if (pid == 0) {
+            auto start = hclock::now();
+            size_t fileCount = 0;
+            size_t diskSize = 0;
+            if (useContainer) {
+                auto container = MMKV::mmkvWithID(containerID);
+                for (int index = 0; index < storeCount; index++) {
+                    auto store = container->storeWithID("user" + to_string(index));
+                    assert(store->getInt32("setting0") == index);
+                }
+                fileCount = 2;
+                diskSize = container->totalSize() + getpagesize();
+            } else {
+                for (int index = 0; index < storeCount; index++) {
+                    auto kv = MMKV::mmkvWithID(mmapID(index));
+                    assert(kv->getInt32("setting0") == index);
+                    fileCount += 2;
+                    diskSize += kv->totalSize() + getpagesize();
+                }
+            }
+            long long cost = chrono::duration_cast<chrono::microseconds>(hclock::now() - start).count();
+            printf("%d stores %s: opened & read in %lld us, %zu files, %zu KB on disk\n", storeCount,
+                   useContainer ? "in one container" : "a file each", cost, fileCount, diskSize / 1024);
+            fflush(stdout);
+            _exit(0);
+        }
+        waitpid(pid, nullptr, 0);
+    }
+    MMKV::removeStorage(containerID);
+    for (int index = 0; index < storeCount; index++) {
+        MMKV::removeStorage(mmapID(index));
+    }
+}
+
+void testMemoryBudgetSpeed() {
+    using hclock = chrono::high_resolution_clock;
+    constexpr int instanceCount = 500;
+    constexpr int keyCount = 200;
+    constexpr int rounds = 3;
+    auto mmapID = [](int index) { return "testMemoryBudgetSpeed" + to_string(index); };
+    auto pid = fork();
+    if (pid == 0) {
+        for (int index = 0; index < instanceCount; index++) {
+            auto kv = MMKV::mmkvWithID(mmapID(index));
+            for (int key = 0; key < keyCount; key++) {
+                kv->set("value of the setting " + to_string(key), "com.example.settings.key." + to_string(key));
+            }
+        }
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+
+    for (size_t budget : {size_t(0), size_t(8 * 1024 * 1024)}) {
+        pid = fork();
+        if (pid == 0) {
+            MMKV::setMemoryBudget(budget);
+            auto rss = residentSize();
+            auto start = hclock::now();
+            vector<MMKV *> instances;
+            for (int round = 0; round < rounds; round++) {
+                for (int index = 0; index < instanceCount; index++) {
+                    auto kv = MMKV::mmkvWithID(mmapID(index));
+                    kv->containsKey("com.example.settings.key.0");
+                    if (round == 0) {
+                        instances.push_back(kv);
+                    }
+                }
+            }
+            long long cost = chrono::duration_cast<chrono::milliseconds>(hclock::now() - start).count();
+            rss = residentSize() - rss;
+            size_t totalSize = 0;
+            for (auto kv : instances) {
+                totalSize += kv->memoryUsage().totalSize();
+            }
+            printf("memory budget %zu KB, %d instances accessed %d times: %lld ms, %zu KB held, rss +%ld KB\n",
+                   budget / 1024, instanceCount, rounds, cost, totalSize / 1024, rss);
+            fflush(stdout);
+            _exit(0);
+        }
+        waitpid(pid, nullptr, 0);
+    }
+    for (int index = 0; index < instanceCount; index++) {
+        MMKV::removeStorage(mmapID(index));
+    }
+}
+
+// a malloc() wrapper that tells how much of the heap an instance holds
+void testAllocatorSpeed() {
+    using hclock = chrono::high_resolution_clock;
+    const int keyCounts[] = {10000, 100000};
+    for (int keyCount : keyCounts) {
+        auto mmapID = "testAllocatorSpeed" + to_string(keyCount);
+        auto kv = MMKV::mmkvWithID(mmapID);
+        for (int key = 0; key < keyCount; key++) {
+            kv->set("value of the setting " + to_string(key), "com.example.settings.key." + to_string(key));
+        }
+        kv->close();
+
+        for (bool tracked : {false, true}) {
+            TrackingAllocator allocator;
+            MMKVConfig config;
+            config.allocator = tracked ? &allocator : nullptr;
+            auto start = hclock::now();
+            kv = MMKV::mmkvWithID(mmapID, config);
+            kv->count();
+            long long cost = chrono::duration_cast<chrono::microseconds>(hclock::now() - start).count();
+            printf("load %d keys with %s allocator: %lld us, %lld KB held by the instance\n", keyCount,
+                   tracked ? "tracking" : "default", cost, (long long) allocator.m_liveBytes.load() / 1024);
+            kv->close();
+        }
+        MMKV::removeStorage(mmapID);
+    }
+}
+
 int main() {
     locale::global(locale(""));
     wcout.imbue(locale(""));
@@ -1472,11 +2379,33 @@ int main() {
     threadTest();
     processTest();
     testInterProcessLock();
+    testSharedMemoryLockSpeed();
+    testMetaGenerationSpeed();
+    testDeltaReloadSpeed();
+    testSharedIndexSpeed();
+    testPrefixSpeed();
+    testKeyPrefixesSpeed();
+    testKeyHandleSpeed();
+    testDictionaryArenaSpeed();
+    testAllocatorSpeed();
+    testCryptMemoryLimitSpeed();
+    testMemoryBudgetSpeed();
+    testContainerSpeed();
+#ifdef MMKV_LINUX
+    testChangeNotificationSpeed();
+#endif
     testExpectedCapacity();
     testOnlyOneKey();
     testOverride();
     testClearAllKeepSpace();
 //    testGetStringSpeed();
+    testEncodeContainerSpeed();
+    testDecodeVectorSpeed();
+    testAlignedVectorSpeed();
+    testValueStreamSpeed();
+    testBlobSeparationSpeed();
+    testSegmentedLogSpeed();
+    testPartitionedSpeed();
     testCompareBeforeSet();
     testBackup();
     testRestore();
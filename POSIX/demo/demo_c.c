@@ -27,6 +27,7 @@
 #include <float.h>
 #include <limits.h>
 #include <math.h>
+#include <time.h>
 
 /* ── Log callback ──────────────────────────────────────────────────── */
 
@@ -248,6 +249,77 @@ static void valueInspectionTest(MMKVHandle_t kv) {
     printf("=== Value Inspection & Lock Test Done ===\n");
 }
 
+/* ── Batch test ────────────────────────────────────────────────────── */
+
+static double elapsedMicroseconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+struct BatchVisit {
+    uint64_t matched;
+    uint64_t bytes;
+};
+
+static bool batchVisitor(const char *key, uint32_t keyLength, const void *value, uint64_t valueLength, void *context) {
+    struct BatchVisit *visit = (struct BatchVisit *) context;
+    if (value && keyLength > 6 && memcmp(key, "batch_", 6) == 0) {
+        visit->matched++;
+        visit->bytes += valueLength;
+    }
+    return false;
+}
+
+static void batchTest(MMKVHandle_t kv) {
+    printf("\n=== Batch Test (C Bridge) ===\n");
+
+    enum { COUNT = 200 };
+    static char keyStorage[COUNT][16], valueStorage[COUNT][32];
+    const char *keys[COUNT + 1];
+    const void *values[COUNT];
+    uint64_t lengths[COUNT];
+    for (int i = 0; i < COUNT; i++) {
+        snprintf(keyStorage[i], sizeof(keyStorage[i]), "batch_%d", i);
+        snprintf(valueStorage[i], sizeof(valueStorage[i]), "value of %d", i);
+        keys[i] = keyStorage[i];
+        values[i] = valueStorage[i];
+        lengths[i] = strlen(valueStorage[i]);
+    }
+    keys[COUNT] = "batch_missing";
+    bool ret = mmkv_multi_set(kv, keys, values, lengths, COUNT);
+    printf("multi_set %d keys = %d, count = %" PRIu64 "\n", COUNT, ret, mmkv_count(kv, false));
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int64_t valueLengths[COUNT + 1];
+    char *arena = mmkv_multi_get(kv, keys, COUNT + 1, valueLengths);
+    double batchCost = elapsedMicroseconds(&start);
+    bool matched = arena != NULL && valueLengths[COUNT] == -1;
+    size_t offset = 0;
+    for (int i = 0; i < COUNT && matched; i++) {
+        matched = valueLengths[i] == (int64_t) lengths[i] && memcmp(arena + offset, valueStorage[i], lengths[i]) == 0;
+        offset += valueLengths[i] > 0 ? (size_t) valueLengths[i] : 0;
+    }
+    mmkv_free(arena);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < COUNT; i++) {
+        mmkv_free(mmkv_decode_string(kv, keys[i]));
+    }
+    double singleCost = elapsedMicroseconds(&start);
+    printf("multi_get %d keys matched = %d, %.1f us, one by one %.1f us\n", COUNT + 1, matched, batchCost, singleCost);
+
+    struct BatchVisit visit = {0, 0};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t visited = mmkv_for_each(kv, batchVisitor, &visit);
+    printf("for_each visited %" PRIu64 " keys, %" PRIu64 " batch values of %" PRIu64 " bytes, %.1f us\n", visited,
+           visit.matched, visit.bytes, elapsedMicroseconds(&start));
+
+    mmkv_remove_values(kv, keys, COUNT);
+    printf("=== Batch Test Done ===\n");
+}
+
 /* ── NameSpace test ────────────────────────────────────────────────── */
 
 static void namespaceTest(void) {
@@ -351,6 +423,7 @@ int main(void) {
     functionalTest(kv);
     encryptionTest();
     valueInspectionTest(kv);
+    batchTest(kv);
     namespaceTest();
 
     mmkv_on_exit();
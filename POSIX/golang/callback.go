@@ -26,6 +26,7 @@ package mmkv
 #include <stdlib.h>
 */
 import "C"
+import "sync"
 
 const (
 	OnErrorDiscard = iota // When there's an error, MMKV will discard everything by default.
@@ -125,3 +126,32 @@ func myContentLoadedHandler(mmapID string) {
 		gHandler.OnMMKVContentLoadSuccessfully(mmapID)
 	}
 }
+
+// visitors of ForEach() in flight, a Go func can't be handed to C directly
+var gVisitors = struct {
+	sync.Mutex
+	next     uintptr
+	visitors map[uintptr]func(key string, value []byte) bool
+}{visitors: make(map[uintptr]func(key string, value []byte) bool)}
+
+func registerVisitor(visitor func(key string, value []byte) bool) uintptr {
+	gVisitors.Lock()
+	defer gVisitors.Unlock()
+	gVisitors.next++
+	gVisitors.visitors[gVisitors.next] = visitor
+	return gVisitors.next
+}
+
+func unregisterVisitor(context uintptr) {
+	gVisitors.Lock()
+	defer gVisitors.Unlock()
+	delete(gVisitors.visitors, context)
+}
+
+//export myForEachVisitor
+func myForEachVisitor(context uintptr, key string, value []byte) bool {
+	gVisitors.Lock()
+	visitor := gVisitors.visitors[context]
+	gVisitors.Unlock()
+	return visitor == nil || visitor(key, value)
+}
@@ -38,6 +38,7 @@ extern "C" void myLogHandler(int64_t level, GoStringWrap file, int64_t line, GoS
 extern "C" int64_t myErrorHandler(GoStringWrap mmapID, int64_t error);
 extern "C" void myContentChangeHandler(GoStringWrap mmapID);
 extern "C" void myContentLoadedHandler(GoStringWrap mmapID);
+extern "C" uint8_t myForEachVisitor(uintptr_t context, GoStringWrap key, GoSliceWrap value);
 
 class GoMMKVHandler : public mmkv::MMKVHandler {
 public:
@@ -409,19 +410,13 @@ MMKV_EXPORT void *decodeBytes(void *handle, GoStringWrap oKey, uint64_t *lengthP
         auto key = string(oKey.ptr, oKey.length);
         auto value = kv->getBytes(key);
         if (value.length() > 0) {
-            if (value.isStoredOnStack()) {
-                auto result = malloc(value.length());
-                if (result) {
-                    memcpy(result, value.getPtr(), value.length());
-                    *lengthPtr = value.length();
-                }
-                return result;
-            } else {
-                void *result = value.getPtr();
-                *lengthPtr = value.length();
-                value.detach();
-                return result;
+            auto length = value.length();
+            // freed by the caller with free()
+            auto result = value.detachToMalloc();
+            if (result) {
+                *lengthPtr = length;
             }
+            return result;
         }
     }
     return nullptr;
@@ -510,6 +505,24 @@ MMKV_EXPORT GoStringWrap *allKeys(void *handle, uint64_t *lengthPtr, bool filter
     return nullptr;
 }
 
+// hand the views to Go as they are, the visitor is told not to keep them
+MMKV_EXPORT uint64_t forEach(void *handle, uintptr_t context) {
+    MMKV *kv = static_cast<MMKV *>(handle);
+    if (!kv) {
+        return 0;
+    }
+    return kv->forEach([context](string_view key, const MMBuffer &value) {
+        GoStringWrap oKey { key.data(), static_cast<int64_t>(key.size()) };
+        GoSliceWrap oValue { nullptr, 0, 0 };
+        MMBuffer bytes;
+        if (MMKV::bytesView(value, bytes)) {
+            auto length = static_cast<int64_t>(bytes.length());
+            oValue = { bytes.getPtr(), length, length };
+        }
+        return myForEachVisitor(context, oKey, oValue) != 0;
+    });
+}
+
 MMKV_EXPORT bool containsKey(void *handle, GoStringWrap oKey) {
     MMKV *kv = static_cast<MMKV *>(handle);
     if (kv && oKey.ptr) {
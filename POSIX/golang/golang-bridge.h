@@ -103,6 +103,7 @@ void *cryptKey(void *handle, uint32_t *lengthPtr);
 void checkReSetCryptKey(void *handle, GoStringWrap_t oKey, bool aes256);
 
 GoStringWrap_t *allKeys(void *handle, uint64_t *lengthPtr, bool filterExpire);
+uint64_t forEach(void *handle, uintptr_t context);
 bool containsKey(void *handle, GoStringWrap_t oKey);
 uint64_t count(void *handle, bool filterExpire);
 uint64_t totalSize(void *handle);
@@ -257,6 +257,12 @@ type MMKV interface {
 	// AllNonExpireKeys same as AllKeys() except that it filters expired keys
 	AllNonExpireKeys() []string
 
+	// ForEach visit every key and its string/bytes value (nil for other types) without copying them.
+	// They are only valid inside visitor, copy them to keep. Expired keys are skipped.
+	// Return true from visitor to stop, don't modify the instance inside it.
+	// Return the number of keys visited.
+	ForEach(visitor func(key string, value []byte) bool) uint64
+
 	Contains(key string) bool
 
 	// TotalSize total size of the file
@@ -718,6 +724,12 @@ func (kv ctorMMKV) AllNonExpireKeys() []string {
 	return kv.allKeys(true)
 }
 
+func (kv ctorMMKV) ForEach(visitor func(key string, value []byte) bool) uint64 {
+	context := registerVisitor(visitor)
+	defer unregisterVisitor(context)
+	return uint64(C.forEach(unsafe.Pointer(kv), C.uintptr_t(context)))
+}
+
 func (kv ctorMMKV) Contains(key string) bool {
 	ret := C.containsKey(unsafe.Pointer(kv), C.wrapGoString(key))
 	return bool(ret)
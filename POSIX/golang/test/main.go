@@ -90,6 +90,13 @@ func functionalTest() {
 
 	kv.RemoveKeys([]string{"int32", "int64"})
 	fmt.Println("count =", kv.Count(), ", all keys:", kv.AllKeys())
+	visited := kv.ForEach(func(key string, value []byte) bool {
+		if value != nil {
+			fmt.Println("for each:", key, "=", string(value))
+		}
+		return false
+	})
+	fmt.Println("visited", visited, "keys")
 
 	kv.Trim()
 	kv.ClearMemoryCache()
@@ -366,6 +366,24 @@ PYBIND11_MODULE(mmkv, m) {
 
     clsMMKV.def("__contains__", &MMKV::containsKey, py::arg("key"));
     clsMMKV.def("keys", &MMKV::allKeys, py::arg("filterExpire") = false);
+    clsMMKV.def(
+        "forEach",
+        [](MMKV &kv, const py::function &callback) {
+            return kv.forEach([&callback](string_view key, const MMBuffer &value) {
+                py::str pyKey(key.data(), key.size());
+                MMBuffer bytes;
+                if (!MMKV::bytesView(value, bytes)) {
+                    return callback(pyKey, py::none()).cast<bool>();
+                }
+                // copied, the value points into the mapping (or a temporary decrypted buffer) that Python can't pin
+                py::bytes pyValue((const char *) bytes.getPtr(), bytes.length());
+                return callback(pyKey, pyValue).cast<bool>();
+            });
+        },
+        "visit every key with its string/bytes value (None for other types) as bytes under one lock,\n"
+        "expired keys are skipped; return True from callback to stop, don't modify the instance inside it\n"
+        "return the number of keys visited",
+        py::arg("callback"));
 
     clsMMKV.def("count", &MMKV::count, py::arg("filterExpire") = false);
     clsMMKV.def("totalSize", &MMKV::totalSize);
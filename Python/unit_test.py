@@ -180,6 +180,29 @@ def test_bytes(kv):
     print('test bytes: passed')
 
 
+def test_for_each(kv):
+    kv.set(b'for', 'forEach-bytes')
+    kv.set('each', 'forEach-string')
+
+    visited = {}
+
+    def visit(key, value):
+        visited[key] = value
+        return False
+
+    count = kv.forEach(visit)
+    assert count == kv.count()
+    # still valid after the call
+    assert visited['forEach-bytes'] == b'for'
+    assert visited['forEach-string'] == b'each'
+    assert visited['bool'] is None
+
+    count = kv.forEach(lambda key, value: True)
+    assert count == 1
+
+    print('test forEach: passed')
+
+
 def test_equal(kv, mmap_id):
     assert kv.mmapID() == mmap_id
 
@@ -206,4 +229,5 @@ if __name__ == '__main__':
     test_float(kv)
     test_string(kv)
     test_bytes(kv)
+    test_for_each(kv)
     test_equal(kv, 'unit_test_python')